@@ -35,6 +35,7 @@
 //-*****************************************************************************
 
 #include "util.h"
+#include "CreateSceneHelper.h"
 #include "NodeIteratorVisitorHelper.h"
 #include "AbcImport.h"
 
@@ -97,6 +98,18 @@ scene but doesn't exist in the archive, children of that node will be connected\
 -eft / excludeFilterObjects \"regex1 regex2 ...\"                          \n\
                     Selective exclude cache objects whose name matches with \n\
 the input regular expressions.                                              \n\
+-dl / depthLimit    int                                                     \n\
+                    Only create the top N levels of the hierarchy. Nodes at \
+the limit that have children are created as placeholders, tagged with the   \n\
+                    AbcDeferredPath and AbcDeferredFiles attributes.        \n\
+-exp/ expand        string node1 node2 ...                                  \n\
+                    Create the sub-trees of the given placeholder nodes. The\
+ -depthLimit, -filterObjects, -excludeFilterObjects and -attributeFilter    \n\
+                    flags apply to the expanded sub-trees. No file argument \
+is needed, the files are taken from the placeholders.                       \n\
+-af / attributeFilter \"regex1 regex2 ...\"                                 \n\
+                    Only create the arbitrary and user attributes whose name\
+ matches with the input regular expressions.                                \n\
 -h  / help          Print this message                                      \n\
 -d  / debug         Turn on debug message printout                        \n\n\
 Specifying more than one file will layer those files together.            \n\n\
@@ -105,7 +118,9 @@ AbcImport -h;                                                               \n\
 AbcImport -d -m open \"/tmp/test.abc\";                                     \n\
 AbcImport -ftr -ct \"/\" -crt -rm \"/tmp/test.abc\";                        \n\
 AbcImport -ct \"root1 root2 root3 ...\" \"/tmp/test.abc\";                  \n\
-AbcImport \"/tmp/test.abc\" \"/tmp/justUVs.abc\" \"/tmp/other.abc\"         \n"
+AbcImport \"/tmp/test.abc\" \"/tmp/justUVs.abc\" \"/tmp/other.abc\"         \n\
+AbcImport -dl 2 -af \"^material\" \"/tmp/layout.abc\";                        \n\
+AbcImport -dl 1 -exp \"set_A|building_12\";                                 \n"
 );  // usage
 
 };
@@ -139,7 +154,11 @@ MSyntax AbcImport::createSyntax()
     syntax.addFlag("-ft",   "-filterObjects",    MSyntax::kString);
     syntax.addFlag("-eft",  "-excludeFilterObjects",    MSyntax::kString);
 
-    syntax.setObjectType( MSyntax::kStringObjects, 1, 1024 );
+    syntax.addFlag("-dl",   "-depthLimit",       MSyntax::kLong);
+    syntax.addFlag("-exp",  "-expand",           MSyntax::kString);
+    syntax.addFlag("-af",   "-attributeFilter",  MSyntax::kString);
+
+    syntax.setObjectType( MSyntax::kStringObjects, 0, 1024 );
 
     syntax.enableQuery(true);
     syntax.enableEdit(false);
@@ -163,6 +182,8 @@ MStatus AbcImport::doIt(const MArgList & args)
     MString connectRootNodes("");
     MString filterString("");
     MString excludeFilterString("");
+    MString attrFilterString("");
+    int     depthLimit = -1;
 
     MObject reparentObj = MObject::kNullObj;
 
@@ -235,6 +256,21 @@ MStatus AbcImport::doIt(const MArgList & args)
         argData.getFlagArgument("excludeFilterObjects", 0, excludeFilterString);
     }
 
+    if (argData.isFlagSet("attributeFilter"))
+    {
+        argData.getFlagArgument("attributeFilter", 0, attrFilterString);
+    }
+
+    if (argData.isFlagSet("depthLimit"))
+    {
+        argData.getFlagArgument("depthLimit", 0, depthLimit);
+        if (depthLimit < 1)
+        {
+            printWarning("-depthLimit must be at least 1, ignoring it");
+            depthLimit = -1;
+        }
+    }
+
     // if the flag isn't specified we'll only do stuff marked with the Maya
     // meta data
     bool recreateColorSets = false;
@@ -243,6 +279,52 @@ MStatus AbcImport::doIt(const MArgList & args)
         recreateColorSets = true;
     }
 
+    if (argData.isFlagSet("expand"))
+    {
+        MString placeholders;
+        argData.getFlagArgument("expand", 0, placeholders);
+
+        MStringArray nameArray;
+        placeholders.split(' ', nameArray);
+
+        MStringArray abcNodeNames;
+        for (unsigned int i = 0; i < nameArray.length(); ++i)
+        {
+            MDagPath placeholderPath;
+            MString abcPath;
+            std::vector< std::string > placeholderFiles;
+            if (getDagPathByName(nameArray[i], placeholderPath) !=
+                MS::kSuccess ||
+                !getPlaceholderInfo(placeholderPath.node(), abcPath,
+                    placeholderFiles))
+            {
+                MString theWarning = nameArray[i];
+                theWarning += MString(" is not an Alembic placeholder node");
+                printWarning(theWarning);
+                continue;
+            }
+
+            MObject placeholderObj = placeholderPath.node();
+
+            // the sub-tree of a deferred shape goes under its transform
+            ArgData inputData(placeholderFiles, debugOn,
+                placeholderPath.transform(),
+                false, MString(), false, false, recreateColorSets,
+                filterString, excludeFilterString, depthLimit,
+                attrFilterString, abcPath);
+            MString expandedNodeName = createScene(inputData);
+            if (expandedNodeName.length() > 0)
+            {
+                abcNodeNames.append(expandedNodeName);
+            }
+
+            clearPlaceholder(placeholderObj);
+        }
+
+        MPxCommand::setResult(abcNodeNames);
+        return MS::kSuccess;
+    }
+
     MString abcNodeName;
 
     MStringArray filenameArray;
@@ -326,7 +408,8 @@ MStatus AbcImport::doIt(const MArgList & args)
         {
             ArgData inputData(filenameList, debugOn, reparentObj,
                 swap, connectRootNodes, createIfNotFound, removeIfNoUpdate,
-                recreateColorSets, filterString, excludeFilterString);
+                recreateColorSets, filterString, excludeFilterString,
+                depthLimit, attrFilterString);
             abcNodeName = createScene(inputData);
 
             if (inputData.mSequenceStartTime != inputData.mSequenceEndTime &&
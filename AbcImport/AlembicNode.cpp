@@ -84,6 +84,9 @@ MObject AlembicNode::mStartFrameAttr;
 MObject AlembicNode::mEndFrameAttr;
 MObject AlembicNode::mIncludeFilterAttr;
 MObject AlembicNode::mExcludeFilterAttr;
+MObject AlembicNode::mDepthLimitAttr;
+MObject AlembicNode::mAttrFilterAttr;
+MObject AlembicNode::mRootPathAttr;
 
 MObject AlembicNode::mOutSubDArrayAttr;
 MObject AlembicNode::mOutPolyArrayAttr;
@@ -176,6 +179,27 @@ MStatus AlembicNode::initialize()
     status = tAttr.setHidden(true);
     status = addAttribute(mExcludeFilterAttr);
 
+    // Lazy import options
+    // These are hidden variables to preserve the depth limit, attribute
+    // filter and sub-tree root of a lazy import into a .ma file.
+    mDepthLimitAttr = nAttr.create("depthLimit", "dlm",
+        MFnNumericData::kInt, -1, &status);
+    status = nAttr.setStorable(true);
+    status = nAttr.setHidden(true);
+    status = addAttribute(mDepthLimitAttr);
+
+    mAttrFilterAttr = tAttr.create("regexAttributeFilter", "aft",
+        MFnData::kString);
+    status = tAttr.setStorable(true);
+    status = tAttr.setHidden(true);
+    status = addAttribute(mAttrFilterAttr);
+
+    mRootPathAttr = tAttr.create("abcRootPath", "arp",
+        MFnData::kString);
+    status = tAttr.setStorable(true);
+    status = tAttr.setHidden(true);
+    status = addAttribute(mRootPathAttr);
+
     // sequence min and max in frames
     mStartFrameAttr = nAttr.create("startFrame", "sf",
         MFnNumericData::kDouble, 0, &status);
@@ -573,12 +597,54 @@ MStatus AlembicNode::compute(const MPlug & plug, MDataBlock & dataBlock)
             mExcludeFilterString = excludeFilterString;
         }
 
+        // same for the lazy import options
+        MDataHandle depthLimitHandle =
+            dataBlock.inputValue(mDepthLimitAttr, &status);
+
+        if (mDepthLimit >= 0)
+        {
+            depthLimitHandle.set(mDepthLimit);
+            dataBlock.setClean(mDepthLimitAttr);
+        }
+        else
+        {
+            mDepthLimit = depthLimitHandle.asInt();
+        }
+
+        MDataHandle attrFilterHandle =
+            dataBlock.inputValue(mAttrFilterAttr, &status);
+        MString& attrFilterString = attrFilterHandle.asString();
+
+        if (mAttrFilterString.length() > 0)
+        {
+            attrFilterHandle.set(mAttrFilterString);
+            dataBlock.setClean(mAttrFilterAttr);
+        }
+        else if (attrFilterString.length() > 0)
+        {
+            mAttrFilterString = attrFilterString;
+        }
+
+        MDataHandle rootPathHandle =
+            dataBlock.inputValue(mRootPathAttr, &status);
+        MString& rootPathString = rootPathHandle.asString();
+
+        if (mRootPath.length() > 0)
+        {
+            rootPathHandle.set(mRootPath);
+            dataBlock.setClean(mRootPathAttr);
+        }
+        else if (rootPathString.length() > 0)
+        {
+            mRootPath = rootPathString;
+        }
 
         MFnDependencyNode dep(thisMObject());
         MPlug allSetsPlug = dep.findPlug("allColorSets", true);
         CreateSceneVisitor visitor(inputTime, !allSetsPlug.isNull(),
             MObject::kNullObj, CreateSceneVisitor::NONE, "",
-            mIncludeFilterString, mExcludeFilterString);
+            mIncludeFilterString, mExcludeFilterString, mDepthLimit,
+            mAttrFilterString, mRootPath);
 
         visitor.walk(archive);
 
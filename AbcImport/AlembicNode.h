@@ -55,7 +55,7 @@ class AlembicNode : public MPxNode
 {
 public:
 
-    AlembicNode() : mFileInitialized(0), mDebugOn(false)
+    AlembicNode() : mFileInitialized(0), mDebugOn(false), mDepthLimit(-1)
     {
         mCurTime = DBL_MAX;
 
@@ -91,6 +91,9 @@ public:
     static MObject mCycleTypeAttr;
     static MObject mIncludeFilterAttr;
     static MObject mExcludeFilterAttr;
+    static MObject mDepthLimitAttr;
+    static MObject mAttrFilterAttr;
+    static MObject mRootPathAttr;
 
     // output attributes
     static MObject mOutPropArrayAttr;
@@ -138,6 +141,13 @@ public:
     {
         mExcludeFilterString = iExcludeFilterString;
     }
+    void   setLazyOptions(int iDepthLimit, const MString & iAttrFilterString,
+                          const MString & iRootPath)
+    {
+        mDepthLimit = iDepthLimit;
+        mAttrFilterString = iAttrFilterString;
+        mRootPath = iRootPath;
+    }
 
 private:
     // compute the adjusted time from inputTime, speed and time offset.
@@ -185,6 +195,12 @@ private:
     MString mIncludeFilterString;
     MString mExcludeFilterString;
 
+    // lazy import options, the hierarchy walk has to match the one done
+    // by AbcImport for the connections to line up
+    int     mDepthLimit;
+    MString mAttrFilterString;
+    MString mRootPath;
+
     WriterData mData;
 };
 
@@ -57,6 +57,7 @@
 #include <maya/MFnDagNode.h>
 #include <maya/MFnIntArrayData.h>
 #include <maya/MFnStringData.h>
+#include <maya/MFnStringArrayData.h>
 #include <maya/MFnTransform.h>
 #include <maya/MFnNumericAttribute.h>
 #include <maya/MFnNurbsCurve.h>
@@ -177,7 +178,8 @@ namespace
         fnSet.addMember(dpShape, comp);
     }
 
-    void addFaceSets(MObject & iNode, Alembic::Abc::IObject & iObj)
+    void addFaceSets(MObject & iNode, Alembic::Abc::IObject & iObj,
+                     const PropFilter & iFilter)
     {
         MStatus status;
 
@@ -243,8 +245,8 @@ namespace
                 Alembic::Abc::ICompoundProperty userProp =
                     faceSet.getSchema().getUserProperties();
 
-                addProps(arbProp, shadingGroup, false);
-                addProps(userProp, shadingGroup, false);
+                addProps(arbProp, shadingGroup, false, iFilter);
+                addProps(userProp, shadingGroup, false, iFilter);
             }
         }
     }
@@ -322,6 +324,28 @@ namespace
         return false;
     }
 
+    Alembic::Abc::IObject findObjectByPath(Alembic::Abc::IObject iTop,
+                                           const std::string & iPath)
+    {
+        Alembic::Abc::IObject obj = iTop;
+        std::size_t start = 0;
+        while (obj.valid() && start < iPath.size())
+        {
+            std::size_t end = iPath.find('/', start);
+            if (end == std::string::npos)
+            {
+                end = iPath.size();
+            }
+
+            if (end > start)
+            {
+                obj = obj.getChild(iPath.substr(start, end - start));
+            }
+            start = end + 1;
+        }
+        return obj;
+    }
+
     void connectIntermediateMesh(MFnMesh& ioFn, MFnMesh& fn)
     {
         // Maya doesn't allow to delete history on a referenced mesh. We
@@ -373,9 +397,12 @@ namespace
 CreateSceneVisitor::CreateSceneVisitor(double iFrame,
     bool iUnmarkedFaceVaryingColors, const MObject & iParent,
     Action iAction, MString iRootNodes,
-    MString iIncludeFilterString, MString iExcludeFilterString) :
+    MString iIncludeFilterString, MString iExcludeFilterString,
+    int iDepthLimit, MString iAttrFilterString, MString iRootPath) :
     mFrame(iFrame), mParent(iParent),
-    mUnmarkedFaceVaryingColors(iUnmarkedFaceVaryingColors), mAction(iAction)
+    mUnmarkedFaceVaryingColors(iUnmarkedFaceVaryingColors), mAction(iAction),
+    mDepthLimit(iDepthLimit), mAttrFilter(iAttrFilterString),
+    mRootPath(iRootPath.asChar())
 {
     mAnyRoots = false;
 
@@ -431,6 +458,64 @@ CreateSceneVisitor::~CreateSceneVisitor()
 {
 }
 
+void CreateSceneVisitor::setPlaceholderFiles(
+    const std::vector<std::string> & iFileNames)
+{
+    mPlaceholderFiles = iFileNames;
+}
+
+bool CreateSceneVisitor::isDeferred(const Alembic::Abc::IObject & iObj) const
+{
+    return mDeferredPaths.find(iObj.getFullName()) != mDeferredPaths.end();
+}
+
+void CreateSceneVisitor::tagPlaceholder(MObject & iNode,
+    const Alembic::Abc::IObject & iObj)
+{
+    if (!isDeferred(iObj))
+    {
+        return;
+    }
+
+    MFnDependencyNode fnDepNode(iNode);
+
+    MPlug pathPlug = fnDepNode.findPlug(kPlaceholderPathAttr, true);
+    if (pathPlug.isNull())
+    {
+        MFnStringData fnStringData;
+        MObject strAttrObject = fnStringData.create("");
+
+        MFnTypedAttribute attr;
+        MObject attrObj = attr.create(kPlaceholderPathAttr,
+            kPlaceholderPathAttr, MFnData::kString, strAttrObject);
+        fnDepNode.addAttribute(attrObj);
+        pathPlug = fnDepNode.findPlug(attrObj, true);
+    }
+    pathPlug.setString(iObj.getFullName().c_str());
+
+    MStringArray files;
+    std::vector<std::string>::const_iterator it = mPlaceholderFiles.begin();
+    for (; it != mPlaceholderFiles.end(); ++it)
+    {
+        files.append(it->c_str());
+    }
+
+    MFnStringArrayData fnFilesData;
+    MObject filesObject = fnFilesData.create(files);
+
+    MPlug filesPlug = fnDepNode.findPlug(kPlaceholderFilesAttr, true);
+    if (filesPlug.isNull())
+    {
+        MFnTypedAttribute attr;
+        MObject attrObj = attr.create(kPlaceholderFilesAttr,
+            kPlaceholderFilesAttr, MFnData::kStringArray);
+        attr.setUsedAsFilename(true);
+        fnDepNode.addAttribute(attrObj);
+        filesPlug = fnDepNode.findPlug(attrObj, true);
+    }
+    filesPlug.setValue(filesObject);
+}
+
 void CreateSceneVisitor::getData(WriterData & oData)
 {
     oData = mData;
@@ -479,7 +564,7 @@ void CreateSceneVisitor::addFaceSetsAfterConnection()
     for (; i != end; ++i)
     {
         MObject dagNode = i->first;
-        addFaceSets(dagNode, i->second);
+        addFaceSets(dagNode, i->second, mAttrFilter);
     }
 }
 
@@ -581,7 +666,8 @@ void CreateSceneVisitor::visit(AlembicObjectPtr iObject)
     }
 }
 
-AlembicObjectPtr CreateSceneVisitor::previsit(AlembicObjectPtr iParentObject)
+AlembicObjectPtr CreateSceneVisitor::previsit(AlembicObjectPtr iParentObject,
+    int iDepth)
 {
     Alembic::Abc::IObject parent = iParentObject->object();
     const MString name = parent.getFullName().c_str();
@@ -594,11 +680,21 @@ AlembicObjectPtr CreateSceneVisitor::previsit(AlembicObjectPtr iParentObject)
         return AlembicObjectPtr();
     }
 
+    // Lazy import: don't descend below the depth limit at all, the
+    // sub-tree is only read when the placeholder gets expanded, which is
+    // also when the include filters get applied to it.
+    if (mDepthLimit >= 0 && iDepth > 0 && iDepth >= mDepthLimit &&
+        numChildren > 0)
+    {
+        mDeferredPaths.insert(parent.getFullName());
+        return iParentObject;
+    }
+
     for (size_t i = 0; i < numChildren; ++i)
     {
         Alembic::Abc::IObject child = parent.getChild(i);
         AlembicObjectPtr childObject =
-            previsit(AlembicObjectPtr(new AlembicObject(child)));
+            previsit(AlembicObjectPtr(new AlembicObject(child)), iDepth + 1);
 
         if (childObject)
         {
@@ -664,9 +760,25 @@ MStatus CreateSceneVisitor::walk(Alembic::Abc::IArchive & iRoot)
 
     if (!iRoot.valid()) return MS::kFailure;
 
+    // when expanding a placeholder, start from the deferred object instead
+    // of the top of the archive
+    Alembic::Abc::IObject top = iRoot.getTop();
+    if (!mRootPath.empty())
+    {
+        top = findObjectByPath(top, mRootPath);
+        if (!top.valid())
+        {
+            MString theError("Could not find ");
+            theError += mRootPath.c_str();
+            theError += " in the archive.";
+            printError(theError);
+            return MS::kFailure;
+        }
+    }
+
     // preload the cache hierarchy with an optional filtering.
     AlembicObjectPtr topObject =
-        previsit(AlembicObjectPtr(new AlembicObject(iRoot.getTop())));
+        previsit(AlembicObjectPtr(new AlembicObject(top)));
 
     if (!topObject) return status;
 
@@ -845,8 +957,8 @@ MStatus CreateSceneVisitor::operator()(Alembic::AbcGeom::ICamera & iNode)
         iNode.getSchema().getUserProperties();
 
     std::size_t firstProp = mData.mPropList.size();
-    getAnimatedProps(arbProp, mData.mPropList, false);
-    getAnimatedProps(userProp, mData.mPropList, false);
+    getAnimatedProps(arbProp, mData.mPropList, false, mAttrFilter);
+    getAnimatedProps(userProp, mData.mPropList, false, mAttrFilter);
     Alembic::Abc::IScalarProperty visProp = getVisible(iNode, isConstant,
         mData.mPropList, mData.mAnimVisStaticObjList);
 
@@ -876,8 +988,9 @@ MStatus CreateSceneVisitor::operator()(Alembic::AbcGeom::ICamera & iNode)
     if (cameraObj != MObject::kNullObj)
     {
         setConstantVisibility(visProp, cameraObj);
-        addProps(arbProp, cameraObj, false);
-        addProps(userProp, cameraObj, false);
+        addProps(arbProp, cameraObj, false, mAttrFilter);
+        addProps(userProp, cameraObj, false, mAttrFilter);
+        tagPlaceholder(cameraObj, iNode);
     }
 
     if ( mAction >= CONNECT )
@@ -943,8 +1056,8 @@ MStatus CreateSceneVisitor::operator()(Alembic::AbcGeom::ICurves & iNode)
     }
 
     std::size_t firstProp = mData.mPropList.size();
-    getAnimatedProps(arbProp, mData.mPropList, false);
-    getAnimatedProps(userProp, mData.mPropList, false);
+    getAnimatedProps(arbProp, mData.mPropList, false, mAttrFilter);
+    getAnimatedProps(userProp, mData.mPropList, false, mAttrFilter);
     Alembic::Abc::IScalarProperty visProp = getVisible(iNode, isConstant,
         mData.mPropList, mData.mAnimVisStaticObjList);
 
@@ -994,8 +1107,9 @@ MStatus CreateSceneVisitor::operator()(Alembic::AbcGeom::ICurves & iNode)
     if (curvesObj != MObject::kNullObj)
     {
         setConstantVisibility(visProp, curvesObj);
-        addProps(arbProp, curvesObj, false);
-        addProps(userProp, curvesObj, false);
+        addProps(arbProp, curvesObj, false, mAttrFilter);
+        addProps(userProp, curvesObj, false, mAttrFilter);
+        tagPlaceholder(curvesObj, iNode);
     }
 
 
@@ -1088,8 +1202,9 @@ MStatus CreateSceneVisitor::operator()(Alembic::AbcGeom::IPoints& iNode)
         Alembic::Abc::ICompoundProperty userProp =
             iNode.getSchema().getUserProperties();
 
-        addProps(arbProp, particleObj, false);
-        addProps(userProp, particleObj, false);
+        addProps(arbProp, particleObj, false, mAttrFilter);
+        addProps(userProp, particleObj, false, mAttrFilter);
+        tagPlaceholder(particleObj, iNode);
     }
 
     if (hasDag)
@@ -1128,8 +1243,10 @@ MStatus CreateSceneVisitor::operator()(Alembic::AbcGeom::ISubD& iNode)
 
     std::size_t firstProp = mData.mPropList.size();
 
-    getAnimatedProps(arbProp, mData.mPropList, mUnmarkedFaceVaryingColors);
-    getAnimatedProps(userProp, mData.mPropList, mUnmarkedFaceVaryingColors);
+    getAnimatedProps(arbProp, mData.mPropList, mUnmarkedFaceVaryingColors,
+        mAttrFilter);
+    getAnimatedProps(userProp, mData.mPropList, mUnmarkedFaceVaryingColors,
+        mAttrFilter);
     Alembic::Abc::IScalarProperty visProp = getVisible(iNode, isConstant,
         mData.mPropList, mData.mAnimVisStaticObjList);
 
@@ -1160,9 +1277,10 @@ MStatus CreateSceneVisitor::operator()(Alembic::AbcGeom::ISubD& iNode)
     if (subDObj != MObject::kNullObj)
     {
         setConstantVisibility(visProp, subDObj);
-        addProps(arbProp, subDObj, mUnmarkedFaceVaryingColors);
-        addProps(userProp, subDObj, mUnmarkedFaceVaryingColors);
-        addFaceSets(subDObj, iNode);
+        addProps(arbProp, subDObj, mUnmarkedFaceVaryingColors, mAttrFilter);
+        addProps(userProp, subDObj, mUnmarkedFaceVaryingColors, mAttrFilter);
+        addFaceSets(subDObj, iNode, mAttrFilter);
+        tagPlaceholder(subDObj, iNode);
     }
 
     if ( mAction >= CONNECT )
@@ -1243,8 +1361,10 @@ MStatus CreateSceneVisitor::operator()(Alembic::AbcGeom::IPolyMesh& iNode)
         mData.mPolyMeshList.push_back(meshAndFriends);
 
     std::size_t firstProp = mData.mPropList.size();
-    getAnimatedProps(arbProp, mData.mPropList, mUnmarkedFaceVaryingColors);
-    getAnimatedProps(userProp, mData.mPropList, mUnmarkedFaceVaryingColors);
+    getAnimatedProps(arbProp, mData.mPropList, mUnmarkedFaceVaryingColors,
+        mAttrFilter);
+    getAnimatedProps(userProp, mData.mPropList, mUnmarkedFaceVaryingColors,
+        mAttrFilter);
     Alembic::Abc::IScalarProperty visProp = getVisible(iNode, isConstant,
         mData.mPropList, mData.mAnimVisStaticObjList);
 
@@ -1275,9 +1395,10 @@ MStatus CreateSceneVisitor::operator()(Alembic::AbcGeom::IPolyMesh& iNode)
     if (polyObj != MObject::kNullObj)
     {
         setConstantVisibility(visProp, polyObj);
-        addProps(arbProp, polyObj, mUnmarkedFaceVaryingColors);
-        addProps(userProp, polyObj, mUnmarkedFaceVaryingColors);
-        addFaceSets(polyObj, iNode);
+        addProps(arbProp, polyObj, mUnmarkedFaceVaryingColors, mAttrFilter);
+        addProps(userProp, polyObj, mUnmarkedFaceVaryingColors, mAttrFilter);
+        addFaceSets(polyObj, iNode, mAttrFilter);
+        tagPlaceholder(polyObj, iNode);
     }
 
     if ( mAction >= CONNECT )
@@ -1349,8 +1470,8 @@ MStatus CreateSceneVisitor::operator()(Alembic::AbcGeom::INuPatch& iNode)
         iNode.getSchema().getUserProperties();
 
     std::size_t firstProp = mData.mPropList.size();
-    getAnimatedProps(arbProp, mData.mPropList, false);
-    getAnimatedProps(userProp, mData.mPropList, false);
+    getAnimatedProps(arbProp, mData.mPropList, false, mAttrFilter);
+    getAnimatedProps(userProp, mData.mPropList, false, mAttrFilter);
     Alembic::Abc::IScalarProperty visProp = getVisible(iNode, isConstant,
         mData.mPropList, mData.mAnimVisStaticObjList);
 
@@ -1379,9 +1500,10 @@ MStatus CreateSceneVisitor::operator()(Alembic::AbcGeom::INuPatch& iNode)
 
     if (nurbsObj != MObject::kNullObj)
     {
-        addProps(arbProp, nurbsObj, false);
-        addProps(userProp, nurbsObj, false);
+        addProps(arbProp, nurbsObj, false, mAttrFilter);
+        addProps(userProp, nurbsObj, false, mAttrFilter);
         setConstantVisibility(visProp, nurbsObj);
+        tagPlaceholder(nurbsObj, iNode);
     }
 
 
@@ -1428,8 +1550,8 @@ MStatus CreateSceneVisitor::operator()(Alembic::AbcGeom::IXform & iNode,
         iNode.getSchema().getUserProperties();
 
     std::size_t firstProp = mData.mPropList.size();
-    getAnimatedProps(arbProp, mData.mPropList, false);
-    getAnimatedProps(userProp, mData.mPropList, false);
+    getAnimatedProps(arbProp, mData.mPropList, false, mAttrFilter);
+    getAnimatedProps(userProp, mData.mPropList, false, mAttrFilter);
 
     if (iNode.getProperties().getPropertyHeader("locator") != NULL)
     {
@@ -1476,9 +1598,10 @@ MStatus CreateSceneVisitor::operator()(Alembic::AbcGeom::IXform & iNode,
 
             if (xformObj != MObject::kNullObj)
             {
-                addProps(arbProp, xformObj, false);
-                addProps(userProp, xformObj, false);
+                addProps(arbProp, xformObj, false, mAttrFilter);
+                addProps(userProp, xformObj, false, mAttrFilter);
                 setConstantVisibility(visProp, xformObj);
+                tagPlaceholder(xformObj, iNode);
             }
 
             if ( mAction >= CONNECT )
@@ -1544,13 +1667,21 @@ MStatus CreateSceneVisitor::operator()(Alembic::AbcGeom::IXform & iNode,
             std::vector<MDagPath> dagToBeRemoved;
 
             // get names of immediate children so we can compare with
-            // the hierarchy in the scene
+            // the hierarchy in the scene, all of them for a deferred
+            // object as its children were not visited
             std::set< std::string > childNodesInFile;
             for (size_t j = 0; j < numChildren; ++j)
             {
                 Alembic::Abc::IObject child = iNodeObject->getChild(j)->object();
                 childNodesInFile.insert(child.getName());
             }
+            if (isDeferred(iNode))
+            {
+                for (size_t j = 0; j < iNode.getNumChildren(); ++j)
+                {
+                    childNodesInFile.insert(iNode.getChildHeader(j).getName());
+                }
+            }
 
             for (unsigned int i = 0; i < numDags; i++)
             {
@@ -1604,8 +1735,9 @@ MStatus CreateSceneVisitor::operator()(Alembic::AbcGeom::IXform & iNode,
         if (xformObj != MObject::kNullObj)
         {
             setConstantVisibility(visProp, xformObj);
-            addProps(arbProp, xformObj, false);
-            addProps(userProp, xformObj, false);
+            addProps(arbProp, xformObj, false, mAttrFilter);
+            addProps(userProp, xformObj, false, mAttrFilter);
+            tagPlaceholder(xformObj, iNode);
         }
 
         if (mAction >= CONNECT)
@@ -1683,13 +1815,21 @@ MStatus CreateSceneVisitor::createEmptyObject(AlembicObjectPtr iNodeObject)
         std::vector<MDagPath> dagToBeRemoved;
 
         // get names of immediate children so we can compare with
-        // the hierarchy in the scene
+        // the hierarchy in the scene, all of them for a deferred
+        // object as its children were not visited
         std::set< std::string > childNodesInFile;
         for (size_t j = 0; j < numChildren; ++j)
         {
             Alembic::Abc::IObject child = iNodeObject->getChild(j)->object();
             childNodesInFile.insert(child.getName());
         }
+        if (isDeferred(iNode))
+        {
+            for (size_t j = 0; j < iNode.getNumChildren(); ++j)
+            {
+                childNodesInFile.insert(iNode.getChildHeader(j).getName());
+            }
+        }
 
         for (unsigned int i = 0; i < numDags; i++)
         {
@@ -1740,6 +1880,11 @@ MStatus CreateSceneVisitor::createEmptyObject(AlembicObjectPtr iNodeObject)
         trans.setName(name);
     }
 
+    if (xformObj != MObject::kNullObj)
+    {
+        tagPlaceholder(xformObj, iNode);
+    }
+
     MObject saveParent = xformObj;
     for (size_t i = 0; i < numChildren; ++i)
     {
@@ -1755,3 +1900,46 @@ MStatus CreateSceneVisitor::createEmptyObject(AlembicObjectPtr iNodeObject)
     return status;
 }
 
+bool getPlaceholderInfo(const MObject & iNode, MString & oPath,
+    std::vector<std::string> & oFileNames)
+{
+    MStatus status;
+    MFnDependencyNode fnDepNode(iNode, &status);
+    if (status != MS::kSuccess)
+        return false;
+
+    MPlug pathPlug = fnDepNode.findPlug(kPlaceholderPathAttr, true);
+    MPlug filesPlug = fnDepNode.findPlug(kPlaceholderFilesAttr, true);
+    if (pathPlug.isNull() || filesPlug.isNull())
+        return false;
+
+    oPath = pathPlug.asString();
+
+    MObject filesObject;
+    filesPlug.getValue(filesObject);
+    MFnStringArrayData fnFilesData(filesObject, &status);
+    if (status != MS::kSuccess)
+        return false;
+
+    MStringArray files = fnFilesData.array();
+    oFileNames.clear();
+    for (unsigned int i = 0; i < files.length(); ++i)
+    {
+        oFileNames.push_back(files[i].asChar());
+    }
+
+    return oPath.length() > 0 && !oFileNames.empty();
+}
+
+void clearPlaceholder(MObject & iNode)
+{
+    MFnDependencyNode fnDepNode(iNode);
+
+    MObject pathAttr = fnDepNode.attribute(kPlaceholderPathAttr);
+    if (!pathAttr.isNull())
+        fnDepNode.removeAttribute(pathAttr);
+
+    MObject filesAttr = fnDepNode.attribute(kPlaceholderFilesAttr);
+    if (!filesAttr.isNull())
+        fnDepNode.removeAttribute(filesAttr);
+}
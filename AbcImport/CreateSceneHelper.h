@@ -57,6 +57,7 @@
 
 #include <set>
 #include <map>
+#include <string>
 #include <vector>
 
 struct ltMObj
@@ -67,6 +68,11 @@ struct ltMObj
   }
 };
 
+// dynamic attributes added to the placeholder nodes of a lazy import, they
+// hold the Alembic path of the deferred sub-tree and the files it came from
+const char * const kPlaceholderPathAttr = "AbcDeferredPath";
+const char * const kPlaceholderFilesAttr = "AbcDeferredFiles";
+
 class AlembicObject;
 typedef Alembic::Util::shared_ptr<AlembicObject> AlembicObjectPtr;
 
@@ -105,12 +111,19 @@ public:
         const MObject & iParent = MObject::kNullObj,
         Action iAction = CREATE, MString iRootNodes = MString(),
         MString iFilterString = MString(),
-        MString iExcludeFilterString = MString());
+        MString iExcludeFilterString = MString(),
+        int iDepthLimit = -1,
+        MString iAttrFilterString = MString(),
+        MString iRootPath = MString());
 
     ~CreateSceneVisitor();
 
+    // files recorded on placeholder nodes so they can be expanded later
+    void setPlaceholderFiles(const std::vector<std::string> & iFileNames);
+
     // previsit the hierarchy and return a tree of selected nodes.
-    AlembicObjectPtr previsit(AlembicObjectPtr iParentObj);
+    // iDepth is the depth of iParentObj below the walk root.
+    AlembicObjectPtr previsit(AlembicObjectPtr iParentObj, int iDepth = 0);
 
     // gets the ball rolling starting the hierarchy walk
     MStatus walk(Alembic::Abc::IArchive & iRoot);
@@ -152,6 +165,14 @@ private:
     // closest match to mRootNodes when appropriate
     std::string searchRootNames(const std::string & iName);
 
+    // a deferred object sits at the depth limit of a lazy import and has
+    // children, which were not visited
+    bool isDeferred(const Alembic::Abc::IObject & iObj) const;
+
+    // tag the node created for iObj as a placeholder if iObj is deferred,
+    // so that its children can be expanded later
+    void tagPlaceholder(MObject & iNode, const Alembic::Abc::IObject & iObj);
+
     double mFrame;
     MObject mParent;
 
@@ -176,6 +197,17 @@ private:
     MStringArray mOnlyPatterns;
     MStringArray mExceptPatterns;
 
+    // lazy import: number of levels created below the walk root (-1 for
+    // all of them), the arbitrary attribute filter, and the Alembic path
+    // the walk starts from
+    int mDepthLimit;
+    PropFilter mAttrFilter;
+    std::string mRootPath;
+    std::vector<std::string> mPlaceholderFiles;
+
+    // full names of the deferred objects
+    std::set<std::string> mDeferredPaths;
+
     // special map of shaders to selection lists that have selections
     // of parts of meshes.  They are to get around a problem where a shape
     // wont shade correctly after a swap if it is shaded per face
@@ -186,5 +218,12 @@ private:
     std::map < MObject, Alembic::Abc::IObject, ltMObj > mAddFaceSetsMap;
 };  // class CreateSceneVisitor
 
+// returns false if iNode isn't a placeholder left by a lazy import
+bool getPlaceholderInfo(const MObject & iNode, MString & oPath,
+    std::vector<std::string> & oFileNames);
+
+// removes the placeholder tags once the sub-tree has been expanded
+void clearPlaceholder(MObject & iNode);
+
 
 #endif  // ABCIMPORT_CREATE_SCENE_H_
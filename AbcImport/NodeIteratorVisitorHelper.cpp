@@ -1334,8 +1334,48 @@ bool addScalarProp(Alembic::Abc::IScalarProperty & iProp, MObject & iParent)
 //=============================================================================
 
 
+PropFilter::PropFilter(const MString & iPatterns)
+{
+    if (iPatterns == MString() || iPatterns == MString("*"))
+        return;
+
+    MStringArray patterns;
+    iPatterns.split(' ', patterns);
+    unsigned int length = patterns.length();
+    for (unsigned int i = 0; i < length; ++i)
+    {
+        try
+        {
+            mPatterns.push_back(std::regex(patterns[i].asChar(),
+                std::regex::optimize));
+        }
+        catch (const std::regex_error &)
+        {
+            MString theWarning("Ignoring invalid attribute filter: ");
+            theWarning += patterns[i];
+            printWarning(theWarning);
+        }
+    }
+}
+
+bool PropFilter::matches(const std::string & iPropName) const
+{
+    if (mPatterns.empty())
+        return true;
+
+    std::vector<std::regex>::const_iterator it = mPatterns.begin();
+    for (; it != mPatterns.end(); ++it)
+    {
+        if (std::regex_search(iPropName, *it))
+            return true;
+    }
+    return false;
+}
+
+//=============================================================================
+
 void addProps(Alembic::Abc::ICompoundProperty & iParent, MObject & iObject,
-    bool iUnmarkedFaceVaryingColors)
+    bool iUnmarkedFaceVaryingColors, const PropFilter & iFilter)
 {
     // if the params CompoundProperty (.arbGeomParam or .userProperties)
     // aren't valid, then skip
@@ -1364,6 +1404,10 @@ void addProps(Alembic::Abc::ICompoundProperty & iParent, MObject & iObject,
 
             printWarning(warn);
         }
+        else if (!iFilter.matches(propName))
+        {
+            continue;
+        }
         else
         {
             if (propHeader.isArray())
@@ -1538,7 +1582,8 @@ void getAnimatedScalarProp(Alembic::Abc::IScalarProperty prop,
 
 void getAnimatedProps(Alembic::Abc::ICompoundProperty & iParent,
                       std::vector<Prop> & oPropList,
-                      bool iUnmarkedFaceVaryingColors)
+                      bool iUnmarkedFaceVaryingColors,
+                      const PropFilter & iFilter)
 {
     // if the arbitrary geom params aren't valid, then skip
     if (!iParent)
@@ -1562,6 +1607,10 @@ void getAnimatedProps(Alembic::Abc::ICompoundProperty & iParent,
         {
             continue;
         }
+        else if (!iFilter.matches(propName))
+        {
+            continue;
+        }
         else if (propHeader.isArray())
         {
             Alembic::Abc::IArrayProperty prop(iParent, propName);
@@ -2818,7 +2867,8 @@ ArgData::ArgData(std::vector<std::string>& iFileNames,
     bool iDebugOn, MObject iReparentObj, bool iConnect,
     MString iConnectRootNodes, bool iCreateIfNotFound, bool iRemoveIfNoUpdate,
     bool iRecreateColorSets, MString iFilterString,
-    MString iExcludeFilterString) :
+    MString iExcludeFilterString, int iDepthLimit, MString iAttrFilterString,
+    MString iRootPath) :
         mFileNames(iFileNames),
         mDebugOn(iDebugOn), mReparentObj(iReparentObj),
         mRecreateColorSets(iRecreateColorSets),
@@ -2827,7 +2877,10 @@ ArgData::ArgData(std::vector<std::string>& iFileNames,
         mCreateIfNotFound(iCreateIfNotFound),
         mRemoveIfNoUpdate(iRemoveIfNoUpdate),
         mIncludeFilterString(iFilterString),
-        mExcludeFilterString(iExcludeFilterString)
+        mExcludeFilterString(iExcludeFilterString),
+        mDepthLimit(iDepthLimit),
+        mAttrFilterString(iAttrFilterString),
+        mRootPath(iRootPath)
 {
     mSequenceStartTime = -DBL_MAX;
     mSequenceEndTime = DBL_MAX;
@@ -2851,6 +2904,10 @@ ArgData & ArgData::operator=(const ArgData & rhs)
     mIncludeFilterString = rhs.mIncludeFilterString;
     mExcludeFilterString = rhs.mExcludeFilterString;
 
+    mDepthLimit = rhs.mDepthLimit;
+    mAttrFilterString = rhs.mAttrFilterString;
+    mRootPath = rhs.mRootPath;
+
     // optional information for the "connect" flag
     mConnect = rhs.mConnect;
     mConnectRootNodes = rhs.mConnectRootNodes;
@@ -2893,7 +2950,9 @@ MString createScene(ArgData & iArgData)
     CreateSceneVisitor visitor(iArgData.mSequenceStartTime,
         iArgData.mRecreateColorSets, iArgData.mReparentObj, action,
         iArgData.mConnectRootNodes, iArgData.mIncludeFilterString,
-        iArgData.mExcludeFilterString);
+        iArgData.mExcludeFilterString, iArgData.mDepthLimit,
+        iArgData.mAttrFilterString, iArgData.mRootPath);
+    visitor.setPlaceholderFiles(iArgData.mFileNames);
 
     visitor.walk(archive);
 
@@ -2936,6 +2995,8 @@ MString connectAttr(ArgData & iArgData)
         alembicNodePtr->setDebugMode(iArgData.mDebugOn);
         alembicNodePtr->setIncludeFilterString(iArgData.mIncludeFilterString);
         alembicNodePtr->setExcludeFilterString(iArgData.mExcludeFilterString);
+        alembicNodePtr->setLazyOptions(iArgData.mDepthLimit,
+            iArgData.mAttrFilterString, iArgData.mRootPath);
     }
 
     if (iArgData.mRecreateColorSets)
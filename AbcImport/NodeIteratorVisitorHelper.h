@@ -61,6 +61,7 @@
 #include <maya/MFnNumericAttribute.h>
 #include <maya/MFnNumericData.h>
 
+#include <regex>
 #include <vector>
 #include <string>
 
@@ -72,8 +73,27 @@ struct Prop
     Alembic::Abc::IScalarProperty mScalar;
 };
 
+// Restricts which arbitrary and user properties are turned into Maya
+// attributes.  The patterns are space separated regular expressions matched
+// against the property name, an empty filter accepts every property.
+// Unlike the object filters these are compiled once since they are tested
+// for every property of every object in the archive.
+class PropFilter
+{
+public:
+    PropFilter() {}
+    explicit PropFilter(const MString & iPatterns);
+
+    bool empty() const { return mPatterns.empty(); }
+    bool matches(const std::string & iPropName) const;
+
+private:
+    std::vector<std::regex> mPatterns;
+};
+
 void addProps(Alembic::Abc::ICompoundProperty & iParent, MObject & iObject,
-              bool iUnmarkedFaceVaryingColors);
+              bool iUnmarkedFaceVaryingColors,
+              const PropFilter & iFilter = PropFilter());
 
 bool addArrayProp(Alembic::Abc::IArrayProperty & iProp, MObject & iParent);
 bool addScalarProp(Alembic::Abc::IScalarProperty & iProp, MObject & iParent);
@@ -141,7 +161,8 @@ void readProp(double iFrame,
               MDataHandle & iHandle);
 
 void getAnimatedProps(Alembic::Abc::ICompoundProperty & iParent,
-    std::vector<Prop> & oPropList, bool iUnmarkedFaceVaryingColors);
+    std::vector<Prop> & oPropList, bool iUnmarkedFaceVaryingColors,
+    const PropFilter & iFilter = PropFilter());
 
 void getAnimatedArrayProp(Alembic::Abc::IArrayProperty prop,
                           std::vector<Prop> & oPropList);
@@ -255,7 +276,10 @@ public:
         bool    iRemoveIfNoUpdate = false,
         bool    iRecreateColorSets = false,
         MString iIncludeFilterString = MString(""),
-        MString iExcludeFilterString = MString(""));
+        MString iExcludeFilterString = MString(""),
+        int     iDepthLimit = -1,
+        MString iAttrFilterString = MString(""),
+        MString iRootPath = MString(""));
     ArgData(const ArgData & rhs);
     ArgData & operator=(const ArgData & rhs);
 
@@ -276,6 +300,13 @@ public:
     MString                    mIncludeFilterString;
     MString                    mExcludeFilterString;
 
+    // optional information for lazy (depth limited) imports, -1 means the
+    // whole hierarchy is created.  mRootPath is the full Alembic path of
+    // the sub-tree to create, used when expanding a placeholder node.
+    int                        mDepthLimit;
+    MString                    mAttrFilterString;
+    MString                    mRootPath;
+
     WriterData                 mData;
 };  // ArgData
 
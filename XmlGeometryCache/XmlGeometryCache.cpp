@@ -15,19 +15,59 @@
 //
 //  In this example, the cache files are written in xml format.
 //
+//  The first findTime() after a cache is opened for reading builds a
+//  time -> file offset index of its chunks (or loads it from a
+//  "<cache>.mc.idx" sidecar when one is present and up to date) so that
+//  findTime() can seek straight to a chunk instead of scanning the file.
+//  Sequential reads never build it.  Set MAYA_XMLCACHE_WRITE_INDEX to have
+//  the sidecar written next to the cache after the index is built.
+//
+//  A second format, "chunkedBinary" (.mcb files), is registered next to it.
+//  It keeps the same chunk/channel layout but stores the arrays as raw
+//  little-endian data behind a per-chunk directory, and reads them out of
+//  a memory mapping of the file.  Existing xml caches are converted with
+//
+//      xmlCacheToBinary "/path/cache.mc" "/path/cache.mcb";
+//
+//  The "xmlCacheSeekBenchmark" command writes a temporary cache and times
+//  random findTime() calls with and without the index:
+//
+//      xmlCacheSeekBenchmark -frames 2000 -points 1000 -seeks 500;
+//
 
 #include <string>
 #include <stack>
 #include <fstream>
 #include <sstream>
+#include <vector>
+#include <map>
+#include <algorithm>
 
 #include <assert.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
 #include <maya/MFnPlugin.h>
 #include <maya/MGlobal.h>
 #include <maya/MString.h>
 #include <maya/MPxCacheFormat.h>
+#include <maya/MPxCommand.h>
+#include <maya/MSyntax.h>
+#include <maya/MArgDatabase.h>
+#include <maya/MTimer.h>
 #include <maya/MTime.h>
+#include <maya/MFloatVector.h>
 #include <maya/MFloatVectorArray.h>
 #include <maya/MDoubleArray.h>
 #include <maya/MFloatArray.h>
@@ -36,6 +76,27 @@
 
 using namespace std;
 
+// One element of a cache chunk, in the order it was written.  Used to move
+// data from one cache format to the other.
+struct CacheItem
+{
+    enum Type
+    {
+        kChannel = 1,
+        kInt32,
+        kDoubleArray,
+        kFloatArray,
+        kDoubleVectorArray,
+        kFloatVectorArray
+    };
+
+    Type            type;
+    MString         name;       // kChannel
+    int             intValue;   // kInt32
+    MDoubleArray    doubles;    // kDoubleArray, kDoubleVectorArray (xyz interleaved)
+    MFloatArray     floats;     // kFloatArray, kFloatVectorArray (xyz interleaved)
+};
+
 class XmlCacheFormat : public MPxCacheFormat
 {
 public:
@@ -85,6 +146,18 @@ public:
  
     MString         extension() override;
 
+    // Seek without the chunk index, scanning from the current position.
+    // Used when no index could be built and by the seek benchmark.
+    MStatus         findTimeLinear( MTime& time, MTime& foundTime );
+    bool            hasTimeIndex() const { return !fTimeIndex.empty(); }
+
+    // Header values from the last readHeader().
+    void            headerInfo( MString& version, MTime& startTime, MTime& endTime ) const;
+
+    // Read the next item of the current chunk, false at the end of the
+    // chunk (the chunk end tag is consumed).
+    bool            readChunkItem( CacheItem& item );
+
 protected:
 
     static MString  comment( const MString& text );
@@ -108,12 +181,41 @@ private:
     void            writeXmlValue( double value );
     void            writeXmlValue( float value );
     void            writeXmlValue( int value );
-        
+
+    // Chunk index, one entry per chunk sorted by time.  The offset is the
+    // position of the chunk start tag in the file.
+    struct ChunkEntry
+    {
+        double      time;
+        streamoff   offset;
+
+        bool operator<( const ChunkEntry& rhs ) const { return time < rhs.time; }
+    };
+
+    bool            timeIndexIsCurrent() const;
+    bool            buildTimeIndex();
+    bool            loadTimeIndex( const string& indexName );
+    void            saveTimeIndex( const string& indexName ) const;
+    const MString&  internChannelName( const string& name );
+
     MString         fFileName;
     fstream         fFile;
     stack<string>   fXmlStack;
     FileAccessMode  fMode;
 
+    vector<ChunkEntry>      fTimeIndex;
+    MString                 fIndexedFileName;
+    long long               fIndexedFileSize;
+    long long               fIndexedFileTime;
+    bool                    fIndexChecked;
+
+    // Channel names seen in this cache, so reading a channel name doesn't
+    // allocate a new MString every chunk.
+    map<string, MString>    fChannelNames;
+
+    MString                 fHeaderVersion;
+    double                  fHeaderStart;
+    double                  fHeaderEnd;
 };
 
 MString XmlCacheFormat::fExtension = "mc";          // For files on disk
@@ -158,7 +260,17 @@ string floatVectorArrayTag("floatVectorArray");
 string channelTag("channel");   
 string chunkTag("chunk");           
 
+static const bool sWriteIndexSidecar = (getenv("MAYA_XMLCACHE_WRITE_INDEX") != NULL);
+static const char sIndexMagic[4] = { 'X', 'C', 'I', 'X' };
+static const unsigned int sIndexVersion = 1;
+
 XmlCacheFormat::XmlCacheFormat()
+:   fMode( kRead )
+,   fIndexedFileSize( 0 )
+,   fIndexedFileTime( 0 )
+,   fIndexChecked( false )
+,   fHeaderStart( 0.0 )
+,   fHeaderEnd( 0.0 )
 {
 }
 
@@ -175,6 +287,7 @@ XmlCacheFormat::open( const MString& fileName, FileAccessMode mode )
     assert((fileName.length() > 0));
 
     fFileName = fileName;
+    fMode = mode;
     
     if( mode == kWrite ) {
         fFile.open(fFileName.asChar(), ios::out);
@@ -190,6 +303,14 @@ XmlCacheFormat::open( const MString& fileName, FileAccessMode mode )
     } else {
         if (mode == kRead) {
             rtn = readHeader();
+
+            // findTime() checks the index against the file again.
+            fIndexChecked = false;
+        } else {
+            // The file is changing under us, fall back to scanning.
+            fTimeIndex.clear();
+            fIndexedFileName.clear();
+            fIndexChecked = true;
         }
     }
 
@@ -216,11 +337,14 @@ XmlCacheFormat::readHeader()
             if( tag == XMLSTARTTAG(cacheTag) ) 
             {
                 MStringArray value;
-                readXmlTagValue( versionTag, value );
+                if( readXmlTagValue( versionTag, value ) && value.length() > 0 )
+                    fHeaderVersion = value[0];
 
-                readXmlTagValue( startTimeTag, value );
+                if( readXmlTagValue( startTimeTag, value ) && value.length() > 0 )
+                    fHeaderStart = strtod( value[0].asChar(), NULL );
 
-                readXmlTagValue( endTimeTag, value );
+                if( readXmlTagValue( endTimeTag, value ) && value.length() > 0 )
+                    fHeaderEnd = strtod( value[0].asChar(), NULL );
 
                 readXmlTag( tag );  // Should be header close tag, check
                 if( tag != XMLENDTAG(cacheTag) )
@@ -325,10 +449,10 @@ XmlCacheFormat::findChannelName( const MString& name )
 //  of the channel we're trying to read.
 //
 {
-    MStringArray value;
-    while (readXmlTagValueInChunk(channelTag, value)) 
+    MString channel;
+    while (readChannelName(channel)) 
     {
-        if( value.length() == 1 && value[0] == name )
+        if( channel == name )
         {
             return MS::kSuccess;
         }
@@ -349,15 +473,46 @@ XmlCacheFormat::readChannelName( MString& name )
 //  TODO: the current implementation assumes there are numChannels of data stored
 //  for every time.  This assumption needs to be removed.
 //
+//  Channel names are written as a single token, so read it directly and
+//  hand back the interned name rather than going through an MStringArray.
+//
 {
-    MStringArray value;
-    readXmlTagValueInChunk(channelTag, value);
+    name.clear();
+    if( !findXmlStartTagInChunk(channelTag) )
+    {
+        return MS::kFailure;
+    }
+
+    string token;
+    fFile >> token;
+    if( fFile.eof() || token == XMLENDTAG(channelTag) )
+    {
+        return MS::kFailure;
+    }
+    name = internChannelName( token );
 
-    name = value[0];
+    // Skip to the end tag
+    string endTag = XMLENDTAG(channelTag);
+    fFile >> token;
+    while ( !fFile.eof() && token != endTag )
+    {
+        fFile >> token;
+    }
 
     return name.length() == 0 ? MS::kFailure : MS::kSuccess;
 }
 
+const MString&
+XmlCacheFormat::internChannelName( const string& name )
+{
+    map<string, MString>::iterator it = fChannelNames.find( name );
+    if( it == fChannelNames.end() )
+    {
+        it = fChannelNames.insert( make_pair( name, MString( name.c_str() ) ) ).first;
+    }
+    return it->second;
+}
+
 
 MStatus
 XmlCacheFormat::readNextTime( MTime& foundTime )
@@ -378,6 +533,64 @@ XmlCacheFormat::findTime( MTime& time, MTime& foundTime )
 // Find the biggest cached time, which is smaller or equal to 
 // seekTime and return foundTime
 //
+// With a chunk index this is a binary search and a single seek, leaving
+// the stream just after the chunk's time tag like the linear scan does.
+//
+{
+    if( !fIndexChecked )
+    {
+        // Only index on the first seek after open(), so that sequential
+        // reads don't pay for the extra pass over the file.  rewind()
+        // reopens the file, keep the index if the file is unchanged.
+        fIndexChecked = true;
+        if( !timeIndexIsCurrent() )
+        {
+            buildTimeIndex();
+        }
+    }
+
+    if( fTimeIndex.empty() )
+    {
+        return findTimeLinear( time, foundTime );
+    }
+
+    MTime timeTolerance(0.0, MTime::k6000FPS);
+    MTime seekTime(time);
+    MTime preTime( seekTime - timeTolerance );
+    MTime postTime( seekTime + timeTolerance );
+
+    ChunkEntry key;
+    key.time = preTime.as( MTime::k6000FPS );
+    key.offset = 0;
+    vector<ChunkEntry>::const_iterator it =
+        lower_bound( fTimeIndex.begin(), fTimeIndex.end(), key );
+    if( it == fTimeIndex.end() )
+    {
+        return MS::kFailure;
+    }
+
+    MTime rTime( it->time, MTime::k6000FPS );
+    if( rTime > postTime )
+    {
+        // Time could not be found
+        //
+        return MS::kFailure;
+    }
+
+    fFile.clear();
+    fFile.seekg( it->offset );
+    if( !fFile || !beginReadChunk() )
+    {
+        return MS::kFailure;
+    }
+
+    readTime( rTime );
+    foundTime = rTime;
+    return MS::kSuccess;
+}
+
+MStatus
+XmlCacheFormat::findTimeLinear( MTime& time, MTime& foundTime )
 {
     MTime timeTolerance(0.0, MTime::k6000FPS);
     MTime seekTime(time);
@@ -647,6 +860,84 @@ XmlCacheFormat::extension()
     return fExtension;
 }
 
+void
+XmlCacheFormat::headerInfo( MString& version, MTime& startTime, MTime& endTime ) const
+{
+    version = fHeaderVersion;
+    startTime = MTime( fHeaderStart, MTime::k6000FPS );
+    endTime = MTime( fHeaderEnd, MTime::k6000FPS );
+}
+
+bool
+XmlCacheFormat::readChunkItem( CacheItem& item )
+{
+    string tagEndChunk = XMLENDTAG(chunkTag);
+    string sizeStart = XMLSTARTTAG(sizeTag);
+
+    string tag;
+    fFile >> tag;
+
+    // The array sizes are implied by the number of values.
+    while( !fFile.eof() && tag == sizeStart )
+    {
+        string endTag = XMLENDTAG(sizeTag);
+        fFile >> tag;
+        while( !fFile.eof() && tag != endTag )
+            fFile >> tag;
+        fFile >> tag;
+    }
+
+    if( fFile.eof() || tag == tagEndChunk || tag.size() < 3 )
+    {
+        return false;
+    }
+
+    string name = tag.substr( 1, tag.size() - 2 );
+    string endTag = XMLENDTAG(name);
+    vector<string> values;
+    string token;
+    fFile >> token;
+    while( !fFile.eof() && token != endTag )
+    {
+        values.push_back( token );
+        fFile >> token;
+    }
+
+    if( name == channelTag )
+    {
+        item.type = CacheItem::kChannel;
+        item.name = values.empty() ? MString() : internChannelName( values[0] );
+    }
+    else if( name == intTag )
+    {
+        item.type = CacheItem::kInt32;
+        item.intValue = values.empty() ? 0 : atoi( values[0].c_str() );
+    }
+    else if( name == doubleArrayTag || name == doubleVectorArrayTag )
+    {
+        item.type = ( name == doubleArrayTag ) ? CacheItem::kDoubleArray
+                                               : CacheItem::kDoubleVectorArray;
+        item.doubles.setLength( (unsigned int)values.size() );
+        for( unsigned int i = 0; i < values.size(); i++ )
+            item.doubles[i] = strtod( values[i].c_str(), NULL );
+    }
+    else if( name == floatArrayTag || name == floatVectorArrayTag )
+    {
+        item.type = ( name == floatArrayTag ) ? CacheItem::kFloatArray
+                                              : CacheItem::kFloatVectorArray;
+        item.floats.setLength( (unsigned int)values.size() );
+        for( unsigned int i = 0; i < values.size(); i++ )
+            item.floats[i] = (float)strtod( values[i].c_str(), NULL );
+    }
+    else
+    {
+        // Unknown tag, skip it.
+        return readChunkItem( item );
+    }
+
+    return true;
+}
+
 // ****************************************
 //
 //  Helper functions
@@ -822,17 +1113,1316 @@ void XmlCacheFormat::writeXmlValue( int value )
     fFile << value << " ";
 }
 
+// ****************************************
+//
+//  Chunk index
+//
+
+bool XmlCacheFormat::timeIndexIsCurrent() const
+//
+// Whether fTimeIndex was built from this file as it is now.  The name
+// alone isn't enough, the cache may have been rewritten since.
+//
+{
+    struct stat cacheStat;
+    return fIndexedFileName == fFileName
+        && stat( fFileName.asChar(), &cacheStat ) == 0
+        && fIndexedFileSize == (long long)cacheStat.st_size
+        && fIndexedFileTime == (long long)cacheStat.st_mtime;
+}
+
+bool XmlCacheFormat::buildTimeIndex()
+//
+// Collect the offset and time of every chunk in one pass over the raw
+// file.  Block tags are written unindented on their own line and the
+// time tag is the first line of each chunk, so there's no need to go
+// through the token parser.
+//
+{
+    fTimeIndex.clear();
+    fIndexedFileName.clear();
+
+    struct stat cacheStat;
+    if( stat( fFileName.asChar(), &cacheStat ) != 0 )
+    {
+        return false;
+    }
+    fIndexedFileSize = (long long)cacheStat.st_size;
+    fIndexedFileTime = (long long)cacheStat.st_mtime;
+
+    string indexName = string( fFileName.asChar() ) + ".idx";
+    if( loadTimeIndex( indexName ) )
+    {
+        fIndexedFileName = fFileName;
+        return true;
+    }
+
+    ifstream in( fFileName.asChar(), ios::in | ios::binary );
+    if( !in.is_open() )
+    {
+        return false;
+    }
+
+    string chunkStart = XMLSTARTTAG(chunkTag);
+    string timeStart = XMLSTARTTAG(timeTag);
+
+    string line;
+    streamoff lineOffset = 0;
+    streamoff chunkOffset = -1;
+    bool sorted = true;
+    while( getline( in, line ) )
+    {
+        streamoff nextOffset = lineOffset + (streamoff)line.size() + 1;
+
+        if( !line.empty() && line[line.size()-1] == '\r' )
+        {
+            line.erase( line.size()-1 );
+        }
+
+        if( line == chunkStart )
+        {
+            chunkOffset = lineOffset;
+        }
+        else if( chunkOffset >= 0 )
+        {
+            string::size_type pos = line.find( timeStart );
+            if( pos != string::npos )
+            {
+                ChunkEntry entry;
+                entry.time = strtod( line.c_str() + pos + timeStart.size(), NULL );
+                entry.offset = chunkOffset;
+                if( !fTimeIndex.empty() && entry.time < fTimeIndex.back().time )
+                {
+                    sorted = false;
+                }
+                fTimeIndex.push_back( entry );
+                chunkOffset = -1;
+            }
+        }
+
+        lineOffset = nextOffset;
+    }
+
+    if( !sorted )
+    {
+        stable_sort( fTimeIndex.begin(), fTimeIndex.end() );
+    }
+
+    fIndexedFileName = fFileName;
+
+    if( sWriteIndexSidecar && !fTimeIndex.empty() )
+    {
+        saveTimeIndex( indexName );
+    }
+
+    return !fTimeIndex.empty();
+}
+
+bool XmlCacheFormat::loadTimeIndex( const string& indexName )
+//
+// Load the sidecar index, rejecting it if the cache file changed since
+// it was written.
+//
+{
+    struct stat cacheStat;
+    if( stat( fFileName.asChar(), &cacheStat ) != 0 )
+    {
+        return false;
+    }
+
+    FILE* fp = fopen( indexName.c_str(), "rb" );
+    if( fp == NULL )
+    {
+        return false;
+    }
+
+    char magic[4];
+    unsigned int version = 0;
+    long long fileSize = 0, fileTime = 0;
+    unsigned int count = 0;
+    bool ok = fread( magic, sizeof(magic), 1, fp ) == 1
+           && memcmp( magic, sIndexMagic, sizeof(magic) ) == 0
+           && fread( &version, sizeof(version), 1, fp ) == 1
+           && version == sIndexVersion
+           && fread( &fileSize, sizeof(fileSize), 1, fp ) == 1
+           && fread( &fileTime, sizeof(fileTime), 1, fp ) == 1
+           && fileSize == (long long)cacheStat.st_size
+           && fileTime == (long long)cacheStat.st_mtime
+           && fread( &count, sizeof(count), 1, fp ) == 1;
+
+    if( ok )
+    {
+        fTimeIndex.resize( count );
+        for( unsigned int i = 0; ok && i < count; i++ )
+        {
+            long long offset = 0;
+            ok = fread( &fTimeIndex[i].time, sizeof(double), 1, fp ) == 1
+              && fread( &offset, sizeof(offset), 1, fp ) == 1;
+            fTimeIndex[i].offset = (streamoff)offset;
+        }
+    }
+    fclose( fp );
+
+    if( !ok )
+    {
+        fTimeIndex.clear();
+    }
+    return ok && !fTimeIndex.empty();
+}
+
+void XmlCacheFormat::saveTimeIndex( const string& indexName ) const
+{
+    struct stat cacheStat;
+    if( stat( fFileName.asChar(), &cacheStat ) != 0 )
+    {
+        return;
+    }
+
+    FILE* fp = fopen( indexName.c_str(), "wb" );
+    if( fp == NULL )
+    {
+        return;
+    }
 
+    long long fileSize = (long long)cacheStat.st_size;
+    long long fileTime = (long long)cacheStat.st_mtime;
+    unsigned int count = (unsigned int)fTimeIndex.size();
+    fwrite( sIndexMagic, sizeof(sIndexMagic), 1, fp );
+    fwrite( &sIndexVersion, sizeof(sIndexVersion), 1, fp );
+    fwrite( &fileSize, sizeof(fileSize), 1, fp );
+    fwrite( &fileTime, sizeof(fileTime), 1, fp );
+    fwrite( &count, sizeof(count), 1, fp );
+    for( unsigned int i = 0; i < count; i++ )
+    {
+        long long offset = (long long)fTimeIndex[i].offset;
+        fwrite( &fTimeIndex[i].time, sizeof(double), 1, fp );
+        fwrite( &offset, sizeof(offset), 1, fp );
+    }
+    fclose( fp );
+}
 
 // ****************************************
+//
+//  Binary chunked cache format
+//
+//  File layout, all values little-endian:
+//
+//      header      "MCBN", uint32 version, double start, double end
+//                  (6000fps ticks), uint32 length + version string,
+//                  padded to 16 bytes
+//      chunk       "CHNK", uint32 entry count, double time,
+//                  uint64 chunk size in bytes (header included)
+//                  entry directory, 24 bytes per entry:
+//                      uint32 type, uint32 element count,
+//                      uint64 offset from chunk start, uint64 byte size
+//                  entry data, each block 16 byte aligned
+//
+//  The directory keeps the entries in write order, so the read side walks
+//  it with a cursor and gets the same channel/array sequence the xml
+//  format produces, without touching the data it skips over.
+//
 
-MStatus initializePlugin( MObject obj )
+class MappedCacheFile
 {
-    MFnPlugin plugin( obj, PLUGIN_COMPANY, "1.0", "Any" );
+public:
+    MappedCacheFile() : fData( NULL ), fSize( 0 )
+#ifdef _WIN32
+    , fFile( INVALID_HANDLE_VALUE ), fMapping( NULL )
+#endif
+    {}
+    ~MappedCacheFile() { unmap(); }
 
-    plugin.registerCacheFormat(
-        XmlCacheFormat::translatorName(),
-        XmlCacheFormat::creator
+    bool map( const MString& fileName );
+    void unmap();
+
+    const char*     data() const { return fData; }
+    size_t          size() const { return fSize; }
+
+private:
+    const char*     fData;
+    size_t          fSize;
+#ifdef _WIN32
+    HANDLE          fFile;
+    HANDLE          fMapping;
+#endif
+};
+
+bool MappedCacheFile::map( const MString& fileName )
+{
+    unmap();
+
+#ifdef _WIN32
+    fFile = CreateFileA( fileName.asChar(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                         OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, NULL );
+    if( fFile == INVALID_HANDLE_VALUE )
+        return false;
+
+    LARGE_INTEGER size;
+    if( !GetFileSizeEx( fFile, &size ) || size.QuadPart == 0 )
+    {
+        unmap();
+        return false;
+    }
+
+    fMapping = CreateFileMappingA( fFile, NULL, PAGE_READONLY, 0, 0, NULL );
+    if( fMapping == NULL )
+    {
+        unmap();
+        return false;
+    }
+
+    fData = (const char*)MapViewOfFile( fMapping, FILE_MAP_READ, 0, 0, 0 );
+    fSize = (size_t)size.QuadPart;
+#else
+    int fd = ::open( fileName.asChar(), O_RDONLY );
+    if( fd < 0 )
+        return false;
+
+    struct stat st;
+    if( fstat( fd, &st ) != 0 || st.st_size == 0 )
+    {
+        ::close( fd );
+        return false;
+    }
+
+    void* addr = mmap( NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    ::close( fd );
+    if( addr == MAP_FAILED )
+        return false;
+
+    fData = (const char*)addr;
+    fSize = (size_t)st.st_size;
+#endif
+
+    if( fData == NULL )
+    {
+        unmap();
+        return false;
+    }
+    return true;
+}
+
+void MappedCacheFile::unmap()
+{
+#ifdef _WIN32
+    if( fData ) UnmapViewOfFile( fData );
+    if( fMapping ) CloseHandle( fMapping );
+    if( fFile != INVALID_HANDLE_VALUE ) CloseHandle( fFile );
+    fMapping = NULL;
+    fFile = INVALID_HANDLE_VALUE;
+#else
+    if( fData ) munmap( (void*)fData, fSize );
+#endif
+    fData = NULL;
+    fSize = 0;
+}
+
+class BinaryCacheFormat : public MPxCacheFormat
+{
+public:
+    BinaryCacheFormat();
+    ~BinaryCacheFormat() override;
+
+    static void*    creator();
+    static MString  translatorName();
+
+    MStatus         isValid() override;
+
+    MStatus         open( const MString& fileName, FileAccessMode mode ) override;
+    void            close() override;
+
+    MStatus         readHeader() override;
+    MStatus         writeHeader( const MString& version, MTime& startTime, MTime& endTime ) override;
+
+    void            beginWriteChunk() override;
+    void            endWriteChunk() override;
+    MStatus         beginReadChunk() override;
+    void            endReadChunk() override;
+
+    MStatus         writeTime( MTime& time ) override;
+    MStatus         readTime( MTime& time ) override;
+    MStatus         findTime( MTime& time, MTime& foundTime ) override;
+    MStatus         readNextTime( MTime& foundTime ) override;
+
+    unsigned        readArraySize() override;
+
+    MStatus         writeDoubleArray( const MDoubleArray& ) override;
+    MStatus         readDoubleArray( MDoubleArray&, unsigned size ) override;
+    MStatus         writeFloatArray( const MFloatArray& ) override;
+    MStatus         readFloatArray( MFloatArray&, unsigned size ) override;
+    MStatus         writeDoubleVectorArray( const MVectorArray& array ) override;
+    MStatus         readDoubleVectorArray( MVectorArray&, unsigned arraySize ) override;
+    MStatus         writeFloatVectorArray( const MFloatVectorArray& array ) override;
+    MStatus         readFloatVectorArray( MFloatVectorArray& array, unsigned arraySize ) override;
+
+    MStatus         writeChannelName( const MString& name ) override;
+    MStatus         findChannelName( const MString& name ) override;
+    MStatus         readChannelName( MString& name ) override;
+
+    MStatus         writeInt32( int ) override;
+    int             readInt32() override;
+    MStatus         rewind() override;
+
+    MString         extension() override;
+
+    // Append one item read from another format to the current chunk.
+    MStatus         writeItem( const CacheItem& item );
+
+protected:
+    static MString  fExtension;
+    static MString  fCacheFormatName;
+
+private:
+    struct DirEntry
+    {
+        unsigned int        type;
+        unsigned int        count;
+        unsigned long long  offset;
+        unsigned long long  size;
+    };
+
+    struct ChunkRef
+    {
+        double      time;
+        size_t      offset;
+
+        bool operator<( const ChunkRef& rhs ) const { return time < rhs.time; }
+    };
+
+    static const size_t kChunkHeaderSize = 24;
+    static const size_t kAlignment = 16;
+
+    void            addEntry( unsigned int type, unsigned int count, const void* data, size_t size );
+    const DirEntry* entry( size_t chunk, unsigned int index ) const;
+    const DirEntry* nextDataEntry( unsigned int type );
+    bool            readChunkHeader( size_t offset, unsigned int& numEntries,
+                                     double& time, unsigned long long& chunkSize ) const;
+    bool            indexChunks();
+    bool            selectChunk( size_t offset );
+
+    MString         fFileName;
+    FileAccessMode  fMode;
+
+    // write side: the current chunk is built in memory and written out
+    // with its directory in endWriteChunk()
+    FILE*               fOutFile;
+    double              fChunkTime;
+    vector<DirEntry>    fPendingEntries;
+    vector<char>        fPendingData;
+
+    // read side
+    MappedCacheFile     fMapped;
+    size_t              fFirstChunk;
+    vector<ChunkRef>    fChunks;
+    size_t              fNextChunk;     // index into fChunks
+    size_t              fCurChunk;      // byte offset, 0 when outside a chunk
+    unsigned int        fCurEntries;
+    unsigned int        fCursor;
+
+    map<string, MString>    fChannelNames;
+};
+
+MString BinaryCacheFormat::fExtension = "mcb";
+MString BinaryCacheFormat::fCacheFormatName = "chunkedBinary";
+
+static const char sBinaryMagic[4] = { 'M', 'C', 'B', 'N' };
+static const char sChunkMagic[4] = { 'C', 'H', 'N', 'K' };
+static const unsigned int sBinaryVersion = 1;
+
+static inline bool isLittleEndianHost()
+{
+    const unsigned int one = 1;
+    return *(const unsigned char*)&one == 1;
+}
+
+static inline size_t alignUp( size_t value, size_t alignment )
+{
+    return ( value + alignment - 1 ) & ~( alignment - 1 );
+}
+
+inline MString BinaryCacheFormat::translatorName()
+{
+    return fCacheFormatName;
+}
+
+void* BinaryCacheFormat::creator()
+{
+    return new BinaryCacheFormat();
+}
+
+BinaryCacheFormat::BinaryCacheFormat()
+:   fMode( kRead )
+,   fOutFile( NULL )
+,   fChunkTime( 0.0 )
+,   fFirstChunk( 0 )
+,   fNextChunk( 0 )
+,   fCurChunk( 0 )
+,   fCurEntries( 0 )
+,   fCursor( 0 )
+{
+}
+
+BinaryCacheFormat::~BinaryCacheFormat()
+{
+    close();
+}
+
+MStatus
+BinaryCacheFormat::open( const MString& fileName, FileAccessMode mode )
+{
+    assert((fileName.length() > 0));
+
+    // The data is handed to Maya straight from the file.
+    if( !isLittleEndianHost() )
+    {
+        return MS::kFailure;
+    }
+
+    close();
+    fFileName = fileName;
+    fMode = mode;
+
+    if( mode == kWrite || mode == kReadWrite )
+    {
+        fOutFile = fopen( fFileName.asChar(), mode == kWrite ? "wb" : "ab" );
+        return fOutFile != NULL ? MS::kSuccess : MS::kFailure;
+    }
+
+    if( !fMapped.map( fFileName ) )
+    {
+        return MS::kFailure;
+    }
+    return readHeader();
+}
+
+void
+BinaryCacheFormat::close()
+{
+    if( fOutFile != NULL )
+    {
+        fclose( fOutFile );
+        fOutFile = NULL;
+    }
+    fMapped.unmap();
+    fChunks.clear();
+    fNextChunk = 0;
+    fCurChunk = 0;
+    fCurEntries = 0;
+    fCursor = 0;
+}
+
+MStatus
+BinaryCacheFormat::isValid()
+{
+    bool rtn = ( fOutFile != NULL ) || ( fMapped.data() != NULL );
+    return rtn ? MS::kSuccess : MS::kFailure;
+}
+
+MStatus
+BinaryCacheFormat::readHeader()
+{
+    const char* data = fMapped.data();
+    size_t size = fMapped.size();
+    if( data == NULL || size < 28 || memcmp( data, sBinaryMagic, 4 ) != 0 )
+    {
+        return MS::kFailure;
+    }
+
+    unsigned int version, versionLength;
+    memcpy( &version, data + 4, 4 );
+    memcpy( &versionLength, data + 24, 4 );
+    if( version != sBinaryVersion || 28 + (size_t)versionLength > size )
+    {
+        return MS::kFailure;
+    }
+
+    fFirstChunk = alignUp( 28 + versionLength, kAlignment );
+    return indexChunks() ? MS::kSuccess : MS::kFailure;
+}
+
+MStatus
+BinaryCacheFormat::writeHeader( const MString& version, MTime& startTime, MTime& endTime )
+{
+    if( fOutFile == NULL )
+    {
+        return MS::kFailure;
+    }
+
+    unsigned int versionLength = version.length();
+    double start = startTime.as( MTime::k6000FPS );
+    double end = endTime.as( MTime::k6000FPS );
+
+    fwrite( sBinaryMagic, 4, 1, fOutFile );
+    fwrite( &sBinaryVersion, 4, 1, fOutFile );
+    fwrite( &start, 8, 1, fOutFile );
+    fwrite( &end, 8, 1, fOutFile );
+    fwrite( &versionLength, 4, 1, fOutFile );
+    fwrite( version.asChar(), 1, versionLength, fOutFile );
+
+    static const char padding[kAlignment] = { 0 };
+    size_t written = 28 + versionLength;
+    fwrite( padding, 1, alignUp( written, kAlignment ) - written, fOutFile );
+
+    return ferror( fOutFile ) ? MS::kFailure : MS::kSuccess;
+}
+
+bool
+BinaryCacheFormat::readChunkHeader( size_t offset, unsigned int& numEntries,
+                                    double& time, unsigned long long& chunkSize ) const
+{
+    const char* data = fMapped.data();
+    if( offset + kChunkHeaderSize > fMapped.size() || memcmp( data + offset, sChunkMagic, 4 ) != 0 )
+    {
+        return false;
+    }
+
+    memcpy( &numEntries, data + offset + 4, 4 );
+    memcpy( &time, data + offset + 8, 8 );
+    memcpy( &chunkSize, data + offset + 16, 8 );
+
+    return chunkSize >= kChunkHeaderSize + numEntries * sizeof(DirEntry)
+        && offset + chunkSize <= fMapped.size();
+}
+
+bool
+BinaryCacheFormat::indexChunks()
+//
+// Hop from chunk header to chunk header to collect the chunk times. A
+// truncated last chunk (from an interrupted write) is ignored.
+//
+{
+    fChunks.clear();
+
+    size_t offset = fFirstChunk;
+    bool sorted = true;
+    unsigned int numEntries;
+    double time;
+    unsigned long long chunkSize;
+    while( readChunkHeader( offset, numEntries, time, chunkSize ) )
+    {
+        ChunkRef ref;
+        ref.time = time;
+        ref.offset = offset;
+        if( !fChunks.empty() && time < fChunks.back().time )
+        {
+            sorted = false;
+        }
+        fChunks.push_back( ref );
+        offset += (size_t)chunkSize;
+    }
+
+    // Sequential reads and findTime() both go through fChunks in time order.
+    // Maya writes chunks in time order, so this is normally the file order.
+    if( !sorted )
+    {
+        stable_sort( fChunks.begin(), fChunks.end() );
+    }
+
+    fNextChunk = 0;
+    fCurChunk = 0;
+    return true;
+}
+
+bool
+BinaryCacheFormat::selectChunk( size_t offset )
+{
+    unsigned int numEntries;
+    double time;
+    unsigned long long chunkSize;
+    if( !readChunkHeader( offset, numEntries, time, chunkSize ) )
+    {
+        fCurChunk = 0;
+        return false;
+    }
+
+    fCurChunk = offset;
+    fCurEntries = numEntries;
+    fCursor = 0;
+    return true;
+}
+
+const BinaryCacheFormat::DirEntry*
+BinaryCacheFormat::entry( size_t chunk, unsigned int index ) const
+{
+    // Directory entries are 8 byte aligned within the mapping.
+    return (const DirEntry*)( fMapped.data() + chunk + kChunkHeaderSize ) + index;
+}
+
+MStatus
+BinaryCacheFormat::rewind()
+{
+    if( fMapped.data() == NULL )
+    {
+        return MS::kFailure;
+    }
+    fNextChunk = 0;
+    fCurChunk = 0;
+    return MS::kSuccess;
+}
+
+void
+BinaryCacheFormat::beginWriteChunk()
+{
+    fChunkTime = 0.0;
+    fPendingEntries.clear();
+    fPendingData.clear();
+}
+
+void
+BinaryCacheFormat::endWriteChunk()
+{
+    if( fOutFile == NULL )
+    {
+        return;
+    }
+
+    unsigned int numEntries = (unsigned int)fPendingEntries.size();
+    size_t dataStart = alignUp( kChunkHeaderSize + numEntries * sizeof(DirEntry), kAlignment );
+    unsigned long long chunkSize = dataStart + fPendingData.size();
+
+    for( unsigned int i = 0; i < numEntries; i++ )
+    {
+        fPendingEntries[i].offset += dataStart;
+    }
+
+    fwrite( sChunkMagic, 4, 1, fOutFile );
+    fwrite( &numEntries, 4, 1, fOutFile );
+    fwrite( &fChunkTime, 8, 1, fOutFile );
+    fwrite( &chunkSize, 8, 1, fOutFile );
+    if( numEntries > 0 )
+    {
+        fwrite( &fPendingEntries[0], sizeof(DirEntry), numEntries, fOutFile );
+    }
+
+    static const char padding[kAlignment] = { 0 };
+    size_t written = kChunkHeaderSize + numEntries * sizeof(DirEntry);
+    fwrite( padding, 1, dataStart - written, fOutFile );
+    if( !fPendingData.empty() )
+    {
+        fwrite( &fPendingData[0], 1, fPendingData.size(), fOutFile );
+    }
+
+    fPendingEntries.clear();
+    fPendingData.clear();
+}
+
+void
+BinaryCacheFormat::addEntry( unsigned int type, unsigned int count, const void* data, size_t size )
+{
+    DirEntry e;
+    e.type = type;
+    e.count = count;
+    e.offset = fPendingData.size();     // made chunk relative in endWriteChunk()
+    e.size = size;
+    fPendingEntries.push_back( e );
+
+    fPendingData.resize( alignUp( fPendingData.size() + size, kAlignment ), 0 );
+    if( size > 0 )
+    {
+        memcpy( &fPendingData[(size_t)e.offset], data, size );
+    }
+}
+
+MStatus
+BinaryCacheFormat::beginReadChunk()
+{
+    if( fNextChunk >= fChunks.size() )
+    {
+        fCurChunk = 0;
+        return MS::kFailure;
+    }
+    return selectChunk( fChunks[fNextChunk++].offset ) ? MS::kSuccess : MS::kFailure;
+}
+
+void
+BinaryCacheFormat::endReadChunk()
+{
+    fCurChunk = 0;
+}
+
+MStatus
+BinaryCacheFormat::writeTime( MTime& time )
+{
+    fChunkTime = time.as( MTime::k6000FPS );
+    return MS::kSuccess;
+}
+
+MStatus
+BinaryCacheFormat::readTime( MTime& time )
+{
+    if( fCurChunk == 0 )
+    {
+        return MS::kFailure;
+    }
+
+    double ticks;
+    memcpy( &ticks, fMapped.data() + fCurChunk + 8, 8 );
+    time = MTime( ticks, MTime::k6000FPS );
+    return MS::kSuccess;
+}
+
+MStatus
+BinaryCacheFormat::readNextTime( MTime& foundTime )
+{
+    return readTime( foundTime );
+}
+
+MStatus
+BinaryCacheFormat::findTime( MTime& time, MTime& foundTime )
+//
+// Binary search of the chunk times collected when the file was opened.
+//
+{
+    ChunkRef key;
+    key.time = time.as( MTime::k6000FPS );
+    key.offset = 0;
+
+    vector<ChunkRef>::const_iterator it = lower_bound( fChunks.begin(), fChunks.end(), key );
+    if( it == fChunks.end() || it->time > key.time )
+    {
+        return MS::kFailure;
+    }
+
+    fNextChunk = ( it - fChunks.begin() ) + 1;
+    if( !selectChunk( it->offset ) )
+    {
+        return MS::kFailure;
+    }
+    return readTime( foundTime );
+}
+
+MStatus
+BinaryCacheFormat::writeChannelName( const MString& name )
+{
+    addEntry( CacheItem::kChannel, name.length(), name.asChar(), name.length() );
+    return MS::kSuccess;
+}
+
+MStatus
+BinaryCacheFormat::readChannelName( MString& name )
+//
+// Advance to the next channel entry of the current chunk. Failing at the
+// end of the chunk is how callers stop scanning, not an error.
+//
+{
+    name.clear();
+    if( fCurChunk == 0 )
+    {
+        return MS::kFailure;
+    }
+
+    while( fCursor < fCurEntries )
+    {
+        const DirEntry* e = entry( fCurChunk, fCursor++ );
+        if( e->type == CacheItem::kChannel )
+        {
+            string channel( fMapped.data() + fCurChunk + e->offset, (size_t)e->size );
+            map<string, MString>::iterator it = fChannelNames.find( channel );
+            if( it == fChannelNames.end() )
+            {
+                it = fChannelNames.insert( make_pair( channel, MString( channel.c_str() ) ) ).first;
+            }
+            name = it->second;
+            return MS::kSuccess;
+        }
+    }
+    return MS::kFailure;
+}
+
+MStatus
+BinaryCacheFormat::findChannelName( const MString& name )
+{
+    MString channel;
+    while( readChannelName( channel ) )
+    {
+        if( channel == name )
+        {
+            return MS::kSuccess;
+        }
+    }
+    return MS::kFailure;
+}
+
+const BinaryCacheFormat::DirEntry*
+BinaryCacheFormat::nextDataEntry( unsigned int type )
+{
+    if( fCurChunk == 0 || fCursor >= fCurEntries )
+    {
+        return NULL;
+    }
+
+    const DirEntry* e = entry( fCurChunk, fCursor );
+    if( type != 0 && e->type != type )
+    {
+        return NULL;
+    }
+    return e;
+}
+
+unsigned
+BinaryCacheFormat::readArraySize()
+{
+    const DirEntry* e = nextDataEntry( 0 );
+    if( e == NULL || e->type == CacheItem::kChannel || e->type == CacheItem::kInt32 )
+    {
+        return 0;
+    }
+    return e->count;
+}
+
+MStatus
+BinaryCacheFormat::writeInt32( int i )
+{
+    addEntry( CacheItem::kInt32, 1, &i, sizeof(int) );
+    return MS::kSuccess;
+}
+
+int
+BinaryCacheFormat::readInt32()
+{
+    const DirEntry* e = nextDataEntry( CacheItem::kInt32 );
+    if( e == NULL )
+    {
+        return 0;
+    }
+    fCursor++;
+
+    int value;
+    memcpy( &value, fMapped.data() + fCurChunk + e->offset, sizeof(int) );
+    return value;
+}
+
+MStatus
+BinaryCacheFormat::writeDoubleArray( const MDoubleArray& array )
+{
+    unsigned int size = array.length();
+    vector<double> values( size );
+    if( size > 0 ) array.get( &values[0] );
+    addEntry( CacheItem::kDoubleArray, size, size ? &values[0] : NULL, size * sizeof(double) );
+    return MS::kSuccess;
+}
+
+MStatus
+BinaryCacheFormat::readDoubleArray( MDoubleArray& array, unsigned arraySize )
+{
+    const DirEntry* e = nextDataEntry( CacheItem::kDoubleArray );
+    if( e == NULL || e->count != arraySize )
+    {
+        return MS::kFailure;
+    }
+    fCursor++;
+
+    const double* src = (const double*)( fMapped.data() + fCurChunk + e->offset );
+    array = MDoubleArray( src, arraySize );
+    return MS::kSuccess;
+}
+
+MStatus
+BinaryCacheFormat::writeFloatArray( const MFloatArray& array )
+{
+    unsigned int size = array.length();
+    vector<float> values( size );
+    if( size > 0 ) array.get( &values[0] );
+    addEntry( CacheItem::kFloatArray, size, size ? &values[0] : NULL, size * sizeof(float) );
+    return MS::kSuccess;
+}
+
+MStatus
+BinaryCacheFormat::readFloatArray( MFloatArray& array, unsigned arraySize )
+{
+    const DirEntry* e = nextDataEntry( CacheItem::kFloatArray );
+    if( e == NULL || e->count != arraySize )
+    {
+        return MS::kFailure;
+    }
+    fCursor++;
+
+    const float* src = (const float*)( fMapped.data() + fCurChunk + e->offset );
+    array = MFloatArray( src, arraySize );
+    return MS::kSuccess;
+}
+
+MStatus
+BinaryCacheFormat::writeDoubleVectorArray( const MVectorArray& array )
+{
+    unsigned int size = array.length();
+    vector<double> values( size * 3 );
+    if( size > 0 ) array.get( (double (*)[3])&values[0] );
+    addEntry( CacheItem::kDoubleVectorArray, size, size ? &values[0] : NULL, size * 3 * sizeof(double) );
+    return MS::kSuccess;
+}
+
+MStatus
+BinaryCacheFormat::readDoubleVectorArray( MVectorArray& array, unsigned arraySize )
+{
+    const DirEntry* e = nextDataEntry( CacheItem::kDoubleVectorArray );
+    if( e == NULL || e->count != arraySize )
+    {
+        return MS::kFailure;
+    }
+    fCursor++;
+
+    const double (*src)[3] = (const double (*)[3])( fMapped.data() + fCurChunk + e->offset );
+    array.setLength( arraySize );
+    for( unsigned int i = 0; i < arraySize; i++ )
+    {
+        array.set( src[i], i );
+    }
+    return MS::kSuccess;
+}
+
+MStatus
+BinaryCacheFormat::writeFloatVectorArray( const MFloatVectorArray& array )
+{
+    unsigned int size = array.length();
+    vector<float> values( size * 3 );
+    if( size > 0 ) array.get( (float (*)[3])&values[0] );
+    addEntry( CacheItem::kFloatVectorArray, size, size ? &values[0] : NULL, size * 3 * sizeof(float) );
+    return MS::kSuccess;
+}
+
+MStatus
+BinaryCacheFormat::readFloatVectorArray( MFloatVectorArray& array, unsigned arraySize )
+//
+// The block is 16 byte aligned in the mapping and already has the float[3]
+// layout, so the vectors are copied straight from the mapped pages into the
+// array without any parsing or intermediate buffer.
+//
+{
+    const DirEntry* e = nextDataEntry( CacheItem::kFloatVectorArray );
+    if( e == NULL || e->count != arraySize )
+    {
+        return MS::kFailure;
+    }
+    fCursor++;
+
+    const float (*src)[3] = (const float (*)[3])( fMapped.data() + fCurChunk + e->offset );
+    array.setLength( arraySize );
+    for( unsigned int i = 0; i < arraySize; i++ )
+    {
+        array.set( src[i], i );
+    }
+    return MS::kSuccess;
+}
+
+MString
+BinaryCacheFormat::extension()
+{
+    return fExtension;
+}
+
+MStatus
+BinaryCacheFormat::writeItem( const CacheItem& item )
+{
+    switch( item.type )
+    {
+    case CacheItem::kChannel:
+        return writeChannelName( item.name );
+    case CacheItem::kInt32:
+        return writeInt32( item.intValue );
+    case CacheItem::kDoubleArray:
+        return writeDoubleArray( item.doubles );
+    case CacheItem::kFloatArray:
+        return writeFloatArray( item.floats );
+    case CacheItem::kDoubleVectorArray:
+    {
+        unsigned int size = item.doubles.length() / 3;
+        vector<double> values( item.doubles.length() );
+        if( !values.empty() ) item.doubles.get( &values[0] );
+        addEntry( CacheItem::kDoubleVectorArray, size, values.empty() ? NULL : &values[0],
+                  size * 3 * sizeof(double) );
+        return MS::kSuccess;
+    }
+    case CacheItem::kFloatVectorArray:
+    {
+        unsigned int size = item.floats.length() / 3;
+        vector<float> values( item.floats.length() );
+        if( !values.empty() ) item.floats.get( &values[0] );
+        addEntry( CacheItem::kFloatVectorArray, size, values.empty() ? NULL : &values[0],
+                  size * 3 * sizeof(float) );
+        return MS::kSuccess;
+    }
+    }
+    return MS::kFailure;
+}
+
+// ****************************************
+//
+//  Xml to binary converter
+//
+
+class XmlCacheToBinaryCmd : public MPxCommand
+{
+public:
+    MStatus         doIt( const MArgList& args ) override;
+
+    static void*    creator() { return new XmlCacheToBinaryCmd(); }
+    static MSyntax  newSyntax();
+
+    static const char* commandName;
+};
+
+const char* XmlCacheToBinaryCmd::commandName = "xmlCacheToBinary";
+
+MSyntax XmlCacheToBinaryCmd::newSyntax()
+{
+    MSyntax syntax;
+    syntax.addArg( MSyntax::kString );
+    syntax.addArg( MSyntax::kString );
+    return syntax;
+}
+
+MStatus XmlCacheToBinaryCmd::doIt( const MArgList& args )
+//
+// Copy every chunk of an xml cache file into a chunkedBinary file. Only
+// the data file is converted, the cache description (.xml) has to point
+// at the new format and extension.
+//
+{
+    MStatus status;
+    MArgDatabase argData( syntax(), args, &status );
+    if( !status )
+    {
+        return status;
+    }
+
+    MString inputName, outputName;
+    argData.getCommandArgument( 0, inputName );
+    argData.getCommandArgument( 1, outputName );
+
+    XmlCacheFormat reader;
+    if( !reader.open( inputName, MPxCacheFormat::kRead ) )
+    {
+        displayError( "Could not read xml cache " + inputName );
+        return MS::kFailure;
+    }
+
+    BinaryCacheFormat writer;
+    if( !writer.open( outputName, MPxCacheFormat::kWrite ) )
+    {
+        displayError( "Could not write " + outputName );
+        return MS::kFailure;
+    }
+
+    MString version;
+    MTime startTime, endTime;
+    reader.headerInfo( version, startTime, endTime );
+    writer.writeHeader( version, startTime, endTime );
+
+    int numChunks = 0;
+    CacheItem item;
+    while( reader.beginReadChunk() )
+    {
+        MTime time( 0.0, MTime::k6000FPS );
+        reader.readTime( time );
+
+        writer.beginWriteChunk();
+        writer.writeTime( time );
+        while( reader.readChunkItem( item ) )
+        {
+            writer.writeItem( item );
+        }
+        writer.endWriteChunk();
+        numChunks++;
+    }
+    reader.close();
+    writer.close();
+
+    setResult( numChunks );
+    return MS::kSuccess;
+}
+
+// ****************************************
+//
+//  Seek benchmark
+//
+
+class XmlCacheSeekBenchmarkCmd : public MPxCommand
+{
+public:
+    MStatus         doIt( const MArgList& args ) override;
+
+    static void*    creator() { return new XmlCacheSeekBenchmarkCmd(); }
+    static MSyntax  newSyntax();
+
+    static const char* commandName;
+};
+
+const char* XmlCacheSeekBenchmarkCmd::commandName = "xmlCacheSeekBenchmark";
+
+MSyntax XmlCacheSeekBenchmarkCmd::newSyntax()
+{
+    MSyntax syntax;
+    syntax.addFlag( "-f", "-frames", MSyntax::kLong );
+    syntax.addFlag( "-p", "-points", MSyntax::kLong );
+    syntax.addFlag( "-s", "-seeks", MSyntax::kLong );
+    syntax.addFlag( "-fn", "-fileName", MSyntax::kString );
+    return syntax;
+}
+
+MStatus XmlCacheSeekBenchmarkCmd::doIt( const MArgList& args )
+//
+// Write a cache with one position channel per frame, then seek to random
+// frames and read the channel back, once through the index and once with
+// the linear scan.  Returns the two timings in seconds.  The indexed one
+// includes building the index on the first seek; the linear reader never
+// builds it.
+//
+{
+    MStatus status;
+    MArgDatabase argData( syntax(), args, &status );
+    if( !status )
+    {
+        return status;
+    }
+
+    int numFrames = 2000;
+    int numPoints = 1000;
+    int numSeeks = 500;
+    MString fileName;
+    MGlobal::executeCommand( "internalVar -userTmpDir", fileName );
+    fileName += "xmlCacheSeekBenchmark.mc";
+    if( argData.isFlagSet( "-frames" ) ) argData.getFlagArgument( "-frames", 0, numFrames );
+    if( argData.isFlagSet( "-points" ) ) argData.getFlagArgument( "-points", 0, numPoints );
+    if( argData.isFlagSet( "-seeks" ) ) argData.getFlagArgument( "-seeks", 0, numSeeks );
+    if( argData.isFlagSet( "-fileName" ) ) argData.getFlagArgument( "-fileName", 0, fileName );
+    if( numFrames < 1 || numPoints < 1 || numSeeks < 1 )
+    {
+        displayError( "frames, points and seeks must be positive" );
+        return MS::kInvalidParameter;
+    }
+
+    MString channel( "benchmarkShape_positions" );
+    MTime frame( 1.0, MTime::kFilm );
+    double ticksPerFrame = frame.as( MTime::k6000FPS );
+
+    // Write the cache.
+    {
+        XmlCacheFormat writer;
+        if( !writer.open( fileName, MPxCacheFormat::kWrite ) )
+        {
+            displayError( "Could not write " + fileName );
+            return MS::kFailure;
+        }
+
+        MTime startTime( ticksPerFrame, MTime::k6000FPS );
+        MTime endTime( ticksPerFrame * numFrames, MTime::k6000FPS );
+        writer.writeHeader( "2.0", startTime, endTime );
+
+        MFloatVectorArray positions( numPoints );
+        for( int f = 1; f <= numFrames; f++ )
+        {
+            for( int i = 0; i < numPoints; i++ )
+            {
+                positions[i] = MFloatVector( (float)i, (float)f, 0.0f );
+            }
+
+            MTime t( ticksPerFrame * f, MTime::k6000FPS );
+            writer.beginWriteChunk();
+            writer.writeTime( t );
+            writer.writeChannelName( channel );
+            writer.writeFloatVectorArray( positions );
+            writer.endWriteChunk();
+        }
+        writer.close();
+    }
+
+    // Same sequence of frames for both runs.
+    vector<int> frames( numSeeks );
+    unsigned int seed = 12345;
+    for( int i = 0; i < numSeeks; i++ )
+    {
+        seed = seed * 1103515245u + 12345u;
+        frames[i] = 1 + (int)( (seed >> 8) % (unsigned int)numFrames );
+    }
+
+    double elapsed[2] = { 0.0, 0.0 };
+    for( int pass = 0; pass < 2; pass++ )
+    {
+        bool useIndex = ( pass == 0 );
+
+        MTimer timer;
+        timer.beginTimer();
+
+        XmlCacheFormat reader;
+        if( !reader.open( fileName, MPxCacheFormat::kRead ) )
+        {
+            displayError( "Could not read " + fileName );
+            return MS::kFailure;
+        }
+
+        MFloatVectorArray positions;
+        for( int i = 0; i < numSeeks; i++ )
+        {
+            MTime seekTime( ticksPerFrame * frames[i], MTime::k6000FPS );
+            MTime foundTime;
+            MStatus found = useIndex ? reader.findTime( seekTime, foundTime )
+                                     : reader.findTimeLinear( seekTime, foundTime );
+            if( !found || !reader.findChannelName( channel ) )
+            {
+                displayError( "Seek failed" );
+                return MS::kFailure;
+            }
+            unsigned size = reader.readArraySize();
+            reader.readFloatVectorArray( positions, size );
+            reader.endReadChunk();
+        }
+        reader.close();
+
+        timer.endTimer();
+        elapsed[pass] = timer.elapsedTime();
+    }
+
+    remove( fileName.asChar() );
+    remove( ( fileName + ".idx" ).asChar() );
+
+    MString out( "xmlCacheSeekBenchmark: " );
+    out += numFrames;
+    out += " frames, ";
+    out += numSeeks;
+    out += " random seeks: indexed ";
+    out += elapsed[0];
+    out += " s, linear ";
+    out += elapsed[1];
+    out += " s";
+    displayInfo( out );
+
+    MDoubleArray result;
+    result.append( elapsed[0] );
+    result.append( elapsed[1] );
+    setResult( result );
+
+    return MS::kSuccess;
+}
+
+
+
+// ****************************************
+
+MStatus initializePlugin( MObject obj )
+{
+    MFnPlugin plugin( obj, PLUGIN_COMPANY, "1.0", "Any" );
+
+    plugin.registerCacheFormat(
+        XmlCacheFormat::translatorName(),
+        XmlCacheFormat::creator
+    );
+
+    plugin.registerCacheFormat(
+        BinaryCacheFormat::translatorName(),
+        BinaryCacheFormat::creator
+    );
+
+    plugin.registerCommand(
+        XmlCacheToBinaryCmd::commandName,
+        XmlCacheToBinaryCmd::creator,
+        XmlCacheToBinaryCmd::newSyntax
+    );
+
+    plugin.registerCommand(
+        XmlCacheSeekBenchmarkCmd::commandName,
+        XmlCacheSeekBenchmarkCmd::creator,
+        XmlCacheSeekBenchmarkCmd::newSyntax
     );
 
     return MS::kSuccess;
@@ -844,6 +2434,9 @@ MStatus uninitializePlugin( MObject obj )
     MFnPlugin plugin( obj );
 
     plugin.deregisterCacheFormat( XmlCacheFormat::translatorName() );
+    plugin.deregisterCacheFormat( BinaryCacheFormat::translatorName() );
+    plugin.deregisterCommand( XmlCacheToBinaryCmd::commandName );
+    plugin.deregisterCommand( XmlCacheSeekBenchmarkCmd::commandName );
 
     return MS::kSuccess;
 }
@@ -14,6 +14,8 @@
 #include <maya/MViewport2Renderer.h>
 #include <maya/MFragmentManager.h>
 
+#include "../common/batchTexture.h"
+
 //
 // DESCRIPTION:
 // Produces dependency graph node brickTexture
@@ -23,6 +25,11 @@
 // The output attribute of the BrickTexture node is called "outColor". To use this shader, create a BrickTexture and connect its output 
 // to an input of a surface/shader node such as Color.
 //
+// The plug-in also provides the command "brickTextureSample", which evaluates
+// a brickTexture node on many uv coordinates at once rather than one
+// compute() per sample, and can bake the texture to an image. See
+// common/batchTexture.h.
+//
 
 //
 // Node declaration
@@ -42,6 +49,21 @@ class brickTextureNode : public MPxNode
     //  Id tag for use with binary file format
     static  MTypeId id;
 
+    // Batch interface, see batchTexture.h
+    struct Params
+    {
+        MFloatVector    color1;
+        MFloatVector    color2;
+        float           blur;
+        float           filterSize[2];
+    };
+
+    static const unsigned int kCoordinates = 2;
+
+    static MStatus getParams( const MObject& node, Params& params );
+    static void sampleBatch( const Params& params, const float* uv,
+                             size_t count, float* rgba );
+
     private:
 
     // Input attributes
@@ -266,6 +288,67 @@ MStatus brickTextureNode::compute(const MPlug& plug, MDataBlock& block)
     return MS::kSuccess;
 }
 
+// DESCRIPTION:
+// Batch interface, see batchTexture.h
+MStatus brickTextureNode::getParams(const MObject& node, Params& params)
+{
+    MStatus status;
+    MFnDependencyNode fnNode(node, &status);
+    if (!status) return status;
+
+    batchTexture::getColor(fnNode, aColor1, params.color1);
+    batchTexture::getColor(fnNode, aColor2, params.color2);
+    fnNode.findPlug(aBlurFactor, true).getValue(params.blur);
+    batchTexture::getFloats(fnNode, aFilterSize, params.filterSize, 2);
+
+    return MS::kSuccess;
+}
+
+void brickTextureNode::sampleBatch(const Params& params, const float* uv,
+                                   size_t count, float* rgba)
+{
+    const float borderWidth = 0.1f;
+    const float brickHeight = 0.4f;
+    const float brickWidth  = 0.9f;
+
+    const float v1 = borderWidth/2;
+    const float v2 = v1 + brickHeight;
+    const float v3 = v2 + borderWidth;
+    const float v4 = v3 + brickHeight;
+    const float u1 = borderWidth/2;
+    const float u2 = brickWidth/2;
+    const float u3 = u2 + borderWidth;
+    const float u4 = u1 + brickWidth;
+
+    const float du = params.blur*params.filterSize[0]/2.0f;
+    const float dv = params.blur*params.filterSize[1]/2.0f;
+
+    const float c1[3] = { params.color1.x, params.color1.y, params.color1.z };
+    const float c2[3] = { params.color2.x, params.color2.y, params.color2.z };
+
+    for (size_t i = 0; i < count; i++)
+    {
+        float u = uv[2*i];
+        float v = uv[2*i+1];
+        u -= floorf(u);
+        v -= floorf(v);
+
+        float t = MAX(MIN(linearstep(v, v1 - dv, v1 + dv) -
+                          linearstep(v, v2 - dv, v2 + dv),
+                          MAX(linearstep(u, u3 - du, u3 + du),
+                              1 - linearstep(u, u2 - du, u2 + du))),
+                      MIN(linearstep(v, v3 - dv, v3 + dv) -
+                          linearstep(v, v4 - dv, v4 + dv),
+                          linearstep(u, u1 - du, u1 + du) -
+                          linearstep(u, u4 - du, u4 + du)));
+
+        rgba[4*i]   = t*c1[0] + (1.0f - t)*c2[0];
+        rgba[4*i+1] = t*c1[1] + (1.0f - t)*c2[1];
+        rgba[4*i+2] = t*c1[2] + (1.0f - t)*c2[2];
+        rgba[4*i+3] = 1.0f;
+    }
+}
+
 //
 // Override definition
 MHWRender::MPxShadingNodeOverride* brickTextureNodeOverride::creator(
@@ -436,12 +519,17 @@ MStatus initializePlugin( MObject obj )
             sRegistrantId,
             brickTextureNodeOverride::creator));
 
+    CHECK_MSTATUS( plugin.registerCommand("brickTextureSample",
+                        batchTexture::SampleCmd<brickTextureNode>::creator,
+                        batchTexture::SampleCmd<brickTextureNode>::newSyntax) );
+
     return MS::kSuccess;
 }
 
 MStatus uninitializePlugin( MObject obj )
 {
     MFnPlugin plugin( obj );
+    CHECK_MSTATUS( plugin.deregisterCommand("brickTextureSample") );
     CHECK_MSTATUS( plugin.deregisterNode( brickTextureNode::id ) );
 
     CHECK_MSTATUS(
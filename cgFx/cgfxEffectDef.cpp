@@ -17,7 +17,7 @@
 #include "cgfxShaderNode.h"
 #include "cgfxShaderCommon.h"
 
-#include <sys/stat.h>
+#include <stdio.h>
 #include <map>
 
 #ifdef _WIN32
@@ -1015,27 +1015,55 @@ bool cgfxTechnique::hasBlending(CGtechnique technique)
 
 namespace cgfxEffectInternal
 {
-    time_t fileTimeStamp(const MString& fileName)
+    // Hash of the content of the effect file, 0 if it cannot be read.
+    // Effects are keyed by file name and content, so that an edited file
+    // is compiled again even when its modification time does not change.
+    // The file name stays in the key: the effect is compiled from it, and
+    // its directory is in the include path.
+    unsigned long long fileContentHash(const MString& fileName)
     {
-        struct stat statBuf;
-        if( stat(fileName.asChar(), &statBuf) != 0 )
+        FILE* file = fopen(fileName.asChar(), "rb");
+        if (!file)
             return 0;
 
-        return statBuf.st_mtime;
+        // 64 bit FNV-1a
+        unsigned long long hash = 14695981039346656037ull;
+        unsigned char buffer[65536];
+        size_t count;
+        while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        {
+            for (size_t i = 0; i < count; ++i)
+            {
+                hash ^= buffer[i];
+                hash *= 1099511628211ull;
+            }
+        }
+        fclose(file);
+
+        return hash ? hash : 1;
     }
 
     struct EffectKey
     {
         const cgfxProfile* profile;
         MString fileName;
-        time_t timeStamp;
+        unsigned long long contentHash;
     };
 
     bool operator< (const EffectKey& lhs, const EffectKey& rhs)
     {
-        return (lhs.profile <  rhs.profile) ||
-               (lhs.profile == rhs.profile && ( (lhs.timeStamp <  rhs.timeStamp) ||
-                                                (lhs.timeStamp == rhs.timeStamp && strcmp(lhs.fileName.asChar(), rhs.fileName.asChar()) < 0) ) );
+        if (lhs.profile != rhs.profile)
+            return lhs.profile < rhs.profile;
+        int order = strcmp(lhs.fileName.asChar(), rhs.fileName.asChar());
+        if (order != 0)
+            return order < 0;
+        return lhs.contentHash < rhs.contentHash;
+    }
+
+    EffectKey makeKey(const MString& fileName, const cgfxProfile* profile)
+    {
+        EffectKey key = { profile, fileName, fileContentHash(fileName) };
+        return key;
     }
 
     // Collection of effects
@@ -1045,8 +1073,8 @@ namespace cgfxEffectInternal
     class cgfxEffectCollection
     {
     public:
-        cgfxEffect* find(const MString& fileName, const cgfxProfile* profile) const;
-        void add(cgfxEffect* effect, const MString& fileName, const cgfxProfile* profile);
+        cgfxEffect* find(const EffectKey& key) const;
+        void add(cgfxEffect* effect, const EffectKey& key);
         void remove(cgfxEffect* effect);
 
     private:
@@ -1058,12 +1086,10 @@ namespace cgfxEffectInternal
     };
 
 
-    cgfxEffect* cgfxEffectCollection::find(const MString& fileName, const cgfxProfile* profile) const
+    cgfxEffect* cgfxEffectCollection::find(const EffectKey& key) const
     {
         cgfxEffect* effect = NULL;
 
-        EffectKey key = { profile, fileName, fileTimeStamp(fileName) } ;
-
         Key2EffectMap::const_iterator it = key2EffectMap.find(key);
         if(it != key2EffectMap.end())
         {
@@ -1073,10 +1099,8 @@ namespace cgfxEffectInternal
         return effect;
     }
 
-    void cgfxEffectCollection::add(cgfxEffect* effect, const MString& fileName, const cgfxProfile* profile)
+    void cgfxEffectCollection::add(cgfxEffect* effect, const EffectKey& key)
     {
-        EffectKey key = { profile, fileName, fileTimeStamp(fileName) } ;
-
         key2EffectMap.insert( std::make_pair(key, effect) );
         effect2KeyMap.insert( std::make_pair(effect, key) );
     }
@@ -1096,11 +1120,12 @@ namespace cgfxEffectInternal
 
 cgfxRCPtr<const cgfxEffect> cgfxEffect::loadEffect(const MString& fileName, const cgfxProfile* profile)
 {
-    cgfxEffect *effect = cgfxEffectInternal::gEffectsCollection.find(fileName, profile);
+    const cgfxEffectInternal::EffectKey key = cgfxEffectInternal::makeKey(fileName, profile);
+    cgfxEffect *effect = cgfxEffectInternal::gEffectsCollection.find(key);
     if(effect == NULL)
     {
         effect = new cgfxEffect(fileName, profile);
-        cgfxEffectInternal::gEffectsCollection.add(effect, fileName, profile);
+        cgfxEffectInternal::gEffectsCollection.add(effect, key);
     }
 
     return cgfxRCPtr<const cgfxEffect>(effect);
@@ -1581,16 +1581,18 @@ void cgfxShaderNode::bindAttrValues()
                         aDef->fTexture = cgfxTextureCache::instance().getTexture(
                             texFileName, textureNode, fShaderFxFile,
                             aDef->fName, aDef->fType);
+                    }
 
-                        if (!aDef->fTexture->isValid() && texFileName.length() > 0) {
-                            MFnDependencyNode fnNode( oNode );
-                            MString sMsg = "cgfxShader ";
-                            sMsg += fnNode.name();
-                            sMsg += " : failed to load texture \"";
-                            sMsg += texFileName;
-                            sMsg += "\".";
-                            MGlobal::displayWarning( sMsg );
-                        }
+                    // Upload the texture once it has been decoded.
+                    if (aDef->fTexture->update() &&
+                        !aDef->fTexture->isValid() && texFileName.length() > 0) {
+                        MFnDependencyNode fnNode( oNode );
+                        MString sMsg = "cgfxShader ";
+                        sMsg += fnNode.name();
+                        sMsg += " : failed to load texture \"";
+                        sMsg += texFileName;
+                        sMsg += "\".";
+                        MGlobal::displayWarning( sMsg );
                     }
 
                     checkGlErrors("After loading texture");
@@ -4331,16 +4333,6 @@ bool cgfxShaderOverride::bindAttrValues() const
 
                         cgGLSetupSampler(activeDef->fParameterHandle, aDef->fTexture->getTextureId());
 
-                        if (!aDef->fTexture->isValid() && texFileName.length() > 0) {
-                            MFnDependencyNode fnNode( oNode );
-                            MString sMsg = "cgfxShader ";
-                            sMsg += fnNode.name();
-                            sMsg += " : failed to load texture \"";
-                            sMsg += texFileName;
-                            sMsg += "\".";
-                            MGlobal::displayWarning( sMsg );
-                        }
-
                         // We need to call cgSetPassState() after
                         // having called cgGLSetupSampler(). Only
                         // calling cgUpdateProgramParameters() is
@@ -4400,6 +4392,18 @@ bool cgfxShaderOverride::bindAttrValues() const
                         }
                     }
 
+                    // Upload the texture once it has been decoded.
+                    if (aDef->fTexture->update() &&
+                        !aDef->fTexture->isValid() && texFileName.length() > 0) {
+                        MFnDependencyNode fnNode( oNode );
+                        MString sMsg = "cgfxShader ";
+                        sMsg += fnNode.name();
+                        sMsg += " : failed to load texture \"";
+                        sMsg += texFileName;
+                        sMsg += "\".";
+                        MGlobal::displayWarning( sMsg );
+                    }
+
                     checkGlErrors("After loading texture");
 
                     break;
@@ -16,9 +16,78 @@
 
 #include <maya/MHardwareRenderer.h>
 #include <maya/MFileObject.h>
+#include <maya/MGlobal.h>
+#include <maya/M3dView.h>
+#include <maya/MTimerMessage.h>
 #include "nv_dds.h"
 
+#include <tbb/task_group.h>
+
+#include <algorithm>
+#include <atomic>
+#include <list>
 #include <map>
+#include <stdlib.h>
+#include <vector>
+
+//==============================================================================
+// Texture decoding
+//==============================================================================
+
+// The reading of a texture file on a decoding thread. The job is shared
+// between the cache entry and the decoding task so that an entry can
+// be deleted while its texture is still being read.
+struct cgfxTextureDecodeJob
+{
+    cgfxTextureDecodeJob(
+        const std::string&          path,
+        cgfxAttrDef::cgfxAttrType   attrType,
+        bool                        flipToOpenGL
+    )
+        : fPath(path),
+          fAttrType(attrType),
+          fFlipToOpenGL(flipToOpenGL),
+          fDone(false)
+    {}
+
+    const std::string                 fPath;
+    const cgfxAttrDef::cgfxAttrType   fAttrType;
+    const bool                        fFlipToOpenGL;
+
+    nv_dds::CDDSImage                 fImage;
+
+    // Set by the decoding thread once fImage can be uploaded.
+    std::atomic<bool>                 fDone;
+};
+
+bool cgfxDecodeTexture(
+    const std::string&          path,
+    cgfxAttrDef::cgfxAttrType   attrType,
+    bool                        flipToOpenGL,
+    nv_dds::CDDSImage&          image
+)
+{
+    if (path.empty()) {
+        return false;
+    }
+
+    switch (attrType)
+    {
+        case cgfxAttrDef::kAttrTypeEnvTexture:
+        case cgfxAttrDef::kAttrTypeCubeTexture:
+        case cgfxAttrDef::kAttrTypeNormalizationTexture:
+            // we don't want to flip cube maps...
+            return image.load(path, false);
+        default:
+            // Only flip 2D textures if we're using right-handed texture
+            // coordinates. Most of the time, we want to do the flipping
+            // on the UV coordinates rather than the texture so that procedural
+            // texture coordinates generated inside the shader work as well
+            // (and if we just flip the texture to compensate for Maya's UV
+            // coordinate system, these will get inverted)
+            return image.load(path, flipToOpenGL);
+    }
+}
 
 namespace {
 
@@ -71,42 +140,32 @@ namespace {
         return path;
     }
     
-    bool allocateAndReadTexture(
-        MString                     path,
+    size_t imageBytes(nv_dds::CDDSImage& image)
+    {
+        size_t bytes = image.get_size();
+        if (image.get_num_mipmaps() == 0) {
+            // The mipmaps are generated by the driver.
+            bytes += bytes / 3;
+        }
+        for (int i = 0; i < image.get_num_mipmaps(); ++i) {
+            bytes += image.get_mipmap(i).get_size();
+        }
+        return image.is_cubemap() ? 6 * bytes : bytes;
+    }
+
+    // Upload the decoded image into the texture. If the image is not
+    // valid, the texture node is read instead or, failing that, a
+    // stand-in texture is created. Returns true if actual texture data
+    // could be uploaded.
+    bool uploadTexture(
+        nv_dds::CDDSImage&          image,
         MObject                     textureNode,
         cgfxAttrDef::cgfxAttrType   attrType,
-        GLuint&                     textureId
+        GLuint                      textureId,
+        size_t&                     bytes
     )
     {
-        GLuint val;
-        glGenTextures(1, &val);
-        textureId = val;
-
-        nv_dds::CDDSImage image;
-
-        if (path.length() > 0)
-        {
-            switch (attrType)
-            {
-                case cgfxAttrDef::kAttrTypeEnvTexture:
-                case cgfxAttrDef::kAttrTypeCubeTexture:
-                case cgfxAttrDef::kAttrTypeNormalizationTexture:
-                    // we don't want to flip cube maps...
-                    image.load(path.asChar(),false);
-                    break;
-                default:
-                    // Only flip 2D textures if we're using right-handed texture
-                    // coordinates. Most of the time, we want to do the flipping
-                    // on the UV coordinates rather than the texture so that procedural
-                    // texture coordinates generated inside the shader work as well
-                    // (and if we just flip the texture to compensate for Maya's UV
-                    // coordinate system, these will get inverted)
-                    image.load(
-                        path.asChar(),
-                        cgfxProfile::getTexCoordOrientation() == cgfxProfile::TEXCOORD_OPENGL);
-                    break;
-            }
-        }
+        bytes = image.is_valid() ? imageBytes(image) : 0;
 
         // Our common stand-in "texture"
         // The code below creates a separate stand-in GL texture
@@ -200,6 +259,7 @@ namespace {
                                 glTexImage2D(
                                     GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0,
                                     GL_RGBA, GL_UNSIGNED_BYTE, img.pixels());
+                                bytes = (size_t)width * height * 4 * 4 / 3;
                                 imageLoaded = true;
                             }
                         }
@@ -385,11 +445,17 @@ public:
     void dump() const override
     {
         fprintf(stderr, "*** Dumping texture cache ***\n");
+        fprintf(stderr, "   retained = %u entries, %u KB of %u KB\n\n",
+                (unsigned int)fRetained.size(),
+                (unsigned int)(fRetainedBytes / 1024),
+                (unsigned int)(fBudget / 1024));
         const Map::const_iterator end = fEntries.end();
         for (Map::const_iterator it = fEntries.begin(); it != end; ++it) {
-            fprintf(stderr, "   entry = 0x%p, refCount = %d\n",
+            fprintf(stderr, "   entry = 0x%p, refCount = %d%s%s\n",
                     it->second.operator->(),
-                    it->second->getRefCount());
+                    it->second->getRefCount(),
+                    it->second->isPending() ? ", pending" : "",
+                    it->second->fRetained ? ", retained" : "");
             fprintf(stderr, "   tex file = \"%s\"\n",
                     it->first.fTextureFilePath.c_str());
             fprintf(stderr, "   fx  file = \"%s\"\n",
@@ -402,22 +468,84 @@ public:
     
     static void flushEntry(const EntryKey& key)
     {
-        sTheTextureCache->fEntries.erase(key);
+        if (!sTheTextureCache) {
+            return;
+        }
+
+        Map& entries = sTheTextureCache->fEntries;
+        const Map::iterator it = entries.find(key);
+        if (it == entries.end()) {
+            return;
+        }
+
+        if (it->second->fRetained) {
+            sTheTextureCache->unretain(it->second.operator->());
+        }
+        entries.erase(it);
     }
-    
+
+    // Keep an entry that is no longer used by any shader, evicting the
+    // least recently released entries beyond the memory budget. Returns
+    // false if the entry should be flushed instead.
+    static bool retainEntry(cgfxTextureCacheEntry* entry);
+
 private:
 
     typedef std::map<EntryKey, cgfxRCPtr<cgfxTextureCacheEntry>, EntryKeyLessThan> Map;
+
+    void unretain(cgfxTextureCacheEntry* entry);
+
+    // Periodically called while textures are being decoded so that the
+    // views get refreshed with the decoded textures.
+    static void decodeTimerCallback(float elapsedTime, float lastTime, void* clientData);
+
     Map fEntries;
+
+    // Whether texture files are read on the decoding threads.
+    bool fAsync;
+
+    tbb::task_group fDecoders;
+    std::vector<std::shared_ptr<cgfxTextureDecodeJob> > fPendingJobs;
+    MCallbackId fDecodeTimer;
+
+    // Entries no longer used by any shader, most recently released
+    // first, and the memory that they are allowed to take.
+    std::list<cgfxTextureCacheEntry*> fRetained;
+    size_t fRetainedBytes;
+    size_t fBudget;
 };
 
 cgfxTextureCache::Imp* cgfxTextureCache::Imp::sTheTextureCache = 0;
 
 cgfxTextureCache::Imp::Imp()
-{}
+    : fAsync(MGlobal::mayaState() == MGlobal::kInteractive &&
+             getenv("MAYA_CGFX_SYNC_TEXTURE_LOAD") == NULL),
+      fDecodeTimer(0),
+      fRetainedBytes(0),
+      fBudget(256)
+{
+    // Memory budget, in MB, for the textures that are kept after the
+    // last shader using them went away. 0 disables the retention.
+    const char* budget = getenv("MAYA_CGFX_TEXTURE_CACHE_MB");
+    if (budget) {
+        fBudget = (size_t)atoi(budget);
+    }
+    fBudget *= 1024 * 1024;
+}
 
 cgfxTextureCache::Imp::~Imp()
-{}
+{
+    fDecoders.wait();
+    if (fDecodeTimer) {
+        MMessage::removeCallback(fDecodeTimer);
+    }
+
+    // The retained entries are only referenced by the map.
+    for (cgfxTextureCacheEntry* entry : fRetained) {
+        entry->fRetained = false;
+    }
+    fRetained.clear();
+}
 
 // Return the texture cache entry matching the parameters. If the
 // texture is present in the cache, an entry will be created and
@@ -441,22 +569,111 @@ cgfxRCPtr<cgfxTextureCacheEntry> cgfxTextureCache::Imp::getTexture(
     
     const Map::const_iterator entryIt = fEntries.find(key);
     if (entryIt != fEntries.end()) {
+        if (entryIt->second->fRetained) {
+            unretain(entryIt->second.operator->());
+        }
         return entryIt->second;
     }
 
     GLuint textureId;
-    bool valid = allocateAndReadTexture(
-        textureFilePath, textureNode, attrType, textureId);
+    glGenTextures(1, &textureId);
     
     cgfxRCPtr<cgfxTextureCacheEntry> entry(
         new cgfxTextureCacheEntry(
             key.fTextureFilePath, key.fShaderFxFile, key.fAttrName, key.fAttrType,
-            textureId, valid));
+            textureNode, textureId));
     fEntries.insert(std::make_pair(key,entry));
 
+    // The orientation is read here as cgfxProfile is not meant to be
+    // used from the decoding threads.
+    std::shared_ptr<cgfxTextureDecodeJob> job =
+        std::make_shared<cgfxTextureDecodeJob>(
+            key.fTextureFilePath, attrType,
+            cgfxProfile::getTexCoordOrientation() == cgfxProfile::TEXCOORD_OPENGL);
+    entry->fJob = job;
+
+    if (fAsync && textureFilePath.length() > 0) {
+        // Hand out a stand-in texture while the file is being read.
+        nv_dds::CDDSImage none;
+        size_t bytes;
+        uploadTexture(none, MObject::kNullObj, attrType, textureId, bytes);
+
+        fPendingJobs.push_back(job);
+        fDecoders.run([job]() {
+            cgfxDecodeTexture(job->fPath, job->fAttrType, job->fFlipToOpenGL, job->fImage);
+            job->fDone = true;
+        });
+
+        if (!fDecodeTimer) {
+            fDecodeTimer = MTimerMessage::addTimerCallback(
+                0.1f, decodeTimerCallback, this);
+        }
+    }
+    else {
+        // Batch rendering can't wait for a later refresh.
+        cgfxDecodeTexture(job->fPath, job->fAttrType, job->fFlipToOpenGL, job->fImage);
+        job->fDone = true;
+        entry->finishLoading();
+    }
+
     return entry;
 }
 
+bool cgfxTextureCache::Imp::retainEntry(cgfxTextureCacheEntry* entry)
+{
+    // Pending entries are not retained as their decoded data would
+    // stay in memory until they are used again.
+    if (!sTheTextureCache || sTheTextureCache->fBudget == 0 || entry->isPending()) {
+        return false;
+    }
+
+    Imp& cache = *sTheTextureCache;
+    entry->fRetained = true;
+    cache.fRetained.push_front(entry);
+    cache.fRetainedBytes += entry->fBytes;
+
+    while (cache.fRetainedBytes > cache.fBudget && !cache.fRetained.empty()) {
+        // This deletes the evicted entry, which might be the one that
+        // has just been retained.
+        cgfxTextureCacheEntry* oldest = cache.fRetained.back();
+        flushEntry(EntryKey(oldest->fTextureFilePath, oldest->fShaderFxFile,
+                            oldest->fAttrName, oldest->fAttrType));
+    }
+
+    return true;
+}
+
+void cgfxTextureCache::Imp::unretain(cgfxTextureCacheEntry* entry)
+{
+    fRetained.erase(std::find(fRetained.begin(), fRetained.end(), entry));
+    fRetainedBytes -= entry->fBytes;
+    entry->fRetained = false;
+}
+
+void cgfxTextureCache::Imp::decodeTimerCallback(
+    float /*elapsedTime*/, float /*lastTime*/, void* clientData)
+{
+    Imp* cache = (Imp*)clientData;
+
+    const size_t pending = cache->fPendingJobs.size();
+    cache->fPendingJobs.erase(
+        std::remove_if(cache->fPendingJobs.begin(), cache->fPendingJobs.end(),
+                       [](const std::shared_ptr<cgfxTextureDecodeJob>& job) {
+                           return job->fDone.load();
+                       }),
+        cache->fPendingJobs.end());
+
+    // The upload itself happens when the shaders are drawn.
+    if (cache->fPendingJobs.size() != pending) {
+        M3dView::scheduleRefreshAllViews();
+    }
+
+    if (cache->fPendingJobs.empty()) {
+        MMessage::removeCallback(cache->fDecodeTimer);
+        cache->fDecodeTimer = 0;
+    }
+}
+
 
 //==============================================================================
 // Class cgfxTextureCacheEntry
@@ -468,6 +685,38 @@ cgfxTextureCacheEntry::~cgfxTextureCacheEntry()
     fTextureId = 0;
 }
 
+bool cgfxTextureCacheEntry::update()
+{
+    if (fJob) {
+        if (!fJob->fDone) {
+            return false;
+        }
+        // Don't disturb the textures bound by the caller.
+        glPushAttrib(GL_TEXTURE_BIT);
+        finishLoading();
+        glPopAttrib();
+    }
+
+    if (fReported) {
+        return false;
+    }
+    fReported = true;
+    return true;
+}
+
+void cgfxTextureCacheEntry::finishLoading()
+{
+    // The texture node might have been deleted while the texture file
+    // was being read.
+    MObject textureNode =
+        fTextureNode.isValid() ? fTextureNode.object() : MObject::kNullObj;
+
+    fValid = uploadTexture(fJob->fImage, textureNode, fAttrType, fTextureId, fBytes);
+
+    fJob.reset();
+    fTextureNode = MObjectHandle();
+}
+
 void cgfxTextureCacheEntry::markAsStaled()
 {
     fStaled = true;
@@ -500,10 +749,14 @@ void cgfxTextureCacheEntry::release()
     if (fRefCount == 1) {
         // If the refCount is one, only 2 cases are possible. Either
         // the last reference comes for the texture cache and we can
-        // safely remove it from the texture cache to save memory. Or,
-        // the last reference is for a staled texture cache entry and
-        // it is no longer referenced by the texture cache anyway.  
+        // keep it around within the memory budget, or remove it from
+        // the texture cache to save memory. Or, the last reference is
+        // for a staled texture cache entry and it is no longer
+        // referenced by the texture cache anyway.  
         //
+        if (!fStaled && cgfxTextureCache::Imp::retainEntry(this)) {
+            return;
+        }
         cgfxTextureCache::Imp::flushEntry(
             EntryKey(fTextureFilePath, fShaderFxFile, fAttrName, fAttrType));
     }
@@ -523,8 +776,11 @@ void cgfxTextureCache::initialize()
 
 void cgfxTextureCache::uninitialize()
 {
-    delete Imp::sTheTextureCache;
+    // Entries released while the cache is being destroyed must not
+    // try to flush themselves from it.
+    Imp* cache = Imp::sTheTextureCache;
     Imp::sTheTextureCache = 0;
+    delete cache;
 }
 
 cgfxTextureCache& cgfxTextureCache::instance()
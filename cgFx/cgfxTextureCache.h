@@ -16,10 +16,27 @@
 #include "cgfxShaderCommon.h"
 #include "cgfxAttrDef.h"
 
+#include <maya/MObjectHandle.h>
+
+#include <memory>
 #include <string>
 
 template <class T> class cgfxRCPtr;
 class cgfxTextureCache;
+struct cgfxTextureDecodeJob;
+
+namespace nv_dds { class CDDSImage; }
+
+// Read and, if requested, flip the texture file into image. This is the
+// part of the texture loading that runs on the decoding threads: it does
+// not touch OpenGL nor Maya and can therefore be exercised without a GL
+// context. The flip is ignored for the cube map types.
+bool cgfxDecodeTexture(
+    const std::string&          path,
+    cgfxAttrDef::cgfxAttrType   attrType,
+    bool                        flipToOpenGL,
+    nv_dds::CDDSImage&          image
+);
 
 class cgfxTextureCacheEntry
 {
@@ -48,6 +65,18 @@ public:
         return fValid;
     }
 
+    // Indicates that the texture file is still being decoded. The
+    // entry holds a stand-in texture until update() uploads the data.
+    bool isPending() const {
+        return fJob != nullptr;
+    }
+
+    // Upload the texture data once it has been decoded. Must be called
+    // with the GL context current. Returns true the first time it is
+    // called after the texture has finished loading, successfully or
+    // not, so that the caller can report the failures only once.
+    bool update();
+
     GLuint isStaled() const {
         return fStaled;
     }
@@ -70,17 +99,21 @@ private:
         const std::string&        shaderFxFile,
         const std::string&        attrName,
         cgfxAttrDef::cgfxAttrType attrType,
-        GLuint                    textureId,
-        bool                      valid
+        MObject                   textureNode,
+        GLuint                    textureId
     )
         : fRefCount(0),
           fTextureFilePath(textureFilePath),
           fShaderFxFile(shaderFxFile),
           fAttrName(attrName),
           fAttrType(attrType),
-          fValid(valid), 
+          fValid(false), 
           fStaled(false),
-          fTextureId(textureId)
+          fRetained(false),
+          fReported(false),
+          fTextureId(textureId),
+          fTextureNode(textureNode),
+          fBytes(0)
     {}
         
     ~cgfxTextureCacheEntry();
@@ -88,6 +121,9 @@ private:
     void addRef();
     void release();
 
+    // Upload the decoded texture data and drop the decoding job.
+    void finishLoading();
+
     int     fRefCount;  // For cgfxRCPtr...
 
     // Key for uniquely indentifying this entry.
@@ -110,9 +146,28 @@ private:
     // instead of reusing this entry.
     bool    fStaled;
 
+    // Indicates that the entry is no longer used by any shader but is
+    // kept by the texture cache in case it is requested again.
+    bool    fRetained;
+
+    // Indicates that update() has already reported the end of the
+    // loading.
+    bool    fReported;
+
     // The GL identifer for this entry. Might contained a stand-in
-    // texture if the texture file couldn't be properly read.
+    // texture if the texture file couldn't be properly read or is
+    // still being decoded.
     GLuint  fTextureId;        
+
+    // Texture node used as a fallback when the texture file can't be
+    // read by the DDS loader.
+    MObjectHandle fTextureNode;
+
+    // The decoding in progress, if any.
+    std::shared_ptr<cgfxTextureDecodeJob> fJob;
+
+    // Estimated size of the texture data, in bytes.
+    size_t  fBytes;
 };
 
 
@@ -128,7 +183,9 @@ public:
     // Return the texture cache entry matching the parameters. If the
     // texture is not present in the cache, an entry will be created
     // and an attempt to load the texture data from the texture file
-    // will be made.
+    // will be made. In interactive sessions, the texture file is read
+    // in the background and the entry holds a stand-in texture until
+    // cgfxTextureCacheEntry::update() has uploaded the texture data.
     virtual cgfxRCPtr<cgfxTextureCacheEntry> getTexture(
         MString                     texFileName,
         MObject                     textureNode,
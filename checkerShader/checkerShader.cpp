@@ -28,6 +28,11 @@
 // You can now connect the outColor output to an input of a surface/shader node
 // such as Color.
 //
+// The plug-in also provides the command "checkerTextureSample", which
+// evaluates a checkerTexture node on many uv coordinates at once rather than
+// one compute() per sample, and can bake the texture to an image. See
+// common/batchTexture.h.
+//
 // The plugin assumes that the devkit location follows "Setting up your build
 // environment" at Maya Developer Help; otherwise, shaders/textures cannot be
 // located. In this case create a mod (module description file) as below in a
@@ -55,6 +60,8 @@
 #include <maya/MFragmentManager.h>
 #include <maya/MGlobal.h>
 
+#include "../common/batchTexture.h"
+
 //
 // Node declaration
 class CheckerNode : public MPxNode
@@ -72,6 +79,20 @@ class CheckerNode : public MPxNode
     //  Id tag for use with binary file format
     static const MTypeId id;
 
+    // Batch interface, see batchTexture.h
+    struct Params
+    {
+        MFloatVector    color1;
+        MFloatVector    color2;
+        float           bias[2];
+    };
+
+    static const unsigned int kCoordinates = 2;
+
+    static MStatus getParams( const MObject& node, Params& params );
+    static void sampleBatch( const Params& params, const float* uv,
+                             size_t count, float* rgba );
+
     private:
 
     // Input attributes
@@ -254,6 +275,43 @@ const MPlug&      plug,
     return MS::kSuccess;
 }
 
+//
+// Batch interface, see batchTexture.h
+//
+MStatus CheckerNode::getParams( const MObject& node, Params& params )
+{
+    MStatus status;
+    MFnDependencyNode fnNode( node, &status );
+    if (!status) return status;
+
+    batchTexture::getColor( fnNode, aColor1, params.color1 );
+    batchTexture::getColor( fnNode, aColor2, params.color2 );
+    batchTexture::getFloats( fnNode, aBias, params.bias, 2 );
+
+    return MS::kSuccess;
+}
+
+void CheckerNode::sampleBatch( const Params& params, const float* uv,
+                               size_t count, float* rgba )
+{
+    const float c1[3] = { params.color1.x, params.color1.y, params.color1.z };
+    const float c2[3] = { params.color2.x, params.color2.y, params.color2.z };
+    const float bu = params.bias[0];
+    const float bv = params.bias[1];
+
+    for (size_t i = 0; i < count; i++)
+    {
+        float u = uv[2*i];
+        float v = uv[2*i+1];
+        int odd = ((u - floorf(u) < bu) + (v - floorf(v) < bv)) & 1;
+
+        rgba[4*i]   = odd ? c2[0] : c1[0];
+        rgba[4*i+1] = odd ? c2[1] : c1[1];
+        rgba[4*i+2] = odd ? c2[2] : c1[2];
+        rgba[4*i+3] = odd ? 1.f : 0.f;
+    }
+}
+
 //
 // Override definition
 MHWRender::MPxShadingNodeOverride* CheckerNodeOverride::creator(
@@ -358,12 +416,17 @@ MStatus initializePlugin( MObject obj )
             sRegistrantId,
             CheckerNodeOverride::creator));
 
+    CHECK_MSTATUS( plugin.registerCommand( "checkerTextureSample",
+                       batchTexture::SampleCmd<CheckerNode>::creator,
+                       batchTexture::SampleCmd<CheckerNode>::newSyntax ) );
+
     return MS::kSuccess;
 }
 
 MStatus uninitializePlugin( MObject obj )
 {
     MFnPlugin plugin( obj );
+    CHECK_MSTATUS( plugin.deregisterCommand( "checkerTextureSample" ) );
     CHECK_MSTATUS( plugin.deregisterNode( CheckerNode::id ) );
 
     CHECK_MSTATUS(
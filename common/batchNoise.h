@@ -0,0 +1,352 @@
+//-
+// ==========================================================================
+// Copyright 2015 Autodesk, Inc.  All rights reserved.
+//
+// Use of this software is subject to the terms of the Autodesk
+// license agreement provided at the time of installation or download,
+// or which otherwise accompanies this software in either electronic
+// or hard copy form.
+// ==========================================================================
+//+
+
+#ifndef _batchNoise_h_
+#define _batchNoise_h_
+
+//
+// DESCRIPTION:
+// Batched evaluation of the solid noise functions used by the solidNoise
+// (noiseShader), lava (lavaShader) and flame (flameShader) texture nodes.
+//
+// The nodes compute one sample per MPxNode::compute(). These functions take
+// arrays of points instead and evaluate them W lanes at a time, W being 4,
+// 8 or 16. Each stage of the noise is written as a loop over the lanes of a
+// block, with the table lookups kept apart from the arithmetic, so that the
+// compiler can map a block onto SSE (4 wide), AVX (8 wide) or AVX-512
+// (16 wide) registers without per-platform intrinsics.
+//
+// Every lane performs the same float operations in the same order as the
+// scalar functions in the nodes, so a batch returns exactly the values the
+// nodes' compute() does, as long as the compiler is not allowed to contract
+// multiplies and adds into FMAs.
+//
+// The noise tables stay owned by the nodes and are passed in:
+//
+//  perlin()        the gradient noise of solidNoise, noise3::pnoise3()
+//                  p[] and g[] sized B + B + 2 with B = 256.
+//  noise()         the gradient noise of lava and flame, Noise()
+//  turbulence()    the fractal sum of noise() over octaves, turbulence()
+//                  Phi[] and G[] sized 512.
+//
+
+#include <math.h>
+#include <stddef.h>
+
+namespace batchNoise
+{
+
+const int kMaxWidth = 16;
+
+// --------------------------------------------------------------------------
+// Perlin gradient noise (noise3::pnoise3)
+// --------------------------------------------------------------------------
+
+template <int W>
+inline void perlinBlock(const int* p, const float (*g)[3],
+                        const float* x, const float* y, const float* z,
+                        float* out)
+{
+    int bx0[W], bx1[W], by0[W], by1[W], bz0[W], bz1[W];
+    float rx0[W], rx1[W], ry0[W], ry1[W], rz0[W], rz1[W];
+    int l;
+
+    // setup()
+    for (l = 0; l < W; ++l)
+    {
+        float tx = x[l] + 10000.0f;
+        float ty = y[l] + 10000.0f;
+        float tz = z[l] + 10000.0f;
+        int ix = (int)tx, iy = (int)ty, iz = (int)tz;
+        bx0[l] = ix & 255; bx1[l] = (bx0[l] + 1) & 255;
+        by0[l] = iy & 255; by1[l] = (by0[l] + 1) & 255;
+        bz0[l] = iz & 255; bz1[l] = (bz0[l] + 1) & 255;
+        rx0[l] = tx - ix; rx1[l] = rx0[l] - 1.0f;
+        ry0[l] = ty - iy; ry1[l] = ry0[l] - 1.0f;
+        rz0[l] = tz - iz; rz1[l] = rz0[l] - 1.0f;
+    }
+
+    // Lattice lookups
+    const float* q[8][W];
+    for (l = 0; l < W; ++l)
+    {
+        int i = p[bx0[l]];
+        int j = p[bx1[l]];
+        int b00 = p[i + by0[l]];
+        int b10 = p[j + by0[l]];
+        int b01 = p[i + by1[l]];
+        int b11 = p[j + by1[l]];
+        q[0][l] = g[b00 + bz0[l]];
+        q[1][l] = g[b10 + bz0[l]];
+        q[2][l] = g[b01 + bz0[l]];
+        q[3][l] = g[b11 + bz0[l]];
+        q[4][l] = g[b00 + bz1[l]];
+        q[5][l] = g[b10 + bz1[l]];
+        q[6][l] = g[b01 + bz1[l]];
+        q[7][l] = g[b11 + bz1[l]];
+    }
+
+    // Gradients, gathered so the interpolation below is pure arithmetic
+    float gx[8][W], gy[8][W], gz[8][W];
+    for (int c = 0; c < 8; ++c)
+    {
+        for (l = 0; l < W; ++l)
+        {
+            gx[c][l] = q[c][l][0];
+            gy[c][l] = q[c][l][1];
+            gz[c][l] = q[c][l][2];
+        }
+    }
+
+    for (l = 0; l < W; ++l)
+    {
+        float sx = rx0[l] * rx0[l] * (3.0f - 2.0f * rx0[l]);
+        float sy = ry0[l] * ry0[l] * (3.0f - 2.0f * ry0[l]);
+        float sz = rz0[l] * rz0[l] * (3.0f - 2.0f * rz0[l]);
+        float u, v, a, b, c, d;
+
+        u = rx0[l] * gx[0][l] + ry0[l] * gy[0][l] + rz0[l] * gz[0][l];
+        v = rx1[l] * gx[1][l] + ry0[l] * gy[1][l] + rz0[l] * gz[1][l];
+        a = u + sx * (v - u);
+        u = rx0[l] * gx[2][l] + ry1[l] * gy[2][l] + rz0[l] * gz[2][l];
+        v = rx1[l] * gx[3][l] + ry1[l] * gy[3][l] + rz0[l] * gz[3][l];
+        b = u + sx * (v - u);
+        c = a + sy * (b - a);
+        u = rx0[l] * gx[4][l] + ry0[l] * gy[4][l] + rz1[l] * gz[4][l];
+        v = rx1[l] * gx[5][l] + ry0[l] * gy[5][l] + rz1[l] * gz[5][l];
+        a = u + sx * (v - u);
+        u = rx0[l] * gx[6][l] + ry1[l] * gy[6][l] + rz1[l] * gz[6][l];
+        v = rx1[l] * gx[7][l] + ry1[l] * gy[7][l] + rz1[l] * gz[7][l];
+        b = u + sx * (v - u);
+        d = a + sy * (b - a);
+        out[l] = 1.5f * (c + sz * (d - c));
+    }
+}
+
+// --------------------------------------------------------------------------
+// Lattice noise of lava and flame (Noise, Omega, omega)
+// --------------------------------------------------------------------------
+
+template <int W>
+inline void noiseBlock(const int* Phi, const float (*G)[3],
+                       const float* u, const float* v, const float* w,
+                       float* out)
+{
+    // Per axis values of the two lattice planes around each point, index 0
+    // being the upper plane since Noise() walks the corners downwards.
+    float t0[2][W], t1[2][W], t2[2][W];
+    float o0[2][W], o1[2][W], o2[2][W];
+    int ci[2][W], cj[2][W], ck[2][W];
+    int l, a, b, c;
+
+    for (a = 0; a < 2; ++a)
+    {
+        for (l = 0; l < W; ++l)
+        {
+            ci[a][l] = (int)floorf(u[l]) + 1 - a;
+            cj[a][l] = (int)floorf(v[l]) + 1 - a;
+            ck[a][l] = (int)floorf(w[l]) + 1 - a;
+            t0[a][l] = u[l] - ci[a][l];
+            t1[a][l] = v[l] - cj[a][l];
+            t2[a][l] = w[l] - ck[a][l];
+
+            float a0 = fabsf(t0[a][l]);
+            float a1 = fabsf(t1[a][l]);
+            float a2 = fabsf(t2[a][l]);
+            o0[a][l] = (a0 * (a0 * (a0 * 2.0f - 3.0f))) + 1.0f;
+            o1[a][l] = (a1 * (a1 * (a1 * 2.0f - 3.0f))) + 1.0f;
+            o2[a][l] = (a2 * (a2 * (a2 * 2.0f - 3.0f))) + 1.0f;
+        }
+    }
+
+    // Hash the corners, sharing the inner lookups between them
+    float gx[8][W], gy[8][W], gz[8][W];
+    for (l = 0; l < W; ++l)
+    {
+        int pk[2], pjk[2][2];
+        for (c = 0; c < 2; ++c)
+            pk[c] = Phi[(ck[c][l] % 256) + 256];
+        for (b = 0; b < 2; ++b)
+            for (c = 0; c < 2; ++c)
+                pjk[b][c] = Phi[((cj[b][l] + pk[c]) % 256) + 256];
+        for (a = 0; a < 2; ++a)
+        {
+            for (b = 0; b < 2; ++b)
+            {
+                for (c = 0; c < 2; ++c)
+                {
+                    int corner = a * 4 + b * 2 + c;
+                    int ct = Phi[((ci[a][l] + pjk[b][c]) % 256) + 256];
+                    gx[corner][l] = G[ct][0];
+                    gy[corner][l] = G[ct][1];
+                    gz[corner][l] = G[ct][2];
+                }
+            }
+        }
+    }
+
+    // Sum the corners in the same order as Noise()
+    for (l = 0; l < W; ++l)
+        out[l] = 0.0f;
+    for (a = 0; a < 2; ++a)
+    {
+        for (b = 0; b < 2; ++b)
+        {
+            for (c = 0; c < 2; ++c)
+            {
+                int corner = a * 4 + b * 2 + c;
+                for (l = 0; l < W; ++l)
+                {
+                    out[l] += o0[a][l] * o1[b][l] * o2[c][l] *
+                        (gx[corner][l] * t0[a][l] +
+                         gy[corner][l] * t1[b][l] +
+                         gz[corner][l] * t2[c][l]);
+                }
+            }
+        }
+    }
+}
+
+template <int W>
+inline void turbulenceBlock(const int* Phi, const float (*G)[3],
+                            const float* u, const float* v, const float* w,
+                            int octaves, double* out)
+{
+    double du[W], dv[W], dw[W];
+    float fu[W], fv[W], fw[W], n[W];
+    double s = 1.0;
+    int l;
+
+    for (l = 0; l < W; ++l)
+    {
+        du[l] = u[l]; dv[l] = v[l]; dw[l] = w[l];
+        out[l] = 0.0;
+    }
+
+    while (octaves--)
+    {
+        for (l = 0; l < W; ++l)
+        {
+            fu[l] = (float)du[l]; fv[l] = (float)dv[l]; fw[l] = (float)dw[l];
+        }
+        noiseBlock<W>(Phi, G, fu, fv, fw, n);
+        for (l = 0; l < W; ++l)
+        {
+            out[l] += n[l] * s;
+            du[l] *= 2.0; dv[l] *= 2.0; dw[l] *= 2.0;
+        }
+        s *= 0.5;
+    }
+}
+
+// --------------------------------------------------------------------------
+// Array drivers
+// --------------------------------------------------------------------------
+
+// Runs a block function over n points, padding the last partial block.
+template <int W, typename T, typename BlockFn>
+inline void forEachBlock(const float* x, const float* y, const float* z,
+                         T* out, size_t n, BlockFn block)
+{
+    size_t i = 0;
+    for (; i + W <= n; i += W)
+        block(x + i, y + i, z + i, out + i);
+
+    if (i < n)
+    {
+        float px[W], py[W], pz[W];
+        T pout[W];
+        size_t rest = n - i;
+        for (size_t l = 0; l < (size_t)W; ++l)
+        {
+            size_t src = i + (l < rest ? l : rest - 1);
+            px[l] = x[src]; py[l] = y[src]; pz[l] = z[src];
+        }
+        block(px, py, pz, pout);
+        for (size_t l = 0; l < rest; ++l)
+            out[i + l] = pout[l];
+    }
+}
+
+template <int W>
+inline void perlinW(const int* p, const float (*g)[3],
+                    const float* x, const float* y, const float* z,
+                    float* out, size_t n)
+{
+    forEachBlock<W>(x, y, z, out, n,
+        [p, g](const float* bx, const float* by, const float* bz, float* bo) {
+            perlinBlock<W>(p, g, bx, by, bz, bo);
+        });
+}
+
+template <int W>
+inline void noiseW(const int* Phi, const float (*G)[3],
+                   const float* u, const float* v, const float* w,
+                   float* out, size_t n)
+{
+    forEachBlock<W>(u, v, w, out, n,
+        [Phi, G](const float* bu, const float* bv, const float* bw, float* bo) {
+            noiseBlock<W>(Phi, G, bu, bv, bw, bo);
+        });
+}
+
+template <int W>
+inline void turbulenceW(const int* Phi, const float (*G)[3],
+                        const float* u, const float* v, const float* w,
+                        int octaves, double* out, size_t n)
+{
+    forEachBlock<W>(u, v, w, out, n,
+        [Phi, G, octaves](const float* bu, const float* bv, const float* bw, double* bo) {
+            turbulenceBlock<W>(Phi, G, bu, bv, bw, octaves, bo);
+        });
+}
+
+// Entry points, width is 4, 8 or 16; anything else uses 16.
+
+inline void perlin(int width, const int* p, const float (*g)[3],
+                   const float* x, const float* y, const float* z,
+                   float* out, size_t n)
+{
+    switch (width)
+    {
+        case 4:  perlinW<4>(p, g, x, y, z, out, n); break;
+        case 8:  perlinW<8>(p, g, x, y, z, out, n); break;
+        default: perlinW<16>(p, g, x, y, z, out, n); break;
+    }
+}
+
+inline void noise(int width, const int* Phi, const float (*G)[3],
+                  const float* u, const float* v, const float* w,
+                  float* out, size_t n)
+{
+    switch (width)
+    {
+        case 4:  noiseW<4>(Phi, G, u, v, w, out, n); break;
+        case 8:  noiseW<8>(Phi, G, u, v, w, out, n); break;
+        default: noiseW<16>(Phi, G, u, v, w, out, n); break;
+    }
+}
+
+inline void turbulence(int width, const int* Phi, const float (*G)[3],
+                       const float* u, const float* v, const float* w,
+                       int octaves, double* out, size_t n)
+{
+    switch (width)
+    {
+        case 4:  turbulenceW<4>(Phi, G, u, v, w, octaves, out, n); break;
+        case 8:  turbulenceW<8>(Phi, G, u, v, w, octaves, out, n); break;
+        default: turbulenceW<16>(Phi, G, u, v, w, octaves, out, n); break;
+    }
+}
+
+} // namespace batchNoise
+
+#endif /* _batchNoise_h_ */
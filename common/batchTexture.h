@@ -0,0 +1,402 @@
+//-
+// ==========================================================================
+// Copyright 2015 Autodesk, Inc.  All rights reserved.
+//
+// Use of this software is subject to the terms of the Autodesk
+// license agreement provided at the time of installation or download,
+// or which otherwise accompanies this software in either electronic
+// or hard copy form.
+// ==========================================================================
+//+
+
+#ifndef _batchTexture_h_
+#define _batchTexture_h_
+
+//
+// DESCRIPTION:
+// Batched evaluation of the checkerTexture (checkerShader), brickTexture
+// (brickShader), solidChecker (solidCheckerShader), solidNoise
+// (noiseShader), lava (lavaShader) and flame (flameShader) texture nodes.
+//
+// The nodes compute one sample per MPxNode::compute(), reading every input
+// through the data block. Each of them also implements the same static
+// interface, which evaluates arrays of samples from values read once:
+//
+//  struct Params       the values compute() uses, apart from the sample
+//                      coordinates
+//  kCoordinates        the floats per sample: 2 for the uv of the 2d
+//                      textures, 3 for the world space point of the 3d ones
+//  getParams()         reads from the plugs of a node the values compute()
+//                      would read from its data block. It runs once per
+//                      batch, before any sampleBatch() call.
+//  sampleBatch()       evaluates count samples, writing r, g, b, a per
+//                      sample. Nodes without an outAlpha write 1.
+//
+//      static MStatus getParams( const MObject& node, Params& params );
+//      static void sampleBatch( const Params& params, const float* coords,
+//                               size_t count, float* rgba );
+//
+// sampleBatch() is a plain loop without branches on the data, so the
+// compiler vectorizes it, and performs the same float operations as
+// compute(), so it returns the same values. sampleParallel() splits a
+// batch across threads through TBB. getFloats(), getColor() and getMatrix()
+// read the compound and matrix plugs for getParams().
+//
+// The noise textures evaluate their batches through batchNoise.h, W points
+// at a time. Their Params also have an int width, which getParams() sets
+// to batchNoise::kMaxWidth and sampleBatch() passes on as W.
+//
+// SampleCmd<Node> is the command each plug-in builds on that interface
+// (checkerTextureSample, brickTextureSample, solidCheckerSample,
+// solidNoiseSample, lavaSample and flameSample). It either returns the
+// colors of the given samples:
+//
+//  checkerTextureSample -uv 0.1 0.1 -uv 0.9 0.1 checkerTexture1;
+//  // Result: r0 g0 b0 a0 r1 g1 b1 a1 //
+//
+// (-point x y z for the 3d textures), bakes the unit uv square (the z = 0
+// unit square of world space for the 3d textures) into an image and
+// returns the time taken in seconds:
+//
+//  checkerTextureSample -bake 4096 4096 "/tmp/checker.iff" checkerTexture1;
+//
+// or evaluates a res x res grid both through sampleBatch() and through
+// MRenderUtil::sampleShadingNetwork(), which computes the node one sample
+// at a time, and returns both times in seconds:
+//
+//  checkerTextureSample -benchmark 512 checkerTexture1;
+//  // Result: 0.0021 1.734 //
+//
+// For the nodes whose Params have a width, -width 4, 8 or 16 sets it:
+//
+//  lavaSample -width 8 -bake 4096 4096 "/tmp/lava.iff" lava1;
+//
+
+#include <maya/MPxCommand.h>
+#include <maya/MSyntax.h>
+#include <maya/MArgDatabase.h>
+#include <maya/MArgList.h>
+#include <maya/MSelectionList.h>
+#include <maya/MFnDependencyNode.h>
+#include <maya/MFnMatrixData.h>
+#include <maya/MPlug.h>
+#include <maya/MStringArray.h>
+#include <maya/MDoubleArray.h>
+#include <maya/MFloatArray.h>
+#include <maya/MFloatMatrix.h>
+#include <maya/MFloatVector.h>
+#include <maya/MMatrix.h>
+#include <maya/MFloatPointArray.h>
+#include <maya/MFloatVectorArray.h>
+#include <maya/MRenderUtil.h>
+#include <maya/MImage.h>
+#include <maya/MTimer.h>
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
+#include <stddef.h>
+#include <type_traits>
+#include <vector>
+
+namespace batchTexture
+{
+
+// Samples per task in sampleParallel()
+const size_t kGrainSize = 4096;
+
+template <class Node>
+void sampleParallel( const typename Node::Params& params, const float* coords,
+                     size_t count, float* rgba )
+{
+    tbb::parallel_for( tbb::blocked_range<size_t>( 0, count, kGrainSize ),
+        [&]( const tbb::blocked_range<size_t>& r ) {
+            Node::sampleBatch( params, coords + r.begin() * Node::kCoordinates,
+                               r.size(), rgba + 4 * r.begin() );
+        });
+}
+
+// The coordinates of the center of pixel (col, row) of a xres x yres
+// image covering the unit square
+inline void pixelCoords( int col, int row, int xres, int yres,
+                         unsigned int dimension, float* coords )
+{
+    coords[0] = (col + 0.5f) / xres;
+    coords[1] = (row + 0.5f) / yres;
+    if (dimension > 2)
+        coords[2] = 0.0f;
+}
+
+// Reads the first count children of the compound plug attr of a node
+inline void getFloats( const MFnDependencyNode& fnNode, const MObject& attr,
+                       float* values, unsigned int count )
+{
+    MPlug plug = fnNode.findPlug( attr, true );
+    for (unsigned int i = 0; i < count; i++)
+        plug.child( i ).getValue( values[i] );
+}
+
+// Reads a color (or any float3) plug
+inline void getColor( const MFnDependencyNode& fnNode, const MObject& attr,
+                      MFloatVector& color )
+{
+    float values[3];
+    getFloats( fnNode, attr, values, 3 );
+    color = MFloatVector( values[0], values[1], values[2] );
+}
+
+// Reads a matrix plug, such as the placementMatrix of the 3d textures
+inline MStatus getMatrix( const MFnDependencyNode& fnNode, const MObject& attr,
+                          MFloatMatrix& matrix )
+{
+    MObject matrixData;
+    MStatus status = fnNode.findPlug( attr, true ).getValue( matrixData );
+    if (!status) return status;
+    MFnMatrixData( matrixData ).matrix().get( matrix.matrix );
+    return MS::kSuccess;
+}
+
+// Whether Params has a width (the noise textures)
+template <class Params, class = void>
+struct HasWidth : std::false_type {};
+
+template <class Params>
+struct HasWidth<Params, std::void_t<decltype( &Params::width )>> : std::true_type {};
+
+#define kBatchUVFlag            "-uv"
+#define kBatchUVFlagLong        "-uvCoord"
+#define kBatchPointFlag         "-p"
+#define kBatchPointFlagLong     "-point"
+#define kBatchBakeFlag          "-b"
+#define kBatchBakeFlagLong      "-bake"
+#define kBatchBenchmarkFlag     "-bm"
+#define kBatchBenchmarkFlagLong "-benchmark"
+#define kBatchWidthFlag         "-w"
+#define kBatchWidthFlagLong     "-width"
+
+template <class Node>
+class SampleCmd : public MPxCommand
+{
+    public:
+
+    MStatus doIt( const MArgList& args ) override;
+
+    static void *   creator();
+    static MSyntax  newSyntax();
+
+    private:
+
+    static const char* coordFlag()
+    {
+        return (Node::kCoordinates == 2) ? kBatchUVFlag : kBatchPointFlag;
+    }
+
+    MStatus bake( const typename Node::Params& params, const MArgDatabase& argData );
+    MStatus benchmark( const typename Node::Params& params, const MObject& node,
+                       const MArgDatabase& argData );
+};
+
+template <class Node>
+void * SampleCmd<Node>::creator()
+{
+    return new SampleCmd<Node>();
+}
+
+template <class Node>
+MSyntax SampleCmd<Node>::newSyntax()
+{
+    MSyntax syntax;
+    if (Node::kCoordinates == 2)
+        syntax.addFlag( kBatchUVFlag, kBatchUVFlagLong,
+                        MSyntax::kDouble, MSyntax::kDouble );
+    else
+        syntax.addFlag( kBatchPointFlag, kBatchPointFlagLong,
+                        MSyntax::kDouble, MSyntax::kDouble, MSyntax::kDouble );
+    syntax.makeFlagMultiUse( coordFlag() );
+    syntax.addFlag( kBatchBakeFlag, kBatchBakeFlagLong,
+                    MSyntax::kLong, MSyntax::kLong, MSyntax::kString );
+    syntax.addFlag( kBatchBenchmarkFlag, kBatchBenchmarkFlagLong, MSyntax::kLong );
+    if constexpr (HasWidth<typename Node::Params>::value)
+        syntax.addFlag( kBatchWidthFlag, kBatchWidthFlagLong, MSyntax::kLong );
+    syntax.setObjectType( MSyntax::kStringObjects, 1, 1 );
+    return syntax;
+}
+
+template <class Node>
+MStatus SampleCmd<Node>::doIt( const MArgList& args )
+{
+    MStatus status;
+    MArgDatabase argData( syntax(), args, &status );
+    if (!status) return status;
+
+    MStringArray objects;
+    argData.getObjects( objects );
+
+    MSelectionList list;
+    MObject node;
+    if (!list.add( objects[0] ) || !list.getDependNode( 0, node ) ||
+        MFnDependencyNode( node ).typeId() != Node::id)
+    {
+        displayError( objects[0] + " is not a node supported by this command." );
+        return MS::kInvalidParameter;
+    }
+
+    typename Node::Params params;
+    status = Node::getParams( node, params );
+    if (!status) return status;
+
+    if constexpr (HasWidth<typename Node::Params>::value)
+    {
+        if (argData.isFlagSet( kBatchWidthFlag ))
+            argData.getFlagArgument( kBatchWidthFlag, 0, params.width );
+    }
+
+    if (argData.isFlagSet( kBatchBakeFlag ))
+        return bake( params, argData );
+
+    if (argData.isFlagSet( kBatchBenchmarkFlag ))
+        return benchmark( params, node, argData );
+
+    const unsigned int dim = Node::kCoordinates;
+    unsigned int count = argData.numberOfFlagUses( coordFlag() );
+    std::vector<float> coords( dim * count ), rgba( 4 * count );
+    unsigned int i, j;
+    for (i = 0; i < count; i++)
+    {
+        MArgList coordArgs;
+        argData.getFlagArgumentList( coordFlag(), i, coordArgs );
+        for (j = 0; j < dim; j++)
+            coords[dim*i+j] = (float) coordArgs.asDouble( j );
+    }
+
+    if (count > 0)
+        sampleParallel<Node>( params, &coords[0], count, &rgba[0] );
+
+    MDoubleArray result( 4 * count );
+    for (i = 0; i < 4 * count; i++)
+        result[i] = rgba[i];
+    setResult( result );
+
+    return MS::kSuccess;
+}
+
+template <class Node>
+MStatus SampleCmd<Node>::bake( const typename Node::Params& params,
+                               const MArgDatabase& argData )
+{
+    int xres = 0, yres = 0;
+    MString fileName;
+    argData.getFlagArgument( kBatchBakeFlag, 0, xres );
+    argData.getFlagArgument( kBatchBakeFlag, 1, yres );
+    argData.getFlagArgument( kBatchBakeFlag, 2, fileName );
+    if (xres <= 0 || yres <= 0)
+    {
+        displayError( "The bake resolution must be positive." );
+        return MS::kInvalidParameter;
+    }
+
+    MTimer timer;
+    timer.beginTimer();
+
+    MImage image;
+    image.create( xres, yres, 4, MImage::kByte );
+    unsigned char* pixels = image.pixels();
+
+    // One row of samples at a time, rows in parallel
+    const unsigned int dim = Node::kCoordinates;
+    tbb::parallel_for( tbb::blocked_range<int>( 0, yres ),
+        [&]( const tbb::blocked_range<int>& r ) {
+            std::vector<float> coords( dim * xres ), rgba( 4 * xres );
+            for (int row = r.begin(); row != r.end(); ++row)
+            {
+                for (int col = 0; col < xres; ++col)
+                    pixelCoords( col, row, xres, yres, dim, &coords[dim*col] );
+                Node::sampleBatch( params, &coords[0], xres, &rgba[0] );
+
+                unsigned char* dst = pixels + (size_t)row * xres * 4;
+                for (int c = 0; c < 4 * xres; ++c)
+                {
+                    float v = rgba[c];
+                    if (v < 0.0f) v = 0.0f;
+                    if (v > 1.0f) v = 1.0f;
+                    dst[c] = (unsigned char)(v * 255.0f + 0.5f);
+                }
+            }
+        });
+
+    timer.endTimer();
+
+    int dot = fileName.rindex( '.' );
+    MString format = (dot > 0) ? fileName.substring( dot + 1, fileName.length() - 1 ) : MString( "iff" );
+    MStatus status = image.writeToFile( fileName, format );
+    if (!status)
+    {
+        displayError( "Could not write " + fileName );
+        return status;
+    }
+
+    setResult( timer.elapsedTime() );
+    return MS::kSuccess;
+}
+
+template <class Node>
+MStatus SampleCmd<Node>::benchmark( const typename Node::Params& params,
+                                    const MObject& node,
+                                    const MArgDatabase& argData )
+{
+    int res = 0;
+    argData.getFlagArgument( kBatchBenchmarkFlag, 0, res );
+    if (res <= 0)
+    {
+        displayError( "The benchmark resolution must be positive." );
+        return MS::kInvalidParameter;
+    }
+
+    const unsigned int dim = Node::kCoordinates;
+    const int count = res * res;
+    std::vector<float> coords( dim * count ), rgba( 4 * count );
+    MFloatPointArray points( count );
+    MFloatArray uCoords( count ), vCoords( count );
+    int i;
+    for (i = 0; i < count; i++)
+    {
+        float* c = &coords[dim*i];
+        pixelCoords( i % res, i / res, res, res, dim, c );
+        points[i] = MFloatPoint( c[0], c[1], (dim > 2) ? c[2] : 0.0f );
+        uCoords[i] = c[0];
+        vCoords[i] = c[1];
+    }
+
+    MTimer timer;
+    timer.beginTimer();
+    sampleParallel<Node>( params, &coords[0], count, &rgba[0] );
+    timer.endTimer();
+    double batchTime = timer.elapsedTime();
+
+    MString attr = MFnDependencyNode( node ).name() + ".outColor";
+    MFloatMatrix cameraMat;
+    MFloatVectorArray colors, transps;
+
+    timer.beginTimer();
+    MStatus status = MRenderUtil::sampleShadingNetwork(
+        attr, count, false, false, cameraMat,
+        &points, &uCoords, &vCoords, NULL, NULL, NULL, NULL, NULL,
+        colors, transps );
+    timer.endTimer();
+    if (!status)
+    {
+        displayError( "Could not sample " + attr );
+        return status;
+    }
+
+    MDoubleArray result;
+    result.append( batchTime );
+    result.append( timer.elapsedTime() );
+    setResult( result );
+
+    return MS::kSuccess;
+}
+
+}
+
+#endif
@@ -0,0 +1,109 @@
+//-
+// ==========================================================================
+// Copyright 2015 Autodesk, Inc.  All rights reserved.
+//
+// Use of this software is subject to the terms of the Autodesk
+// license agreement provided at the time of installation or download,
+// or which otherwise accompanies this software in either electronic
+// or hard copy form.
+// ==========================================================================
+//+
+
+#ifndef _emitterJitter_h_
+#define _emitterJitter_h_
+
+//
+// DESCRIPTION:
+// Counter-based random numbers for the emitters which emit in parallel
+// (ownerEmitter, sweptEmitter and simpleFluidEmitter).
+//
+// drand48() and the fluid emitters' randgen() are sequential streams, so
+// the values they give depend on which thread draws first. value() is
+// instead a splitmix64 hash of a seed and a sample index: the same seed
+// and index give the same value in [0,1) whichever thread evaluates it
+// and in whatever order.
+//
+// The seed of a pass comes either from the emitter's seed attribute and
+// the current time (particle emitters), so that every frame gets
+// different particles and reruns the same ones:
+//
+//  unsigned long long seed = emitterJitter::seed(
+//      emitterJitter::seedAttribute( block, multiIndex ), currentTime );
+//
+// or from two draws of the emitter's own random stream (fluid emitters),
+// which keeps it repeatable from run to run:
+//
+//  unsigned long long seed = emitterJitter::seed( randgen(), randgen() );
+//
+
+#include <maya/MTime.h>
+#include <maya/MDataBlock.h>
+#include <maya/MArrayDataHandle.h>
+#include <maya/MPxEmitterNode.h>
+
+#include <math.h>
+
+namespace emitterJitter
+{
+
+// The splitmix64 finalizer of z, mapped to [0,1)
+inline double unit( unsigned long long z )
+{
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    z ^= z >> 31;
+    return (double)(z >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Value n of the given seed
+inline double value( unsigned long long seed, unsigned int n )
+{
+    return unit( seed + (n + 1) * 0x9E3779B97F4A7C15ULL );
+}
+
+// Value n of voxel (or any other second index) of the given seed
+inline double value( unsigned long long seed, unsigned int voxel, unsigned int n )
+{
+    return unit( seed + voxel * 0x9E3779B97F4A7C15ULL +
+                 (n + 1) * 0xD1B54A32D192ED03ULL );
+}
+
+// Seed for the given seed attribute value and time
+inline unsigned long long seed( int seedValue, const MTime& time )
+{
+    long long ticks = (long long) floor( time.as( MTime::k6000FPS ) + 0.5 );
+    return ( (unsigned long long)(unsigned int) seedValue << 32 ) ^
+            ( (unsigned long long) ticks * 0xD1B54A32D192ED03ULL );
+}
+
+// Seed from two values in [0,1) of a sequential random stream
+inline unsigned long long seed( double r0, double r1 )
+{
+    return ((unsigned long long)(r0 * 4294967296.0) << 32) |
+            (unsigned long long)(r1 * 4294967296.0);
+}
+
+// Element plugIndex of the emitter's seed attribute, 0 when it is not set
+inline int seedAttribute( MDataBlock& block, int plugIndex )
+{
+    MStatus status;
+    int value = 0;
+
+    MArrayDataHandle mhValue = block.inputArrayValue( MPxEmitterNode::mSeed, &status );
+    if( status == MS::kSuccess )
+    {
+        status = mhValue.jumpToElement( plugIndex );
+        if( status == MS::kSuccess )
+        {
+            MDataHandle hValue = mhValue.inputValue( &status );
+            if( status == MS::kSuccess )
+                value = hValue.asInt();
+        }
+    }
+
+    return( value );
+}
+
+}
+
+#endif
@@ -0,0 +1,125 @@
+//-
+// ==========================================================================
+// Copyright 2015 Autodesk, Inc.  All rights reserved.
+//
+// Use of this software is subject to the terms of the Autodesk
+// license agreement provided at the time of installation or download,
+// or which otherwise accompanies this software in either electronic
+// or hard copy form.
+// ==========================================================================
+//+
+
+#ifndef _pathEmission_h_
+#define _pathEmission_h_
+
+//
+// DESCRIPTION:
+// Emission of particles along the paths of a set of points during a time
+// step, shared by the ownerEmitter and sweptEmitter nodes.
+//
+// Point p emits emitCountPP[p] particles, spread over its path from
+// inPosAry[p] - inVelAry[p] * dt to inPosAry[p]. The particles are
+// appended to the output arrays in the order of the points, the output
+// arrays being grown once.
+//
+// The points are processed in parallel. Each one writes its particles at
+// the offset given by the counts of the points before it, and the jitter
+// of a particle only depends on the seed and on its index (see
+// emitterJitter.h), so the result does not depend on the number of
+// threads.
+//
+
+#include <maya/MVector.h>
+#include <maya/MVectorArray.h>
+#include <maya/MIntArray.h>
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
+#include <vector>
+
+#include "emitterJitter.h"
+
+namespace pathEmission
+{
+
+inline void emit
+    (
+        const MVectorArray &inPosAry,   // points where new particles from
+        const MVectorArray &inVelAry,   // initial velocity of new particles
+        const MIntArray &emitCountPP,   // # of new particles per point
+        double dt,                      // elapsed time
+        double speed,                   // speed factor
+        double inheritFactor,           // for inherit velocity
+        MVector dirV,                   // emit direction
+        unsigned long long seed,        // seed of the jitter
+        MVectorArray &outPosAry,        // holding new particles position
+        MVectorArray &outVelAry         // holding new particles velocity
+    )
+{
+    // check the length of input arrays.
+    //
+    int posLength = inPosAry.length();
+    int velLength = inVelAry.length();
+    int countLength = emitCountPP.length();
+    if( (posLength != velLength) || (posLength != countLength) )
+        return;
+
+    // Compute the first particle of each point and the total emit count.
+    //
+    int index;
+    std::vector<int> firstPP( countLength );
+    int totalCount = 0;
+    for( index = 0; index < countLength; index ++ )
+    {
+        firstPP[index] = totalCount;
+        if( emitCountPP[index] > 0 )
+            totalCount += emitCountPP[index];
+    }
+
+    if( totalCount <= 0 )
+        return;
+
+    // Map direction vector into world space and normalize it.
+    //
+    dirV.normalize();
+    MVector dirVel = dirV * speed;
+
+    // Grow the output arrays once.
+    //
+    unsigned int outStart = outPosAry.length();
+    outPosAry.setLength( outStart + totalCount );
+    outVelAry.setLength( outStart + totalCount );
+
+    // Start emission.
+    //
+    tbb::parallel_for( tbb::blocked_range<int>( 0, posLength ),
+        [&]( const tbb::blocked_range<int>& r ) {
+            for( int p = r.begin(); p != r.end(); p++ )
+            {
+                int emitCount = emitCountPP[p];
+                if( emitCount <= 0 )
+                    continue;
+
+                const MVector sPos = inPosAry[p];
+                const MVector sVel = inVelAry[p];
+                const MVector prePos = sPos - sVel * dt;
+                const MVector newVel = dirVel + sVel * inheritFactor;
+                const unsigned int first = outStart + firstPP[p];
+
+                for( int i = 0; i < emitCount; i++ )
+                {
+                    double alpha = ( (double)i +
+                        emitterJitter::value( seed, firstPP[p] + i ) ) / (double)emitCount;
+
+                    outPosAry[first + i] = (1 - alpha) * prePos + alpha * sPos
+                        + dirVel * ( dt * (1 - alpha) );
+                    outVelAry[first + i] = newVel;
+                }
+            }
+        });
+}
+
+}
+
+#endif
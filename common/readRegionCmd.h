@@ -0,0 +1,148 @@
+//-
+// ==========================================================================
+// Copyright 2015 Autodesk, Inc.  All rights reserved.
+//
+// Use of this software is subject to the terms of the Autodesk
+// license agreement provided at the time of installation or download,
+// or which otherwise accompanies this software in either electronic
+// or hard copy form.
+// ==========================================================================
+//+
+
+#ifndef _readRegionCmd_h_
+#define _readRegionCmd_h_
+
+//
+// DESCRIPTION:
+// The command the ddsFloatReader and tiffFloatReader plug-ins add to read a
+// region of an image into a new MImage (ddsFloatReadRegion and
+// tiffFloatReadRegion):
+//
+//  tiffFloatReadRegion [-level n] [-region x0 y0 x1 y1] [-output file] "map.tif";
+//
+// The region is given in pixels of the level, top-left origin, with
+// inclusive bounds. The command returns the width and height that were
+// read and writes the image to -output when given.
+//
+// ReadRegionCmd<Reader> works with any MPxImageFile which also has
+//
+//  MStatus loadRegion( MImage& image, unsigned int level,
+//                      unsigned int xMin, unsigned int yMin,
+//                      unsigned int xMax, unsigned int yMax );
+//
+// reading the given rectangle of a level, with the bounds clamped to the
+// size of the level.
+//
+
+#include <maya/MPxCommand.h>
+#include <maya/MSyntax.h>
+#include <maya/MArgDatabase.h>
+#include <maya/MArgList.h>
+#include <maya/MStringArray.h>
+#include <maya/MIntArray.h>
+#include <maya/MImage.h>
+
+namespace readRegion
+{
+
+#define kReadRegionLevelFlag        "-l"
+#define kReadRegionLevelFlagLong    "-level"
+#define kReadRegionRegionFlag       "-r"
+#define kReadRegionRegionFlagLong   "-region"
+#define kReadRegionOutputFlag       "-o"
+#define kReadRegionOutputFlagLong   "-output"
+
+template <class Reader>
+class ReadRegionCmd : public MPxCommand
+{
+public:
+    MStatus         doIt( const MArgList& args) override;
+    static void*    creator();
+    static MSyntax  newSyntax();
+};
+
+template <class Reader>
+void* ReadRegionCmd<Reader>::creator()
+{
+    return new ReadRegionCmd<Reader>();
+}
+
+template <class Reader>
+MSyntax ReadRegionCmd<Reader>::newSyntax()
+{
+    MSyntax syntax;
+    syntax.addFlag( kReadRegionLevelFlag, kReadRegionLevelFlagLong, MSyntax::kLong);
+    syntax.addFlag( kReadRegionRegionFlag, kReadRegionRegionFlagLong,
+                    MSyntax::kLong, MSyntax::kLong, MSyntax::kLong, MSyntax::kLong);
+    syntax.addFlag( kReadRegionOutputFlag, kReadRegionOutputFlagLong, MSyntax::kString);
+    syntax.setObjectType( MSyntax::kStringObjects, 1, 1);
+    return syntax;
+}
+
+template <class Reader>
+MStatus ReadRegionCmd<Reader>::doIt( const MArgList& args)
+{
+    MStatus status;
+    MArgDatabase argData( syntax(), args, &status);
+    if (!status)
+        return status;
+
+    MStringArray files;
+    argData.getObjects( files);
+
+    int level = 0;
+    if (argData.isFlagSet( kReadRegionLevelFlag))
+        argData.getFlagArgument( kReadRegionLevelFlag, 0, level);
+
+    int region[4] = { 0, 0, -1, -1 };
+    if (argData.isFlagSet( kReadRegionRegionFlag))
+    {
+        for (unsigned int i=0; i<4; i++)
+            argData.getFlagArgument( kReadRegionRegionFlag, i, region[i]);
+    }
+    if (level < 0 || region[0] < 0 || region[1] < 0)
+    {
+        displayError( "Negative level or region");
+        return MS::kInvalidParameter;
+    }
+
+    Reader reader;
+    MImage image;
+    status = reader.open( files[0], NULL);
+    if (status)
+    {
+        status = reader.loadRegion( image, (unsigned int)level,
+                                    (unsigned int)region[0], (unsigned int)region[1],
+                                    (unsigned int)region[2], (unsigned int)region[3]);
+    }
+    if (!status)
+    {
+        displayError( "Could not read " + files[0]);
+        return MS::kFailure;
+    }
+
+    if (argData.isFlagSet( kReadRegionOutputFlag))
+    {
+        MString output;
+        argData.getFlagArgument( kReadRegionOutputFlag, 0, output);
+        status = image.writeToFile( output);
+        if (!status)
+        {
+            displayError( "Could not write " + output);
+            return status;
+        }
+    }
+
+    unsigned int width = 0, height = 0;
+    image.getSize( width, height);
+    MIntArray result;
+    result.append( (int)width);
+    result.append( (int)height);
+    setResult( result);
+
+    return MS::kSuccess;
+}
+
+}
+
+#endif
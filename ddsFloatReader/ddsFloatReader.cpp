@@ -15,6 +15,20 @@
 // In Maya's image reading menu dialogs, you can select *.* to see all images, and
 // then retrieve a dds extension file item to load the .dds file into Maya. 
 //
+// Each MIP level of the file is exposed as one image, so load( image, n)
+// reads level n. loadRegion() reads a sub-rectangle of a level: only the
+// rows of the rectangle are read from disk, and the half float to float
+// conversion is a table lookup done in parallel over bands of scanlines.
+//
+// The plug-in also adds a command that reads a region into a new image:
+//
+//      ddsFloatReadRegion [-level n] [-region x0 y0 x1 y1] [-output file] "map.dds";
+//
+// The region is given in pixels of the level, top-left origin, with
+// inclusive bounds. The command returns the width and height that were
+// read and writes the image to -output when given. See
+// common/readRegionCmd.h.
+//
 
 #include <maya/MPxImageFile.h>
 #include <maya/MImageFileInfo.h>
@@ -23,12 +37,19 @@
 #include <maya/MStringArray.h>
 #include <maya/MIOStream.h>
 
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
 #if _WIN32   
 #pragma warning( disable : 4290 )       // Disable STL warnings.
 #endif
 
 #include "ddsFloatReader.h"
 #include <math.h>
+#include <string.h>
+#include <vector>
+
+#include "../common/readRegionCmd.h"
 
 using namespace dds_Float_Reader;
 MString kImageFormatName( "DDS Float");
@@ -43,12 +64,19 @@ public:
     MStatus load( MImage& image, unsigned int idx) override;
     MStatus close() override;
 
+    // Read the given rectangle of a MIP level. The bounds are inclusive
+    // and clamped to the size of the level.
+    MStatus loadRegion( MImage& image, unsigned int level,
+                        unsigned int xMin, unsigned int yMin,
+                        unsigned int xMax, unsigned int yMax);
+
 protected:
     // Data members 
     unsigned int        fWidth;
     unsigned int        fHeight;
     unsigned int        fNumChannels;
     unsigned int        fBytesPerPixel;
+    unsigned int        fMipCount;
 
     // File and header description
     FILE                *fInputFile;
@@ -62,6 +90,7 @@ ddsFloatReader::ddsFloatReader()
     fHeight(0), 
     fNumChannels(0), 
     fBytesPerPixel(0),
+    fMipCount(0),
     fInputFile(NULL)
 {
 }
@@ -83,6 +112,7 @@ MStatus  ddsFloatReader::close()
     fHeight = 0;
     fNumChannels = 0;
     fBytesPerPixel = 0;
+    fMipCount = 0;
 
     // Close our file
     if (fInputFile != NULL)
@@ -125,39 +155,78 @@ inline void swap_endian_half(void *val)
 #endif
 }
 
-const double two_pow_neg14 = pow(2.0, -14.0);
-
 //
 // Half to float conversion
 //
-inline float halfToFloat(unsigned short val)
+static float halfToFloat(unsigned short val)
 {
-    float outValue = 0.0f;
-
-
-#if defined(__APPLE__)
-    // Need to swap bytes on Power PC (Mac)
-    swap_endian_half( &val );
-#endif
+    unsigned int sign = (unsigned int)(val & 0x8000) << 16;
+    unsigned int exponent = (val >> 10) & 31;
+    unsigned int mantissa = val & 1023;
+    unsigned int bits;
 
-    // Convert 16-value into a float...
-    double h_mantissa = (float) (val & 1023); // Mantissa = low order 10  bits
-    double h_exponent = (float)  ((val >> 10) & 31); // Exponent = next 5 bits
-    unsigned int i_sign = (val >> 15) & 1;  ; // Sign is the highest bit
-    double h_sign = (i_sign == 0) ? 1.0 : -1.0;
-
-    if (h_exponent != 30.0)
+    if (exponent == 0)
+    {
+        if (mantissa == 0)
+        {
+            // Signed zero
+            bits = sign;
+        }
+        else
+        {
+            // Denormal, renormalize it
+            int shift = -1;
+            do
+            {
+                shift++;
+                mantissa <<= 1;
+            } while ((mantissa & 1024) == 0);
+            mantissa &= 1023;
+            bits = sign | ((unsigned int)(112 - shift) << 23) | (mantissa << 13);
+        }
+    }
+    else if (exponent == 31)
     {
-        outValue = (float) (h_sign * pow(2.0, h_exponent-15.0) * ( 1.0 + ( h_mantissa / 1024.0 )));
+        // Infinity or NaN
+        bits = sign | 0x7f800000 | (mantissa << 13);
     }
     else
     {
-        outValue = (float) ( h_sign * pow(2.0, two_pow_neg14) * ( h_mantissa / 1024.0 ) );
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
     }
-    //printf("[%d][%d] = inValue=%d, isign =%d, sign=%g, exp=%g, mant=%g, value=%g\n", y,x, *inPtr, i_sign, h_sign, h_exponent, h_mantissa, outValue);
+
+    float outValue;
+    memcpy(&outValue, &bits, sizeof(float));
     return outValue;
 }
 
+//
+// Table of all 65536 half values, built on first use.
+//
+static const float* halfTable()
+{
+    static const std::vector<float> table = []()
+    {
+        std::vector<float> values(65536);
+        for (unsigned int i = 0; i < 65536; i++)
+            values[i] = halfToFloat((unsigned short)i);
+        return values;
+    }();
+    return &table[0];
+}
+
+//
+// Position the file, past the 2GB limit of fseek where needed.
+//
+static bool seekTo(FILE* file, unsigned long long offset)
+{
+#if _WIN32
+    return _fseeki64(file, (__int64)offset, SEEK_SET) == 0;
+#else
+    return fseeko(file, (off_t)offset, SEEK_SET) == 0;
+#endif
+}
+
 //
 // DESCRIPTION:
 MStatus ddsFloatReader::open( MString filename, MImageFileInfo* info)
@@ -195,6 +264,19 @@ MStatus ddsFloatReader::open( MString filename, MImageFileInfo* info)
         fHeight = fHeader.fHeight;
         fNumChannels = 0;
 
+        // Count the MIP levels stored after the top level
+        //
+        swap_endian(&fHeader.fFlags);
+        swap_endian(&fHeader.fMipMapCount);
+        swap_endian(&fHeader.fCapabilities.dwCaps);
+        fMipCount = 1;
+        if ((fHeader.fFlags & DDS_MIPMAP_COUNT_FLAG) &&
+            (fHeader.fCapabilities.dwCaps & DDSCAPS_MIPMAP_FLAG) &&
+            fHeader.fMipMapCount > 1)
+        {
+            fMipCount = fHeader.fMipMapCount;
+        }
+
         if (fWidth==0 || fHeight==0)
         {
             close();
@@ -272,14 +354,14 @@ MStatus ddsFloatReader::open( MString filename, MImageFileInfo* info)
             //  fHeight,
             //  fHeader.fFormat.fPixelFormat);
 
-            // Only read in 1 image for now
-            info->numberOfImages( 1 );
+            // One image per MIP level
+            info->numberOfImages( fMipCount );
             info->width( fWidth );
             info->height( fHeight );
             info->channels( fNumChannels );
             info->hasAlpha( fNumChannels == 4 );
 
-            // Mip maps not handled for now
+            // The levels are read one at a time, see load()
             info->hasMipMaps( false );
 
             info->imageType( MImageFileInfo::kImageTypeColor );
@@ -295,144 +377,131 @@ MStatus ddsFloatReader::open( MString filename, MImageFileInfo* info)
 // DESCRIPTION:
 MStatus ddsFloatReader::load( MImage& image, unsigned int imageNumber)
 {
-    MStatus loaded = MS::kFailure;
+    return loadRegion( image, imageNumber, 0, 0, 0xffffffff, 0xffffffff);
+}
 
-    // Check for half type, since we need to perform
-    // some special bit conversions to get a float back.
-    //
-    bool isHalfType = false;
-    switch (fHeader.fFormat.fPixelFormat)
-    {
-    case DDS_R16F:
-        isHalfType = true;
-        break;
-    case DDS_G16R16F:
-        isHalfType = true;
-        break;
-    case DDS_A16B16G16R16F:
-        isHalfType = true;
-        break;
-    default:
-        break;
-    }   
 
-    // Create the output buffer
-    //
-    image.create( fWidth, fHeight, fNumChannels, MImage::kFloat);
-    float* outputBuffer = image.floatPixels();
+//
+// DESCRIPTION:
+MStatus ddsFloatReader::loadRegion( MImage& image, unsigned int level,
+                                    unsigned int xMin, unsigned int yMin,
+                                    unsigned int xMax, unsigned int yMax)
+{
+    if (fInputFile == NULL || level >= fMipCount)
+        return MS::kFailure;
 
-    // Create the input buffer to read one scanline at a time.
+    // Skip the levels before the one requested. Each level
+    // halves the size of the previous one.
     //
-    float *inputFloatBuffer = NULL;         // For IEEE float
-    unsigned short *inputIntBuffer = NULL;  // For half-float = 16-bits per channel
-    if (!isHalfType)
+    unsigned long long offset = sizeof(DDS_HEADER);
+    unsigned int width = fWidth;
+    unsigned int height = fHeight;
+    unsigned int l;
+    for (l=0; l<level; l++)
     {
-        inputFloatBuffer = new float[fWidth * fNumChannels];
+        offset += (unsigned long long)width * height * fBytesPerPixel;
+        width = (width > 1) ? width / 2 : 1;
+        height = (height > 1) ? height / 2 : 1;
     }
-    else
-        inputIntBuffer= new unsigned short[fWidth * fNumChannels];
 
-    // Can't get sufficient memory so fail and close up the
-    // file.
-    if ((!inputFloatBuffer && !inputIntBuffer) || !outputBuffer)
+    if (xMax >= width)
+        xMax = width - 1;
+    if (yMax >= height)
+        yMax = height - 1;
+    if (xMin > xMax || yMin > yMax)
     {
-        if (inputFloatBuffer)
-        {
-            delete [] inputFloatBuffer;
-            inputFloatBuffer = NULL;
-        }
-        if (inputIntBuffer)
-        {
-            delete [] inputIntBuffer;
-            inputIntBuffer = NULL;
-        }
         close();
         return MS::kFailure;
     }
 
-    // Transfer to output buffer.
+    unsigned int regionWidth = xMax - xMin + 1;
+    unsigned int regionHeight = yMax - yMin + 1;
+    size_t rowBytes = (size_t)regionWidth * fBytesPerPixel;
+
+    // Read the rows of the region. Full width regions are
+    // contiguous in the file and are read in one go.
     //
-    if (isHalfType) 
+    std::vector<unsigned char> inputBuffer;
+    try
     {
-        unsigned int x,y;
-        float *outPtr = outputBuffer;
-
-        // Do a scanline at a time. From top-to-bottom
-        // so that scan lines are flipped for Maya's usage.
-        //
-        outPtr += (fHeight-1) * (fWidth * fNumChannels);
+        inputBuffer.resize(rowBytes * regionHeight);
+    }
+    catch (...)
+    {
+        close();
+        return MS::kFailure;
+    }
 
-        for (y=0; y<fHeight; y++)
+    bool readOk = true;
+    if (regionWidth == width)
+    {
+        readOk = seekTo(fInputFile, offset + (unsigned long long)yMin * rowBytes) &&
+                 fread(&inputBuffer[0], 1, inputBuffer.size(), fInputFile) == inputBuffer.size();
+    }
+    else
+    {
+        unsigned int y;
+        for (y=0; y<regionHeight && readOk; y++)
         {
-            // Read in one scan line of data
-            unsigned int numBytes = fWidth * fBytesPerPixel;
-            fread( inputIntBuffer, 1, numBytes, fInputFile);
-            
-            unsigned short *inPtr = inputIntBuffer;
-
-            for (x=0; x<fWidth * fNumChannels; x++)
-            {
-                float outValue = halfToFloat(*inPtr);
-                *(outPtr + x) = outValue;
-                inPtr++; // Jump 2 bytes at a time = 1 channel
-            }
-            outPtr -= (fWidth * fNumChannels);
+            unsigned long long rowOffset = offset +
+                ((unsigned long long)(yMin + y) * width + xMin) * fBytesPerPixel;
+            readOk = seekTo(fInputFile, rowOffset) &&
+                     fread(&inputBuffer[y * rowBytes], 1, rowBytes, fInputFile) == rowBytes;
         }
-        loaded = MS::kSuccess;
     }
-    
-    // IEEE 32-bit float
-    else 
-    {
-        unsigned int x,y;
-        float *outPtr = outputBuffer;
+    close();
 
-        // Do a scanline at a time. From top-to-bottom
-        // so that scan lines are flipped for Maya's usage.
-        //
-        outPtr += (fHeight-1) * (fWidth * fNumChannels);
+    if (!readOk)
+        return MS::kFailure;
+
+    // Create the output buffer
+    //
+    image.create( regionWidth, regionHeight, fNumChannels, MImage::kFloat);
+    float* outputBuffer = image.floatPixels();
+    if (outputBuffer == NULL)
+        return MS::kFailure;
+
+    // Half float formats use 2 bytes per channel
+    //
+    const float* table = (fBytesPerPixel == 2 * fNumChannels) ? halfTable() : NULL;
+    size_t rowValues = (size_t)regionWidth * fNumChannels;
+    const unsigned char* input = &inputBuffer[0];
 
-        for (y=0; y<fHeight; y++)
+    // Convert bands of scan lines in parallel. The file is stored
+    // top-to-bottom so scan lines are flipped for Maya's usage.
+    //
+    tbb::parallel_for(tbb::blocked_range<unsigned int>(0, regionHeight, 32),
+        [=](const tbb::blocked_range<unsigned int>& r)
+    {
+        for (unsigned int y = r.begin(); y != r.end(); y++)
         {
-            // Read in one scan line of data
-            unsigned int numBytes = fWidth * fBytesPerPixel;
-            fread( inputFloatBuffer, 1, numBytes, fInputFile);
-            
-#if defined(__APPLE__)
-            // Need to swap bytes on Power PC (Mac)
-            unsigned int *bPtr = (unsigned int *)inputFloatBuffer;
-            unsigned int b;
-            for (b=0; b<numBytes / 4; b++)
+            const unsigned char* inPtr = input + y * rowBytes;
+            float* outPtr = outputBuffer + (regionHeight - 1 - y) * rowValues;
+            size_t x;
+
+            if (table)
             {
-                swap_endian( bPtr );
-                bPtr++;
+                const unsigned short* halfPtr = (const unsigned short*)inPtr;
+                for (x=0; x<rowValues; x++)
+                {
+                    unsigned short value = halfPtr[x];
+                    swap_endian_half(&value);
+                    outPtr[x] = table[value];
+                }
             }
-#endif
-            float *inPtr = inputFloatBuffer;
-            for (x=0; x<fWidth * fNumChannels; x++)
+            else
             {
-                *(outPtr + x) = *inPtr;
-                inPtr++;
+                memcpy(outPtr, inPtr, rowValues * sizeof(float));
+#if defined(__APPLE__)
+                // Need to swap bytes on Power PC (Mac)
+                for (x=0; x<rowValues; x++)
+                    swap_endian(&outPtr[x]);
+#endif
             }
-            outPtr -= (fWidth * fNumChannels);
         }
-        loaded = MS::kSuccess;
-    }
-
-    // Cleanup memory and close the file
-    if (inputFloatBuffer)
-    {
-        delete [] inputFloatBuffer;
-        inputFloatBuffer = NULL;
-    }
-    if (inputIntBuffer)
-    {
-        delete [] inputFloatBuffer;
-        inputFloatBuffer = NULL;
-    }
-    close();
+    });
 
-    return loaded;
+    return MS::kSuccess;
 }
 
 
@@ -450,6 +519,10 @@ MStatus initializePlugin( MObject obj )
                     ddsFloatReader::creator,       
                     extensions,
                     MFnPlugin::kImageFilePriorityLow));
+    CHECK_MSTATUS( plugin.registerCommand(
+                    "ddsFloatReadRegion",
+                    readRegion::ReadRegionCmd<ddsFloatReader>::creator,
+                    readRegion::ReadRegionCmd<ddsFloatReader>::newSyntax));
     
     return MS::kSuccess;
 }
@@ -458,6 +531,7 @@ MStatus initializePlugin( MObject obj )
 MStatus uninitializePlugin( MObject obj )
 {
     MFnPlugin plugin( obj );
+    CHECK_MSTATUS( plugin.deregisterCommand( "ddsFloatReadRegion" ) );
     CHECK_MSTATUS( plugin.deregisterImageFile( kImageFormatName ) );
 
     return MS::kSuccess;
@@ -4,6 +4,9 @@
 //
 //  FileName: the name of the file to load
 //  UV: uv coordinate we're evaluating now.
+//  UVFilterSize: footprint of the lookup in uv space, used by trilinear
+//      filtering to pick the mip level.
+//  FilterType: closest (the default), bilinear or trilinear.
 //
 // Output:
 //
@@ -14,6 +17,19 @@
 //  shadingNode -asTexture fileTexture;
 //  shadingNode -asUtility place2dTexture;
 //  connectAttr place2dTexture1.outUV fileTexture1.uvCoord;
+//  connectAttr place2dTexture1.outUvFilterSize fileTexture1.uvFilterSize;
+//
+// Images are not held by the nodes. All file nodes share one process-wide
+// cache keyed on the resolved file name, which keeps the images as 64x64
+// RGBA8 tiles, along with the decoded files. Mip tiles are only built when
+// a lookup asks for them, each from the tiles of the level above, and
+// entries are evicted least recently used first once the cache goes over
+// its memory budget. The budget defaults to 1024 MB, can be set with the
+// MAYA_FILETEXTURE_CACHE_MB environment variable, and at run time with:
+//
+//  fileTextureCache -memoryLimit 4096;
+//  fileTextureCache -flush;
+//  fileTextureCache;       // returns [bytes used, tiles, textures, limit MB]
 
 #include <maya/MFnPlugin.h>
 #include <maya/MPxNode.h>
@@ -37,6 +53,140 @@
 #include <maya/MShaderManager.h>
 #include <maya/MTextureManager.h>
 #include <maya/MStateManager.h>
+#include <maya/MFnEnumAttribute.h>
+#include <maya/MPxCommand.h>
+#include <maya/MSyntax.h>
+#include <maya/MArgDatabase.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Texture Cache Declaration
+//
+// A texture file known to the cache. It only records the image layout; the
+// texels live in the cache's tiles.
+class TextureFile
+{
+public:
+    static const unsigned int kTileSize = 64;
+    static const unsigned int kPixelSize = 4;
+
+    struct Level
+    {
+        unsigned int width;
+        unsigned int height;
+        unsigned int tilesX;
+        unsigned int tilesY;
+    };
+
+    struct Tile
+    {
+        unsigned int width;
+        unsigned int height;
+        std::vector<unsigned char> texels;
+    };
+
+    TextureFile(const MString& path);
+    ~TextureFile();
+
+    bool open();
+    bool isValid() const { return fValid; }
+    unsigned int numLevels() const { return (unsigned int)fLevels.size(); }
+    const Level& level(unsigned int l) const { return fLevels[l]; }
+
+    // Returns tile (tx, ty) of the given level, building it if it is not
+    // cached.
+    std::shared_ptr<const Tile> tile(unsigned int l, unsigned int tx, unsigned int ty);
+
+private:
+    // Cache level of the decoded file, kept as a single tile
+    static const unsigned int kSourceLevel = ~0u;
+
+    bool decode();
+    std::shared_ptr<const Tile> source();
+    std::shared_ptr<const Tile> fetchTile(unsigned int l, unsigned int tx, unsigned int ty);
+    std::shared_ptr<const Tile> buildTile(unsigned int l, unsigned int tx, unsigned int ty);
+
+    MString fPath;
+    bool fOpened;
+    bool fValid;
+    std::vector<Level> fLevels;
+
+    // Serializes building tiles, so that threads missing the same tiles
+    // wait for one build, and for one read of the file, instead of all
+    // doing it.
+    std::mutex fLoadMutex;
+};
+
+// The process-wide tile cache shared by all file nodes.
+class TextureCache
+{
+public:
+    static TextureCache& instance();
+
+    std::shared_ptr<TextureFile> acquire(const MString& path);
+
+    std::shared_ptr<const TextureFile::Tile> find(
+        const TextureFile* file, unsigned int l, unsigned int tx, unsigned int ty);
+    void insert(
+        const TextureFile* file, unsigned int l, unsigned int tx, unsigned int ty,
+        const std::shared_ptr<const TextureFile::Tile>& tile);
+    void dropTiles(const TextureFile* file);
+
+    void setMemoryLimit(size_t bytes);
+    size_t memoryLimit();
+    void flush();
+    void stats(size_t& bytes, size_t& tiles, size_t& textures);
+
+private:
+    TextureCache();
+    void evict();
+
+    struct TileKey
+    {
+        const TextureFile* file;
+        unsigned int level;
+        unsigned int tx;
+        unsigned int ty;
+
+        bool operator==(const TileKey& rhs) const
+        {
+            return file == rhs.file && level == rhs.level &&
+                   tx == rhs.tx && ty == rhs.ty;
+        }
+    };
+
+    struct TileKeyHash
+    {
+        size_t operator()(const TileKey& key) const
+        {
+            size_t h = std::hash<const void*>()(key.file);
+            h = h * 31 + key.level;
+            h = h * 131071 + key.tx;
+            h = h * 131071 + key.ty;
+            return h;
+        }
+    };
+
+    typedef std::pair<TileKey, std::shared_ptr<const TextureFile::Tile> > TileRecord;
+    typedef std::list<TileRecord> TileList;
+
+    std::mutex fMutex;
+    TileList fTiles;    // most recently used first
+    std::unordered_map<TileKey, TileList::iterator, TileKeyHash> fIndex;
+    std::map<std::string, std::weak_ptr<TextureFile> > fFiles;
+    size_t fBytes;
+    size_t fLimit;
+};
 
 // Node Declaration
 class FileNode : public MPxNode
@@ -58,9 +208,10 @@ public:
     static const MTypeId id;
 
 private:
-    MImage fImage;
-    size_t fWidth;
-    size_t fHeight;
+    std::shared_ptr<TextureFile> texture(MDataBlock& block);
+
+    std::shared_ptr<TextureFile> fTexture;
+    std::mutex fTextureMutex;
 
     // Attributes
     static MObject aFileName;
@@ -70,12 +221,24 @@ private:
     static MObject aCMEnabled;
     static MObject aCMConfigEnabled;
     static MObject aUVCoord;
+    static MObject aUVFilterSize;
+    static MObject aFilterType;
     static MObject aOutColor;
     static MObject aOutAlpha;
 
     friend class FileNodeOverride;
 };
 
+// Command Declaration
+class FileTextureCacheCmd : public MPxCommand
+{
+public:
+    static void* creator();
+    static MSyntax newSyntax();
+
+    MStatus doIt(const MArgList& args) override;
+};
+
 // Override Declaration
 class FileNodeOverride : public MHWRender::MPxShadingNodeOverride
 {
@@ -111,6 +274,452 @@ private:
 
 
 
+// Texture Cache Implementation
+const unsigned int TextureFile::kTileSize;
+const unsigned int TextureFile::kPixelSize;
+
+TextureFile::TextureFile(const MString& path)
+: fPath(path)
+, fOpened(false)
+, fValid(false)
+{
+}
+
+TextureFile::~TextureFile()
+{
+    TextureCache::instance().dropTiles(this);
+}
+
+bool TextureFile::open()
+{
+    std::lock_guard<std::mutex> lock(fLoadMutex);
+    if (fOpened)
+        return fValid;
+    fOpened = true;
+
+    // MImage can only read whole files, so the size is only known once the
+    // file has been decoded. decode() keeps the image in the cache, so that
+    // the first lookups don't read the file again.
+    fLevels.clear();
+    fValid = decode();
+    return fValid;
+}
+
+bool TextureFile::decode()
+{
+    MImage image;
+    unsigned int width = 0;
+    unsigned int height = 0;
+    if (!image.readFromFile(fPath) ||
+        !image.getSize(width, height) ||
+        !image.pixels() || width == 0 || height == 0)
+    {
+        return false;
+    }
+
+    if (fLevels.empty())
+    {
+        for (;;)
+        {
+            Level level;
+            level.width = width;
+            level.height = height;
+            level.tilesX = (width + kTileSize - 1) / kTileSize;
+            level.tilesY = (height + kTileSize - 1) / kTileSize;
+            fLevels.push_back(level);
+            if (width == 1 && height == 1)
+                break;
+            width = std::max(1u, width / 2);
+            height = std::max(1u, height / 2);
+        }
+    }
+    else if (width != fLevels[0].width || height != fLevels[0].height)
+    {
+        // The file changed size since it was opened
+        return false;
+    }
+
+    std::shared_ptr<Tile> t = std::make_shared<Tile>();
+    t->width = fLevels[0].width;
+    t->height = fLevels[0].height;
+    t->texels.assign(image.pixels(),
+        image.pixels() + (size_t)t->width * t->height * kPixelSize);
+    TextureCache::instance().insert(this, kSourceLevel, 0, 0, t);
+    return true;
+}
+
+// Called with fLoadMutex held
+std::shared_ptr<const TextureFile::Tile> TextureFile::source()
+{
+    TextureCache& cache = TextureCache::instance();
+    std::shared_ptr<const Tile> t = cache.find(this, kSourceLevel, 0, 0);
+    if (!t && decode())
+        t = cache.find(this, kSourceLevel, 0, 0);
+    return t;
+}
+
+// Called with fLoadMutex held
+std::shared_ptr<const TextureFile::Tile> TextureFile::fetchTile(
+    unsigned int l, unsigned int tx, unsigned int ty)
+{
+    TextureCache& cache = TextureCache::instance();
+    std::shared_ptr<const Tile> t = cache.find(this, l, tx, ty);
+    if (t)
+        return t;
+    t = buildTile(l, tx, ty);
+    if (t)
+        cache.insert(this, l, tx, ty, t);
+    return t;
+}
+
+// Builds one tile: level 0 tiles are copied from the decoded file, the
+// tiles of the other levels are box filtered from the (up to) 4 tiles of
+// the level above which they cover. So a miss only builds the missing tile,
+// and the file is only decoded again once it was evicted itself.
+std::shared_ptr<const TextureFile::Tile> TextureFile::buildTile(
+    unsigned int l, unsigned int tx, unsigned int ty)
+{
+    const Level& level = fLevels[l];
+    std::shared_ptr<Tile> t = std::make_shared<Tile>();
+    t->width = std::min(kTileSize, level.width - tx * kTileSize);
+    t->height = std::min(kTileSize, level.height - ty * kTileSize);
+    t->texels.resize(t->width * t->height * kPixelSize);
+
+    if (l == 0)
+    {
+        std::shared_ptr<const Tile> src = source();
+        if (!src)
+            return std::shared_ptr<const Tile>();
+        for (unsigned int y = 0; y < t->height; ++y)
+        {
+            const unsigned char* row = &src->texels[
+                ((size_t)(ty * kTileSize + y) * level.width + tx * kTileSize) * kPixelSize];
+            memcpy(&t->texels[y * t->width * kPixelSize], row, t->width * kPixelSize);
+        }
+        return t;
+    }
+
+    // Source tiles, indexed by [y][x] relative to (2 tx, 2 ty)
+    const Level& above = fLevels[l - 1];
+    std::shared_ptr<const Tile> src[2][2];
+    for (unsigned int j = 0; j < 2; ++j)
+    {
+        for (unsigned int i = 0; i < 2; ++i)
+        {
+            unsigned int sx = std::min(2 * tx + i, above.tilesX - 1);
+            unsigned int sy = std::min(2 * ty + j, above.tilesY - 1);
+            src[j][i] = fetchTile(l - 1, sx, sy);
+            if (!src[j][i])
+                return std::shared_ptr<const Tile>();
+        }
+    }
+
+    // Texel (x, y) of the level above, inside the source tiles
+    auto texel = [&](unsigned int x, unsigned int y) -> const unsigned char*
+    {
+        x = std::min(x, above.width - 1);
+        y = std::min(y, above.height - 1);
+        const Tile& s = *src[y / kTileSize - 2 * ty][x / kTileSize - 2 * tx];
+        unsigned int lx = x % kTileSize;
+        unsigned int ly = y % kTileSize;
+        return &s.texels[(ly * s.width + lx) * kPixelSize];
+    };
+
+    // Box filter. Odd sizes clamp at the edge.
+    for (unsigned int y = 0; y < t->height; ++y)
+    {
+        unsigned int ay = 2 * (ty * kTileSize + y);
+        for (unsigned int x = 0; x < t->width; ++x)
+        {
+            unsigned int ax = 2 * (tx * kTileSize + x);
+            const unsigned char* p00 = texel(ax, ay);
+            const unsigned char* p01 = texel(ax + 1, ay);
+            const unsigned char* p10 = texel(ax, ay + 1);
+            const unsigned char* p11 = texel(ax + 1, ay + 1);
+            unsigned char* out = &t->texels[(y * t->width + x) * kPixelSize];
+            for (unsigned int c = 0; c < kPixelSize; ++c)
+                out[c] = (unsigned char)((p00[c] + p01[c] + p10[c] + p11[c] + 2) / 4);
+        }
+    }
+    return t;
+}
+
+std::shared_ptr<const TextureFile::Tile> TextureFile::tile(
+    unsigned int l, unsigned int tx, unsigned int ty)
+{
+    TextureCache& cache = TextureCache::instance();
+    std::shared_ptr<const Tile> t = cache.find(this, l, tx, ty);
+    if (t)
+        return t;
+
+    // Another thread may build it while we wait, fetchTile() looks again
+    std::lock_guard<std::mutex> lock(fLoadMutex);
+    return fetchTile(l, tx, ty);
+}
+
+TextureCache& TextureCache::instance()
+{
+    static TextureCache sCache;
+    return sCache;
+}
+
+TextureCache::TextureCache()
+: fBytes(0)
+, fLimit((size_t)1024 * 1024 * 1024)
+{
+    const char* limit = getenv("MAYA_FILETEXTURE_CACHE_MB");
+    if (limit && atoi(limit) > 0)
+        fLimit = (size_t)atoi(limit) * 1024 * 1024;
+}
+
+std::shared_ptr<TextureFile> TextureCache::acquire(const MString& path)
+{
+    std::shared_ptr<TextureFile> file;
+    {
+        std::lock_guard<std::mutex> lock(fMutex);
+        std::weak_ptr<TextureFile>& entry = fFiles[path.asChar()];
+        file = entry.lock();
+        if (!file)
+        {
+            file = std::make_shared<TextureFile>(path);
+            entry = file;
+        }
+    }
+
+    // Opening decodes the file, don't hold the cache lock for it
+    if (!file->open())
+        return std::shared_ptr<TextureFile>();
+    return file;
+}
+
+std::shared_ptr<const TextureFile::Tile> TextureCache::find(
+    const TextureFile* file, unsigned int l, unsigned int tx, unsigned int ty)
+{
+    TileKey key = { file, l, tx, ty };
+    std::lock_guard<std::mutex> lock(fMutex);
+    auto it = fIndex.find(key);
+    if (it == fIndex.end())
+        return std::shared_ptr<const TextureFile::Tile>();
+    fTiles.splice(fTiles.begin(), fTiles, it->second);
+    return it->second->second;
+}
+
+void TextureCache::insert(
+    const TextureFile* file, unsigned int l, unsigned int tx, unsigned int ty,
+    const std::shared_ptr<const TextureFile::Tile>& tile)
+{
+    TileKey key = { file, l, tx, ty };
+    std::lock_guard<std::mutex> lock(fMutex);
+    auto it = fIndex.find(key);
+    if (it != fIndex.end())
+    {
+        fBytes -= it->second->second->texels.size();
+        fTiles.erase(it->second);
+        fIndex.erase(it);
+    }
+    fTiles.push_front(TileRecord(key, tile));
+    fIndex[key] = fTiles.begin();
+    fBytes += tile->texels.size();
+    evict();
+}
+
+void TextureCache::evict()
+{
+    // Tiles still used by a lookup stay alive through their shared_ptr
+    while (fBytes > fLimit && fTiles.size() > 1)
+    {
+        TileRecord& oldest = fTiles.back();
+        fBytes -= oldest.second->texels.size();
+        fIndex.erase(oldest.first);
+        fTiles.pop_back();
+    }
+}
+
+void TextureCache::dropTiles(const TextureFile* file)
+{
+    std::lock_guard<std::mutex> lock(fMutex);
+    for (auto it = fTiles.begin(); it != fTiles.end(); )
+    {
+        if (it->first.file == file)
+        {
+            fBytes -= it->second->texels.size();
+            fIndex.erase(it->first);
+            it = fTiles.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+    for (auto it = fFiles.begin(); it != fFiles.end(); )
+    {
+        if (it->second.expired())
+            it = fFiles.erase(it);
+        else
+            ++it;
+    }
+}
+
+void TextureCache::setMemoryLimit(size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(fMutex);
+    fLimit = bytes;
+    evict();
+}
+
+size_t TextureCache::memoryLimit()
+{
+    std::lock_guard<std::mutex> lock(fMutex);
+    return fLimit;
+}
+
+void TextureCache::flush()
+{
+    std::lock_guard<std::mutex> lock(fMutex);
+    fTiles.clear();
+    fIndex.clear();
+    fBytes = 0;
+}
+
+void TextureCache::stats(size_t& bytes, size_t& tiles, size_t& textures)
+{
+    std::lock_guard<std::mutex> lock(fMutex);
+    bytes = fBytes;
+    tiles = fTiles.size();
+    textures = 0;
+    for (auto it = fFiles.begin(); it != fFiles.end(); ++it)
+    {
+        if (!it->second.expired())
+            ++textures;
+    }
+}
+
+namespace
+{
+    // Walks texels of one level, keeping the last tile so that neighbouring
+    // texels don't go back to the cache.
+    class TexelReader
+    {
+    public:
+        TexelReader(TextureFile& file, unsigned int l)
+        : fFile(file)
+        , fLevel(l)
+        , fLevelInfo(file.level(l))
+        , fTX(~0u)
+        , fTY(~0u)
+        {
+        }
+
+        const unsigned char* texel(int x, int y)
+        {
+            static const unsigned char sBlack[TextureFile::kPixelSize] = { 0, 0, 0, 0 };
+
+            x = std::min(std::max(x, 0), (int)fLevelInfo.width - 1);
+            y = std::min(std::max(y, 0), (int)fLevelInfo.height - 1);
+            unsigned int tx = x / TextureFile::kTileSize;
+            unsigned int ty = y / TextureFile::kTileSize;
+            if (tx != fTX || ty != fTY || !fTile)
+            {
+                fTile = fFile.tile(fLevel, tx, ty);
+                fTX = tx;
+                fTY = ty;
+            }
+            if (!fTile)
+                return sBlack;
+            unsigned int lx = x - tx * TextureFile::kTileSize;
+            unsigned int ly = y - ty * TextureFile::kTileSize;
+            return &fTile->texels[(ly * fTile->width + lx) * TextureFile::kPixelSize];
+        }
+
+        const TextureFile::Level& info() const { return fLevelInfo; }
+
+    private:
+        TextureFile& fFile;
+        unsigned int fLevel;
+        const TextureFile::Level& fLevelInfo;
+        unsigned int fTX;
+        unsigned int fTY;
+        std::shared_ptr<const TextureFile::Tile> fTile;
+    };
+
+    enum FilterType
+    {
+        kClosest = 0,
+        kBilinear,
+        kTrilinear
+    };
+
+    void sampleClosest(TextureFile& file, unsigned int l, float u, float v, float result[4])
+    {
+        TexelReader reader(file, l);
+        const TextureFile::Level& info = reader.info();
+        const unsigned char* p = reader.texel(
+            (int)(u * (info.width - 1)), (int)(v * (info.height - 1)));
+        for (int c = 0; c < 4; ++c)
+            result[c] = p[c] / 255.0f;
+    }
+
+    void sampleBilinear(TextureFile& file, unsigned int l, float u, float v, float result[4])
+    {
+        TexelReader reader(file, l);
+        const TextureFile::Level& info = reader.info();
+
+        // Texel centers are at half integers
+        float x = u * info.width - 0.5f;
+        float y = v * info.height - 0.5f;
+        float fx = floorf(x);
+        float fy = floorf(y);
+        int x0 = (int)fx;
+        int y0 = (int)fy;
+        float ax = x - fx;
+        float ay = y - fy;
+
+        const unsigned char* p00 = reader.texel(x0, y0);
+        const unsigned char* p01 = reader.texel(x0 + 1, y0);
+        const unsigned char* p10 = reader.texel(x0, y0 + 1);
+        const unsigned char* p11 = reader.texel(x0 + 1, y0 + 1);
+        for (int c = 0; c < 4; ++c)
+        {
+            float top = p00[c] + (p01[c] - p00[c]) * ax;
+            float bottom = p10[c] + (p11[c] - p10[c]) * ax;
+            result[c] = (top + (bottom - top) * ay) / 255.0f;
+        }
+    }
+
+    void sampleTexture(TextureFile& file, int filter, float u, float v,
+                       float filterU, float filterV, float result[4])
+    {
+        if (filter == kClosest)
+        {
+            sampleClosest(file, 0, u, v, result);
+            return;
+        }
+        if (filter == kBilinear)
+        {
+            sampleBilinear(file, 0, u, v, result);
+            return;
+        }
+
+        // Pick the level whose texels match the footprint
+        const TextureFile::Level& top = file.level(0);
+        float footprint = std::max(filterU * top.width, filterV * top.height);
+        float lod = footprint > 1.0f ? log2f(footprint) : 0.0f;
+        float maxLod = (float)(file.numLevels() - 1);
+        if (lod > maxLod) lod = maxLod;
+
+        unsigned int l0 = (unsigned int)lod;
+        float t = lod - l0;
+        sampleBilinear(file, l0, u, v, result);
+        if (t > 0.0f && l0 + 1 < file.numLevels())
+        {
+            float next[4];
+            sampleBilinear(file, l0 + 1, u, v, next);
+            for (int c = 0; c < 4; ++c)
+                result[c] += (next[c] - result[c]) * t;
+        }
+    }
+}
+
 // Node Implementation
 const MTypeId FileNode::id(0x00081057);
 
@@ -120,8 +729,6 @@ void* FileNode::creator()
 }
 
 FileNode::FileNode()
-: fWidth(0)
-, fHeight(0)
 {
 }
 
@@ -135,12 +742,32 @@ MStatus FileNode::setDependentsDirty(
 {
     if (plug == aFileName)
     {
-        fImage.release();
-        fWidth = fHeight = 0;
+        std::lock_guard<std::mutex> lock(fTextureMutex);
+        fTexture.reset();
     }
     return MPxNode::setDependentsDirty(plug, plugArray);
 }
 
+std::shared_ptr<TextureFile> FileNode::texture(MDataBlock& block)
+{
+    std::lock_guard<std::mutex> lock(fTextureMutex);
+
+    // Look up the shared texture if we need to
+    if (!fTexture)
+    {
+        MString& fileName = block.inputValue(aFileName).asString();
+        MString exactName(fileName);
+
+        // This class is derived from MPxNode, therefore it is not a DAG node and does not have a path.
+        // Instead you we just get the node's name using the name() method inherited from MPxNode as the context.
+        if (MRenderUtil::exactFileTextureName(fileName, false, "", name(), exactName))
+        {
+            fTexture = TextureCache::instance().acquire(exactName);
+        }
+    }
+    return fTexture;
+}
+
 MStatus FileNode::compute(const MPlug& plug, MDataBlock& block)
 {
     // outColor or individial R, G, B channel, or alpha
@@ -154,45 +781,24 @@ MStatus FileNode::compute(const MPlug& plug, MDataBlock& block)
     MFloatVector resultColor(0.0f, 0.0f, 0.0f);
     float resultAlpha = 1.0f;
 
-    // Read from file if we need to
-    if (!fImage.pixels())
-    {
-        MString& fileName = block.inputValue(aFileName).asString();
-        MString exactName(fileName);
-        
-        // This class is derived from MPxNode, therefore it is not a DAG node and does not have a path.
-        // Instead you we just get the node's name using the name() method inherited from MPxNode as the context.
-        if (MRenderUtil::exactFileTextureName(fileName, false, "", name(), exactName))
-        {
-            unsigned int width = 0;
-            unsigned int height = 0;
-            if (fImage.readFromFile(exactName) &&
-                fImage.getSize(width, height))
-            {
-                fWidth = width;
-                fHeight = height;
-            }
-        }
-    }
-
-    // Compute outputs from image data
-    unsigned char* data = fImage.pixels();
-    if (data && fWidth > 0 && fHeight > 0)
+    // Compute outputs from the cached image
+    std::shared_ptr<TextureFile> file = texture(block);
+    if (file && file->isValid())
     {
         float2& uv = block.inputValue(aUVCoord).asFloat2();
         float u = uv[0]; if (u<0.0f) u=0.0f; if (u>1.0f) u=1.0f;
         float v = uv[1]; if (v<0.0f) v=0.0f; if (v>1.0f) v=1.0f;
 
-        static const size_t pixelSize = 4;
-        size_t rowOffset = (size_t)(v*(fHeight-1)) * fWidth;
-        size_t colOffset = (size_t)(u*(fWidth-1));
-        const unsigned char* pixel = data +
-            ((rowOffset + colOffset) * pixelSize);
+        float2& filterSize = block.inputValue(aUVFilterSize).asFloat2();
+        short filter = block.inputValue(aFilterType).asShort();
+
+        float texel[4];
+        sampleTexture(*file, filter, u, v, filterSize[0], filterSize[1], texel);
 
-        resultColor[0] = ((float)pixel[0])/255.0f;
-        resultColor[1] = ((float)pixel[1])/255.0f;
-        resultColor[2] = ((float)pixel[2])/255.0f;
-        resultAlpha = ((float)pixel[3])/255.0f;
+        resultColor[0] = texel[0];
+        resultColor[1] = texel[1];
+        resultColor[2] = texel[2];
+        resultAlpha = texel[3];
     }
 
     // Set ouput color attribute
@@ -230,6 +836,8 @@ MObject FileNode::aColorSpace;
 MObject FileNode::aCMEnabled;
 MObject FileNode::aCMConfigEnabled;
 MObject FileNode::aUVCoord;
+MObject FileNode::aUVFilterSize;
+MObject FileNode::aFilterType;
 MObject FileNode::aOutColor;
 MObject FileNode::aOutAlpha;
 
@@ -237,6 +845,7 @@ MStatus FileNode::initialize()
 {
     MFnNumericAttribute nAttr;
     MFnTypedAttribute tAttr;
+    MFnEnumAttribute eAttr;
 
     // Input attributes
     MFnStringData stringData;
@@ -272,6 +881,18 @@ MStatus FileNode::initialize()
     MAKE_INPUT(nAttr);
     CHECK_MSTATUS(nAttr.setHidden(true));
 
+    child1 = nAttr.create("uvFilterSizeX", "fsx", MFnNumericData::kFloat);
+    child2 = nAttr.create("uvFilterSizeY", "fsy", MFnNumericData::kFloat);
+    aUVFilterSize = nAttr.create("uvFilterSize", "fs", child1, child2);
+    MAKE_INPUT(nAttr);
+    CHECK_MSTATUS(nAttr.setHidden(true));
+
+    aFilterType = eAttr.create("filterType", "ft", kClosest);
+    CHECK_MSTATUS(eAttr.addField("Closest", kClosest));
+    CHECK_MSTATUS(eAttr.addField("Bilinear", kBilinear));
+    CHECK_MSTATUS(eAttr.addField("Trilinear", kTrilinear));
+    MAKE_INPUT(eAttr);
+
     // Output attributes
     aOutColor = nAttr.createColor("outColor", "oc");
     MAKE_OUTPUT(nAttr);
@@ -282,6 +903,8 @@ MStatus FileNode::initialize()
     // Add attributes to the node database.
     CHECK_MSTATUS(addAttribute(aFileName));
     CHECK_MSTATUS(addAttribute(aUVCoord));
+    CHECK_MSTATUS(addAttribute(aUVFilterSize));
+    CHECK_MSTATUS(addAttribute(aFilterType));
     CHECK_MSTATUS(addAttribute(aOutColor));
     CHECK_MSTATUS(addAttribute(aOutAlpha));
     CHECK_MSTATUS(addAttribute(aCMEnabled));
@@ -295,6 +918,10 @@ MStatus FileNode::initialize()
     CHECK_MSTATUS(attributeAffects(aFileName, aOutAlpha));
     CHECK_MSTATUS(attributeAffects(aUVCoord, aOutColor));
     CHECK_MSTATUS(attributeAffects(aUVCoord, aOutAlpha));
+    CHECK_MSTATUS(attributeAffects(aUVFilterSize, aOutColor));
+    CHECK_MSTATUS(attributeAffects(aUVFilterSize, aOutAlpha));
+    CHECK_MSTATUS(attributeAffects(aFilterType, aOutColor));
+    CHECK_MSTATUS(attributeAffects(aFilterType, aOutAlpha));
     CHECK_MSTATUS(attributeAffects(aCMEnabled, aOutColor));
     CHECK_MSTATUS(attributeAffects(aCMConfigEnabled, aOutColor));
     CHECK_MSTATUS(attributeAffects(aCMConfigPath, aOutColor));
@@ -615,6 +1242,62 @@ bool FileNodeOverride::valueChangeRequiresFragmentRebuild(const MPlug* plug) con
 
 
 
+// Command Implementation
+#define kMemoryLimitFlag     "-ml"
+#define kMemoryLimitFlagLong "-memoryLimit"
+#define kFlushFlag           "-fl"
+#define kFlushFlagLong       "-flush"
+
+void* FileTextureCacheCmd::creator()
+{
+    return new FileTextureCacheCmd();
+}
+
+MSyntax FileTextureCacheCmd::newSyntax()
+{
+    MSyntax syntax;
+    syntax.addFlag(kMemoryLimitFlag, kMemoryLimitFlagLong, MSyntax::kLong);
+    syntax.addFlag(kFlushFlag, kFlushFlagLong);
+    return syntax;
+}
+
+MStatus FileTextureCacheCmd::doIt(const MArgList& args)
+{
+    MStatus status;
+    MArgDatabase argData(syntax(), args, &status);
+    if (!status)
+        return status;
+
+    TextureCache& cache = TextureCache::instance();
+
+    if (argData.isFlagSet(kFlushFlag))
+        cache.flush();
+
+    if (argData.isFlagSet(kMemoryLimitFlag))
+    {
+        int megabytes = 0;
+        argData.getFlagArgument(kMemoryLimitFlag, 0, megabytes);
+        if (megabytes <= 0)
+        {
+            displayError("The memory limit must be positive.");
+            return MS::kInvalidParameter;
+        }
+        cache.setMemoryLimit((size_t)megabytes * 1024 * 1024);
+    }
+
+    // Report [bytes used, tiles, textures, limit in MB]
+    size_t bytes, tiles, textures;
+    cache.stats(bytes, tiles, textures);
+    clearResult();
+    appendToResult((double)bytes);
+    appendToResult((int)tiles);
+    appendToResult((int)textures);
+    appendToResult((int)(cache.memoryLimit() / (1024 * 1024)));
+    return MS::kSuccess;
+}
+
+
+
 // Plugin Setup
 static const MString sRegistrantId("fileTexturePlugin");
 
@@ -637,6 +1320,11 @@ MStatus initializePlugin(MObject obj)
             sRegistrantId,
             FileNodeOverride::creator));
 
+    CHECK_MSTATUS(plugin.registerCommand(
+        "fileTextureCache",
+        FileTextureCacheCmd::creator,
+        FileTextureCacheCmd::newSyntax));
+
     return MS::kSuccess;
 }
 
@@ -644,6 +1332,7 @@ MStatus uninitializePlugin(MObject obj)
 {
     MFnPlugin plugin(obj);
 
+    CHECK_MSTATUS(plugin.deregisterCommand("fileTextureCache"));
     CHECK_MSTATUS(plugin.deregisterNode(FileNode::id));
 
     CHECK_MSTATUS(
@@ -13,6 +13,15 @@
 #include <maya/MFloatVector.h>
 #include <maya/MFloatPoint.h>
 #include <maya/MFnPlugin.h>
+#include <maya/MFnDependencyNode.h>
+#include <maya/MFnMatrixData.h>
+#include <maya/MMatrix.h>
+#include <maya/MFloatMatrix.h>
+
+#include <vector>
+
+#include "../common/batchNoise.h"
+#include "../common/batchTexture.h"
 
 // DESCRIPTION: 
 //  Produces dependency graph node Flame 
@@ -23,6 +32,12 @@
 
 //  To use this shader, create a Flame node and connect its output to an input of a surface/shader node such as Color. 
 //
+//  The plug-in also provides the command "flameSample", which evaluates a
+//  flame node on many points at once through the batched noise in
+//  common/batchNoise.h rather than one compute() per point, and can bake
+//  the texture to an image. -width 4, 8 or 16 sets how many points are
+//  evaluated together. See common/batchTexture.h.
+//
 
 
 
@@ -64,6 +79,27 @@ class Flame3D : public MPxNode
     //  Id tag for use with binary file format
     static  MTypeId id;
 
+    // Batch interface, see batchTexture.h
+    struct Params
+    {
+        MFloatVector    colorBase;
+        MFloatVector    colorFlame;
+        MFloatVector    axis;
+        float           riseSpeed;
+        float           flickerSpeed;
+        float           flickerDeform;
+        float           power;
+        float           frame;
+        MFloatMatrix    placement;
+        int             width;      // batchNoise lanes, set by -width
+    };
+
+    static const unsigned int kCoordinates = 3;
+
+    static MStatus getParams( const MObject& node, Params& params );
+    static void sampleBatch( const Params& params, const float* worldPoints,
+                             size_t count, float* rgba );
+
     private:
 
     // Input attributes
@@ -331,6 +367,86 @@ MStatus Flame3D::compute(const MPlug& plug, MDataBlock& block)
     return MS::kSuccess;
 }
 
+//
+// DESCRIPTION:
+// Batch interface, see batchTexture.h
+//
+MStatus Flame3D::getParams( const MObject& node, Params& params )
+{
+    MStatus status;
+    MFnDependencyNode fnNode( node, &status );
+    if (!status) return status;
+
+    params.width = batchNoise::kMaxWidth;
+
+    batchTexture::getColor( fnNode, aColorBase, params.colorBase );
+    batchTexture::getColor( fnNode, aColorFlame, params.colorFlame );
+    batchTexture::getColor( fnNode, aRiseAxis, params.axis );
+    fnNode.findPlug( aRiseSpeed, true ).getValue( params.riseSpeed );
+    fnNode.findPlug( aFlickerSpeed, true ).getValue( params.flickerSpeed );
+    fnNode.findPlug( aFlickerDeform, true ).getValue( params.flickerDeform );
+    fnNode.findPlug( aFlamePow, true ).getValue( params.power );
+    fnNode.findPlug( aFlameFrame, true ).getValue( params.frame );
+
+    return batchTexture::getMatrix( fnNode, aPlaceMat, params.placement );
+}
+
+void Flame3D::sampleBatch( const Params& params, const float* worldPoints,
+                           size_t count, float* rgba )
+{
+    std::vector<float> u( count ), v( count ), w( count );
+    std::vector<float> au( count ), av( count ), aw( count ), ascale( count );
+    std::vector<double> turb( count );
+    size_t i;
+
+    float rise_distance = -1.0f * params.riseSpeed * params.frame;
+    float dist = params.flickerSpeed * params.frame;
+    for (i = 0; i < count; i++)
+    {
+        MFloatPoint q( worldPoints[3*i], worldPoints[3*i+1], worldPoints[3*i+2] );
+        q *= params.placement;              // Convert into solid space
+
+        // Offset texture coord along the RiseAxis
+        u[i] = q.x + ( rise_distance * params.axis[0]);
+        v[i] = q.y + ( rise_distance * params.axis[1]);
+        w[i] = q.z + ( rise_distance * params.axis[2]);
+
+        au[i] = u[i] + dist;
+        av[i] = v[i] + dist;
+        aw[i] = w[i] + dist;
+    }
+
+    batchNoise::noise( params.width, Phi, G, &au[0], &av[0], &aw[0], &ascale[0], count );
+
+    for (i = 0; i < count; i++)
+    {
+        u[i] += ascale[i] * params.flickerDeform;
+        v[i] += ascale[i] * params.flickerDeform;
+        w[i] += ascale[i] * params.flickerDeform;
+    }
+
+    batchNoise::turbulence( params.width, Phi, G, &u[0], &v[0], &w[0], 3, &turb[0], count );
+
+    for (i = 0; i < count; i++)
+    {
+        float scalar = (float) (turb[i] + 0.5);
+        if (params.power != 1) scalar = powf (scalar, params.power);
+
+        MFloatVector resultColor;
+        if (scalar >= 1)
+            resultColor = params.colorFlame;
+        else if (scalar < 0) 
+            resultColor = params.colorBase;
+        else
+            resultColor = ((params.colorFlame-params.colorBase)*scalar) + params.colorBase;
+
+        rgba[4*i]   = resultColor.x;
+        rgba[4*i+1] = resultColor.y;
+        rgba[4*i+2] = resultColor.z;
+        rgba[4*i+3] = scalar;
+    }
+}
+
 MStatus initializePlugin( MObject obj )
 {
     const MString UserClassify( "texture/3d" );
@@ -339,6 +455,9 @@ MStatus initializePlugin( MObject obj )
     CHECK_MSTATUS( plugin.registerNode( "flame", Flame3D::id, 
         Flame3D::creator, Flame3D::initialize,
         MPxNode::kDependNode, &UserClassify) );
+    CHECK_MSTATUS( plugin.registerCommand( "flameSample",
+        batchTexture::SampleCmd<Flame3D>::creator,
+        batchTexture::SampleCmd<Flame3D>::newSyntax ) );
 
     Noise_init();
     
@@ -349,6 +468,7 @@ MStatus initializePlugin( MObject obj )
 MStatus uninitializePlugin( MObject obj )
 {
     MFnPlugin plugin( obj );
+    CHECK_MSTATUS( plugin.deregisterCommand( "flameSample" ) );
     CHECK_MSTATUS( plugin.deregisterNode( Flame3D::id ) );
 
     return MS::kSuccess;
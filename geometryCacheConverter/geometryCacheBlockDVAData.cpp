@@ -37,8 +37,9 @@ geometryCacheBlockDVAData::geometryCacheBlockDVAData(
     blockTag = tag;
     group = false;
 
-    for(unsigned int i = 0; i < size * 3; i+=3 ) {
-        vectorArrayData.append( MVector( value[i], value[i+1], value[i+2] ) );
+    vectorArrayData.setLength( size );
+    for(unsigned int i = 0; i < size; i++ ) {
+        vectorArrayData.set( MVector( value[i*3], value[i*3+1], value[i*3+2] ), i );
     }
 }
 
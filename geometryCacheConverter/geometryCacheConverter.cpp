@@ -29,6 +29,18 @@
 //  Where, "fileName1" and "fileName2" are the string paths to the geometry 
 //  cache files.
 //
+//  Additional flags:
+//
+//  -stream         Convert each file block by block while reading it instead
+//                  of reading the whole file first. Memory use stays fixed
+//                  regardless of the cache size.
+//  -bufferSize n   Output buffer per file in KB when streaming (default 4096).
+//  -parallel       Convert the files concurrently, one per core. Meant for
+//                  per-frame caches made of many files. Implies -stream.
+//
+//  A summary with the amount of data read and the throughput in MB/s is
+//  printed once all the files are converted.
+//
 
 // Project includes
 //
@@ -42,6 +54,13 @@
 #include <maya/MArgList.h>
 #include <maya/MArgDatabase.h>
 #include <maya/MFnPlugin.h>
+#include <maya/MTimer.h>
+
+// Other includes
+//
+#include <tbb/parallel_for.h>
+#include <sys/stat.h>
+#include <vector>
 
 #define LFLAG_TOASCII "-toAscii"
 #define SFLAG_TOASCII "-ta"
@@ -49,6 +68,51 @@
 #define LFLAG_FILE "-file"
 #define SFLAG_FILE "-f"
 
+#define LFLAG_STREAM "-stream"
+#define SFLAG_STREAM "-st"
+
+#define LFLAG_PARALLEL "-parallel"
+#define SFLAG_PARALLEL "-p"
+
+#define LFLAG_BUFFERSIZE "-bufferSize"
+#define SFLAG_BUFFERSIZE "-bs"
+
+namespace
+{
+    // Result of converting one file, reported on the main thread since
+    // MGlobal can't be used from the worker threads.
+    //
+    struct conversionResult
+    {
+        MString     name;
+        bool        readOk;
+        bool        convertOk;
+        double      bytesIn;
+        double      bytesOut;
+    };
+
+    double fileSize( const MString& name )
+    {
+        struct stat st;
+        if( stat( name.asChar(), &st ) != 0 )
+            return 0.0;
+        return (double) st.st_size;
+    }
+
+    void streamFile( conversionResult& result, size_t bufferSize )
+    {
+        // MIffFile keeps the read state, each conversion needs its own.
+        //
+        MIffFile iffFile;
+        geometryCacheFile cacheFile( result.name, &iffFile );
+
+        result.convertOk = cacheFile.convertToAsciiStreaming( bufferSize );
+        result.readOk = cacheFile.isRead();
+        result.bytesIn = fileSize( result.name );
+        result.bytesOut = result.convertOk ? fileSize( cacheFile.asciiFileName() ) : 0.0;
+    }
+}
+
 class convertGeometryCache : public MPxCommand
 {
 public:
@@ -119,6 +183,9 @@ MSyntax convertGeometryCache::cmdSyntax()
     syntax.addFlag( SFLAG_TOASCII, LFLAG_TOASCII, MSyntax::kNoArg );
     syntax.addFlag( SFLAG_FILE, LFLAG_FILE, MSyntax::kString );
     syntax.makeFlagMultiUse( SFLAG_FILE );  
+    syntax.addFlag( SFLAG_STREAM, LFLAG_STREAM, MSyntax::kNoArg );
+    syntax.addFlag( SFLAG_PARALLEL, LFLAG_PARALLEL, MSyntax::kNoArg );
+    syntax.addFlag( SFLAG_BUFFERSIZE, LFLAG_BUFFERSIZE, MSyntax::kLong );
     syntax.enableQuery( false );
     syntax.enableEdit( false );
 
@@ -145,61 +212,139 @@ MStatus convertGeometryCache::doIt( const MArgList& args )
         return status;
     }
 
-    // Create an MIffFile to read our cache files
-    //
-    MIffFile iffFilePtr;
+    bool isParallel = argDb.isFlagSet( SFLAG_PARALLEL );
+    bool isStream = isParallel || argDb.isFlagSet( SFLAG_STREAM );
+
+    int bufferSizeKB = 4096;
+    if( argDb.isFlagSet( SFLAG_BUFFERSIZE ) )
+    {
+        argDb.getFlagArgument( SFLAG_BUFFERSIZE, 0, bufferSizeKB );
+        if( bufferSizeKB < 1 ) bufferSizeKB = 1;
+    }
 
-    // Iterate through all the files specified
+    // Gather all the files specified
     //
     unsigned int numUses = argDb.numberOfFlagUses( SFLAG_FILE );
+    std::vector<conversionResult> results( numUses );
     for(unsigned int i = 0; i < numUses; i++ )
     {
         MArgList argList;
         status = argDb.getFlagArgumentList( SFLAG_FILE, i, argList ); 
         if( !status ) return status;
 
-        MString name = argList.asString( 0, &status );
+        results[i].name = argList.asString( 0, &status );
         if( !status ) return status;
 
-        // Create a geometryCacheFile object from the current file path
+        results[i].readOk = false;
+        results[i].convertOk = false;
+        results[i].bytesIn = 0.0;
+        results[i].bytesOut = 0.0;
+    }
+
+    MTimer timer;
+    timer.beginTimer();
+
+    if( isStream )
+    {
+        size_t bufferSize = (size_t)bufferSizeKB * 1024;
+        if( isParallel )
+        {
+            // One file per task, the files are independent.
+            //
+            tbb::parallel_for( 0u, numUses, [&]( unsigned int i ) {
+                streamFile( results[i], bufferSize );
+            });
+        }
+        else
+        {
+            for(unsigned int i = 0; i < numUses; i++ )
+                streamFile( results[i], bufferSize );
+        }
+    }
+    else
+    {
+        // Create an MIffFile to read our cache files
         //
-        geometryCacheFile cacheFile( name, &iffFilePtr);
+        MIffFile iffFilePtr;
 
-        // Read the geometry cache file
+        // Iterate through all the files specified
         //
-        bool readStatus = cacheFile.readCacheFiles();
+        for(unsigned int i = 0; i < numUses; i++ )
+        {
+            conversionResult& result = results[i];
 
-        if( !readStatus ) {
-            // If the read failed, report the file name that failed
+            // Create a geometryCacheFile object from the current file path
             //
-            MGlobal::displayError( "Failed in reading file \"" + name + "\"" );
+            geometryCacheFile cacheFile( result.name, &iffFilePtr);
 
-            // Skip the conversion process
+            // Read the geometry cache file
             //
-            continue;
-        } 
-        
-        // Convert the geometry cache file to the specified format
-        //
-        if( isToAscii ) {
-            // Convert to Ascii
+            result.readOk = cacheFile.readCacheFiles();
+
+            // Skip the conversion process if the read failed
             //
-            bool convertStatus = cacheFile.convertToAscii();
+            if( !result.readOk )
+                continue;
+            result.bytesIn = fileSize( result.name );
 
-            if( !convertStatus )
-            {
-                // If the convert failed, report the file name that failed
+            // Convert the geometry cache file to the specified format
+            //
+            if( isToAscii ) {
+                // Convert to Ascii
                 //
-                MGlobal::displayError( "Failed in converting file \"" + 
-                                        name +
-                                        "\" to ASCII");
+                result.convertOk = cacheFile.convertToAscii();
+                if( result.convertOk )
+                    result.bytesOut = fileSize( cacheFile.asciiFileName() );
             }
+
+            // Insert other file format conversions here
+            //
         }
+    }
 
-        // Insert other file format conversions here
-        //
+    timer.endTimer();
+
+    // Report failures and the summary
+    //
+    unsigned int numConverted = 0;
+    double bytesIn = 0.0, bytesOut = 0.0;
+    for(unsigned int i = 0; i < numUses; i++ )
+    {
+        const conversionResult& result = results[i];
+        if( !result.readOk ) {
+            // If the read failed, report the file name that failed
+            //
+            MGlobal::displayError( "Failed in reading file \"" + result.name + "\"" );
+        } else if( !result.convertOk ) {
+            // If the convert failed, report the file name that failed
+            //
+            MGlobal::displayError( "Failed in converting file \"" + 
+                                    result.name +
+                                    "\" to ASCII");
+        } else {
+            numConverted++;
+            bytesIn += result.bytesIn;
+            bytesOut += result.bytesOut;
+        }
     }
 
+    double seconds = timer.elapsedTime();
+    double megabytes = 1.0 / ( 1024.0 * 1024.0 );
+    MString summary = "convertGeometryCache: converted ";
+    summary += (int) numConverted;
+    summary += " of ";
+    summary += (int) numUses;
+    summary += " files, read ";
+    summary += bytesIn * megabytes;
+    summary += " MB, wrote ";
+    summary += bytesOut * megabytes;
+    summary += " MB in ";
+    summary += seconds;
+    summary += " s (";
+    summary += seconds > 0.0 ? bytesIn * megabytes / seconds : 0.0;
+    summary += " MB/s)";
+    MGlobal::displayInfo( summary );
+
     return status;
 }
 
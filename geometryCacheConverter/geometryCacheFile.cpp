@@ -54,6 +54,7 @@ geometryCacheFile::geometryCacheFile( const MString& fileName, MIffFile* iffFile
 {   
     readStatus = false;
     iffFilePtr = iffFile;
+    streamOut = NULL;
 }
 
 geometryCacheFile::~geometryCacheFile()
@@ -102,6 +103,18 @@ const bool& geometryCacheFile::isRead()
     return readStatus;
 }
 
+MString geometryCacheFile::asciiFileName()
+//
+// Description : ( public method )
+//      Returns the output file name, the file name with a txt extension
+//
+{
+    int loc = cacheFileName.rindex('.');
+    MString outputFileName = cacheFileName.substring(0, loc-1);
+    outputFileName += ".txt";
+    return outputFileName;
+}
+
 bool geometryCacheFile::readCacheFiles()
 //
 // Description : ( public method )
@@ -149,34 +162,12 @@ bool geometryCacheFile::convertToAscii()
 {
     // Generate an output file name by changing the file name extention to txt
     //
-    int loc = cacheFileName.rindex('.');
-    MString outputFileName = cacheFileName.substring(0, loc-1);
-    outputFileName += ".txt";
+    MString outputFileName = asciiFileName();
 
     // Create an output file steam to flush our data to ascii
     //
     std::ofstream oFile( outputFileName.asChar() );
-    if( !oFile.bad() ) 
-    {
-        // Create an iterator to iterate through the blockList
-        //
-        cacheBlockIterator blockIt;
-
-        // Write out all the blocks in the blockList
-        //
-        for( blockIt = blockList.begin();
-            blockIt != blockList.end();
-            blockIt++ )
-        {
-            // Get the current block
-            //
-            geometryCacheBlockBase* block = *blockIt;
-            
-            // OutputToAscii
-            //
-            block->outputToAscii( oFile );
-        }
-    } else
+    if( !writeAscii( oFile ) )
         // If output file stream could not open the file
         //
         return false;
@@ -191,6 +182,62 @@ bool geometryCacheFile::convertToAscii()
     return true;
 }
 
+bool geometryCacheFile::writeAscii( std::ostream& os )
+//
+// Description : ( private method )
+//      Write out all the blocks in the blockList
+//
+{
+    if( os.bad() )
+        return false;
+
+    // Create an iterator to iterate through the blockList
+    //
+    cacheBlockIterator blockIt;
+
+    for( blockIt = blockList.begin();
+        blockIt != blockList.end();
+        blockIt++ )
+    {
+        // Get the current block
+        //
+        geometryCacheBlockBase* block = *blockIt;
+        
+        // OutputToAscii
+        //
+        block->outputToAscii( os );
+    }
+    return !os.bad();
+}
+
+bool geometryCacheFile::convertToAsciiStreaming( size_t bufferSize )
+//
+// Description : ( public method )
+//      Convert the file to Ascii while reading it
+//
+{
+    MString outputFileName = asciiFileName();
+
+    // The stream buffer is the only memory that grows with the output, so
+    // give it a fixed size. It has to be set before the file is opened.
+    //
+    std::vector<char> outBuffer( bufferSize > 0 ? bufferSize : 1 );
+    std::ofstream oFile;
+    oFile.rdbuf()->pubsetbuf( &outBuffer[0], (std::streamsize)outBuffer.size() );
+    oFile.open( outputFileName.asChar() );
+    if( !oFile.is_open() )
+        return false;
+
+    // Blocks are written out as they are read, see appendBlock()
+    //
+    streamOut = &oFile;
+    bool status = readCacheFiles();
+    streamOut = NULL;
+
+    oFile.close();
+    return status && !oFile.fail();
+}
+
 bool geometryCacheFile::readHeaderGroup( MStatus& status )
 //
 // Description : ( private method )
@@ -465,31 +512,36 @@ bool geometryCacheFile::readChannelData()
     if( size ) {
         const void *tmpVec = (double*) iffFilePtr->getChunk(tmpTag, (unsigned *)&byteCount);
 
+        // The swap buffer is kept between channels so that reading a file
+        // doesn't allocate per channel.
+        //
         if( tmpVec && 
             tmpTag == MIffTag('D', 'V', 'C', 'A') &&
             size * sizeof(double)*3 == byteCount )
         {
             double *tmpVecDbl = (double*) tmpVec;
-            double *dataArray = new double[size*3];
+            if( swapBuffer.size() < byteCount )
+                swapBuffer.resize( byteCount );
+            double *dataArray = (double*) &swapBuffer[0];
             for(unsigned int i = 0; i < size*3; i++) {
                 FLswapdouble(tmpVecDbl[i], &(dataArray[i]));
             }
             // Store the channel geometry points in the blockList
             //
             storeCacheBlock( "DVCA", dataArray, size );
-            delete [] dataArray;
         } else if( tmpVec && 
                    tmpTag == MIffTag('F', 'V', 'C', 'A') &&
                    size * sizeof(float)*3 == byteCount ) {
             float *tmpVecFlt = (float*) tmpVec;
-            float *dataArray = new float[size*3];
+            if( swapBuffer.size() < byteCount )
+                swapBuffer.resize( byteCount );
+            float *dataArray = (float*) &swapBuffer[0];
             for(unsigned int i = 0; i < size*3; i++) {
                 FLswapfloat(tmpVecFlt[i], &(dataArray[i]));
             }
             // Store the channel geometry points in the blockList
             //
             storeCacheBlock( "FVCA", dataArray, size );
-            delete [] dataArray;
         } else {
             return false;
         }
@@ -503,7 +555,7 @@ void geometryCacheFile::storeCacheBlock( const MString& tag )
 //      Stores the specified data into the blockList.
 //
 {
-    blockList.push_back( new geometryCacheBlockBase( tag ) );
+    appendBlock( new geometryCacheBlockBase( tag ) );
 }
 
 void geometryCacheFile::storeCacheBlock( const MString& tag, const int& value )
@@ -512,7 +564,7 @@ void geometryCacheFile::storeCacheBlock( const MString& tag, const int& value )
 //      Stores the specified data into the blockList.
 //
 {
-    blockList.push_back( new geometryCacheBlockIntData( tag, value ) );
+    appendBlock( new geometryCacheBlockIntData( tag, value ) );
 }
 
 void geometryCacheFile::storeCacheBlock( const MString& tag, const MString& value  )
@@ -521,7 +573,7 @@ void geometryCacheFile::storeCacheBlock( const MString& tag, const MString& valu
 //      Stores the specified data into the blockList.
 //
 {
-    blockList.push_back( new geometryCacheBlockStringData( tag, value ) );
+    appendBlock( new geometryCacheBlockStringData( tag, value ) );
 }
 
 void geometryCacheFile::storeCacheBlock( const MString& tag, const double* value, const unsigned int& size )
@@ -530,7 +582,7 @@ void geometryCacheFile::storeCacheBlock( const MString& tag, const double* value
 //      Stores the specified data into the blockList.
 //
 {
-    blockList.push_back( new geometryCacheBlockDVAData( tag, value, size ) );
+    appendBlock( new geometryCacheBlockDVAData( tag, value, size ) );
 }
 
 
@@ -540,5 +592,20 @@ void geometryCacheFile::storeCacheBlock( const MString& tag, const float* value,
 //      Stores the specified data into the blockList.
 //
 {
-    blockList.push_back( new geometryCacheBlockFVAData( tag, value, size ) );
+    appendBlock( new geometryCacheBlockFVAData( tag, value, size ) );
+}
+
+void geometryCacheFile::appendBlock( geometryCacheBlockBase* block )
+//
+// Description : ( private method )
+//      Stores the block into the blockList, or writes it out right away
+//      when streaming.
+//
+{
+    if( streamOut ) {
+        block->outputToAscii( *streamOut );
+        delete block;
+    } else {
+        blockList.push_back( block );
+    }
 }
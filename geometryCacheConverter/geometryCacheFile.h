@@ -71,7 +71,9 @@
 
 // Other includes
 //
+#include <iosfwd>
 #include <list>
+#include <vector>
 
 // Typedef of STL containers to store our chunks of data
 //
@@ -90,15 +92,23 @@ public:
     //
     const MString&  fileName();
     const bool&     isRead();
+    MString         asciiFileName();
 
     // Read cache method
     //
     bool    readCacheFiles();
 
-    // Convert cache method
+    // Convert cache methods
     //
     bool    convertToAscii();
 
+    // Reads and converts in one pass, writing each block out as soon as it
+    // is read instead of keeping the whole file in blockList. Memory use is
+    // bounded by the output buffer and the largest channel. Does not call
+    // into MGlobal so it can run on worker threads.
+    //
+    bool    convertToAsciiStreaming( size_t bufferSize );
+
 private:
     // Read header methods
     //
@@ -127,6 +137,8 @@ private:
     void    storeCacheBlock( const MString& tag, 
                         const float* value, 
                         const unsigned int& size );
+    void    appendBlock( geometryCacheBlockBase* block );
+    bool    writeAscii( std::ostream& os );
 
     // Data members
     //
@@ -134,6 +146,8 @@ private:
     MString             cacheFileName;  // The cache file name
     bool                readStatus;     // Indicates if the file was read
     cacheBlockList      blockList;      // List of read data blocks from file
+    std::ostream*       streamOut;      // Streaming output, blocks aren't kept
+    std::vector<char>   swapBuffer;     // Reused for byte swapping channel data
 };
 
 #endif
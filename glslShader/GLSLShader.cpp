@@ -47,6 +47,7 @@
 #include <maya/MUIDrawManager.h>
 
 #include <iostream>
+#include <fstream>
 #include <sstream>
 #include <algorithm>
 #include <list>
@@ -197,6 +198,201 @@ private:
     StringSet_t fBrokenEffects; // All effects that did not load correctly
 };
 
+// EffectContentCache shares compiled effects between nodes whose effect files have the same
+// content. Maya's effect cache is keyed by file name: copies of a file under other names compile
+// again, and an entry goes stale when the file is edited. Here the key is a hash of the file bytes
+// and directory (for relative includes) plus the technique and the compile macros.
+// The first node to use a technique compiles and binds it, and keeps a clone of the instance; the
+// following nodes clone that instance and reuse its pass descriptions instead of compiling and
+// binding again. When the content of a file changes, its entries in Maya's cache are flushed
+// before it is compiled again.
+// Only the effect file itself is hashed; GLSLShaderNode::reload() must be used after editing an
+// included file.
+class EffectContentCache
+{
+public:
+    struct PassInfo
+    {
+        MString drawContext;
+        bool forFatLine;
+        bool forFatPoint;
+    };
+
+    struct Entry
+    {
+        MHWRender::MShaderInstance* prototype;  // Bound successfully once, cloned for each node
+        unsigned int passCount;
+        std::vector<PassInfo> passes;
+    };
+
+    static EffectContentCache& instance()
+    {
+        static EffectContentCache s_instance;
+        return s_instance;
+    }
+
+    // Hash of the content of the effect file, or 0 when the file cannot be read.
+    // Effects with a 0 hash are not cached.
+    unsigned long long contentHash(const MString& effectName) const
+    {
+        MFileObject fileObj;
+        fileObj.setRawFullName(effectName);
+        std::ifstream file(fileObj.resolvedFullName().asChar(), std::ios::in | std::ios::binary);
+        if (!file)
+            return 0;
+
+        // 64 bit FNV-1a of the directory, then of the content
+        unsigned long long hash = 14695981039346656037ull;
+        const MString directory = fileObj.resolvedPath();
+        for (const char* c = directory.asChar(); *c; ++c)
+        {
+            hash ^= (unsigned char)*c;
+            hash *= 1099511628211ull;
+        }
+
+        char buffer[65536];
+        while (file)
+        {
+            file.read(buffer, sizeof(buffer));
+            const std::streamsize count = file.gcount();
+            for (std::streamsize i = 0; i < count; ++i)
+            {
+                hash ^= (unsigned char)buffer[i];
+                hash *= 1099511628211ull;
+            }
+        }
+        return hash ? hash : 1;
+    }
+
+    // Flush Maya's cache for the effect file if its content changed since it was last loaded.
+    void checkForChanges(const MHWRender::MShaderManager* shaderMgr, const MString& effectName, unsigned long long hash)
+    {
+        Path2HashMap_t::iterator it = fPathHashes.find(effectName);
+        if (it != fPathHashes.end() && it->second != hash)
+        {
+            shaderMgr->removeEffectFromCache(effectName, MString(), GLSLShaderNamespace::sMacros, GLSLShaderNamespace::sNbMacros);
+
+            const MStringArray* techniqueNames = techniques(it->second);
+            for (unsigned int i = 0; techniqueNames && i < techniqueNames->length(); ++i)
+                shaderMgr->removeEffectFromCache(effectName, (*techniqueNames)[i], GLSLShaderNamespace::sMacros, GLSLShaderNamespace::sNbMacros);
+        }
+
+        if (hash != 0)
+            fPathHashes[effectName] = hash;
+        else if (it != fPathHashes.end())
+            fPathHashes.erase(it);
+    }
+
+    const MStringArray* techniques(unsigned long long hash) const
+    {
+        Hash2TechniquesMap_t::const_iterator it = fTechniques.find(hash);
+        return (hash != 0 && it != fTechniques.end()) ? &it->second : NULL;
+    }
+
+    void setTechniques(unsigned long long hash, const MStringArray& techniqueNames)
+    {
+        if (hash != 0)
+            fTechniques[hash] = techniqueNames;
+    }
+
+    const Entry* find(unsigned long long hash, const MString& techniqueName) const
+    {
+        Key2EntryMap_t::const_iterator it = fEntries.find(key(hash, techniqueName));
+        return (hash != 0 && it != fEntries.end()) ? &it->second : NULL;
+    }
+
+    // Takes ownership of the entry prototype
+    void insert(unsigned long long hash, const MString& techniqueName, const Entry& entry)
+    {
+        const MString entryKey = key(hash, techniqueName);
+        Key2EntryMap_t::iterator it = fEntries.find(entryKey);
+        if (it != fEntries.end())
+        {
+            releaseShader(it->second.prototype);
+            it->second = entry;
+        }
+        else
+            fEntries.insert(std::make_pair(entryKey, entry));
+    }
+
+    // Drop everything cached for the content last loaded from this effect file
+    void forget(const MString& effectName)
+    {
+        Path2HashMap_t::iterator pathIt = fPathHashes.find(effectName);
+        if (pathIt == fPathHashes.end())
+            return;
+
+        const MString prefix = hashString(pathIt->second);
+        Key2EntryMap_t::iterator it = fEntries.begin();
+        while (it != fEntries.end())
+        {
+            if (strncmp(it->first.asChar(), prefix.asChar(), prefix.length()) == 0)
+            {
+                releaseShader(it->second.prototype);
+                fEntries.erase(it++);
+            }
+            else
+                ++it;
+        }
+
+        fTechniques.erase(pathIt->second);
+        fPathHashes.erase(pathIt);
+    }
+
+    void clear()
+    {
+        Key2EntryMap_t::iterator it = fEntries.begin();
+        for (; it != fEntries.end(); ++it)
+            releaseShader(it->second.prototype);
+
+        fEntries.clear();
+        fTechniques.clear();
+        fPathHashes.clear();
+    }
+
+private:
+    EffectContentCache()
+    {
+        for (unsigned int i = 0; i < GLSLShaderNamespace::sNbMacros; ++i)
+        {
+            fMacrosKey += GLSLShaderNamespace::sMacros[i].mName;
+            fMacrosKey += "=";
+            fMacrosKey += GLSLShaderNamespace::sMacros[i].mDefinition;
+            fMacrosKey += ";";
+        }
+    }
+
+    static MString hashString(unsigned long long hash)
+    {
+        char buffer[32];
+        sprintf(buffer, "%016llx|", hash);
+        return MString(buffer);
+    }
+
+    MString key(unsigned long long hash, const MString& techniqueName) const
+    {
+        return hashString(hash) + techniqueName + "|" + fMacrosKey;
+    }
+
+    static void releaseShader(MHWRender::MShaderInstance* shader)
+    {
+        MHWRender::MRenderer* renderer = MHWRender::MRenderer::theRenderer();
+        const MHWRender::MShaderManager* shaderMgr = renderer ? renderer->getShaderManager() : NULL;
+        if (shaderMgr && shader)
+            shaderMgr->releaseShader(shader);
+    }
+
+private:
+    typedef std::map<MString, unsigned long long, MStringSorter> Path2HashMap_t;
+    typedef std::map<unsigned long long, MStringArray> Hash2TechniquesMap_t;
+    typedef std::map<MString, Entry, MStringSorter> Key2EntryMap_t;
+
+    MString fMacrosKey;
+    Path2HashMap_t fPathHashes;         // Content hash last loaded from each effect file
+    Hash2TechniquesMap_t fTechniques;   // Technique names per content hash
+    Key2EntryMap_t fEntries;            // Compiled effects per content hash, technique and macros
+};
+
 // Convert Maya light type to glslShader light type
 static GLSLShaderNode::ELightType getLightType(const MHWRender::MLightParameterInformation* lightParam)
 {
@@ -1173,9 +1369,17 @@ bool GLSLShaderNode::loadEffect(const MString& effectName)
         return false;
     }
 
+    // Nodes using identical effect files share the compiled effect
+    EffectContentCache& contentCache = EffectContentCache::instance();
+    const unsigned long long contentHash = contentCache.contentHash(effectName);
+    contentCache.checkForChanges(shaderMgr, effectName, contentHash);
+
     // Get list of techniques
     MStringArray techniqueNames;
-    shaderMgr->getEffectsTechniques(effectName, techniqueNames, GLSLShaderNamespace::sMacros, GLSLShaderNamespace::sNbMacros);
+    if (const MStringArray* cachedTechniqueNames = contentCache.techniques(contentHash))
+        techniqueNames = *cachedTechniqueNames;
+    else
+        shaderMgr->getEffectsTechniques(effectName, techniqueNames, GLSLShaderNamespace::sMacros, GLSLShaderNamespace::sNbMacros);
     if (techniqueNames.length() == 0)
     {
         // An effect file that fails parsing at the OGSFX level will not have any techniques
@@ -1197,6 +1401,7 @@ bool GLSLShaderNode::loadEffect(const MString& effectName)
 
         return false;
     }
+    contentCache.setTechniques(contentHash, techniqueNames);
 
     // Get preferred technique
     MString techniqueName;
@@ -1220,10 +1425,26 @@ bool GLSLShaderNode::loadEffect(const MString& effectName)
     }
 
     MHWRender::MDrawContext* context = NULL;
+    MHWRender::MShaderInstance* newInstance = NULL;
+
+    // An effect with the same content was already compiled and bound successfully:
+    // start from a copy of it.
+    const EffectContentCache::Entry* cachedEffect = contentCache.find(contentHash, techniqueName);
+    if (cachedEffect)
+        newInstance = cachedEffect->prototype->clone();
+    if (!newInstance)
+        cachedEffect = NULL;
+
+    // Otherwise compile it. Maya's effect cache is keyed by file name, it was
+    // flushed above if the file content changed since it was last loaded.
+    if (!cachedEffect)
+    {
+        newInstance = shaderMgr->getEffectsFileShader(effectName, techniqueName, GLSLShaderNamespace::sMacros, GLSLShaderNamespace::sNbMacros);
+        if (!newInstance)
+            EffectCollection::instance().registerBrokenEffect(effectName);
+    }
 
-    // Do not use cache here, in case we want to recompiling a shader that has been modified after loading.
-    MHWRender::MShaderInstance* newInstance = shaderMgr->getEffectsFileShader(effectName, techniqueName, GLSLShaderNamespace::sMacros, GLSLShaderNamespace::sNbMacros);
-    if (newInstance)
+    if (newInstance && !cachedEffect)
     {   
         context = MHWRender::MRenderUtilities::acquireSwatchDrawContext();
         if(context)
@@ -1243,12 +1464,8 @@ bool GLSLShaderNode::loadEffect(const MString& effectName)
             }
         }
     }
-    else
-    {
-        EffectCollection::instance().registerBrokenEffect(effectName);
-    }
 
-    if (context)
+    if (context || cachedEffect)
     {
         // Reset current light connections, that will unlock light parameters so that their uniform attributes can be properly removed if not reused
         // Do not refresh AE, it's done on idle and the attribute may not exist anymore. The AE will be refreshed later on anyway
@@ -1272,24 +1489,54 @@ bool GLSLShaderNode::loadEffect(const MString& effectName)
         fTechniquePassCount = 0;
         fTechniquePassSpecs.clear();
 
-        fTechniquePassCount = newInstance->getPassCount(*context);
-        for (unsigned int passIndex = 0; passIndex < fTechniquePassCount; ++passIndex)
+        if (cachedEffect)
         {
-            const MString passDrawContext = newInstance->passAnnotationAsString(passIndex, glslShaderAnnotation::kDrawContext, opStatus);
-            if (STRICMP(passDrawContext.asChar(), MHWRender::MPassContext::kSelectionPassSemantic.asChar()) == 0)
-                fTechniqueIsSelectable = true;
-
-            const MString passPrimitiveFilter = newInstance->passAnnotationAsString(passIndex, glslShaderAnnotation::kPrimitiveFilter, opStatus);
-            const bool passIsForFatLine  = (STRICMP(passPrimitiveFilter.asChar(), glslShaderAnnotationValue::kFatLine) == 0);
-            const bool passIsForFatPoint = (STRICMP(passPrimitiveFilter.asChar(), glslShaderAnnotationValue::kFatPoint) == 0);
+            fTechniquePassCount = cachedEffect->passCount;
+            for (unsigned int passIndex = 0; passIndex < fTechniquePassCount; ++passIndex)
+            {
+                const EffectContentCache::PassInfo& pass = cachedEffect->passes[passIndex];
+                if (STRICMP(pass.drawContext.asChar(), MHWRender::MPassContext::kSelectionPassSemantic.asChar()) == 0)
+                    fTechniqueIsSelectable = true;
 
-            PassSpec spec = { passDrawContext, passIsForFatLine, passIsForFatPoint };
-            fTechniquePassSpecs.insert( std::make_pair(passIndex, spec) );
+                PassSpec spec = { pass.drawContext, pass.forFatLine, pass.forFatPoint };
+                fTechniquePassSpecs.insert( std::make_pair(passIndex, spec) );
+            }
         }
+        else
+        {
+            EffectContentCache::Entry entry;
+
+            fTechniquePassCount = newInstance->getPassCount(*context);
+            for (unsigned int passIndex = 0; passIndex < fTechniquePassCount; ++passIndex)
+            {
+                const MString passDrawContext = newInstance->passAnnotationAsString(passIndex, glslShaderAnnotation::kDrawContext, opStatus);
+                if (STRICMP(passDrawContext.asChar(), MHWRender::MPassContext::kSelectionPassSemantic.asChar()) == 0)
+                    fTechniqueIsSelectable = true;
+
+                const MString passPrimitiveFilter = newInstance->passAnnotationAsString(passIndex, glslShaderAnnotation::kPrimitiveFilter, opStatus);
+                const bool passIsForFatLine  = (STRICMP(passPrimitiveFilter.asChar(), glslShaderAnnotationValue::kFatLine) == 0);
+                const bool passIsForFatPoint = (STRICMP(passPrimitiveFilter.asChar(), glslShaderAnnotationValue::kFatPoint) == 0);
 
-        newInstance->unbind(*context);
-        MHWRender::MRenderUtilities::releaseDrawContext(context);
-        context = NULL;
+                PassSpec spec = { passDrawContext, passIsForFatLine, passIsForFatPoint };
+                fTechniquePassSpecs.insert( std::make_pair(passIndex, spec) );
+
+                EffectContentCache::PassInfo pass = { passDrawContext, passIsForFatLine, passIsForFatPoint };
+                entry.passes.push_back(pass);
+            }
+
+            newInstance->unbind(*context);
+            MHWRender::MRenderUtilities::releaseDrawContext(context);
+            context = NULL;
+
+            // Keep a copy for the next nodes using the same effect content
+            if (contentHash != 0)
+            {
+                entry.prototype = newInstance->clone();
+                entry.passCount = fTechniquePassCount;
+                if (entry.prototype)
+                    contentCache.insert(contentHash, techniqueName, entry);
+            }
+        }
 
         // Setup Transparency using technique annotation
         fTechniqueIsTransparent = false;
@@ -2649,6 +2896,11 @@ MStatus GLSLShaderNode::renderImage( const MPxHardwareShader::ShaderContext& sha
     return MStatus::kSuccess;
 }
 
+void GLSLShaderNode::releaseEffectCache()
+{
+    EffectContentCache::instance().clear();
+}
+
 MTypeId GLSLShaderNode::TypeID()
 {
     return m_TypeId;
@@ -2659,6 +2911,9 @@ bool GLSLShaderNode::reload()
     // Mark the effect as potentially fixed if it was previously broken:
     EffectCollection::instance().unregisterBrokenEffect(this, fEffectName);
 
+    // Included files may have changed even if the effect file did not:
+    EffectContentCache::instance().forget(fEffectName);
+
     // Reload ALL nodes using that effect. Leaving a few nodes on a seemingly working old
     // effect when the current one is broken would be misleading.
     bool result = true;
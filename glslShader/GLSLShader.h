@@ -70,6 +70,9 @@ public:
 
     static MTypeId TypeID();
 
+    // Release the compiled effects shared between nodes, see EffectContentCache
+    static void releaseEffectCache();
+
     static const MTypeId m_TypeId;
     static const MString m_TypeName;
     static const MString m_RegistrantId;
@@ -129,6 +129,8 @@ MStatus uninitializePlugin( MObject obj)
     MHWRender::MDrawRegistry::deregisterIndexBufferMutator("GLSL_PNAEN9");
     MHWRender::MDrawRegistry::deregisterIndexBufferMutator("GLSL_TRIADJ");
 
+    GLSLShaderNode::releaseEffectCache();
+
     status = plugin.deregisterNode(GLSLShaderNode::m_TypeId);
     if (status != MS::kSuccess)
     {
@@ -20,8 +20,16 @@
 #include <maya/MFnMesh.h>
 #include <maya/MHairSystem.h>
 #include <maya/MFnPlugin.h>
+#include <maya/MObjectHandle.h>
+#include <maya/MIntArray.h>
+#include <maya/MDGMessage.h>
+#include <maya/MMessage.h>
 
 #include <math.h> 
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <vector>
 
 #define kPluginName     "hairCollisionSolver"
 
@@ -87,8 +95,12 @@
 //
 // For the purposes of our simple demo plug-in, our private data will
 // consist of a COLLISION_INFO which contains an array of COLLISION_OBJ
-// structures, each one holding the bounding box of the object in world
-// space.
+// structures, each one holding the bounding box and the triangles of the
+// object in world space, along with a broad-phase grid of the triangles.
+// The grid is a uniform grid whose cells are hashed into a fixed number
+// of buckets, so it needs no more memory than the triangles themselves
+// however large the object is. The collide() callback only tests a hair
+// point against the triangles of the cells its motion goes through.
 //
 // One issue with pre-processing the data involves managing the private
 // data. A collision object could be deleted or turned off during a
@@ -114,13 +126,291 @@ typedef struct {
     double          maxx;       // Bounding box maximal extrema.
     double          maxy;       // Bounding box maximal extrema.
     double          maxz;       // Bounding box maximal extrema.
+
+    // Triangles in world space, as arrays of the first vertex (v0) and
+    // the two edges from it (e1, e2), so that they can be tested several
+    // at a time.
+    //
+    int                 numTris;
+    std::vector<float>  v0x, v0y, v0z;
+    std::vector<float>  e1x, e1y, e1z;
+    std::vector<float>  e2x, e2y, e2z;
+
+    // Broad-phase grid. The triangles overlapping the cells hashed to
+    // bucket b are cellTris[ cellStart[b] ] to cellTris[ cellStart[b+1]-1 ].
+    // Triangles overlapping more than MAX_CELLS_PER_TRIANGLE cells are
+    // listed in bigTris instead, and always tested.
+    //
+    float               cellSize;
+    unsigned int        bucketMask;
+    std::vector<int>    cellStart;
+    std::vector<int>    cellTris;
+    std::vector<int>    bigTris;
 } COLLISION_OBJ ;
 
 typedef struct {
-    int             numObjs;    // Number of collision objects.
-    COLLISION_OBJ   *objs;      // Array of per-object info.
+    int                         numObjs;    // Number of collision objects.
+    std::vector<COLLISION_OBJ>  objs;       // Array of per-object info.
 } COLLISION_INFO ;
 
+#define MAX_CELLS_PER_TRIANGLE  64
+#define MAX_QUERY_CELLS         512
+
+//
+// Private data of each hair system. It is rebuilt by preFrame() every
+// frame but kept from frame to frame, so that its arrays are reused rather
+// than allocated again. It is freed when the hair system node is removed.
+//
+// The map is keyed by the hash code of the node for the lookup, but hash
+// codes are not unique, so the entries with the same hash code are told
+// apart by comparing their handles.
+//
+typedef std::multimap<unsigned int, std::pair<MObjectHandle, COLLISION_INFO *> >
+        COLLISION_INFO_MAP;
+
+static COLLISION_INFO_MAP   collisionInfos;
+static std::mutex           collisionInfosLock;
+static MCallbackId          hairSystemRemovedId = 0;
+
+static COLLISION_INFO_MAP::iterator findCollisionInfo( const MObjectHandle &handle )
+{
+    std::pair<COLLISION_INFO_MAP::iterator, COLLISION_INFO_MAP::iterator>
+            range = collisionInfos.equal_range( handle.hashCode() );
+    for ( COLLISION_INFO_MAP::iterator it = range.first; it != range.second; ++it ) {
+        if ( it->second.first == handle ) {
+            return( it );
+        }
+    }
+    return( collisionInfos.end() );
+}
+
+static void hairSystemRemoved( MObject &node, void * )
+{
+    std::lock_guard<std::mutex> lock( collisionInfosLock );
+    COLLISION_INFO_MAP::iterator it = findCollisionInfo( MObjectHandle( node ) );
+    if ( it != collisionInfos.end() ) {
+        delete it->second.second;
+        collisionInfos.erase( it );
+    }
+}
+
+static inline int cellCoord( float x, float cellSize )
+{
+    // Clamped, for points thrown far away by an unstable simulation
+    float c = floorf( x / cellSize );
+    if ( !( c > -1.0e9f ) ) {
+        return( -1000000000 );
+    }
+    return( c < 1.0e9f ? (int) c : 1000000000 );
+}
+
+static inline unsigned int cellBucket( int ix, int iy, int iz, unsigned int mask )
+{
+    return( ( (unsigned int) ix * 73856093u ^ (unsigned int) iy * 19349663u
+            ^ (unsigned int) iz * 83492791u ) & mask );
+}
+
+//
+// Synopsis:
+//      void    buildGrid( co )
+//
+// Description:
+//      Builds the broad-phase grid of the triangles of `co'. The cells
+//  are twice the mean size of the triangles.
+//
+static void buildGrid( COLLISION_OBJ *co )
+{
+    int nt = co->numTris;
+    int t, pass;
+
+    double sumSize = 0.0;
+    for ( t = 0; t < nt; ++t ) {
+        float sx = fabsf( co->e1x[t] ) + fabsf( co->e2x[t] );
+        float sy = fabsf( co->e1y[t] ) + fabsf( co->e2y[t] );
+        float sz = fabsf( co->e1z[t] ) + fabsf( co->e2z[t] );
+        sumSize += std::max( sx, std::max( sy, sz ) );
+    }
+    co->cellSize = ( nt > 0 && sumSize > 0.0 ) ? (float) ( 2.0 * sumSize / nt ) : 1.0f;
+
+    unsigned int numBuckets = 1;
+    while ( numBuckets < 2u * (unsigned int) nt ) {
+        numBuckets <<= 1;
+    }
+    co->bucketMask = numBuckets - 1;
+    co->cellStart.assign( numBuckets + 1, 0 );
+    co->bigTris.clear();
+
+    // Count the triangles of each bucket, then fill them in.
+    //
+    std::vector<int> fill;
+    for ( pass = 0; pass < 2; ++pass ) {
+        for ( t = 0; t < nt; ++t ) {
+            float x[3] = { co->v0x[t], co->v0x[t] + co->e1x[t], co->v0x[t] + co->e2x[t] };
+            float y[3] = { co->v0y[t], co->v0y[t] + co->e1y[t], co->v0y[t] + co->e2y[t] };
+            float z[3] = { co->v0z[t], co->v0z[t] + co->e1z[t], co->v0z[t] + co->e2z[t] };
+            int lx = cellCoord( std::min( x[0], std::min( x[1], x[2] ) ), co->cellSize );
+            int ly = cellCoord( std::min( y[0], std::min( y[1], y[2] ) ), co->cellSize );
+            int lz = cellCoord( std::min( z[0], std::min( z[1], z[2] ) ), co->cellSize );
+            int hx = cellCoord( std::max( x[0], std::max( x[1], x[2] ) ), co->cellSize );
+            int hy = cellCoord( std::max( y[0], std::max( y[1], y[2] ) ), co->cellSize );
+            int hz = cellCoord( std::max( z[0], std::max( z[1], z[2] ) ), co->cellSize );
+
+            if ( ( (double) hx - lx + 1 ) * ( (double) hy - ly + 1 )
+                    * ( (double) hz - lz + 1 ) > MAX_CELLS_PER_TRIANGLE ) {
+                if ( pass == 0 ) {
+                    co->bigTris.push_back( t );
+                }
+                continue;
+            }
+
+            int ix, iy, iz;
+            for ( iz = lz; iz <= hz; ++iz ) {
+                for ( iy = ly; iy <= hy; ++iy ) {
+                    for ( ix = lx; ix <= hx; ++ix ) {
+                        unsigned int b = cellBucket( ix, iy, iz, co->bucketMask );
+                        if ( pass == 0 ) {
+                            co->cellStart[b + 1]++;
+                        } else {
+                            co->cellTris[fill[b]++] = t;
+                        }
+                    }
+                }
+            }
+        }
+
+        if ( pass == 0 ) {
+            for ( unsigned int b = 0; b < numBuckets; ++b ) {
+                co->cellStart[b + 1] += co->cellStart[b];
+            }
+            co->cellTris.resize( co->cellStart[numBuckets] );
+            fill.assign( co->cellStart.begin(), co->cellStart.end() - 1 );
+        }
+    }
+}
+
+//
+// Synopsis:
+//      void    gatherCandidates( co, lo, hi, cand )
+//
+// Description:
+//      Returns in `cand' the triangles of `co' which may overlap the box
+//  `lo' - `hi', each one once. This is every triangle if the box covers
+//  more than MAX_QUERY_CELLS cells.
+//
+static void gatherCandidates(
+                const COLLISION_OBJ *co,
+                const float         lo[3],
+                const float         hi[3],
+                std::vector<int>    &cand )
+{
+    cand.clear();
+
+    int lx = cellCoord( lo[0], co->cellSize );
+    int ly = cellCoord( lo[1], co->cellSize );
+    int lz = cellCoord( lo[2], co->cellSize );
+    int hx = cellCoord( hi[0], co->cellSize );
+    int hy = cellCoord( hi[1], co->cellSize );
+    int hz = cellCoord( hi[2], co->cellSize );
+
+    if ( ( (double) hx - lx + 1 ) * ( (double) hy - ly + 1 )
+            * ( (double) hz - lz + 1 ) > MAX_QUERY_CELLS ) {
+        cand.resize( co->numTris );
+        for ( int t = 0; t < co->numTris; ++t ) {
+            cand[t] = t;
+        }
+        return;
+    }
+
+    int ix, iy, iz;
+    for ( iz = lz; iz <= hz; ++iz ) {
+        for ( iy = ly; iy <= hy; ++iy ) {
+            for ( ix = lx; ix <= hx; ++ix ) {
+                unsigned int b = cellBucket( ix, iy, iz, co->bucketMask );
+                cand.insert( cand.end(), co->cellTris.begin() + co->cellStart[b],
+                        co->cellTris.begin() + co->cellStart[b + 1] );
+            }
+        }
+    }
+    cand.insert( cand.end(), co->bigTris.begin(), co->bigTris.end() );
+
+    std::sort( cand.begin(), cand.end() );
+    cand.erase( std::unique( cand.begin(), cand.end() ), cand.end() );
+}
+
+//
+// Synopsis:
+//      int     firstHit( co, cand, o, d, tHit, scratch )
+//
+// Description:
+//      Intersects the motion `o' + t * `d', t in [0,1], with the triangles
+//  `cand' of `co'. The triangles are first copied to `scratch' so that the
+//  intersection tests run on contiguous floats, in a loop without
+//  branches which the compiler vectorizes.
+//
+// Returns:
+//      int                 : The triangle hit first, its t in `tHit', or
+//                            -1 if none is hit.
+//
+static int firstHit(
+                const COLLISION_OBJ     *co,
+                const std::vector<int>  &cand,
+                const float             o[3],
+                const float             d[3],
+                float                   &tHit,
+                std::vector<float>      &scratch )
+{
+    const int n = (int) cand.size();
+    scratch.resize( 10 * (size_t) n );
+    float *v0x = &scratch[0],     *v0y = v0x + n, *v0z = v0y + n;
+    float *e1x = v0z + n,         *e1y = e1x + n, *e1z = e1y + n;
+    float *e2x = e1z + n,         *e2y = e2x + n, *e2z = e2y + n;
+    float *tt  = e2z + n;
+
+    int i;
+    for ( i = 0; i < n; ++i ) {
+        int t = cand[i];
+        v0x[i] = co->v0x[t]; v0y[i] = co->v0y[t]; v0z[i] = co->v0z[t];
+        e1x[i] = co->e1x[t]; e1y[i] = co->e1y[t]; e1z[i] = co->e1z[t];
+        e2x[i] = co->e2x[t]; e2y[i] = co->e2y[t]; e2z[i] = co->e2z[t];
+    }
+
+    // Moller-Trumbore, for the segment rather than the ray.
+    //
+    const float ox = o[0], oy = o[1], oz = o[2];
+    const float dx = d[0], dy = d[1], dz = d[2];
+    for ( i = 0; i < n; ++i ) {
+        float px = dy * e2z[i] - dz * e2y[i];
+        float py = dz * e2x[i] - dx * e2z[i];
+        float pz = dx * e2y[i] - dy * e2x[i];
+        float det = e1x[i] * px + e1y[i] * py + e1z[i] * pz;
+        bool  ok = fabsf( det ) > 1e-12f;
+        float inv = 1.0f / ( ok ? det : 1.0f );
+
+        float sx = ox - v0x[i], sy = oy - v0y[i], sz = oz - v0z[i];
+        float u = ( sx * px + sy * py + sz * pz ) * inv;
+
+        float qx = sy * e1z[i] - sz * e1y[i];
+        float qy = sz * e1x[i] - sx * e1z[i];
+        float qz = sx * e1y[i] - sy * e1x[i];
+        float v = ( dx * qx + dy * qy + dz * qz ) * inv;
+        float t = ( e2x[i] * qx + e2y[i] * qy + e2z[i] * qz ) * inv;
+
+        bool hit = ok && u >= 0.0f && v >= 0.0f && u + v <= 1.0f
+                && t >= 0.0f && t <= 1.0f;
+        tt[i] = hit ? t : 2.0f;
+    }
+
+    int first = -1;
+    tHit = 2.0f;
+    for ( i = 0; i < n; ++i ) {
+        if ( tt[i] < tHit ) {
+            tHit = tt[i];
+            first = cand[i];
+        }
+    }
+    return( first );
+}
+
 //
 // Synopsis:
 //      bool    preFrame( hairSystem, curTime, privateData )
@@ -169,8 +459,9 @@ bool        preFrame(
     // processed data is on a typed attribute on the hairSystem node.
     // That data could be fetched and updated here.
     //
-    // In our example, we'll just compute a bounding box here and NOT use
-    // attribute storage. That is an exercise for the reader.
+    // In our example, we'll just compute a bounding box and a grid of the
+    // triangles here and NOT use attribute storage. That is an exercise
+    // for the reader.
     //
     MFnDependencyNode fnHairSystem( hairSystem, &status );
     CHECK_MSTATUS_AND_RETURN( status, false );
@@ -183,31 +474,31 @@ bool        preFrame(
             cols, logIdxs ), false );
     int nobj = cols.length();
 
-    // Allocate private data.
-    // This allows us to pre-process data on a pre-frame basis to avoid
-    // calculating it per hair inside the collide() call. As noted earlier
-    // we could allocate this in preFrame() and hang it off the hairSystem
-    // node via a dynamic attribute.
-    // Instead we'll allocate it here.
-    //
-    COLLISION_INFO *collisionInfo = (COLLISION_INFO *) malloc(
-            sizeof( COLLISION_INFO ) );
-    collisionInfo->objs = (COLLISION_OBJ *) malloc(
-            nobj * sizeof( COLLISION_OBJ ) );
-    collisionInfo->numObjs = nobj;
-
-    // Create the private data that we'll make available to the collide
-    // method. The data should actually be stored in a way that it can
-    // be cleaned up (such as storing the pointer on the hairSystem node
-    // using a dynamic attribute). As it stands right now, there is a
-    // memory leak with this plug-in because the memory we're allocating
-    // for the private data is never cleaned up.
+    // Get the private data of this hair system, allocating it the first
+    // time. This allows us to pre-process data on a pre-frame basis to
+    // avoid calculating it per hair inside the collide() call. As noted
+    // earlier we could hang it off the hairSystem node via a dynamic
+    // attribute. Instead we keep it in collisionInfos, and free it when
+    // the hair system is removed or the plug-in is unloaded.
     //
     // Note that when using the dynamic attribute approach, it is still
     // wise to set *privateData because this avoids the need to look up
     // the plug inside the collide() routine which is a high-traffic
     // method.
     //
+    COLLISION_INFO *collisionInfo;
+    {
+        std::lock_guard<std::mutex> lock( collisionInfosLock );
+        MObjectHandle handle( hairSystem );
+        COLLISION_INFO_MAP::iterator it = findCollisionInfo( handle );
+        if ( it == collisionInfos.end() ) {
+            it = collisionInfos.insert( std::make_pair( handle.hashCode(),
+                    std::make_pair( handle, new COLLISION_INFO ) ) );
+        }
+        collisionInfo = it->second.second;
+    }
+    collisionInfo->objs.resize( nobj );
+    collisionInfo->numObjs = nobj;
     *privateData = (void *) collisionInfo;
 
     // Loop through the collision objects and pre-process, storing the
@@ -215,6 +506,10 @@ bool        preFrame(
     //
     int    obj;
     for ( obj = 0; obj < nobj; ++obj ) {
+        COLLISION_OBJ *co = &collisionInfo->objs[obj];
+        co->numVerts = 0;
+        co->numTris = 0;
+
         // Get the ith collision geometry we are connected to.
         //
         MObject colObj = cols[obj];
@@ -240,16 +535,18 @@ bool        preFrame(
         MFloatPointArray    verts;
         status = fnMesh.getPoints( verts, MSpace::kWorld );
         CHECK_MSTATUS_AND_RETURN( status, false );
+        int nv = verts.length();
+        if ( nv == 0 ) {
+            continue;
+        }
 
-        // Compute the bounding box for the collision object.
-        // As this is a quick and dirty demo, we'll just support collisions
-        // between hair and the bbox.
+        // Compute the bounding box for the collision object, which
+        // rejects the hair points far from it before the grid is queried.
         //
         double minx, miny, minz, maxx, maxy, maxz, x, y, z;
         minx = maxx = verts[0].x;
         miny = maxy = verts[0].y;
         minz = maxz = verts[0].z;
-        int nv = verts.length();
         int i;
         for ( i = 1; i < nv; ++i ) {
             x = verts[i].x;
@@ -280,46 +577,41 @@ bool        preFrame(
         // Store this precomputed informantion into our private data
         // structure.
         //
-        collisionInfo->objs[obj].numVerts = nv;
-        collisionInfo->objs[obj].minx = minx;
-        collisionInfo->objs[obj].miny = miny;
-        collisionInfo->objs[obj].minz = minz;
-        collisionInfo->objs[obj].maxx = maxx;
-        collisionInfo->objs[obj].maxy = maxy;
-        collisionInfo->objs[obj].maxz = maxz;
+        co->numVerts = nv;
+        co->minx = minx;
+        co->miny = miny;
+        co->minz = minz;
+        co->maxx = maxx;
+        co->maxy = maxy;
+        co->maxz = maxz;
         fprintf( stderr, "Inside preFrameInit, bbox=%g %g %g %g %g %g\n",
                 minx,miny,minz,maxx,maxy,maxz);
+
+        // Store the triangles, and build the grid of them.
+        //
+        MIntArray triCounts, triVerts;
+        status = fnMesh.getTriangles( triCounts, triVerts );
+        CHECK_MSTATUS_AND_RETURN( status, false );
+        int nt = triVerts.length() / 3;
+        co->numTris = nt;
+        co->v0x.resize( nt ); co->v0y.resize( nt ); co->v0z.resize( nt );
+        co->e1x.resize( nt ); co->e1y.resize( nt ); co->e1z.resize( nt );
+        co->e2x.resize( nt ); co->e2y.resize( nt ); co->e2z.resize( nt );
+        int t;
+        for ( t = 0; t < nt; ++t ) {
+            const MFloatPoint &a = verts[triVerts[3 * t]];
+            const MFloatPoint &b = verts[triVerts[3 * t + 1]];
+            const MFloatPoint &c = verts[triVerts[3 * t + 2]];
+            co->v0x[t] = a.x;       co->v0y[t] = a.y;       co->v0z[t] = a.z;
+            co->e1x[t] = b.x - a.x; co->e1y[t] = b.y - a.y; co->e1z[t] = b.z - a.z;
+            co->e2x[t] = c.x - a.x; co->e2y[t] = c.y - a.y; co->e2z[t] = c.z - a.z;
+        }
+        buildGrid( co );
     }
 
     return( true );
 }
 
-//
-// Synopsis:
-//      bool    belowCollisionPlane( co, pnt )
-//
-// Description:
-//      Test if `pnt' is directly below the collision plane of `co'.
-//
-// Parameters:
-//      COLLISION_OBJ   *co : (in)  The collision object to test against.
-//      MVector         &pnt: (in)  Point to test.
-//
-// Returns:
-//      bool    true        : The `pnt' is directly below the collision
-//                            plane specified by `co'.
-//      bool    false       : The `pnt' is not directly below the collis-
-//                            ion plane specified by `co'.
-//
-
-
-bool    belowCollisionPlane( const COLLISION_OBJ *co, const MVector &pnt )
-{
-    return(    pnt.x > co->minx && pnt.x < co->maxx
-                                && pnt.y < co->maxy
-            && pnt.z > co->minz && pnt.z < co->maxz );
-}
-
 //
 // Synopsis:
 //      MStatus collide( hairSystem, follicleIndex, hairPositions,
@@ -410,7 +702,7 @@ bool    collide(
     // Get the private data for the collision objects which was returned
     // from preFrame().
     //
-    COLLISION_INFO *ci = (COLLISION_INFO *) privateData;
+    const COLLISION_INFO *ci = (const COLLISION_INFO *) privateData;
     if ( !ci ) {
         fprintf( stderr,"%s:%d: collide() privateData pointer is NULL\n",
                 __FILE__, __LINE__ );
@@ -428,218 +720,104 @@ bool    collide(
         return( true );
     }
 
+    // collide() only reads the private data, and keeps its scratch
+    // arrays per thread, so that several follicles can be processed at
+    // the same time.
+    //
+    static thread_local std::vector<int>    cand;
+    static thread_local std::vector<float>  scratch;
+
+    int     numPoints = hairPositions.length();
+    int     first = std::max( startIndex, 0 );
+    int     last = std::min( endIndex, numPoints - 1 );
+
     int     obj;
     for ( obj = 0; obj < ci->numObjs; ++obj ) {
-        COLLISION_OBJ *co = &ci->objs[obj];
+        const COLLISION_OBJ *co = &ci->objs[obj];
+        if ( co->numTris == 0 ) {
+            continue;
+        }
 
-        // For our plug-in example, we just collide the segments of the
-        // hair against the top of the bounding box for the geometry.
-        // In an implementation where you only care about hair falling
-        // downwards onto flat objects, this might be OK. However, in the
-        // most deluxe of implementation, you should do the following:
+        // Each point of the hair we can move is swept from where it was
+        // at the previous time to where the solver wants it:
         //
-        //      o  Determine the motion of each face of your collision
-        //         object during the time range.
-        //      o  Step through the follicle, and consider each segment
-        //         to be a moving cylinder where the start and end radii
-        //         can differ. The radii come from `hairWidths' and the
-        //         motion comes from the difference between `hairPositions'
-        //         and `hairPositionsLast'.
-        //      o  Intersect each moving element (e.g. moving triangle
-        //         if you have a mesh obect) with each hair segment
-        //         e.g. moving cylinder). This intersection may occur
-        //         at a point within the frame. (Remember that the
-        //         hairPositions[] array holds the DESIRED location where
-        //         the hair system wants the hair to go.
-        //      o  There can be multiple collisions along a hair segment.
-        //         Use the first location found and the maximal velocity.
+        //      P = hairPositions       // Desired pos'n at cur frame.
+        //      L = hairPositionsLast   // Position at prev frame.
+        //      V = P - L               // Desired velocity of hair.
         //
-        // If a collision is detected, the `hairPositions' array should be
-        // updated. `hairPositionsLast' may also be updated to provide a
-        // dampening effect only.
-        //
-
-        // Loop through the follicle, starting at the root and advancing
-        // toward the tip.
+        // and the segment L -> P is intersected with the triangles of the
+        // collision object, which we assume to be static over the frame.
+        // This catches the points that would go through the surface
+        // whatever its thickness, which sampling the positions cannot.
         //
-        int     numSegments = hairPositions.length() - 1;
-        int     seg;
-        for ( seg = 0; seg < numSegments; ++seg ) {
-            // Get the desired position of the segment (i.e. where the
-            // solver is trying to put the hair for the current frame)
-            // and the velocity required to get to that desired position.
+        int     pnt;
+        for ( pnt = first; pnt <= last; ++pnt ) {
+            MVector p = hairPositions[pnt];
+            MVector l = hairPositionsLast[pnt];
+            MVector v = p - l;
+            double  radius = ( pnt < (int) hairWidths.length() )
+                    ? 0.5 * hairWidths[pnt] : 0.0;
+
+            // Skip the points whose motion misses the bounding box.
             //
-            // Thus,
-            //      P = hairPositions       // Desired pos'n at cur frame.
-            //      L = hairPositionsLast   // Position at prev frame.
-            //      V = P - L               // Desired velocity of hair.
-            //
-            MVector pStart = hairPositions[seg];
-            MVector pEnd = hairPositions[seg + 1];
-
-            MVector vStart = pStart - hairPositionsLast[seg];
-            MVector vEnd = pEnd - hairPositionsLast[seg + 1];
-
-            // The proper way to time sample is to intersect the moving
-            // segment of width `hairWidths[seg] to hairWidths[seg + 1]'
-            // with the moving collision object. For the purposes of our
-            // demo plug-in, we will simply assume the collision object is
-            // static, the hair segment has zero width, and instead of
-            // intersecting continuously in time, we will sample discrete
-            // steps along the segment.
+            if (       std::max( p.x, l.x ) + radius < co->minx
+                    || std::max( p.y, l.y ) + radius < co->miny
+                    || std::max( p.z, l.z ) + radius < co->minz
+                    || std::min( p.x, l.x ) - radius > co->maxx
+                    || std::min( p.y, l.y ) - radius > co->maxy
+                    || std::min( p.z, l.z ) - radius > co->maxz ) {
+                continue;
+            }
+
+            // Broad-phase: the triangles in the cells around the motion.
             //
-            #define STEPS 4
-            int     step;
-            for ( step = 0; step < STEPS; ++step ) {
-                // Compute the point for this step and its corresponding
-                // velocity. This is a "time swept" point:
-                //  p1 = desired position at current time
-                //  p0 = position at previous time to achieve desired pos
-                //
-                MVector pCur, pPrev, v;
-                double fracAlongSeg = step / ( (double) STEPS );
-                v = vStart * ( 1.0 - fracAlongSeg ) + vEnd * fracAlongSeg;
-                MVector p1 = pStart * ( 1.0 - fracAlongSeg )
-                        + pEnd * fracAlongSeg;
-                MVector p0 = p1 - v;
-
-                // See if BOTH endpoints are outside of the bounding box
-                // on the same side. If so, then the segment cannot
-                // intersect the bounding box. Note that we assume the
-                // bounding box is static.
-                //
-                if (       (p0.x < co->minx && p1.x < co->minx)
-                        || (p0.y < co->miny && p1.y < co->miny)
-                        || (p0.z < co->minz && p1.z < co->minz)
-                        || (p0.x > co->maxx && p1.x > co->maxx)
-                        || (p0.y > co->maxy && p1.y > co->maxy)
-                        || (p0.z > co->maxz && p1.z > co->maxz) ) {
-                    continue;
-                }
+            float lo[3] = { (float) ( std::min( p.x, l.x ) - radius ),
+                            (float) ( std::min( p.y, l.y ) - radius ),
+                            (float) ( std::min( p.z, l.z ) - radius ) };
+            float hi[3] = { (float) ( std::max( p.x, l.x ) + radius ),
+                            (float) ( std::max( p.y, l.y ) + radius ),
+                            (float) ( std::max( p.z, l.z ) + radius ) };
+            gatherCandidates( co, lo, hi, cand );
+            if ( cand.empty() ) {
+                continue;
+            }
 
-                // For the purposes of this example plug-in, we'll assume
-                // the hair always moves downwards (due to gravity and
-                // thus in the negative Y direction). As such, we only
-                // need to test for collisions with the TOP of the
-                // bounding box. Expanding the example to all 6 sides is
-                // left as an exercise for the reader.
-                //
-                // Remember that p1 is the point at current time, and
-                // p0 is the point at the previous time. Since we assume
-                // the bounding box to be static, this simplifies things.
-                //
-                MVector where(-100000,-100000,-100000); // Loc'n of collision
-                double  fracTime;   // Time at which collision happens 0..1
-
-                if ( fabs( v.y ) < EPSILON      // velocity is zero
-                        && fabs( p1.y - co->maxy ) < EPSILON ) {    // right on the bbox
-                    // Velocity is zero and the desired location (p1) is
-                    // right on top of the bounding box.
-                    //
-                    where = p1;
-                    fracTime = 1.0;     // Collides right at end;
-                } else {
-                    fracTime = ( co->maxy -  p0.y ) / v.y;
-                    if ( fracTime >= 0.0 && fracTime <= 1.0 ) {
-                        // Compute the collision of the swept point with the
-                        // plane defined by the top of the bounding box.
-                        //
-                        where = p0 + v * fracTime;
-                    }
-                }
+            float o[3] = { (float) l.x, (float) l.y, (float) l.z };
+            float d[3] = { (float) v.x, (float) v.y, (float) v.z };
+            float fracTime;     // Time at which collision happens 0..1
+            int tri = firstHit( co, cand, o, d, fracTime, scratch );
+            if ( tri < 0 ) {
+                continue;
+            }
 
-                // If `seg' lies between startIndex and endIndex
-                // we can move it. If its <= startIndex, the root is
-                // locked and if >= endIndex the tip is locked.
-                //
-                if ( seg >= startIndex && seg <= endIndex ) {
-                    // Since we are just colliding with the top of the
-                    // bounding box, the normal where we hit is (0,1,0).
-                    // For the object velocity, we SHOULD measure the
-                    // relative motion of the object during the time
-                    // interval, but for our example, we'll assume its
-                    // not moving (0,0,0).
-                    //
-                    bool segCollides = false;
-                    MVector normal(0.0,1.0,0.0);    // normal is always up
-                    MVector objectVel(0.0,0.0,0.0); // assume bbox is static
-
-                    // If we get the this point, then the intersection
-                    // point `where' is on the plane of the bounding box
-                    // top. See if it lies within the actual bounds of the
-                    // boxtop, and if so compute the position and velocity
-                    // information and apply to the hair segment.
-                    //
-                    if ( where.x >= co->minx && where.x <= co->maxx
-                            && where.z >= co->minz && where.z <= co->maxz
-                            && fracTime >= 0.0 && fracTime <= 0.0 ) {
-                        // We have a collision at `where' with the plane.
-                        // Compute the new velocity for the hair at the
-                        // point of collision.
-                        //
-                        MVector objVelAlongNormal = (objectVel * normal)
-                                * normal;
-                        MVector objVelAlongTangent = objectVel
-                                - objVelAlongNormal;
-                        MVector pntVelAlongTangent = v - ( v * normal )
-                                * normal;
-                        MVector reflectedPntVelAlongTangent
-                                = pntVelAlongTangent * ( 1.0 - friction )
-                                + objVelAlongTangent * friction;
-                        MVector newVel = objVelAlongNormal
-                                + reflectedPntVelAlongTangent;
-
-                        // Update the hair position. It actually looks
-                        // more stable from a simulation standpoint to
-                        // just move the closest segment endpoint, but
-                        // you are free to experiment. What we'll do in
-                        // our example is move the closest segment end-
-                        // point by the amount the collided point (where)
-                        // has to move to have velocity `newVel' yet still
-                        // pass through `where' at time `fracTime'.
-                        //
-                        if ( fracAlongSeg > 0.5 ) {
-                            MVector deltaPos = -newVel * fracTime;
-                            hairPositionsLast[seg + 1] += deltaPos;
-                            hairPositions[seg + 1] = hairPositionsLast[seg]
-                                    + newVel;
-                        } else {
-                            MVector deltaPos = newVel * fracTime;
-                            hairPositionsLast[seg] += deltaPos;
-                            hairPositions[seg] = hairPositionsLast[seg]
-                                    + newVel;
-                        }
-                        segCollides = true;
-                    }
+            // The normal of the triangle, on the side the point comes
+            // from. For the object velocity, we SHOULD measure the
+            // relative motion of the object during the time interval,
+            // but for our example, we'll assume its not moving (0,0,0).
+            //
+            MVector e1( co->e1x[tri], co->e1y[tri], co->e1z[tri] );
+            MVector e2( co->e2x[tri], co->e2y[tri], co->e2z[tri] );
+            MVector normal = e1 ^ e2;
+            normal.normalize();
+            if ( normal * v > 0.0 ) {
+                normal = -normal;
+            }
+            MVector where = l + v * fracTime;   // Loc'n of collision
 
-                    // Check for segment endpoints that may still be
-                    // inside. Note that segments which started out being
-                    // totally inside will never collide using the
-                    // algorithm we use above, so we'll simply clamp them
-                    // here. One might expect an inside-the-bounding-box
-                    // test instead. However, this does not work if the
-                    // collision object is a very thin object.
-                    //
-                    bool inside = false;
-                    if ( belowCollisionPlane( co, hairPositions[seg] ) ) {
-                        hairPositions[seg].y = co->maxy + EPSILON;
-                        hairPositionsLast[seg] = hairPositions[seg] - objectVel;
-                        inside = true;
-                    }
-                    if ( belowCollisionPlane( co, hairPositions[seg+1] ) ) {
-                        hairPositions[seg+1].y = co->maxy + EPSILON;
-                        hairPositionsLast[seg+1] = hairPositions[seg+1] - objectVel;
-                        inside = true;
-                    }
+            // Compute the new velocity for the hair at the point of
+            // collision: the motion along the normal is stopped, and the
+            // motion along the surface is reduced by friction.
+            //
+            MVector pntVelAlongTangent = v - ( v * normal ) * normal;
+            MVector newVel = pntVelAlongTangent * ( 1.0 - friction );
 
-                    // If we collided, go onto the next segment.
-                    //
-                    if ( segCollides || inside ) {
-                        goto nextSeg;
-                    }
-                }
-            }
-nextSeg:;
+            // Update the hair position: it slides along the surface for
+            // the rest of the time interval, kept off it by its width.
+            // `hairPositionsLast' is only updated to dampen the velocity.
+            //
+            hairPositions[pnt] = where + normal * ( radius + EPSILON )
+                    + newVel * ( 1.0 - fracTime );
+            hairPositionsLast[pnt] = hairPositions[pnt] - newVel;
         }
     }
 
@@ -677,6 +855,11 @@ MStatus initializePlugin( MObject obj )
     CHECK_MSTATUS( MHairSystem::registerCollisionSolverCollide( collide ) );
     CHECK_MSTATUS( MHairSystem::registerCollisionSolverPreFrame( preFrame ) );
 
+    MStatus status;
+    hairSystemRemovedId = MDGMessage::addNodeRemovedCallback(
+            hairSystemRemoved, "hairSystem", NULL, &status );
+    CHECK_MSTATUS( status );
+
     return( MS::kSuccess );
 }
 
@@ -703,5 +886,16 @@ MStatus uninitializePlugin( MObject obj )
     CHECK_MSTATUS( MHairSystem::unregisterCollisionSolverCollide() );
     CHECK_MSTATUS( MHairSystem::unregisterCollisionSolverPreFrame() );
 
+    if ( hairSystemRemovedId ) {
+        CHECK_MSTATUS( MMessage::removeCallback( hairSystemRemovedId ) );
+        hairSystemRemovedId = 0;
+    }
+
+    COLLISION_INFO_MAP::iterator it;
+    for ( it = collisionInfos.begin(); it != collisionInfos.end(); ++it ) {
+        delete it->second.second;
+    }
+    collisionInfos.clear();
+
     return( MS::kSuccess );
 }
@@ -39,6 +39,18 @@ public:
     const byte *getPixelMap () const;
     const float *getDepthMap () const;
 
+    // Whole image access to the data decoded by readImage (), without
+    // copying. The pointers stay valid until close (). Rows are stored top
+    // to bottom and the strides are in bytes.
+    MStatus getPixelMap (const byte *&pixels, int &pixelStride,
+                         int &rowStride) const;
+    MStatus getDepthMap (const float *&depth, int &rowStride) const;
+
+    // Position of each channel within a pixel of the pixel map, counted in
+    // channels of getBytesPerChannel () bytes. 16 bit channels are stored
+    // most significant byte first.
+    static void getChannelOrder (int &r, int &g, int &b, int &a);
+
 protected:
     ILimage *fImage;
     byte *fBuffer;
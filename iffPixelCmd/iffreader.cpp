@@ -163,6 +163,22 @@ MStatus IFFimageReader::readImage ()
     return MS::kSuccess;
 }
 
+void IFFimageReader::getChannelOrder (int &r, int &g, int &b, int &a)
+{
+    // On IRIX pixels are stored as ABGR and on NT as BGRA
+#if     defined(_WIN32) || defined(__linux__)
+    r = 2;
+    g = 1;
+    b = 0;
+    a = 3;
+#else
+    r = 3;
+    g = 2;
+    b = 1;
+    a = 0;
+#endif
+}
+
 MStatus IFFimageReader::getPixel (int x, int y, int *r, int *g, int *b,
                                   int *a)
 {
@@ -172,49 +188,19 @@ MStatus IFFimageReader::getPixel (int x, int y, int *r, int *g, int *b,
     ILgetsize (fImage, &width, &height);
     if (x >= width || y >= height || x < 0 || y < 0)
         return MS::kFailure;
+    int order [4];
+    getChannelOrder (order [0], order [1], order [2], order [3]);
+    int *values [4] = { r, g, b, a };
     if (ILgetbpp (fImage) == 2) {
-        int *ptr = (int *)&fBuffer [(y * width + x) * 4];
-        // On IRIX pixels are stored as ABGR and on NT as BGRA
-#if     defined(_WIN32) || defined(__linux__)
-        if (NULL != r)
-            *r = ptr [2];
-        if (NULL != g)
-            *g = ptr [1];
-        if (NULL != b)
-            *b = ptr [0];
-        if (NULL != a)
-            *a = ptr [3];
-#else
-        if (NULL != r)
-            *r = ptr [3];
-        if (NULL != g)
-            *g = ptr [2];
-        if (NULL != b)
-            *b = ptr [1];
-        if (NULL != a)
-            *a = ptr [0];
-#endif
+        const byte *ptr = &fBuffer [(y * width + x) * 8];
+        for (int c = 0; c < 4; c++)
+            if (NULL != values [c])
+                *values [c] = ((int)ptr [order [c] * 2] << 8) + (int)ptr [order [c] * 2 + 1];
     } else {
-        byte *ptr = &fBuffer [(y * width + x) * 4];
-#if     defined(_WIN32) || defined(__linux__)
-        if (NULL != r)
-            *r = ptr [2];
-        if (NULL != g)
-            *g = ptr [1];
-        if (NULL != b)
-            *b = ptr [0];
-        if (NULL != a)
-            *a = ptr [3];
-#else
-        if (NULL != r)
-            *r = ptr [3];
-        if (NULL != g)
-            *g = ptr [2];
-        if (NULL != b)
-            *b = ptr [1];
-        if (NULL != a)
-            *a = ptr [0];
-#endif
+        const byte *ptr = &fBuffer [(y * width + x) * 4];
+        for (int c = 0; c < 4; c++)
+            if (NULL != values [c])
+                *values [c] = ptr [order [c]];
     }
     return MS::kSuccess;
 }
@@ -249,3 +235,25 @@ const float *IFFimageReader::getDepthMap () const
 {
     return fZBuffer;
 }
+
+MStatus IFFimageReader::getPixelMap (const byte *&pixels, int &pixelStride,
+                                     int &rowStride) const
+{
+    int width,height;
+    if (NULL == fBuffer || ILgetsize (fImage, &width, &height))
+        return MS::kFailure;
+    pixels = fBuffer;
+    pixelStride = 4 * ILgetbpp (fImage);
+    rowStride = width * pixelStride;
+    return MS::kSuccess;
+}
+
+MStatus IFFimageReader::getDepthMap (const float *&depth, int &rowStride) const
+{
+    int width,height;
+    if (NULL == fZBuffer || ILgetsize (fImage, &width, &height))
+        return MS::kFailure;
+    depth = fZBuffer;
+    rowStride = width * (int) sizeof (float);
+    return MS::kSuccess;
+}
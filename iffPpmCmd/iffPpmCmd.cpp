@@ -17,6 +17,17 @@
 // This command takes as arguments the names of an existing IFF file and the name of a PPM (portable pixmap)
 // file that it must create. The IFF image is read and written out in PPM format to the second file.
 // For example: "iffPpm sphere.iff sphere.ppm".
+//
+// Optional flags after the file names:
+//
+//     -depth    write the depth map instead of the colors
+//     -binary   write a binary (P6) pixmap instead of the ASCII (P3) one
+//     -pfm      write a floating point PFM file; colors are scaled to 0-1
+//               and depth is written as the real depth, 0 where empty
+//
+// The pixel map is converted in bands of scanlines. The bands are
+// converted in parallel and written to the file in order, so only a few
+// bands of output are held in memory at once.
 // 
 
 #include <maya/MPxCommand.h>
@@ -28,10 +39,16 @@
 #include <maya/MString.h>
 #include <maya/MPoint.h>
 #include <float.h>
+#include <stdio.h>
 #include "iffreader.h"
 
+#include <tbb/parallel_for.h>
+
 #include <iostream>
 #include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
 
 #define IFFCHECKERR(stat, call) \
 if (!stat) { \
@@ -59,6 +76,8 @@ private:
     MString     ppmFile;
     MString     fileName;
     bool        useDepth;
+    bool        useBinary;
+    bool        useFloat;
 };
 
 iffPpm::iffPpm()
@@ -92,29 +111,135 @@ MString itoa (int n)
 MStatus iffPpm::doIt( const MArgList& args )
 {
     MString componentName;
-    if (args.length () < 2 || args.length () > 3) {
-        displayError ("Syntax: iffPpm ifffile ppmfile [-depth]");
+    if (args.length () < 2 || args.length () > 5) {
+        displayError ("Syntax: iffPpm ifffile ppmfile [-depth] [-binary] [-pfm]");
         return MS::kFailure;
     }
 
     args.get (0, fileName);
     args.get (1, ppmFile);
-    if (args.length () == 3)
+    useDepth = false;
+    useBinary = false;
+    useFloat = false;
+    for (unsigned int i = 2; i < args.length (); i++)
     {
-        MString lastArg;
-        args.get (2, lastArg);
-        if (lastArg != MString ("-depth")) {
-            displayError ("Syntax: iffPpm ifffile ppmfile [-depth]");
+        MString arg;
+        args.get (i, arg);
+        if (arg == MString ("-depth"))
+            useDepth = true;
+        else if (arg == MString ("-binary"))
+            useBinary = true;
+        else if (arg == MString ("-pfm"))
+            useFloat = true;
+        else {
+            displayError ("Syntax: iffPpm ifffile ppmfile [-depth] [-binary] [-pfm]");
             return MS::kFailure;
         }
-        useDepth = true;
     }
-    else
-        useDepth = false;
 
     return redoIt();
 }
 
+//
+// Everything needed to convert one scanline of the image
+//
+struct ppmSource
+{
+    int             width;
+    int             height;
+    bool            useDepth;
+    bool            useBinary;
+    bool            useFloat;
+
+    // Pixel map
+    const byte      *pixels;
+    int             pixelStride;
+    int             rowStride;
+    int             bytesPerChannel;
+    int             order [3];          // r, g and b channel positions
+
+    // Depth map
+    const float     *depth;
+    int             depthStride;
+    float           scaleFactor;
+    float           offset;
+};
+
+static void appendText (std::string &dst, int r, int g, int b)
+{
+    char buffer [64];
+    int length = snprintf (buffer, sizeof (buffer), "%d %d %d\n", r, g, b);
+    dst.append (buffer, length);
+}
+
+static void appendFloat (std::string &dst, float value)
+{
+    dst.append ((const char *) &value, sizeof (float));
+}
+
+//
+// Append the converted scanline y (counted from the top) to dst
+//
+static void convertRow (const ppmSource &src, int y, std::string &dst)
+{
+    if (src.useDepth) {
+        const float *entry = (const float *) ((const char *) src.depth + (size_t) y * src.depthStride);
+        for (int x = 0; x < src.width; x++, entry++)
+        {
+            if (src.useFloat)
+                appendFloat (dst, (*entry == 0.) ? 0.0f : -1.0f / *entry);
+            else if (*entry == 0.) {
+                if (src.useBinary)
+                    dst.append (3, '\0');
+                else
+                    dst.append ("0 0 0\n");
+            }
+            else {
+                float realDepth = -src.scaleFactor / *entry - src.offset;
+                if (src.useBinary) {
+                    int value = (int) realDepth;
+                    char c = (char) (value < 0 ? 0 : (value > 255 ? 255 : value));
+                    dst.append (3, c);
+                }
+                else
+                    appendText (dst, (int) realDepth, (int) realDepth, (int) realDepth);
+            }
+        }
+        return;
+    }
+
+    // Note that if the image was greyscale then the ILload
+    // function will have expanded the grey into rgb now.
+    const byte *pixel = src.pixels + (size_t) y * src.rowStride;
+    float scale = (src.bytesPerChannel == 1) ? 1.0f / 255.0f : 1.0f / 65535.0f;
+    for (int x = 0; x < src.width; x++, pixel += src.pixelStride)
+    {
+        int rgb [3];
+        for (int c = 0; c < 3; c++)
+        {
+            if (src.bytesPerChannel == 1)
+                rgb [c] = pixel [src.order [c]];
+            else // 16 bit
+                rgb [c] = ((int) pixel [src.order [c] * 2] << 8) + (int) pixel [src.order [c] * 2 + 1];
+        }
+
+        if (src.useFloat) {
+            for (int c = 0; c < 3; c++)
+                appendFloat (dst, rgb [c] * scale);
+        }
+        else if (src.useBinary) {
+            for (int c = 0; c < 3; c++)
+            {
+                if (src.bytesPerChannel != 1)
+                    dst += (char) (rgb [c] >> 8);
+                dst += (char) (rgb [c] & 255);
+            }
+        }
+        else
+            appendText (dst, rgb [0], rgb [1], rgb [2]);
+    }
+}
+
 MStatus iffPpm::redoIt()
 {
     clearResult();
@@ -134,105 +259,128 @@ MStatus iffPpm::redoIt()
     stat = reader.readImage ();
     IFFCHECKERR (stat, readImage);
 
-    std::ofstream out (ppmFile.asChar ());
-    if (!out.good ())
-    {
-        displayError ("Could not create output file");
-        return MS::kFailure;
-    }
-    out << "P3" << std::endl << imageWidth << " " << imageHeight << std::endl;
+    ppmSource src;
+    src.width = imageWidth;
+    src.height = imageHeight;
+    src.useDepth = useDepth;
+    src.useBinary = useBinary;
+    src.useFloat = useFloat;
+    src.pixels = NULL;
+    src.depth = NULL;
+    src.bytesPerChannel = bytesPerChannel;
+    int alpha;
+    IFFimageReader::getChannelOrder (src.order [0], src.order [1], src.order [2], alpha);
+
     if (useDepth) {
         if (!reader.hasDepthMap ()) {
             displayError ("Image has no depth map");
             return MS::kFailure;
         }
+        stat = reader.getDepthMap (src.depth, src.depthStride);
+        IFFCHECKERR (stat, getDepthMap);
+    } else {
+        if (!reader.isRGB () && !reader.isGrayscale ()) {
+            displayError ("Image has no RGB data");
+            return MS::kFailure;
+        }
+        stat = reader.getPixelMap (src.pixels, src.pixelStride, src.rowStride);
+        IFFCHECKERR (stat, getPixelMap);
+    }
+
+    // Bands of scanlines converted at once
+    const int bandRows = 32;
+    int bandCount = (imageHeight + bandRows - 1) / bandRows;
+    int bandsInFlight = 2 * (int) std::thread::hardware_concurrency ();
+    if (bandsInFlight < 1)
+        bandsInFlight = 1;
 
+    if (useDepth && !useFloat) {
         // Step 1: calculate the range of depth values in the data.
         // We'll normalize against this range.
-        float minDepth=FLT_MAX, maxDepth=(-FLT_MAX);
-
-        const float *depthMap = reader.getDepthMap ();
-        for(int index=0; index<imageWidth*imageHeight; index++)
+        std::vector<float> bandMin (bandCount, FLT_MAX);
+        std::vector<float> bandMax (bandCount, -FLT_MAX);
+        tbb::parallel_for (0, bandCount, [&](int band)
         {
-            float depth=depthMap[index];
-            if (depth!=0.) // 0 values indicate nothing there
+            int yEnd = (band + 1) * bandRows < imageHeight ? (band + 1) * bandRows : imageHeight;
+            for (int y = band * bandRows; y < yEnd; y++)
             {
-                float realDepth= -1.0f/depth;
-                if (realDepth<minDepth)
-                    minDepth=realDepth;
-                if (realDepth>maxDepth)
-                    maxDepth=realDepth;
+                const float *row = (const float *) ((const char *) src.depth + (size_t) y * src.depthStride);
+                for (int x = 0; x < imageWidth; x++)
+                {
+                    float depth = row [x];
+                    if (depth != 0.) // 0 values indicate nothing there
+                    {
+                        float realDepth = -1.0f/depth;
+                        if (realDepth < bandMin [band])
+                            bandMin [band] = realDepth;
+                        if (realDepth > bandMax [band])
+                            bandMax [band] = realDepth;
+                    }
+                }
             }
-        }
+        });
 
-        // Step 2: output data, normalizing to 0-255
+        float minDepth=FLT_MAX, maxDepth=(-FLT_MAX);
+        for (int band = 0; band < bandCount; band++)
+        {
+            if (bandMin [band] < minDepth)
+                minDepth = bandMin [band];
+            if (bandMax [band] > maxDepth)
+                maxDepth = bandMax [band];
+        }
 
-        out << "255" << std::endl;
-        float scaleFactor = (float) (255.0 / ((double)maxDepth - (double)minDepth));
-        float offset = minDepth * scaleFactor;
+        // Step 2 below outputs data, normalizing to 0-255
+        src.scaleFactor = (float) (255.0 / ((double)maxDepth - (double)minDepth));
+        src.offset = minDepth * src.scaleFactor;
+    }
 
-        const float *entry = depthMap;
+    std::ofstream out (ppmFile.asChar (), (useBinary || useFloat) ?
+                       std::ios::out | std::ios::binary : std::ios::out);
+    if (!out.good ())
+    {
+        displayError ("Could not create output file");
+        return MS::kFailure;
+    }
 
-        for(int y=0; y < imageHeight; y++)
-            for(int x=0; x < imageWidth; x++, entry++)
-            {
-                if (*entry == 0.)
-                    out << "0 0 0" << std::endl;
-                else {
-                    float realDepth = -scaleFactor / *entry - offset;
-                    out << (int)realDepth << " " << (int)realDepth << " " <<
-                        (int) realDepth << std::endl;
-                }
-            }
+    if (useFloat) {
+        // PFM stores the scale as negative for little endian data
+        const unsigned short one = 1;
+        bool littleEndian = *(const unsigned char *) &one == 1;
+        out << (useDepth ? "Pf" : "PF") << "\n" << imageWidth << " " << imageHeight << "\n"
+            << (littleEndian ? "-1.0" : "1.0") << "\n";
     } else {
-        if (!reader.isRGB () && !reader.isGrayscale ()) {
-            displayError ("Image has no RGB data");
-            return MS::kFailure;
-        }
-        if (bytesPerChannel==1)
+        out << (useBinary ? "P6" : "P3") << std::endl << imageWidth << " " << imageHeight << std::endl;
+        if (useDepth || bytesPerChannel==1)
             out << "255" << std::endl;
         else
             out << "65535" << std::endl;
-        const unsigned char *bitmap = reader.getPixelMap ();
-        const unsigned char *pixel = bitmap;
-        int bytesPerPixel = (bytesPerChannel == 1) ? 4 : 8;
-        for(int y=0; y < imageHeight; y++)
-            for(int x=0; x < imageWidth; x++, pixel += bytesPerPixel)
-            {
-                // Note that if the image was greyscale then the ILload
-                // function will have expanded the grey into rgb now.
-                
-                //
-                if (bytesPerChannel==1)
-                {
-#if defined(_WIN32) || defined(__linux__)
-                    // The actual internal storage on NT is BGRA
-                    out << (int)pixel[2] << " " <<
-                        (int)pixel[1] << " " <<
-                        (int)pixel[0] << std::endl;
-#else
-                    // The actual internal storage on IRIX is ABGR
-                    out << (int)pixel[3] << " " <<
-                        (int)pixel[2] << " " <<
-                        (int)pixel[1] << std::endl;
-#endif
-                }
-                else // 16 bit
-                {
-#if defined(_WIN32) || defined(__linux__)
-                    out << ((int)pixel[4]<<8)+(int)pixel[5] << " " 
-                        << ((int)pixel[2]<<8)+(int)pixel[3] << " " 
-                        << ((int)pixel[0]<<8)+(int)pixel[1] << std::endl;
-#else
-                    out << ((int)pixel[6]<<8)+(int)pixel[7] << " " 
-                        << ((int)pixel[4]<<8)+(int)pixel[5] << " " 
-                        << ((int)pixel[2]<<8)+(int)pixel[3] << std::endl;
-#endif
-                }
-            }
     }
 
-    IFFCHECKERR (stat, getPixel);
+    // Step 2: convert a batch of bands in parallel, then write them
+    // in order. PFM scanlines go from the bottom up.
+    std::vector<std::string> bands (bandsInFlight);
+    for (int first = 0; first < bandCount && out.good (); first += bandsInFlight)
+    {
+        int count = (bandCount - first < bandsInFlight) ? bandCount - first : bandsInFlight;
+        tbb::parallel_for (0, count, [&](int i)
+        {
+            std::string &dst = bands [i];
+            dst.clear ();
+            int yBegin = (first + i) * bandRows;
+            int yEnd = (yBegin + bandRows < imageHeight) ? yBegin + bandRows : imageHeight;
+            for (int y = yBegin; y < yEnd; y++)
+                convertRow (src, useFloat ? imageHeight - 1 - y : y, dst);
+        });
+        for (int i = 0; i < count; i++)
+            out.write (bands [i].data (), bands [i].size ());
+    }
+
+    out.close ();
+    if (out.fail ())
+    {
+        displayError ("Could not write output file");
+        return MS::kFailure;
+    }
 
     stat = reader.close ();
     IFFCHECKERR (stat, close);
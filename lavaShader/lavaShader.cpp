@@ -8,6 +8,12 @@
 
 // To use this shader, create a Lava node and connect the output to an input of a surface/shader node such as Color. 
 //
+// The plug-in also provides the command "lavaSample", which evaluates a
+// lava node on many points at once through the batched noise in
+// common/batchNoise.h rather than one compute() per point, and can bake the
+// texture to an image. -width 4, 8 or 16 sets how many points are evaluated
+// together. See common/batchTexture.h.
+//
 
 
 #include <math.h>
@@ -25,6 +31,15 @@
 #include <maya/MFloatVector.h>
 #include <maya/MFloatPoint.h>
 #include <maya/MFnPlugin.h>
+#include <maya/MFnDependencyNode.h>
+#include <maya/MFnMatrixData.h>
+#include <maya/MMatrix.h>
+#include <maya/MFloatMatrix.h>
+
+#include <vector>
+
+#include "../common/batchNoise.h"
+#include "../common/batchTexture.h"
 
 // Local functions
 float Noise(float, float, float);
@@ -63,6 +78,27 @@ class Lava3D : public MPxNode
     //  Id tag for use with binary file format
     static  MTypeId id;
 
+    // Batch interface, see batchTexture.h
+    struct Params
+    {
+        MFloatVector    colorBase;
+        MFloatVector    colorFlame;
+        int             deform;
+        float           warp;
+        float           speed;
+        int             turbulence;
+        float           power;
+        float           frame;
+        MFloatMatrix    placement;
+        int             width;      // batchNoise lanes, set by -width
+    };
+
+    static const unsigned int kCoordinates = 3;
+
+    static MStatus getParams( const MObject& node, Params& params );
+    static void sampleBatch( const Params& params, const float* worldPoints,
+                             size_t count, float* rgba );
+
     private:
 
     // Input attributes
@@ -315,6 +351,86 @@ MStatus Lava3D::compute(const MPlug& plug, MDataBlock& block)
     return MS::kSuccess;
 }
 
+//
+// DESCRIPTION:
+// Batch interface, see batchTexture.h
+//
+MStatus Lava3D::getParams( const MObject& node, Params& params )
+{
+    MStatus status;
+    MFnDependencyNode fnNode( node, &status );
+    if (!status) return status;
+
+    params.width = batchNoise::kMaxWidth;
+
+    batchTexture::getColor( fnNode, aColorBase, params.colorBase );
+    batchTexture::getColor( fnNode, aColorFlame, params.colorFlame );
+    fnNode.findPlug( aDeform, true ).getValue( params.deform );
+    fnNode.findPlug( aWarp, true ).getValue( params.warp );
+    fnNode.findPlug( aSpeed, true ).getValue( params.speed );
+    fnNode.findPlug( aTurbulence, true ).getValue( params.turbulence );
+    fnNode.findPlug( aPower, true ).getValue( params.power );
+    fnNode.findPlug( aFrame, true ).getValue( params.frame );
+
+    return batchTexture::getMatrix( fnNode, aPlaceMat, params.placement );
+}
+
+void Lava3D::sampleBatch( const Params& params, const float* worldPoints,
+                          size_t count, float* rgba )
+{
+    std::vector<float> u( count ), v( count ), w( count );
+    std::vector<float> au( count ), av( count ), aw( count );
+    std::vector<float> nau( count ), nav( count ), naw( count );
+    std::vector<double> ascale( count ), bscale( count ), cscale( count );
+    size_t i;
+
+    float dist = params.speed * params.frame;
+    for (i = 0; i < count; i++)
+    {
+        MFloatPoint q( worldPoints[3*i], worldPoints[3*i+1], worldPoints[3*i+2] );
+        q *= params.placement;              // Convert into solid space
+        u[i] = q.x; v[i] = q.y; w[i] = q.z;
+        au[i] = u[i] + dist;
+        av[i] = v[i] + dist;
+        aw[i] = w[i] + dist;
+        nau[i] = -au[i];
+        nav[i] = -av[i];
+        naw[i] = -aw[i];
+    }
+
+    // Calculate 3 noise values
+    batchNoise::turbulence( params.width, Phi, G, &au[0], &av[0], &aw[0],
+                            params.deform, &ascale[0], count );
+    batchNoise::turbulence( params.width, Phi, G, &au[0], &nav[0], &aw[0],
+                            params.deform, &bscale[0], count );
+    batchNoise::turbulence( params.width, Phi, G, &nau[0], &av[0], &naw[0],
+                            params.deform, &cscale[0], count );
+
+    // Warp the texture coordinates
+    for (i = 0; i < count; i++)
+    {
+        u[i] += (float) ascale[i] * params.warp;
+        v[i] += (float) bscale[i] * params.warp;
+        w[i] += (float) cscale[i] * params.warp;
+    }
+
+    // Turbulence at the warped points, reusing ascale
+    batchNoise::turbulence( params.width, Phi, G, &u[0], &v[0], &w[0],
+                            params.turbulence, &ascale[0], count );
+
+    for (i = 0; i < count; i++)
+    {
+        float scalar = (float) (ascale[i] + 0.5);
+        if (params.power != 1) scalar = powf (scalar, params.power);
+
+        MFloatVector color = ((params.colorFlame-params.colorBase)*scalar) + params.colorBase;
+        rgba[4*i]   = color.x;
+        rgba[4*i+1] = color.y;
+        rgba[4*i+2] = color.z;
+        rgba[4*i+3] = scalar;
+    }
+}
+
 MStatus initializePlugin( MObject obj )
 {
     const MString UserClassify( "texture/3d" );
@@ -323,6 +439,9 @@ MStatus initializePlugin( MObject obj )
     CHECK_MSTATUS ( plugin.registerNode( "lava", Lava3D::id, 
         Lava3D::creator, Lava3D::initialize,
         MPxNode::kDependNode, &UserClassify) );
+    CHECK_MSTATUS ( plugin.registerCommand( "lavaSample",
+        batchTexture::SampleCmd<Lava3D>::creator,
+        batchTexture::SampleCmd<Lava3D>::newSyntax ) );
 
     Noise_init();
     
@@ -333,6 +452,7 @@ MStatus initializePlugin( MObject obj )
 MStatus uninitializePlugin( MObject obj )
 {
     MFnPlugin plugin( obj );
+    CHECK_MSTATUS ( plugin.deregisterCommand( "lavaSample" ) );
     CHECK_MSTATUS ( plugin.deregisterNode( Lava3D::id ) );
 
     return MS::kSuccess;
@@ -31,6 +31,17 @@
 //  -s <frame>      The start frame.  Default to 1.
 //  -e <frame>      The end frame.  Default to 60.
 //  -b <frame>      The by frame.  Default to 1.
+//  -c <0|1>        Evaluate each frame through an MDGContext instead of
+//                  changing the current time.  Only the traced plugs are
+//                  evaluated, and the current time is left unchanged.
+//                  Default to 0.
+//
+// The positions of all the objects are read together at each frame, and
+// the curves are then built in parallel and created in turn. The command
+// returns the time spent evaluating the frames and the time spent building
+// and creating the curves, in seconds:
+//
+//  motionTrace -s 1 -e 3000 -c 1;
 //
 // See also:
 //
@@ -61,6 +72,14 @@
 #include <maya/MDoubleArray.h>
 #include <maya/MObjectArray.h>
 #include <maya/MFnNurbsCurve.h>
+#include <maya/MDGContext.h>
+#include <maya/MDGContextGuard.h>
+#include <maya/MTimer.h>
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
+#include <vector>
 
 //
 // Command class declaration
@@ -80,6 +99,7 @@ private:
     void        printType( MObject node, MString & prefix );
 
     double          start, end, by; // frame range
+    bool            useContext;     // evaluate through an MDGContext
 };
 
 
@@ -110,6 +130,7 @@ MStatus motionTrace::doIt( const MArgList& args )
     start = 1.0;
     end = 60.0;
     by = 1.0;
+    useContext = false;
 
     MStatus stat;
     double tmp;
@@ -138,6 +159,19 @@ MStatus motionTrace::doIt( const MArgList& args )
             if ( MS::kSuccess == stat )
             by = tmp;
         }
+        else if ( MString( "-c" ) == args.asString( i, &stat ) &&
+                  MS::kSuccess == stat)
+        {
+            int on = args.asInt( ++i, &stat );
+            if ( MS::kSuccess == stat )
+            useContext = ( on != 0 );
+        }
+    }
+
+    if ( by <= 0.0 )
+    {
+        displayError( "The by frame must be positive." );
+        return MS::kFailure;
     }
 
     stat = redoIt();
@@ -152,15 +186,10 @@ MStatus motionTrace::doIt( const MArgList& args )
 
 -----------------------------------------
 */
-static void jMakeCurve( MPointArray cvs )
+static void jMakeCurve( const MPointArray& cvs, const MDoubleArray& knots )
 {
     MStatus stat;
     unsigned int deg = 1;
-    MDoubleArray knots;
-
-    unsigned int i;
-    for ( i = 0; i < cvs.length(); i++ )
-        knots.append( (double) i );
 
     // Now create the curve
     //
@@ -214,70 +243,106 @@ MStatus motionTrace::redoIt()
         picked.append( dependNode );
     }
 
-    // array of arrays for object position
+    // Look up the translate plugs of the objects once
 
-    MPointArray *pointArrays = new MPointArray [ picked.length() ];
+    unsigned int numObjects = picked.length();
+    std::vector<MPlug> plugs( 3 * numObjects );
 
     unsigned int i;
-    double time;
+    for ( i = 0; i < numObjects; i++ )
+    {
+        // Get the selected dependency node
+        //
+        dependNode = picked[i];
 
-    //  Sample the animation using start, end, by values
+        // Create a function set for the dependency node
+        //
+        MFnDependencyNode fnDependNode( dependNode );
+
+        // Get the translation attributes
+
+        plugs[3*i]   = MPlug( dependNode, fnDependNode.attribute( MString("translateX"), &stat ) );
+        plugs[3*i+1] = MPlug( dependNode, fnDependNode.attribute( MString("translateY"), &stat ) );
+        plugs[3*i+2] = MPlug( dependNode, fnDependNode.attribute( MString("translateZ"), &stat ) );
+    }
 
+    std::vector<double> times;
+    double time;
     for ( time = start; time <= end; time+=by )
-    {
-        MTime timeval(time);
+        times.push_back( time );
+    unsigned int numFrames = (unsigned int) times.size();
 
-        MGlobal::viewFrame( timeval );
+    //  Sample the animation using start, end, by values. The positions of
+    //  frame f are stored at samples[ 3 * ( f * numObjects + i ) ].
 
-        // Iterate over selected dependency nodes
-        //
+    std::vector<double> samples( 3 * (size_t) numFrames * numObjects );
+
+    MTimer timer;
+    timer.beginTimer();
 
-        for ( i = 0; i < picked.length(); i++ )
+    unsigned int f, k;
+    for ( f = 0; f < numFrames; f++ )
+    {
+        MTime timeval( times[f] );
+        double *values = samples.data() + 3 * (size_t) f * numObjects;
+
+        if ( useContext )
+        {
+            MDGContext ctx( timeval );
+            MDGContextGuard guard( ctx );
+            for ( k = 0; k < 3 * numObjects; k++ )
+                values[k] = plugs[k].asDouble();
+        }
+        else
         {
-            // Get the selected dependency node
-            //
-            dependNode = picked[i];
-
-            // Create a function set for the dependency node
-            //
-            MFnDependencyNode fnDependNode( dependNode );
-
-            // Get the translation attribute values
-
-            MObject txAttr;
-            txAttr = fnDependNode.attribute( MString("translateX"), &stat );
-            MPlug txPlug( dependNode, txAttr );
-            double tx;
-            stat = txPlug.getValue( tx );
-
-            MObject tyAttr;
-            tyAttr = fnDependNode.attribute( MString("translateY"), &stat );
-            MPlug tyPlug( dependNode, tyAttr );
-            double ty;
-            stat = tyPlug.getValue( ty );
-
-            MObject tzAttr;
-            tzAttr = fnDependNode.attribute( MString("translateZ"), &stat );
-            MPlug tzPlug( dependNode, tzAttr );
-            double tz;
-            stat = tzPlug.getValue( tz );
+            MGlobal::viewFrame( timeval );
+            for ( k = 0; k < 3 * numObjects; k++ )
+                values[k] = plugs[k].asDouble();
+        }
 
 #if 0
+        for ( i = 0; i < numObjects; i++ )
             fprintf( stderr,
                      "Time = %2.2lf, XYZ = ( %2.2lf, %2.2lf, %2.2lf )\n\n",
-                     time, tx, ty, tz );
+                     times[f], values[3*i], values[3*i+1], values[3*i+2] );
 #endif
-
-            pointArrays[i].append( MPoint( tx, ty, tz )) ;
-        }
     }
 
-    // make a path curve for each selected object
-
-    for ( i = 0; i < picked.length(); i++ )
-        jMakeCurve( pointArrays[i] );
+    timer.endTimer();
+    double evaluationTime = timer.elapsedTime();
+
+    // make a path curve for each selected object, the CVs and knots of
+    // all the curves being gathered in parallel
+
+    timer.beginTimer();
+
+    std::vector<MPointArray> cvs( numObjects );
+    std::vector<MDoubleArray> knots( numObjects );
+    tbb::parallel_for( tbb::blocked_range<unsigned int>( 0, numObjects ),
+        [&]( const tbb::blocked_range<unsigned int>& r ) {
+            for ( unsigned int j = r.begin(); j != r.end(); ++j )
+            {
+                cvs[j].setLength( numFrames );
+                knots[j].setLength( numFrames );
+                for ( unsigned int g = 0; g < numFrames; g++ )
+                {
+                    const double *p = &samples[3 * ( (size_t) g * numObjects + j )];
+                    cvs[j][g] = MPoint( p[0], p[1], p[2] );
+                    knots[j][g] = (double) g;
+                }
+            }
+        });
+
+    for ( i = 0; i < numObjects; i++ )
+        jMakeCurve( cvs[i], knots[i] );
+
+    timer.endTimer();
+
+    MDoubleArray result;
+    result.append( evaluationTime );
+    result.append( timer.elapsedTime() );
+    setResult( result );
 
-    delete [] pointArrays;
     return MS::kSuccess;
 }
 
@@ -13,6 +13,14 @@
 #include <maya/MFloatVector.h>
 #include <maya/MFloatMatrix.h>
 #include <maya/MFnPlugin.h>
+#include <maya/MFnDependencyNode.h>
+#include <maya/MFnMatrixData.h>
+#include <maya/MMatrix.h>
+
+#include <vector>
+
+#include "../common/batchNoise.h"
+#include "../common/batchTexture.h"
 
 // DESCRIPTION: 
 // Produces dependency graph node SolidNoise
@@ -21,6 +29,12 @@
 
 // The output attribute of the SolidNoise node is called "outColor". 
 //
+// The plug-in also provides the command "solidNoiseSample", which evaluates
+// a solidNoise node on many points at once through the batched noise in
+// common/batchNoise.h rather than one compute() per point, and can bake the
+// texture to an image. -width 4, 8 or 16 sets how many points are evaluated
+// together. See common/batchTexture.h.
+//
 
 
 class noise3 : public MPxNode
@@ -39,6 +53,23 @@ class noise3 : public MPxNode
     //  Id tag for use with binary file format
     static MTypeId id;
 
+    // Batch interface, see batchTexture.h
+    struct Params
+    {
+        MFloatVector    color1;
+        MFloatVector    color2;
+        float           scale;
+        float           bias;
+        MFloatMatrix    placement;
+        int             width;      // batchNoise lanes, set by -width
+    };
+
+    static const unsigned int kCoordinates = 3;
+
+    static MStatus getParams( const MObject& node, Params& params );
+    static void sampleBatch( const Params& params, const float* worldPoints,
+                             size_t count, float* rgba );
+
     private:
 
     static void init();
@@ -280,6 +311,64 @@ void noise3::init()
     }
 }
 
+//
+// Batch interface, see batchTexture.h
+//
+MStatus noise3::getParams( const MObject& node, Params& params )
+{
+    MStatus status;
+    MFnDependencyNode fnNode( node, &status );
+    if (!status) return status;
+
+    params.width = batchNoise::kMaxWidth;
+
+    batchTexture::getColor( fnNode, aColor1, params.color1 );
+    batchTexture::getColor( fnNode, aColor2, params.color2 );
+    fnNode.findPlug( aScale, true ).getValue( params.scale );
+    fnNode.findPlug( aBias, true ).getValue( params.bias );
+
+    status = batchTexture::getMatrix( fnNode, aPlaceMat, params.placement );
+    if (!status) return status;
+
+    // Build the tables here, sampleBatch() may be called from many threads
+    if (start) 
+    { 
+        start = 0; 
+        init(); 
+    } 
+
+    return MS::kSuccess;
+}
+
+void noise3::sampleBatch( const Params& params, const float* worldPoints,
+                          size_t count, float* rgba )
+{
+    std::vector<float> x( count ), y( count ), z( count ), n( count );
+    size_t i;
+    for (i = 0; i < count; i++)
+    {
+        MFloatPoint solidPos( worldPoints[3*i], worldPoints[3*i+1], worldPoints[3*i+2] );
+        solidPos *= params.placement;       // Convert into solid space
+        x[i] = solidPos.x;
+        y[i] = solidPos.y;
+        z[i] = solidPos.z;
+    }
+
+    batchNoise::perlin( params.width, p, g, &x[0], &y[0], &z[0], &n[0], count );
+
+    for (i = 0; i < count; i++)
+    {
+        float val = fabsf( n[i] * params.scale + params.bias );
+        if (val < 0.) val = 0.;
+        if (val > 1.) val = 1.;
+        MFloatVector resultColor = params.color1 * val + params.color2*(1-val);
+        rgba[4*i]   = resultColor.x;
+        rgba[4*i+1] = resultColor.y;
+        rgba[4*i+2] = resultColor.z;
+        rgba[4*i+3] = val;
+    }
+}
+
 //
 // This function gets called by Maya to evaluate the texture.
 //
@@ -330,6 +419,9 @@ MStatus initializePlugin( MObject obj )
     CHECK_MSTATUS ( plugin.registerNode( "solidNoise", noise3::id, 
                          &noise3::creator, &noise3::initialize,
                          MPxNode::kDependNode, &UserClassify ) );
+    CHECK_MSTATUS ( plugin.registerCommand( "solidNoiseSample",
+                         batchTexture::SampleCmd<noise3>::creator,
+                         batchTexture::SampleCmd<noise3>::newSyntax ) );
 
     return MS::kSuccess;
 }
@@ -337,6 +429,7 @@ MStatus initializePlugin( MObject obj )
 MStatus uninitializePlugin( MObject obj )
 {
     MFnPlugin plugin( obj );
+    CHECK_MSTATUS ( plugin.deregisterCommand( "solidNoiseSample" ) );
     CHECK_MSTATUS ( plugin.deregisterNode( noise3::id ) );
 
     return MS::kSuccess;
@@ -0,0 +1,745 @@
+//-
+// Copyright 2020 Autodesk, Inc. All rights reserved.
+//
+// Use of this software is subject to the terms of the Autodesk
+// license agreement provided at the time of installation or download,
+// or which otherwise accompanies this software in either electronic
+// or hard copy form.
+//+
+
+#include "objParser.h"
+
+#include <map>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
+namespace objParser
+{
+
+namespace
+{
+
+// Chunks are at least this big, so that small files are parsed serially
+const size_t kMinChunkSize = 1 << 22;
+const size_t kMaxChunks = 256;
+
+enum EventType { kGroup, kMaterial, kSmoothing };
+
+// A g, o, usemtl or s record, taking effect at face firstFace of the chunk
+struct Event
+{
+    size_t      firstFace;
+    EventType   type;
+    std::string name;
+    int         smoothing;
+};
+
+// The records of one chunk. Indices are 0-based and absolute, except for
+// those at the positions listed in relV, relVt and relVn which were
+// negative in the file: they are relative to the first v, vt or vn of the
+// chunk and are fixed up once the chunks before are counted.
+struct Chunk
+{
+    std::vector<float>      positions;
+    std::vector<float>      uvs;
+    std::vector<float>      normals;
+    std::vector<int>        faceCounts;
+    std::vector<int>        v;
+    std::vector<int>        vt;
+    std::vector<int>        vn;
+    std::vector<size_t>     relV;
+    std::vector<size_t>     relVt;
+    std::vector<size_t>     relVn;
+    std::vector<Event>      events;
+
+    std::string             error;
+    size_t                  errorLine;
+};
+
+class MappedFile
+{
+public:
+    MappedFile() : fData( NULL ), fSize( 0 )
+#ifdef _WIN32
+    , fFile( INVALID_HANDLE_VALUE ), fMapping( NULL )
+#endif
+    {}
+    ~MappedFile() { unmap(); }
+
+    bool map( const char* fileName );
+    void unmap();
+
+    const char*     data() const { return fData; }
+    size_t          size() const { return fSize; }
+
+private:
+    const char*     fData;
+    size_t          fSize;
+#ifdef _WIN32
+    HANDLE          fFile;
+    HANDLE          fMapping;
+#endif
+};
+
+bool MappedFile::map( const char* fileName )
+{
+    unmap();
+
+#ifdef _WIN32
+    fFile = CreateFileA( fileName, GENERIC_READ, FILE_SHARE_READ, NULL,
+                         OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL );
+    if( fFile == INVALID_HANDLE_VALUE )
+        return false;
+
+    LARGE_INTEGER size;
+    if( !GetFileSizeEx( fFile, &size ) || size.QuadPart == 0 )
+    {
+        unmap();
+        return false;
+    }
+
+    fMapping = CreateFileMappingA( fFile, NULL, PAGE_READONLY, 0, 0, NULL );
+    if( fMapping == NULL )
+    {
+        unmap();
+        return false;
+    }
+
+    fData = (const char*)MapViewOfFile( fMapping, FILE_MAP_READ, 0, 0, 0 );
+    fSize = (size_t)size.QuadPart;
+#else
+    int fd = ::open( fileName, O_RDONLY );
+    if( fd < 0 )
+        return false;
+
+    struct stat st;
+    if( fstat( fd, &st ) != 0 || st.st_size == 0 )
+    {
+        ::close( fd );
+        return false;
+    }
+
+    void* addr = mmap( NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    ::close( fd );
+    if( addr == MAP_FAILED )
+        return false;
+
+    fData = (const char*)addr;
+    fSize = (size_t)st.st_size;
+#endif
+
+    if( fData == NULL )
+    {
+        unmap();
+        return false;
+    }
+    return true;
+}
+
+void MappedFile::unmap()
+{
+#ifdef _WIN32
+    if( fData ) UnmapViewOfFile( fData );
+    if( fMapping ) CloseHandle( fMapping );
+    if( fFile != INVALID_HANDLE_VALUE ) CloseHandle( fFile );
+    fMapping = NULL;
+    fFile = INVALID_HANDLE_VALUE;
+#else
+    if( fData ) munmap( (void*)fData, fSize );
+#endif
+    fData = NULL;
+    fSize = 0;
+}
+
+inline bool isBlank( char c )
+{
+    return c == ' ' || c == '\t';
+}
+
+inline bool isDigit( char c )
+{
+    return (unsigned)(c - '0') < 10;
+}
+
+inline const char* skipBlanks( const char* p, const char* end )
+{
+    while( p < end && isBlank( *p ) ) ++p;
+    return p;
+}
+
+inline const char* skipLine( const char* p, const char* end )
+{
+    const char* nl = (const char*)memchr( p, '\n', end - p );
+    return nl ? nl + 1 : end;
+}
+
+// End of the line, without the trailing blanks and carriage return
+inline const char* lineEnd( const char* p, const char* end )
+{
+    const char* nl = (const char*)memchr( p, '\n', end - p );
+    const char* e = nl ? nl : end;
+    while( e > p && (isBlank( e[-1] ) || e[-1] == '\r') ) --e;
+    return e;
+}
+
+inline const char* parseInt( const char* p, const char* end, int& value )
+{
+    bool neg = false;
+    if( p < end && (*p == '-' || *p == '+') )
+    {
+        neg = (*p == '-');
+        ++p;
+    }
+    if( p == end || !isDigit( *p ) )
+        return NULL;
+
+    long long n = 0;
+    while( p < end && isDigit( *p ) )
+    {
+        n = n * 10 + (*p - '0');
+        if( n > 0x7fffffff ) return NULL;
+        ++p;
+    }
+    value = (int)(neg ? -n : n);
+    return p;
+}
+
+// Resolves an OBJ index (1-based, or negative relative to the records
+// parsed so far in the chunk). Returns false for 0.
+inline bool resolveIndex( int index, size_t localCount, int& resolved, bool& relative )
+{
+    if( index > 0 )
+    {
+        resolved = index - 1;
+        relative = false;
+        return true;
+    }
+    if( index < 0 )
+    {
+        resolved = (int)localCount + index;
+        relative = true;
+        return true;
+    }
+    return false;
+}
+
+void parseChunk( const char* begin, const char* end, Chunk& chunk )
+{
+    const char* p = begin;
+    size_t line = 0;
+    float f[3];
+
+    while( p < end )
+    {
+        ++line;
+        p = skipBlanks( p, end );
+        if( p == end ) break;
+
+        const char c = *p;
+        const char c1 = (p + 1 < end) ? p[1] : '\n';
+        const char* q = NULL;
+
+        if( c == 'v' && isBlank( c1 ) )
+        {
+            if( !(q = parseFloat( p + 2, end, f[0] )) ||
+                !(q = parseFloat( q, end, f[1] )) ||
+                !(q = parseFloat( q, end, f[2] )) )
+            {
+                chunk.error = "malformed vertex";
+                chunk.errorLine = line;
+                return;
+            }
+            chunk.positions.insert( chunk.positions.end(), f, f + 3 );
+        }
+        else if( c == 'v' && c1 == 't' && p + 2 < end && isBlank( p[2] ) )
+        {
+            if( !(q = parseFloat( p + 3, end, f[0] )) )
+            {
+                chunk.error = "malformed texture coordinate";
+                chunk.errorLine = line;
+                return;
+            }
+            // A single coordinate is allowed, v defaulting to 0
+            if( !parseFloat( q, end, f[1] ) )
+                f[1] = 0.0f;
+            chunk.uvs.insert( chunk.uvs.end(), f, f + 2 );
+        }
+        else if( c == 'v' && c1 == 'n' && p + 2 < end && isBlank( p[2] ) )
+        {
+            if( !(q = parseFloat( p + 3, end, f[0] )) ||
+                !(q = parseFloat( q, end, f[1] )) ||
+                !(q = parseFloat( q, end, f[2] )) )
+            {
+                chunk.error = "malformed normal";
+                chunk.errorLine = line;
+                return;
+            }
+            chunk.normals.insert( chunk.normals.end(), f, f + 3 );
+        }
+        else if( c == 'f' && isBlank( c1 ) )
+        {
+            const size_t nPositions = chunk.positions.size() / 3;
+            const size_t nUVs = chunk.uvs.size() / 2;
+            const size_t nNormals = chunk.normals.size() / 3;
+            const char* e = lineEnd( p, end );
+            int count = 0;
+            q = skipBlanks( p + 2, e );
+            while( q < e )
+            {
+                int index, resolved;
+                bool relative;
+
+                q = parseInt( q, e, index );
+                if( !q || !resolveIndex( index, nPositions, resolved, relative ) )
+                {
+                    q = NULL;
+                    break;
+                }
+                if( relative ) chunk.relV.push_back( chunk.v.size() );
+
+                int uv = -1, normal = -1;
+                if( q < e && *q == '/' )
+                {
+                    ++q;
+                    if( q < e && *q != '/' )
+                    {
+                        q = parseInt( q, e, index );
+                        if( !q || !resolveIndex( index, nUVs, uv, relative ) )
+                        {
+                            q = NULL;
+                            break;
+                        }
+                        if( relative ) chunk.relVt.push_back( chunk.vt.size() );
+                    }
+                    if( q < e && *q == '/' )
+                    {
+                        ++q;
+                        q = parseInt( q, e, index );
+                        if( !q || !resolveIndex( index, nNormals, normal, relative ) )
+                        {
+                            q = NULL;
+                            break;
+                        }
+                        if( relative ) chunk.relVn.push_back( chunk.vn.size() );
+                    }
+                }
+                chunk.v.push_back( resolved );
+                chunk.vt.push_back( uv );
+                chunk.vn.push_back( normal );
+                ++count;
+
+                if( q < e && !isBlank( *q ) )
+                {
+                    q = NULL;
+                    break;
+                }
+                q = skipBlanks( q, e );
+            }
+
+            if( q != e || count < 3 )
+            {
+                chunk.error = "malformed face";
+                chunk.errorLine = line;
+                return;
+            }
+            chunk.faceCounts.push_back( count );
+        }
+        else if( (c == 'g' || c == 'o') && (isBlank( c1 ) || c1 == '\r' || c1 == '\n') )
+        {
+            const char* e = lineEnd( p, end );
+            const char* n = skipBlanks( p + 1, e );
+            const char* ne = n;
+            while( ne < e && !isBlank( *ne ) ) ++ne;
+
+            Event event;
+            event.firstFace = chunk.faceCounts.size();
+            event.type = kGroup;
+            event.name.assign( n, ne );
+            event.smoothing = 0;
+            chunk.events.push_back( event );
+        }
+        else if( c == 's' && isBlank( c1 ) )
+        {
+            const char* e = lineEnd( p, end );
+            const char* n = skipBlanks( p + 2, e );
+            int group = 0;
+            if( !parseInt( n, e, group ) )
+                group = 0;          // "off"
+
+            Event event;
+            event.firstFace = chunk.faceCounts.size();
+            event.type = kSmoothing;
+            event.smoothing = group;
+            chunk.events.push_back( event );
+        }
+        else if( c == 'u' && end - p > 7 && !strncmp( p, "usemtl", 6 ) && isBlank( p[6] ) )
+        {
+            const char* e = lineEnd( p, end );
+            const char* n = skipBlanks( p + 7, e );
+
+            Event event;
+            event.firstFace = chunk.faceCounts.size();
+            event.type = kMaterial;
+            event.name.assign( n, e );
+            event.smoothing = 0;
+            chunk.events.push_back( event );
+        }
+
+        p = skipLine( p, end );
+    }
+}
+
+template <class T>
+void appendParallel( const std::vector<Chunk>& chunks, std::vector<T> Chunk::* member,
+                     std::vector<T>& out )
+{
+    std::vector<size_t> offsets( chunks.size() + 1, 0 );
+    size_t i;
+    for( i = 0; i < chunks.size(); ++i )
+        offsets[i+1] = offsets[i] + (chunks[i].*member).size();
+
+    out.resize( offsets.back() );
+    if( out.empty() )
+        return;
+
+    tbb::parallel_for( (size_t)0, chunks.size(), [&]( size_t c ) {
+        const std::vector<T>& src = chunks[c].*member;
+        if( !src.empty() )
+            memcpy( &out[offsets[c]], &src[0], src.size() * sizeof( T ) );
+    });
+}
+
+}
+
+size_t Data::runFaceEnd( size_t i ) const
+{
+    return (i + 1 < runs.size()) ? runs[i+1].firstFace : faceCounts.size();
+}
+
+size_t Data::runFaceVertexEnd( size_t i ) const
+{
+    return (i + 1 < runs.size()) ? runs[i+1].firstFaceVertex : v.size();
+}
+
+void Data::clear()
+{
+    positions.clear();
+    uvs.clear();
+    normals.clear();
+    faceCounts.clear();
+    v.clear();
+    vt.clear();
+    vn.clear();
+    runs.clear();
+    groupNames.clear();
+    materialNames.clear();
+}
+
+const char* parseFloat( const char* p, const char* end, float& value )
+{
+    // Exactly representable powers of ten
+    static const double kPow10[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    p = skipBlanks( p, end );
+    const char* start = p;
+
+    bool neg = false;
+    if( p < end && (*p == '-' || *p == '+') )
+    {
+        neg = (*p == '-');
+        ++p;
+    }
+
+    unsigned long long mantissa = 0;
+    int digits = 0, exponent = 0;
+    bool any = false, exact = true;
+
+    for( ; p < end && isDigit( *p ); ++p )
+    {
+        any = true;
+        if( digits < 19 )
+        {
+            mantissa = mantissa * 10 + (*p - '0');
+            if( mantissa ) ++digits;
+        }
+        else
+        {
+            ++exponent;
+            exact = false;
+        }
+    }
+    if( p < end && *p == '.' )
+    {
+        for( ++p; p < end && isDigit( *p ); ++p )
+        {
+            any = true;
+            if( digits < 19 )
+            {
+                mantissa = mantissa * 10 + (*p - '0');
+                if( mantissa ) ++digits;
+                --exponent;
+            }
+            else
+            {
+                exact = false;
+            }
+        }
+    }
+    if( !any )
+    {
+        // nan, inf and the like
+        if( p < end && (*p == 'n' || *p == 'N' || *p == 'i' || *p == 'I') )
+        {
+            char buffer[32];
+            size_t n = 0;
+            while( start + n < end && n < sizeof( buffer ) - 1 &&
+                   !isBlank( start[n] ) && start[n] != '\r' && start[n] != '\n' )
+            {
+                buffer[n] = start[n];
+                ++n;
+            }
+            buffer[n] = 0;
+            char* stop;
+            value = strtof( buffer, &stop );
+            return (stop != buffer) ? start + (stop - buffer) : NULL;
+        }
+        return NULL;
+    }
+
+    if( p < end && (*p == 'e' || *p == 'E') )
+    {
+        int e;
+        const char* q = parseInt( p + 1, end, e );
+        if( q )
+        {
+            exponent += e;
+            p = q;
+        }
+    }
+
+    double d;
+    if( exact && exponent >= -22 && exponent <= 22 )
+    {
+        d = (double)mantissa;
+        d = (exponent < 0) ? d / kPow10[-exponent] : d * kPow10[exponent];
+        if( neg ) d = -d;
+    }
+    else
+    {
+        d = strtod( std::string( start, p ).c_str(), NULL );
+    }
+
+    value = (float)d;
+    return p;
+}
+
+bool parse( const char* data, size_t size, Data& out, std::string& error )
+{
+    out.clear();
+    error.clear();
+
+    // Cut the data into chunks at line boundaries
+    size_t nChunks = size / kMinChunkSize;
+    if( nChunks < 1 ) nChunks = 1;
+    if( nChunks > kMaxChunks ) nChunks = kMaxChunks;
+
+    std::vector<const char*> bounds( 1, data );
+    const char* end = data + size;
+    size_t i;
+    for( i = 1; i < nChunks; ++i )
+    {
+        const char* b = data + i * (size / nChunks);
+        if( b <= bounds.back() ) continue;
+        b = skipLine( b, end );
+        if( b < end ) bounds.push_back( b );
+    }
+    bounds.push_back( end );
+    nChunks = bounds.size() - 1;
+
+    std::vector<Chunk> chunks( nChunks );
+    tbb::parallel_for( (size_t)0, nChunks, [&]( size_t c ) {
+        parseChunk( bounds[c], bounds[c+1], chunks[c] );
+    });
+
+    // Count the records before each chunk, and report the first error
+    std::vector<size_t> vBase( nChunks ), vtBase( nChunks ), vnBase( nChunks ), fBase( nChunks ), fvBase( nChunks );
+    size_t nV = 0, nVt = 0, nVn = 0, nF = 0, nFv = 0;
+    for( i = 0; i < nChunks; ++i )
+    {
+        if( !chunks[i].error.empty() )
+        {
+            size_t line = chunks[i].errorLine;
+            for( const char* p = bounds[0]; p < bounds[i]; ++line )
+                p = skipLine( p, end );
+            error = chunks[i].error + " at line " + std::to_string( line );
+            return false;
+        }
+        vBase[i] = nV;   nV += chunks[i].positions.size() / 3;
+        vtBase[i] = nVt; nVt += chunks[i].uvs.size() / 2;
+        vnBase[i] = nVn; nVn += chunks[i].normals.size() / 3;
+        fBase[i] = nF;   nF += chunks[i].faceCounts.size();
+        fvBase[i] = nFv; nFv += chunks[i].v.size();
+    }
+
+    // Fix up the relative indices
+    tbb::parallel_for( (size_t)0, nChunks, [&]( size_t c ) {
+        Chunk& chunk = chunks[c];
+        for( size_t k : chunk.relV ) chunk.v[k] += (int)vBase[c];
+        for( size_t k : chunk.relVt ) chunk.vt[k] += (int)vtBase[c];
+        for( size_t k : chunk.relVn ) chunk.vn[k] += (int)vnBase[c];
+    });
+
+    appendParallel( chunks, &Chunk::positions, out.positions );
+    appendParallel( chunks, &Chunk::uvs, out.uvs );
+    appendParallel( chunks, &Chunk::normals, out.normals );
+    appendParallel( chunks, &Chunk::faceCounts, out.faceCounts );
+    appendParallel( chunks, &Chunk::v, out.v );
+    appendParallel( chunks, &Chunk::vt, out.vt );
+    appendParallel( chunks, &Chunk::vn, out.vn );
+
+    // Check the indices
+    bool badIndex = false;
+    tbb::parallel_for( tbb::blocked_range<size_t>( 0, nFv, 1 << 16 ),
+        [&]( const tbb::blocked_range<size_t>& r ) {
+            bool bad = false;
+            for( size_t k = r.begin(); k != r.end(); ++k )
+            {
+                bad |= (unsigned)out.v[k] >= nV;
+                bad |= out.vt[k] < -1 || out.vt[k] >= (int)nVt;
+                bad |= out.vn[k] < -1 || out.vn[k] >= (int)nVn;
+            }
+            if( bad ) badIndex = true;
+        });
+    if( badIndex )
+    {
+        error = "face index out of range";
+        return false;
+    }
+
+    // Turn the g, usemtl and s records into runs of faces
+    std::map<std::string, int> groups, materials;
+    Run run;
+    run.firstFace = 0;
+    run.firstFaceVertex = 0;
+    run.group = -1;
+    run.material = -1;
+    run.smoothing = 0;
+
+    for( i = 0; i < nChunks; ++i )
+    {
+        const Chunk& chunk = chunks[i];
+        size_t face = 0, faceVertex = 0;
+        for( const Event& event : chunk.events )
+        {
+            // Position of the event in the chunk, in face-vertices
+            for( ; face < event.firstFace; ++face )
+                faceVertex += chunk.faceCounts[face];
+
+            Run next = run;
+            next.firstFace = fBase[i] + event.firstFace;
+            next.firstFaceVertex = fvBase[i] + faceVertex;
+            if( event.type == kGroup )
+            {
+                std::map<std::string, int>::iterator it = groups.find( event.name );
+                if( it == groups.end() )
+                {
+                    it = groups.insert( std::make_pair( event.name, (int)out.groupNames.size() ) ).first;
+                    out.groupNames.push_back( event.name );
+                }
+                next.group = it->second;
+            }
+            else if( event.type == kMaterial )
+            {
+                std::map<std::string, int>::iterator it = materials.find( event.name );
+                if( it == materials.end() )
+                {
+                    it = materials.insert( std::make_pair( event.name, (int)out.materialNames.size() ) ).first;
+                    out.materialNames.push_back( event.name );
+                }
+                next.material = it->second;
+            }
+            else
+            {
+                next.smoothing = event.smoothing;
+            }
+
+            // Replace a run that has no face yet
+            if( !out.runs.empty() && out.runs.back().firstFace == next.firstFace )
+                out.runs.back() = next;
+            else
+                out.runs.push_back( next );
+            run = next;
+        }
+    }
+
+    // Faces before any g record belong to the default group
+    bool needDefault = out.runs.empty() || out.runs[0].firstFace > 0;
+    for( i = 0; i < out.runs.size(); ++i )
+        needDefault |= out.runs[i].group < 0;
+    if( needDefault && nF > 0 )
+    {
+        std::map<std::string, int>::iterator it = groups.find( "default" );
+        int group = (int)out.groupNames.size();
+        if( it == groups.end() )
+            out.groupNames.push_back( "default" );
+        else
+            group = it->second;
+
+        for( Run& r : out.runs )
+            if( r.group < 0 ) r.group = group;
+
+        if( out.runs.empty() || out.runs[0].firstFace > 0 )
+        {
+            Run first;
+            first.firstFace = 0;
+            first.firstFaceVertex = 0;
+            first.group = group;
+            first.material = -1;
+            first.smoothing = 0;
+            out.runs.insert( out.runs.begin(), first );
+        }
+    }
+
+    // Drop the runs without faces, e.g. a g record after the last face
+    std::vector<Run> runs;
+    runs.reserve( out.runs.size() );
+    for( i = 0; i < out.runs.size(); ++i )
+    {
+        if( out.runFaceEnd( i ) > out.runs[i].firstFace )
+            runs.push_back( out.runs[i] );
+    }
+    out.runs.swap( runs );
+
+    return true;
+}
+
+bool parseFile( const char* fileName, Data& out, std::string& error )
+{
+    MappedFile file;
+    if( !file.map( fileName ) )
+    {
+        error = std::string( "could not open " ) + fileName;
+        return false;
+    }
+    return parse( file.data(), file.size(), out, error );
+}
+
+}
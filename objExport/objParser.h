@@ -0,0 +1,94 @@
+//-
+// Copyright 2020 Autodesk, Inc. All rights reserved.
+//
+// Use of this software is subject to the terms of the Autodesk
+// license agreement provided at the time of installation or download,
+// or which otherwise accompanies this software in either electronic
+// or hard copy form.
+//+
+
+#ifndef _objParser_h_
+#define _objParser_h_
+
+//
+// DESCRIPTION:
+// Parser for the geometry records of Wavefront OBJ files, used by the
+// reader of ObjTranslator. It does not depend on Maya.
+//
+// The file is memory-mapped and cut into chunks at line boundaries. The
+// chunks are parsed in parallel, each into its own arrays, and the arrays
+// are then concatenated, also in parallel. Negative (relative) indices are
+// resolved once the number of v, vt and vn records preceding each chunk is
+// known.
+//
+// Records understood:
+//
+//  v x y z             position (a w or vertex color after it is ignored)
+//  vt u v              texture coordinate (a w is ignored)
+//  vn x y z            normal
+//  f v/vt/vn ...       face, the vt and vn indices being optional
+//  g name ... / o name starts the faces of the group named by the first name
+//  s n / s off         smoothing group, 0 for off
+//  usemtl name         material
+//
+// Anything else, including comments, mtllib and line continuations, is
+// skipped. Indices are stored 0-based, -1 standing for a missing vt or vn.
+//
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+namespace objParser
+{
+
+// A contiguous range of faces sharing the same group, material and
+// smoothing group. Faces are stored in file order and a group may span
+// several runs.
+struct Run
+{
+    size_t  firstFace;
+    size_t  firstFaceVertex;
+    int     group;              // index into groupNames
+    int     material;           // index into materialNames, -1 for none
+    int     smoothing;          // 0 for off
+};
+
+struct Data
+{
+    std::vector<float>          positions;      // x y z
+    std::vector<float>          uvs;            // u v
+    std::vector<float>          normals;        // x y z
+
+    std::vector<int>            faceCounts;     // vertices per face
+    std::vector<int>            v;              // per face-vertex
+    std::vector<int>            vt;             // per face-vertex, -1 if none
+    std::vector<int>            vn;             // per face-vertex, -1 if none
+
+    std::vector<Run>            runs;
+    std::vector<std::string>    groupNames;
+    std::vector<std::string>    materialNames;
+
+    // Number of faces and face-vertices of the runs [0, i], i.e. the end
+    // of run i
+    size_t runFaceEnd( size_t i ) const;
+    size_t runFaceVertexEnd( size_t i ) const;
+
+    void clear();
+};
+
+// Parses size bytes of OBJ text. Returns false, with a description in
+// error, if the data is malformed or references missing elements.
+bool parse( const char* data, size_t size, Data& out, std::string& error );
+
+// Maps the file and parses it.
+bool parseFile( const char* fileName, Data& out, std::string& error );
+
+// Parses a float the way strtof() does for the numbers found in OBJ files,
+// without the locale and with a faster path for up to 19 significant
+// digits. Returns the end of the number, or NULL if there is none.
+const char* parseFloat( const char* p, const char* end, float& value );
+
+}
+
+#endif
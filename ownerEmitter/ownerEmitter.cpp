@@ -42,6 +42,9 @@
 #include <maya/MFnArrayAttrsData.h>
 #include <maya/MFnMatrixData.h>
 
+#include "../common/emitterJitter.h"
+#include "../common/pathEmission.h"
+
 
 MTypeId ownerEmitter::id( 0x80015 );
 
@@ -206,7 +209,9 @@ MStatus ownerEmitter::compute(const MPlug& plug, MDataBlock& block)
     // Start emitting particles.
     //
     emit( inPosAry, inVelAry, emitCountPP,
-            dt, speed, inheritFactor, rotatedV, fnOutPos, fnOutVel );
+            dt, speed, inheritFactor, rotatedV,
+            emitterJitter::seed( emitterJitter::seedAttribute( block, multiIndex ), cT ),
+            fnOutPos, fnOutVel );
 
     // Update the data block with new dOutput and set plug clean.
     //
@@ -226,65 +231,18 @@ void ownerEmitter::emit
         double speed,                   // speed factor
         double inheritFactor,           // for inherit velocity
         MVector dirV,                   // emit direction
+        unsigned long long seed,        // seed of the jitter
         MVectorArray &outPosAry,        // holding new particles position
         MVectorArray &outVelAry         // holding new particles velocity
     )
 //
 //  Descriptions:
+//      Emits emitCountPP[index] particles from each point, see
+//      common/pathEmission.h.
 //
 {
-    // check the length of input arrays.
-    //
-    int posLength = inPosAry.length();
-    int velLength = inVelAry.length();
-    int countLength = emitCountPP.length();
-    if( (posLength != velLength) || (posLength != countLength) )
-        return;
-
-    // Compute total emit count.
-    //
-    int index;
-    int totalCount = 0;
-    for( index = 0; index < countLength; index ++ )
-        totalCount += emitCountPP[index];
-
-    if( totalCount <= 0 )
-        return;
-
-    // Map direction vector into world space and normalize it.
-    //
-    dirV.normalize();
-
-    // Start emission.
-    //
-    int emitCount;
-    MVector newPos, newVel;
-    MVector prePos, sPos, sVel;
-    for( index = 0; index < posLength; index++ )
-    {
-        emitCount = emitCountPP[index];
-        if( emitCount <= 0 )
-            continue;
-
-        sPos = inPosAry[index];
-        sVel = inVelAry[index];
-        prePos = sPos - sVel * dt;
-
-        for( int i = 0; i < emitCount; i++ )
-        {
-            double alpha = ( (double)i + drand48() ) / (double)emitCount;
-            newPos = (1 - alpha) * prePos + alpha * sPos;
-            newVel = dirV * speed;
-
-            newPos += newVel * ( dt * (1 - alpha) );
-            newVel += sVel * inheritFactor;
-
-            // Add new data into output arrays.
-            //
-            outPosAry.append( newPos );
-            outVelAry.append( newVel );
-        }
-    }
+    pathEmission::emit( inPosAry, inVelAry, emitCountPP, dt, speed,
+                        inheritFactor, dirV, seed, outPosAry, outVelAry );
 }
 
 
@@ -315,8 +273,7 @@ void ownerEmitter::ownerPosition
         {
             // assign vectors from block to ownerPosArray.
             //
-            for( unsigned int i = 0; i < posArray.length(); i ++ )
-                ownerPosArray.append( posArray[i] );
+            ownerPosArray = posArray;
 
             // Got position array from owner, turn hasOwnerPos on.
             //
@@ -368,8 +325,7 @@ void ownerEmitter::ownerVelocity
         {
             // assign vectors from block to ownerPosArray.
             //
-            for( unsigned int i = 0; i < velArray.length(); i ++ )
-                ownerVelArray.append( velArray[i] );
+            ownerVelArray = velArray;
 
             // Got position array from owner, turn hasOwnerPos on.
             //
@@ -565,9 +521,11 @@ MStatus ownerEmitter::emitCountPerPoint
     double dblCount = rate * dt.as( MTime::kSeconds );
 
     int intCount = (int)dblCount;
+    unsigned int first = emitCountPP.length();
+    emitCountPP.setLength( first + length );
     for( int i = 0; i < length; i++ )
     {
-        emitCountPP.append( intCount );
+        emitCountPP[first + i] = intCount;
     }
 
     return( MS::kSuccess );
@@ -44,6 +44,7 @@ private:
     void    emit( const MVectorArray &inPosAry, const MVectorArray &inVelAry,
                     const MIntArray &countAry, double dt, double speed,
                     double inheritFactor, MVector dirV,
+                    unsigned long long seed,
                     MVectorArray &outPos, MVectorArray &outVel );
 
     void    ownerPosition(MDataBlock& block, MVectorArray &array);
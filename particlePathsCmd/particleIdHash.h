@@ -14,83 +14,221 @@
 
 /*
 
-    Separate chained hash table for mapping particle ids to sample points in 
-    an efficient manner.  Since particle ID's may not be contiguous, an array 
-    may need to be arbitrarily large to index on particle ID.  The hash table
-    overcomes this limitation by allowing multiple ID's to match a single hash
-    key.
+    Table mapping particle ids to their sample points in an efficient
+    manner.  Since particle ID's may not be contiguous, an array may need to
+    be arbitrarily large to index on particle ID.  The table overcomes this
+    limitation by giving each ID a dense index, in the order the ID's are
+    first seen, through an open addressing hash table which grows as ID's
+    are added.
+
+    The samples are stored in flat arrays as they are added, one time step
+    at a time.  Once they are all added, buildRuns() groups them by index,
+    so that the samples of each particle form a contiguous run, in the order
+    they were added.  It does not depend on Maya.
+
+        ParticleIdHash hash;
+        hash.addSamples( ids, xyz, count );     // for each time step
+        hash.buildRuns();
+        for (int i = 0; i < hash.numIds(); i++)
+            for (int j = 0; j < hash.numSamples(i); j++)
+                const double* p = hash.sample(i, j);
 
 */
 
-#include <maya/MPointArray.h>
+#include <stddef.h>
+#include <vector>
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
 
 class ParticleIdHash
 {
-private:
-
-    // Element class for the hash table
-    class ParticleSample
-    {
-    public:
-        ParticleSample(int inId, MPoint& inPosition, ParticleSample* inNext) : 
-            id(inId), position(inPosition), next(inNext) {}
-        int id;                 // Particle id
-        MPoint position;        // Particle position
-        ParticleSample* next;   // Next pointer for hash table
-    };
-
 public:
-    // Constructor / Destructor
-    ParticleIdHash(int inSize) : size(inSize) {
-        if (size <= 0)
+    // Constructor.  The table starts with room for expectedIds ids.
+    explicit ParticleIdHash(int expectedIds = 1024) : mask(0), duplicates(false) {
+        size_t capacity = 16;
+        while (capacity < 2 * (size_t)(expectedIds > 0 ? expectedIds : 1))
         {
-            size = 1;   // Cannot have hash tables with 0 or less elements
+            capacity <<= 1;
         }
-        data = new ParticleSample*[size];
-        for (int i = 0; i < size; i++)
+        keys.resize(capacity);
+        slots.assign(capacity, -1);
+        mask = capacity - 1;
+        sampleStart.push_back(0);
+    }
+
+    // Index of the given id, or -1 if it was never added
+    int find(int id) const {
+        for (size_t h = hash(id) & mask; ; h = (h + 1) & mask)
         {
-            data[i] = NULL;
+            if (slots[h] < 0)
+            {
+                return -1;
+            }
+            if (keys[h] == id)
+            {
+                return slots[h];
+            }
         }
     }
-    ~ParticleIdHash() {
-        for (int i = 0; i < size; i++)
+
+    // Index of the given id, giving it the next index if it is new
+    int insert(int id) {
+        size_t h = hash(id) & mask;
+        for (; slots[h] >= 0; h = (h + 1) & mask)
         {
-            ParticleSample* sample = data[i];
-            ParticleSample* prev = NULL;
-            while (sample != NULL)
+            if (keys[h] == id)
             {
-                prev = sample;
-                sample = sample->next;
-                delete prev;
+                return slots[h];
             }
         }
-        delete [] data;
+
+        int index = (int)idList.size();
+        keys[h] = id;
+        slots[h] = index;
+        idList.push_back(id);
+        lastStep.push_back(-1);
+
+        // Keep the load factor under 1/2
+        if (2 * idList.size() > keys.size())
+        {
+            grow();
+        }
+        return index;
     }
 
-    // Add the point to the head of the list at its hash value
-    void insert(int id, MPoint& pt) {
-        ParticleSample* sample = new ParticleSample(id,pt,data[id%size]);
-        data[id%size] = sample;
+    // Makes room for the given number of samples, to avoid growing the
+    // sample arrays when their size is known in advance
+    void reserve(size_t samples) {
+        sampleIndex.reserve(samples);
+        samplePos.reserve(3 * samples);
     }
-    // Get the list of points for the given id
-    MPointArray getPoints(int id) {
-        MPointArray result;
-        ParticleSample* sample = data[id%size];
-        while (sample != NULL)
+
+    // Adds the samples of one time step: count ids and their positions,
+    // stored as x y z triples
+    void addSamples(const int* ids, const double* xyz, int count) {
+        int step = (int)sampleStart.size() - 1;
+        size_t first = sampleIndex.size();
+        sampleIndex.resize(first + count);
+        samplePos.insert(samplePos.end(), xyz, xyz + 3 * (size_t)count);
+        for (int j = 0; j < count; j++)
         {
-            if (sample->id == id)
+            int index = insert(ids[j]);
+            if (lastStep[index] == step)
             {
-                result.append(sample->position);
+                duplicates = true;
             }
-            sample = sample->next;
+            lastStep[index] = step;
+            sampleIndex[first + j] = index;
         }
-        return result;
+        sampleStart.push_back(sampleIndex.size());
+    }
+
+    // Groups the samples by id.  Call once all the samples are added.
+    void buildRuns() {
+        size_t n = idList.size();
+        std::vector<size_t> next(n + 1, 0);
+        size_t s;
+        for (s = 0; s < sampleIndex.size(); s++)
+        {
+            next[sampleIndex[s] + 1]++;
+        }
+        for (size_t i = 0; i < n; i++)
+        {
+            next[i + 1] += next[i];
+        }
+        runStart = next;
+
+        // An id appears at most once per time step, so the samples of a
+        // step can be placed in parallel, the steps being placed in order.
+        //
+        runSamples.resize(sampleIndex.size());
+        if (duplicates)
+        {
+            for (s = 0; s < sampleIndex.size(); s++)
+            {
+                runSamples[next[sampleIndex[s]]++] = s;
+            }
+        }
+        else
+        {
+            for (size_t step = 0; step + 1 < sampleStart.size(); step++)
+            {
+                tbb::parallel_for(
+                    tbb::blocked_range<size_t>(sampleStart[step], sampleStart[step + 1], 4096),
+                    [&](const tbb::blocked_range<size_t>& r) {
+                        for (size_t k = r.begin(); k != r.end(); ++k)
+                        {
+                            runSamples[next[sampleIndex[k]]++] = k;
+                        }
+                    });
+            }
+        }
+    }
+
+    // Number of ids, which are indexed in the order they were first added
+    int numIds() const { return (int)idList.size(); }
+    int id(int index) const { return idList[index]; }
+
+    // Samples of the given index, valid after buildRuns()
+    int numSamples(int index) const {
+        return (int)(runStart[index + 1] - runStart[index]);
+    }
+    const double* sample(int index, int i) const {
+        return &samplePos[3 * runSamples[runStart[index] + i]];
     }
 
 private:
-    ParticleSample** data;
-    int size;
+    static size_t hash(int id) {
+        // Murmur3 finalizer, so that ids with a common stride still
+        // spread over the table
+        unsigned int h = (unsigned int)id;
+        h ^= h >> 16;
+        h *= 0x85ebca6bu;
+        h ^= h >> 13;
+        h *= 0xc2b2ae35u;
+        h ^= h >> 16;
+        return (size_t)h;
+    }
+
+    void grow() {
+        std::vector<int> oldKeys, oldSlots;
+        oldKeys.swap(keys);
+        oldSlots.swap(slots);
+        keys.resize(2 * oldKeys.size());
+        slots.assign(2 * oldKeys.size(), -1);
+        mask = keys.size() - 1;
+        for (size_t k = 0; k < oldKeys.size(); k++)
+        {
+            if (oldSlots[k] < 0)
+            {
+                continue;
+            }
+            size_t h = hash(oldKeys[k]) & mask;
+            while (slots[h] >= 0)
+            {
+                h = (h + 1) & mask;
+            }
+            keys[h] = oldKeys[k];
+            slots[h] = oldSlots[k];
+        }
+    }
+
+    // Open addressing table, slots[h] < 0 for an empty entry
+    std::vector<int> keys;
+    std::vector<int> slots;
+    size_t mask;
+
+    std::vector<int> idList;            // id of each index
+    std::vector<int> lastStep;          // last time step of each index
+
+    std::vector<int> sampleIndex;       // index of each sample
+    std::vector<double> samplePos;      // x y z of each sample
+    std::vector<size_t> sampleStart;    // first sample of each time step
+    bool duplicates;                    // an id was added twice in a step
+
+    std::vector<size_t> runStart;       // first run sample of each index
+    std::vector<size_t> runSamples;     // samples, grouped by index
 };
 
 #endif
-
@@ -42,15 +42,25 @@
 //  -i/-increment double : Indicates the amount of time (in seconds) 
 //      between sampling the particle system.
 //
+//  -b/-benchmark int int : Instead of tracing curves, traces the given
+//      number of particles over the given number of time steps, from
+//      synthetic samples, and returns the time taken in seconds by stage 1
+//      (grouping the samples by particle ID) and by stage 2 (computing the
+//      curve points and knots, without creating the curves). The samples
+//      of 1000000 particles over 200 steps take about 7 GB.
+//
 //  In addition, a particleShape object must be specified either through the
 //  active selection or by passing the node name to the command.
 //
 //  Example:
 //      particlePaths -s 0.0 -f 3.0 -i 0.5 particleShape1
+//      particlePaths -b 1000000 200
 //
 // The particle positions will be sampled starting from the start time through
 // to the finish time in increments of the increment time. The accumulated particle positions
 // will be passed to the MFnNurbsCurve function set to create curves from the accumulated data. 
+// The points and knots of the curves are computed in parallel, a block of
+// particles at a time, and the curves of the block are then created in turn.
 //  
 
 #include <maya/MGlobal.h>
@@ -70,6 +80,12 @@
 #include <maya/MArgDatabase.h>
 #include <maya/MTime.h>
 #include <maya/MAnimControl.h>
+#include <maya/MTimer.h>
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
+#include <vector>
 
 #include "particleIdHash.h"
 
@@ -80,9 +96,15 @@ static const char *finishFlag = "-f";
 static const char *finishLongFlag = "-finish";
 static const char *incrementFlag = "-i";
 static const char *incrementLongFlag = "-increment";
+static const char *benchmarkFlag = "-b";
+static const char *benchmarkLongFlag = "-benchmark";
 
 static const double TOLERANCE = 1e-10;
 
+// Particles whose curve points are computed in parallel before the curves
+// are created
+static const int CURVE_BLOCK = 4096;
+
 //
 // particlePaths command class
 //
@@ -100,13 +122,22 @@ public:
 
 private:
     MStatus parseArgs ( const MArgList& args );
+    MStatus benchmark ();
+
+    static bool curveData ( const ParticleIdHash& hash, int index,
+                            MPointArray& points, MDoubleArray& knots );
+    static void curveBlock ( const ParticleIdHash& hash, int first, int count,
+                             std::vector<MPointArray>& points,
+                             std::vector<MDoubleArray>& knots );
 
 private:
     MObject particleNode;
     double start,finish,increment;
+    int benchmarkParticles,benchmarkSteps;
 };
 
-particlePathsCmd::particlePathsCmd() : start(0.0),finish(0.0),increment(0.0)
+particlePathsCmd::particlePathsCmd() : start(0.0),finish(0.0),increment(0.0),
+    benchmarkParticles(0),benchmarkSteps(0)
 {
 }
 
@@ -120,7 +151,8 @@ MSyntax particlePathsCmd::newSyntax() {
     syntax.addFlag( startFlag, startLongFlag, MSyntax::kDouble );
     syntax.addFlag( finishFlag, finishLongFlag, MSyntax::kDouble );
     syntax.addFlag( incrementFlag, incrementLongFlag, MSyntax::kDouble );
-    syntax.setObjectType(MSyntax::kSelectionList,1,1);
+    syntax.addFlag( benchmarkFlag, benchmarkLongFlag, MSyntax::kLong, MSyntax::kLong );
+    syntax.setObjectType(MSyntax::kSelectionList,0,1);
     syntax.useSelectionAsDefault();
     return syntax;
 }
@@ -130,6 +162,18 @@ MStatus particlePathsCmd::parseArgs( const MArgList& args )
 {
     MArgDatabase argData(syntax(), args);
 
+    if (argData.isFlagSet(benchmarkFlag))
+    {
+        argData.getFlagArgument(benchmarkFlag, 0, benchmarkParticles);
+        argData.getFlagArgument(benchmarkFlag, 1, benchmarkSteps);
+        if (benchmarkParticles <= 0 || benchmarkSteps <= 0)
+        {
+            MGlobal::displayError( "Invalid benchmark arguments." );
+            return MS::kFailure;
+        }
+        return MS::kSuccess;
+    }
+
     //
     // Parse the time flags
     //
@@ -196,6 +240,11 @@ MStatus particlePathsCmd::doIt( const MArgList& args )
         return stat;
     }
 
+    if( benchmarkParticles > 0 )
+    {
+        return benchmark();
+    }
+
     MFnParticleSystem cloud( particleNode );
 
     if( ! cloud.isValid() )
@@ -210,14 +259,10 @@ MStatus particlePathsCmd::doIt( const MArgList& args )
     // use the data that was collected to create curves.
     //
 
-    // Create the particle hash table at a fixed size.  This should work fine
-    // for small particle systems, but may become inefficient for larger ones.
-    // If the plugin is running very slow, increase the size.  The value should
-    // be roughly the number of particles that are expected to be emitted
-    // within the time period.
+    // The particle table grows with the number of particles, so its
+    // initial size only needs to be a guess.
     //
     ParticleIdHash hash(1024);
-    MIntArray idList;
 
     //
     // Stage 1
@@ -225,7 +270,7 @@ MStatus particlePathsCmd::doIt( const MArgList& args )
 
     MVectorArray positions;
     MIntArray ids;
-    int i = 0;
+    std::vector<double> xyz;
     for (double time = start; time <= finish + TOLERANCE; time += increment)
     {
         MTime timeSeconds(time,MTime::kSeconds);
@@ -257,75 +302,195 @@ MStatus particlePathsCmd::doIt( const MArgList& args )
             return MS::kFailure;
         }
 
-        for (int j = 0; j < (int)cloud.count(); j++)
+        int count = (int)cloud.count();
+        if (count == 0)
         {
-            // Uncomment to show particle positions as the plugin accumulates
-            // samples.
-            /*
-            MGlobal::displayInfo(MString("(") + (positions[j])[0] + MString(",") + 
-                (positions[j])[1] + MString(",") + (positions[j])[2] + MString(")"));
-            */
-
-            MPoint pt(positions[j]);
-            if (hash.getPoints(ids[j]).length() == 0)
-            {
-                idList.append(ids[j]);
-            }
-            hash.insert(ids[j],pt);
+            continue;
         }
 
-        i++;
+        xyz.resize(3 * (size_t)count);
+        for (int j = 0; j < count; j++)
+        {
+            xyz[3*j]   = positions[j].x;
+            xyz[3*j+1] = positions[j].y;
+            xyz[3*j+2] = positions[j].z;
+        }
+        hash.addSamples(&ids[0], &xyz[0], count);
     }
-    
+
+    hash.buildRuns();
+
     //
     // Stage 2
     //
 
-    for (i = 0; i < (int)(idList.length()); i++)
+    std::vector<MPointArray> points;
+    std::vector<MDoubleArray> knots;
+    for (int first = 0; first < hash.numIds(); first += CURVE_BLOCK)
     {
-        MPointArray points = hash.getPoints(idList[i]);
-
-        // Don't bother with single samples
-        if (points.length() <= 1)
+        int count = hash.numIds() - first;
+        if (count > CURVE_BLOCK)
         {
-            continue;
+            count = CURVE_BLOCK;
         }
+        curveBlock(hash, first, count, points, knots);
 
-        // Add two additional points, so that the curve covers all sampled
-        // values.
-        //
-        MPoint p1 = points[0]*2 - points[1];
-        MPoint p2 = points[points.length()-1]*2 - points[points.length()-2];
-        points.insert(p1,0);
-        points.append(p2);
-
-        // Uncomment to show information about the generated curves
-        /*
-        MGlobal::displayInfo( MString("ID ") + (int)(idList[i]) + " has " + (int)(points.length()) + " curve points.");
-        for (int j = 0; j < (int)(points.length()); j++)
+        for (int i = 0; i < count; i++)
         {
-            MGlobal::displayInfo(MString("(") + points[j][0] + MString(",") + points[j][1] + MString(",") + points[j][2] + MString(")"));
-        }
-        */
+            // Don't bother with single samples
+            if (points[i].length() == 0)
+            {
+                continue;
+            }
 
-        MDoubleArray knots;
-        knots.insert(0.0,0);
-        for (int j = 0; j < (int)(points.length()); j++)
-        {
-            knots.append((double)j);
+            // Uncomment to show information about the generated curves
+            /*
+            MGlobal::displayInfo( MString("ID ") + hash.id(first + i) + " has " + (int)(points[i].length()) + " curve points.");
+            for (int j = 0; j < (int)(points[i].length()); j++)
+            {
+                MGlobal::displayInfo(MString("(") + points[i][j][0] + MString(",") + points[i][j][1] + MString(",") + points[i][j][2] + MString(")"));
+            }
+            */
+
+            MStatus status;
+            MObject dummy;
+            MFnNurbsCurve curve;
+            curve.create(points[i],knots[i],3,MFnNurbsCurve::kOpen,false,false,dummy,&status);
+            if (!status)
+            {
+                MGlobal::displayError("Failed to create nurbs curve.");
+                return MS::kFailure;
+            }
         }
-        knots.append(points.length()-1);
+    }
 
-        MStatus status;
-        MObject dummy;
-        MFnNurbsCurve curve;
-        curve.create(points,knots,3,MFnNurbsCurve::kOpen,false,false,dummy,&status);
-        if (!status)
+    return MS::kSuccess;
+}
+
+//
+// Computes the curve points and knots of the particle with the given index
+// in the table.  Returns false, leaving them empty, for particles with a
+// single sample.
+//
+
+bool particlePathsCmd::curveData( const ParticleIdHash& hash, int index,
+                                  MPointArray& points, MDoubleArray& knots )
+{
+    points.clear();
+    knots.clear();
+
+    int n = hash.numSamples(index);
+    if (n <= 1)
+    {
+        return false;
+    }
+
+    // Add two additional points, so that the curve covers all sampled
+    // values.
+    //
+    points.setLength(n + 2);
+    for (int j = 0; j < n; j++)
+    {
+        const double* p = hash.sample(index, j);
+        points[j+1] = MPoint(p[0], p[1], p[2]);
+    }
+    points[0] = points[1]*2 - points[2];
+    points[n+1] = points[n]*2 - points[n-1];
+
+    knots.setLength(n + 4);
+    knots[0] = 0.0;
+    for (int j = 0; j < n + 2; j++)
+    {
+        knots[j+1] = (double)j;
+    }
+    knots[n+3] = (double)(n + 1);
+
+    return true;
+}
+
+//
+// Computes the curve points and knots of count particles from the given
+// index, in parallel.
+//
+
+void particlePathsCmd::curveBlock( const ParticleIdHash& hash, int first, int count,
+                                   std::vector<MPointArray>& points,
+                                   std::vector<MDoubleArray>& knots )
+{
+    points.resize(count);
+    knots.resize(count);
+    tbb::parallel_for(tbb::blocked_range<int>(0, count, 64),
+        [&](const tbb::blocked_range<int>& r) {
+            for (int i = r.begin(); i != r.end(); ++i)
+            {
+                curveData(hash, first + i, points[i], knots[i]);
+            }
+        });
+}
+
+//
+// Times both stages on benchmarkParticles particles sampled benchmarkSteps
+// times.  A hundredth of the particles dies and is replaced by new ones at
+// every step, so that the ids are not the same from step to step.
+//
+
+MStatus particlePathsCmd::benchmark()
+{
+    const int churn = benchmarkParticles / 100;
+
+    std::vector<int> ids(benchmarkParticles);
+    std::vector<double> xyz(3 * (size_t)benchmarkParticles);
+    ParticleIdHash hash(benchmarkParticles);
+    hash.reserve((size_t)benchmarkParticles * benchmarkSteps);
+
+    MTimer timer;
+    double stage1 = 0.0;
+    for (int step = 0; step < benchmarkSteps; step++)
+    {
+        const int firstId = step * churn;
+        const double t = 0.04 * step;
+        tbb::parallel_for(tbb::blocked_range<int>(0, benchmarkParticles, 4096),
+            [&](const tbb::blocked_range<int>& r) {
+                for (int j = r.begin(); j != r.end(); ++j)
+                {
+                    int id = firstId + j;
+                    ids[j] = id;
+                    xyz[3*j]   = (id % 1000) * 0.01 + t;
+                    xyz[3*j+1] = t * (5.0 - 4.9 * t);
+                    xyz[3*j+2] = (id / 1000 % 1000) * 0.01;
+                }
+            });
+
+        timer.beginTimer();
+        hash.addSamples(&ids[0], &xyz[0], benchmarkParticles);
+        timer.endTimer();
+        stage1 += timer.elapsedTime();
+    }
+
+    timer.beginTimer();
+    hash.buildRuns();
+    timer.endTimer();
+    stage1 += timer.elapsedTime();
+
+    timer.beginTimer();
+    std::vector<MPointArray> points;
+    std::vector<MDoubleArray> knots;
+    for (int first = 0; first < hash.numIds(); first += CURVE_BLOCK)
+    {
+        int count = hash.numIds() - first;
+        if (count > CURVE_BLOCK)
         {
-            MGlobal::displayError("Failed to create nurbs curve.");
-            return MS::kFailure;
+            count = CURVE_BLOCK;
         }
+        curveBlock(hash, first, count, points, knots);
     }
+    timer.endTimer();
+    double stage2 = timer.elapsedTime();
+
+    MDoubleArray result;
+    result.append(stage1);
+    result.append(stage2);
+    setResult(result);
 
     return MS::kSuccess;
 }
@@ -0,0 +1,202 @@
+//-
+// ==========================================================================
+// Copyright 1995,2006,2008 Autodesk, Inc. All rights reserved.
+//
+// Use of this software is subject to the terms of the Autodesk
+// license agreement provided at the time of installation or download,
+// or which otherwise accompanies this software in either electronic
+// or hard copy form.
+// ==========================================================================
+//+
+
+//
+//
+
+//polyRawBinaryExporter.cpp
+#include <maya/MGlobal.h>
+#include <maya/MDagPath.h>
+#include <maya/MFileObject.h>
+
+#include "polyRawBinaryExporter.h"
+#include "polyRawBinaryWriter.h"
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
+#include <cstring>
+#include <fstream>
+#include <ios>
+
+namespace
+{
+    const unsigned int kFileVersion = 1;
+
+    unsigned long long alignUp(unsigned long long n)
+    {
+        return (n + 15) & ~15ull;
+    }
+}
+
+
+polyRawBinaryExporter::~polyRawBinaryExporter()
+{
+//Summary:  destructor method; frees any writers left over from a failed export
+//
+    clearWriters();
+}
+
+
+void* polyRawBinaryExporter::creator()
+//Summary:  allows Maya to allocate an instance of this object
+{
+    return new polyRawBinaryExporter();
+}
+
+
+MString polyRawBinaryExporter::defaultExtension () const
+//Summary:  called when Maya needs to know the preferred extension of this file
+//          format.
+//Returns:  "rawb"
+{
+    return MString("rawb");
+}
+
+
+MStatus polyRawBinaryExporter::writer(const MFileObject& file,
+                                      const MString& /*options*/,
+                                      MPxFileTranslator::FileAccessMode mode)
+//Summary:  saves all or the selected poly meshes (depending on mode) to the
+//          given file.  The meshes are gathered first, packed in parallel,
+//          and then written one after the other.
+//Args   :  file - object containing the pathname of the file to be written to
+//          options - a string representation of any file options
+//          mode - the method used to write the file - export, or export active
+//                 are valid values; method will fail for any other values
+//Returns:  MStatus::kSuccess if the export was successful;
+//          MStatus::kFailure otherwise
+{
+    const MString fileName = file.expandedFullName();
+
+    std::ofstream newFile(fileName.asChar(), std::ios::out | std::ios::binary);
+    if (!newFile) {
+        MGlobal::displayError(fileName + ": could not be opened for writing");
+        return MS::kFailure;
+    }
+
+    //extract the geometry of the meshes to export; processPolyMesh() keeps
+    //the writers instead of writing them out
+    //
+    clearWriters();
+    MStatus status;
+    if (MPxFileTranslator::kExportAccessMode == mode) {
+        status = exportAll(newFile);
+    } else if (MPxFileTranslator::kExportActiveAccessMode == mode) {
+        status = exportSelection(newFile);
+    } else {
+        status = MStatus::kFailure;
+    }
+    if (MStatus::kFailure == status) {
+        clearWriters();
+        return MStatus::kFailure;
+    }
+
+    //pack every mesh into its own buffer
+    //
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, fWriters.size()),
+        [this](const tbb::blocked_range<size_t>& r) {
+            for (size_t i = r.begin(); i != r.end(); ++i) {
+                fWriters[i]->pack();
+            }
+        });
+
+    //header and mesh table, then the meshes themselves
+    //
+    unsigned int meshCount = (unsigned int) fWriters.size();
+
+    FileHeader header;
+    memcpy(header.magic, "PRWB", 4);
+    header.version = kFileVersion;
+    header.meshCount = meshCount;
+    header.reserved = 0;
+
+    std::vector<MeshEntry> table(meshCount);
+    unsigned long long offset = alignUp(sizeof(FileHeader) + meshCount * sizeof(MeshEntry));
+    unsigned int i;
+    for (i = 0; i < meshCount; i++) {
+        table[i].offset = offset;
+        table[i].size = fWriters[i]->packedData().size();
+        offset = alignUp(offset + table[i].size);
+    }
+
+    static const char padding[16] = { 0 };
+    unsigned long long written = sizeof(FileHeader) + meshCount * sizeof(MeshEntry);
+
+    newFile.write((const char*) &header, sizeof(header));
+    if (meshCount > 0) {
+        newFile.write((const char*) &table[0], meshCount * sizeof(MeshEntry));
+    }
+
+    for (i = 0; i < meshCount && newFile; i++) {
+        newFile.write(padding, (std::streamsize) (table[i].offset - written));
+        MGlobal::displayInfo("Exporting " + fWriters[i]->meshName());
+        if (MStatus::kFailure == fWriters[i]->writeToFile(newFile)) {
+            break;
+        }
+        fWriters[i]->releasePackedData();
+        written = table[i].offset + table[i].size;
+    }
+
+    clearWriters();
+    newFile.close();
+
+    if (!newFile) {
+        MGlobal::displayError(fileName + ": write failed");
+        return MS::kFailure;
+    }
+
+    MGlobal::displayInfo("Export to " + fileName + " successful!");
+    return MS::kSuccess;
+}
+
+
+MStatus polyRawBinaryExporter::processPolyMesh(const MDagPath dagPath, std::ostream& /*os*/)
+//Summary:  extracts the geometry of the mesh on the given dag path and keeps
+//          the writer so that it can be packed with the others
+//Args   :  dagPath - the current dag path whose poly mesh is to be processed
+//Returns:  MStatus::kSuccess if the polygonal mesh data was extracted;
+//          MStatus::kFailure otherwise
+{
+    MStatus status;
+    polyRawBinaryWriter* pWriter = new polyRawBinaryWriter(dagPath, status);
+    if (MStatus::kFailure == status) {
+        delete pWriter;
+        return MStatus::kFailure;
+    }
+    if (MStatus::kFailure == pWriter->extractGeometry()) {
+        delete pWriter;
+        return MStatus::kFailure;
+    }
+    fWriters.push_back(pWriter);
+    return MStatus::kSuccess;
+}
+
+
+void polyRawBinaryExporter::clearWriters()
+//Summary:  deletes the writers created by processPolyMesh()
+{
+    for (size_t i = 0; i < fWriters.size(); i++) {
+        delete fWriters[i];
+    }
+    fWriters.clear();
+}
+
+
+polyWriter* polyRawBinaryExporter::createPolyWriter(const MDagPath dagPath, MStatus& status)
+//Summary:  creates a polyWriter for the binary raw export file type
+//Args   :  dagPath - the current polygon dag path
+//          status - will be set to MStatus::kSuccess if the polyWriter was
+//                   created successfully;  MStatus::kFailure otherwise
+//Returns:  pointer to the new polyWriter object
+{
+    return new polyRawBinaryWriter(dagPath, status);
+}
@@ -0,0 +1,82 @@
+//-
+// ==========================================================================
+// Copyright 1995,2006,2008 Autodesk, Inc. All rights reserved.
+//
+// Use of this software is subject to the terms of the Autodesk
+// license agreement provided at the time of installation or download,
+// or which otherwise accompanies this software in either electronic
+// or hard copy form.
+// ==========================================================================
+//+
+
+#ifndef __POLYRAWBINARYEXPORTER_H
+#define __POLYRAWBINARYEXPORTER_H
+
+// polyRawBinaryExporter.h
+
+// *****************************************************************************
+//
+// CLASS:    polyRawBinaryExporter
+//
+// *****************************************************************************
+//
+// CLASS DESCRIPTION (polyRawBinaryExporter)
+//
+// polyRawBinaryExporter is a class derived from polyExporter.  It exports the
+// same polygonal mesh data as polyRawExporter in a binary format meant to be
+// read by tools rather than people.  The file extension for this type is
+// ".rawb".
+//
+// The geometry of every mesh is first extracted on the main thread, then the
+// meshes are packed into separate buffers in parallel and the buffers are
+// concatenated into the file:
+//
+//    FileHeader      magic "PRWB", version, mesh count
+//    MeshEntry[]     file offset and size of each mesh
+//    meshes          each one aligned to 16 bytes, see polyRawBinaryWriter
+//
+// *****************************************************************************
+
+#include "polyExporter.h"
+
+#include <iosfwd>
+#include <vector>
+
+class polyRawBinaryWriter;
+
+class polyRawBinaryExporter : public polyExporter {
+
+    public:
+        struct FileHeader {
+            char                magic[4];
+            unsigned int        version;
+            unsigned int        meshCount;
+            unsigned int        reserved;
+        };
+
+        struct MeshEntry {
+            unsigned long long  offset;
+            unsigned long long  size;
+        };
+
+                                polyRawBinaryExporter(){}
+                            ~polyRawBinaryExporter() override;
+
+        static  void*           creator();
+                MString         defaultExtension () const override;
+                MStatus         writer (const MFileObject& file,
+                                        const MString& optionsString,
+                                        MPxFileTranslator::FileAccessMode mode) override;
+
+
+    private:
+                polyWriter*     createPolyWriter(const MDagPath dagPath, MStatus& status) override;
+                MStatus         processPolyMesh(const MDagPath dagPath, std::ostream& os) override;
+                void            clearWriters();
+
+        //meshes extracted by processPolyMesh(), waiting to be packed
+        //
+        std::vector<polyRawBinaryWriter*>   fWriters;
+};
+
+#endif /*__POLYRAWBINARYEXPORTER_H*/
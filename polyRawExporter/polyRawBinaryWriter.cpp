@@ -0,0 +1,287 @@
+//-
+// ==========================================================================
+// Copyright 1995,2006,2008 Autodesk, Inc. All rights reserved.
+//
+// Use of this software is subject to the terms of the Autodesk
+// license agreement provided at the time of installation or download,
+// or which otherwise accompanies this software in either electronic
+// or hard copy form.
+// ==========================================================================
+//+
+
+//
+//
+
+//polyRawBinaryWriter.cpp
+
+//General Includes
+//
+#include <maya/MIOStream.h>
+#include <maya/MGlobal.h>
+#include <maya/MIntArray.h>
+#include <maya/MDagPath.h>
+#include <maya/MFnMesh.h>
+
+//Header File
+//
+#include "polyRawBinaryWriter.h"
+
+#include <cstring>
+#include <functional>
+
+namespace
+{
+    const size_t kAlignment = 16;
+
+    size_t alignUp(size_t n)
+    {
+        return (n + kAlignment - 1) & ~(kAlignment - 1);
+    }
+
+    size_t elementSize(unsigned int elementType)
+    {
+        return (polyRawBinaryWriter::kChar == elementType) ? 1 : 4;
+    }
+}
+
+
+polyRawBinaryWriter::polyRawBinaryWriter(const MDagPath& dagPath, MStatus& status):
+polyWriter(dagPath, status)
+//Summary:  creates and initializes an object of this class
+//Args   :  dagPath - the DAG path of the current node
+//          status - will be set to MStatus::kSuccess if the constructor was
+//                   successful;  MStatus::kFailure otherwise
+{
+}
+
+
+polyRawBinaryWriter::~polyRawBinaryWriter()
+//Summary:  deletes the objects created by this class
+{
+}
+
+
+MStatus polyRawBinaryWriter::extractGeometry()
+//Summary:  extracts the main geometry, the connectivity, all UV sets with
+//          their coordinates and assignments, and the component sets.  Only
+//          whole-array getters are used so the cost does not depend on the
+//          number of faces.
+//Returns:  MStatus::kSuccess if the method succeeds
+//          MStatus::kFailure if the method fails
+{
+    if (MStatus::kFailure == polyWriter::extractGeometry()) {
+        return MStatus::kFailure;
+    }
+
+    fMeshName = fMesh->partialPathName();
+
+    if (MStatus::kFailure == fMesh->getVertices(fFaceCounts, fFaceVertices)) {
+        MGlobal::displayError("MFnMesh::getVertices");
+        return MStatus::kFailure;
+    }
+
+    MIntArray normalCounts;
+    if (MStatus::kFailure == fMesh->getNormalIds(normalCounts, fNormalIds)) {
+        MGlobal::displayError("MFnMesh::getNormalIds");
+        return MStatus::kFailure;
+    }
+
+    if (MStatus::kFailure == fMesh->getUVSetNames(fUVSetNames)) {
+        MGlobal::displayError("MFnMesh::getUVSetNames");
+        return MStatus::kFailure;
+    }
+
+    unsigned int uvSetCount = fUVSetNames.length();
+    fUArrays.resize(uvSetCount);
+    fVArrays.resize(uvSetCount);
+    fUVCounts.resize(uvSetCount);
+    fUVIds.resize(uvSetCount);
+
+    unsigned int i;
+    for (i = 0; i < uvSetCount; i++) {
+        if (MStatus::kFailure == fMesh->getUVs(fUArrays[i], fVArrays[i], &fUVSetNames[i])) {
+            MGlobal::displayError("MFnMesh::getUVs");
+            return MStatus::kFailure;
+        }
+        if (MStatus::kFailure == fMesh->getAssignedUVs(fUVCounts[i], fUVIds[i], &fUVSetNames[i])) {
+            MGlobal::displayError("MFnMesh::getAssignedUVs");
+            return MStatus::kFailure;
+        }
+    }
+
+    //the set lookups go through the dependency graph, so they are done here
+    //rather than in pack().  outputSingleSet() only records the sets, nothing
+    //is written to the stream.
+    //
+    std::ostream discard(NULL);
+    if (MStatus::kFailure == outputSets(discard)) {
+        return MStatus::kFailure;
+    }
+
+    return MStatus::kSuccess;
+}
+
+
+MStatus polyRawBinaryWriter::outputSingleSet(ostream& /*os*/, MString setName, MIntArray faces, MString textureName)
+//Summary:  records a set, its face components and any associated texture so
+//          that they can be packed later
+//Returns:  MStatus::kSuccess
+{
+    fSetNames.append(setName);
+    fSetTextures.append(textureName);
+    fSetFaces.push_back(faces);
+    return MStatus::kSuccess;
+}
+
+
+void polyRawBinaryWriter::pack()
+//Summary:  lays out the extracted data as a mesh header, a block directory
+//          and the block data into a single buffer.  No Maya function sets
+//          are used, so meshes may be packed concurrently.
+{
+    std::vector<BlockEntry> entries;
+    std::vector<std::function<void (char*)> > fills;
+
+    auto addBlock = [&](unsigned int type, unsigned int elementType,
+                        unsigned int count, unsigned int width,
+                        std::function<void (char*)> fill) {
+        BlockEntry entry;
+        entry.type = type;
+        entry.elementType = elementType;
+        entry.count = count;
+        entry.width = width;
+        entry.offset = 0;
+        entry.size = (unsigned long long) count * width * elementSize(elementType);
+        entries.push_back(entry);
+        fills.push_back(fill);
+    };
+
+    auto addInts = [&](unsigned int type, const MIntArray& array) {
+        const MIntArray* src = &array;
+        addBlock(type, kInt32, array.length(), 1, [src](char* dst) {
+            src->get((int*) dst);
+        });
+    };
+
+    auto addString = [&](unsigned int type, const MString& str) {
+        const char* src = str.asChar();
+        unsigned int length = (unsigned int) strlen(src);
+        addBlock(type, kChar, length, 1, [src, length](char* dst) {
+            memcpy(dst, src, length);
+        });
+    };
+
+    auto addVectors = [&](unsigned int type, const MFloatVectorArray& array) {
+        const MFloatVectorArray* src = &array;
+        addBlock(type, kFloat32, array.length(), 3, [src](char* dst) {
+            src->get((float (*)[3]) dst);
+        });
+    };
+
+    addInts(kFaceCounts, fFaceCounts);
+    addInts(kFaceVertices, fFaceVertices);
+
+    addBlock(kPoints, kFloat32, fVertexArray.length(), 3, [this](char* dst) {
+        float* out = (float*) dst;
+        unsigned int n = fVertexArray.length();
+        for (unsigned int i = 0; i < n; i++) {
+            const MPoint& p = fVertexArray[i];
+            *out++ = (float) p.x;
+            *out++ = (float) p.y;
+            *out++ = (float) p.z;
+        }
+    });
+
+    addBlock(kColors, kFloat32, fColorArray.length(), 4, [this](char* dst) {
+        fColorArray.get((float (*)[4]) dst);
+    });
+
+    addVectors(kNormals, fNormalArray);
+    addInts(kNormalIds, fNormalIds);
+    addVectors(kTangents, fTangentArray);
+    addVectors(kBinormals, fBinormalArray);
+
+    unsigned int i;
+    for (i = 0; i < fUVSetNames.length(); i++) {
+        const MFloatArray* uArray = &fUArrays[i];
+        const MFloatArray* vArray = &fVArrays[i];
+
+        addString(kUVSetName, fUVSetNames[i]);
+        addBlock(kUVs, kFloat32, uArray->length(), 2, [uArray, vArray](char* dst) {
+            float* out = (float*) dst;
+            unsigned int n = uArray->length();
+            for (unsigned int j = 0; j < n; j++) {
+                *out++ = (*uArray)[j];
+                *out++ = (*vArray)[j];
+            }
+        });
+        addInts(kUVCounts, fUVCounts[i]);
+        addInts(kUVIds, fUVIds[i]);
+    }
+
+    for (i = 0; i < fSetNames.length(); i++) {
+        addString(kSetName, fSetNames[i]);
+        addInts(kSetFaces, fSetFaces[i]);
+        addString(kSetTexture, fSetTextures[i]);
+    }
+
+    //assign the offsets
+    //
+    unsigned int nameLength = (unsigned int) strlen(fMeshName.asChar());
+    size_t cursor = alignUp(sizeof(MeshHeader) + alignUp(nameLength) +
+                            entries.size() * sizeof(BlockEntry));
+    size_t k;
+    for (k = 0; k < entries.size(); k++) {
+        entries[k].offset = cursor;
+        cursor = alignUp(cursor + (size_t) entries[k].size);
+    }
+
+    fPacked.assign(cursor, 0);
+    char* base = &fPacked[0];
+
+    MeshHeader header;
+    memcpy(header.magic, "PRWM", 4);
+    header.nameLength = nameLength;
+    header.blockCount = (unsigned int) entries.size();
+    header.reserved = 0;
+    memcpy(base, &header, sizeof(header));
+    memcpy(base + sizeof(header), fMeshName.asChar(), nameLength);
+
+    if (!entries.empty()) {
+        memcpy(base + sizeof(header) + alignUp(nameLength),
+               &entries[0], entries.size() * sizeof(BlockEntry));
+    }
+
+    for (k = 0; k < entries.size(); k++) {
+        if (entries[k].size > 0) {
+            fills[k](base + entries[k].offset);
+        }
+    }
+}
+
+
+void polyRawBinaryWriter::releasePackedData()
+//Summary:  frees the buffer filled by pack() once it has been written
+{
+    std::vector<char>().swap(fPacked);
+}
+
+
+MStatus polyRawBinaryWriter::writeToFile(ostream& os)
+//Summary:  outputs the packed geometry of this polygonal mesh
+//Args   :  os - an output stream to write to
+//Returns:  MStatus::kSuccess if the method succeeds
+//          MStatus::kFailure if the method fails
+{
+    if (fPacked.empty()) {
+        pack();
+    }
+
+    os.write(&fPacked[0], fPacked.size());
+    if (!os) {
+        MGlobal::displayError("Failed writing " + fMeshName);
+        return MStatus::kFailure;
+    }
+
+    return MStatus::kSuccess;
+}
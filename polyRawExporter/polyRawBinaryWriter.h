@@ -0,0 +1,155 @@
+//-
+// ==========================================================================
+// Copyright 1995,2006,2008 Autodesk, Inc. All rights reserved.
+//
+// Use of this software is subject to the terms of the Autodesk
+// license agreement provided at the time of installation or download,
+// or which otherwise accompanies this software in either electronic
+// or hard copy form.
+// ==========================================================================
+//+
+
+#ifndef __POLYRAWBINARYWRITER_H
+#define __POLYRAWBINARYWRITER_H
+
+// polyRawBinaryWriter.h
+
+//
+// *****************************************************************************
+//
+// CLASS:    polyRawBinaryWriter
+//
+// *****************************************************************************
+//
+// CLASS DESCRIPTION (polyRawBinaryWriter)
+//
+// polyRawBinaryWriter is a class derived from polyWriter.  It outputs the same
+// polygonal mesh data as polyRawWriter, but as contiguous typed blocks instead
+// of formatted text:
+// - face vertex counts and vertex indices
+// - vertex coordinates
+// - colors per face vertex
+// - normals, normal indices, tangents and binormals
+// - every uv set with its coordinates and per face vertex uv indices
+// - component sets and their file textures
+//
+// All the data is pulled from the mesh with the bulk MFnMesh array getters in
+// extractGeometry(), which must run on the main thread.  pack() then lays the
+// blocks out into a memory buffer without touching Maya and may be called
+// from any thread.
+//
+// A packed mesh is laid out as:
+//
+//    MeshHeader      magic "PRWM", name length, block count
+//    name            padded to 16 bytes
+//    BlockEntry[]    one per block, offsets relative to the mesh start
+//    block data      each block aligned to 16 bytes
+//
+// Coordinates are converted to single precision.  Values are written in host
+// byte order.  Blocks that repeat (uv sets, sets) are preceded by a kUVSetName
+// or kSetName block that names them.
+//
+// *****************************************************************************
+
+#include "polyWriter.h"
+
+#include <maya/MStringArray.h>
+
+#include <iosfwd>
+#include <vector>
+
+class polyRawBinaryWriter : public polyWriter {
+
+    public:
+        // Block types
+        //
+        enum BlockType {
+            kFaceCounts = 1,    // int32,   one per face
+            kFaceVertices,      // int32,   vertex index per face vertex
+            kPoints,            // float32 x 3
+            kColors,            // float32 x 4, one per face vertex
+            kNormals,           // float32 x 3
+            kNormalIds,         // int32,   normal index per face vertex
+            kTangents,          // float32 x 3
+            kBinormals,         // float32 x 3
+            kUVSetName,         // char,    followed by the next three blocks
+            kUVs,               // float32 x 2
+            kUVCounts,          // int32,   uvs assigned per face
+            kUVIds,             // int32,   uv index per assigned face vertex
+            kSetName,           // char,    followed by the next two blocks
+            kSetFaces,          // int32
+            kSetTexture         // char,    empty when there is no texture
+        };
+
+        // Element types
+        //
+        enum ElementType {
+            kInt32 = 1,
+            kFloat32,
+            kChar
+        };
+
+        struct MeshHeader {
+            char                magic[4];
+            unsigned int        nameLength;
+            unsigned int        blockCount;
+            unsigned int        reserved;
+        };
+
+        struct BlockEntry {
+            unsigned int        type;
+            unsigned int        elementType;
+            unsigned int        count;
+            unsigned int        width;
+            unsigned long long  offset;
+            unsigned long long  size;
+        };
+
+                        polyRawBinaryWriter (const MDagPath& dagPath, MStatus& status);
+                    ~polyRawBinaryWriter () override;
+                MStatus extractGeometry () override;
+                MStatus writeToFile (std::ostream& os) override;
+
+                void    pack ();
+                const std::vector<char>& packedData () const { return fPacked; }
+                void    releasePackedData ();
+                MString meshName () const { return fMeshName; }
+
+    private:
+        //Functions
+        //
+                MStatus outputSingleSet (std::ostream& os,
+                                         MString setName,
+                                         MIntArray faces,
+                                         MString textureName) override;
+
+        //Data Members
+        //
+        MString             fMeshName;
+
+        //connectivity
+        //
+        MIntArray           fFaceCounts;
+        MIntArray           fFaceVertices;
+        MIntArray           fNormalIds;
+
+        //uv sets, in the order of fUVSetNames
+        //
+        MStringArray                fUVSetNames;
+        std::vector<MFloatArray>    fUArrays;
+        std::vector<MFloatArray>    fVArrays;
+        std::vector<MIntArray>      fUVCounts;
+        std::vector<MIntArray>      fUVIds;
+
+        //component sets, filled in by outputSingleSet()
+        //
+        MStringArray                fSetNames;
+        MStringArray                fSetTextures;
+        std::vector<MIntArray>      fSetFaces;
+
+        //the result of pack()
+        //
+        std::vector<char>   fPacked;
+};
+
+#endif /*__POLYRAWBINARYWRITER_H*/
@@ -18,6 +18,7 @@
 
 #include "polyRawExporter.h"
 #include "polyRawWriter.h"
+#include "polyRawBinaryExporter.h"
 
 #include <sstream>
 
@@ -69,6 +70,17 @@ MStatus initializePlugin(MObject obj)
         return status;
     }
 
+    status =  plugin.registerFileTranslator("RawBinary",
+                                            "",
+                                            polyRawBinaryExporter::creator,
+                                            "",
+                                            "",
+                                            true);
+    if (!status) {
+        status.perror("registerFileTranslator");
+        return status;
+    }
+
     return status;
 }
 
@@ -88,6 +100,12 @@ MStatus uninitializePlugin(MObject obj)
         return status;
     }
 
+    status =  plugin.deregisterFileTranslator("RawBinary");
+    if (!status) {
+        status.perror("deregisterFileTranslator");
+        return status;
+    }
+
     return status;
 }
 
@@ -16,6 +16,15 @@
 // This example demonstrates how to use the new MPxFluidEmitterNode class
 // to implement most of the functionality in Maya's standard fluid emitters. 
 //
+// The omni and volume emitters only visit the voxels overlapped by the
+// bounds of each emission point or volume, the omni emitter a z-slab per
+// task, and the surface emitter places its samples in parallel.  Density,
+// heat and fuel are added straight into the fluid's grids; color still
+// goes through MFnFluid::emitIntoArrays(), which blends it, one sample at
+// a time.  Jittered samples are
+// drawn from a per-voxel hash seeded by the emitter's random stream, so
+// they do not depend on the number of threads.
+//
 // MEL usage:
 //  
 //  createNode simpleFluidEmitter -name simpleFluidEmitter;
@@ -84,6 +93,16 @@
 #include <maya/MFnDynSweptGeometryData.h>
 #include <maya/MDynSweptTriangle.h>
 #include <maya/MPlugArray.h>
+#include <maya/MBoundingBox.h>
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <tbb/parallel_sort.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "../common/emitterJitter.h"
 
 
 MTypeId simpleFluidEmitter::id( 0x81020 );
@@ -342,6 +361,226 @@ simpleFluidEmitter::fluidEmitter(
 #define MIN(x,y) ((x)<(y)?(x):(y))
 #define MAX(x,y) ((x)>(y)?(x):(y))
 
+//  Voxels the emission kernels hand to a task: z-slabs for the omni and
+//  volume emitters, samples for the surface emitter.
+//
+#define kSlabGrainSize      1
+#define kSampleGrainSize    4096
+
+//  Slabs evaluated before being emitted through MFnFluid::emitIntoArrays()
+//  when color is emitted.
+//
+#define kColorSlabBatch     8
+
+//  Voxels of a row whose samples the omni emitter evaluates together, in
+//  loops without branches on the data
+//
+#define kRowChunk           64
+
+//  Direct access to the grids that the emission kernels write into.  The
+//  grids are flat arrays, index(i,j,k) being linear in i, j and k.
+//
+struct EmissionGrid
+{
+    float*  density;
+    float*  temperature;
+    float*  fuel;
+    float*  falloff;
+    int     origin;             //  index(0,0,0)
+    int     stride[3];
+    float   densityEmit;
+    float   heatEmit;
+    float   fuelEmit;
+
+    //  color is blended by the fluid, so emission goes through
+    //  MFnFluid::emitIntoArrays(), one voxel at a time
+    //
+    bool    throughFluid;
+
+    int index( int i, int j, int k ) const
+    {
+        return origin + i*stride[0] + j*stride[1] + k*stride[2];
+    }
+
+    //  the increments emitIntoArrays() makes to density, heat and fuel
+    //
+    void emit( int idx, float value ) const
+    {
+        if( density != NULL )       density[idx] += value * densityEmit;
+        if( temperature != NULL )   temperature[idx] += value * heatEmit;
+        if( fuel != NULL )          fuel[idx] += value * fuelEmit;
+    }
+};
+
+static void
+getEmissionGrid(
+    MFnFluid&       fluid,
+    const unsigned int res[3],
+    double          densityEmit,
+    double          heatEmit,
+    double          fuelEmit,
+    bool            doEmitColor,
+    EmissionGrid&   grid
+)
+{
+    grid.density = fluid.density();
+    grid.temperature = fluid.temperature();
+    grid.fuel = fluid.fuel();
+    grid.falloff = fluid.falloff();
+    grid.densityEmit = (float)densityEmit;
+    grid.heatEmit = (float)heatEmit;
+    grid.fuelEmit = (float)fuelEmit;
+
+    grid.origin = fluid.index( 0, 0, 0 );
+    grid.stride[0] = (res[0] > 1) ? fluid.index( 1, 0, 0 ) - grid.origin : 0;
+    grid.stride[1] = (res[1] > 1) ? fluid.index( 0, 1, 0 ) - grid.origin : 0;
+    grid.stride[2] = (res[2] > 1) ? fluid.index( 0, 0, 1 ) - grid.origin : 0;
+
+    float *r = NULL, *g = NULL, *b = NULL;
+    grid.throughFluid = doEmitColor &&
+                        (fluid.getColors( r, g, b ) == MS::kSuccess) && (r != NULL);
+}
+
+//  Range of voxels overlapped by a fluid space box, voxel i spanning
+//  [origin + i*voxel, origin + (i+1)*voxel].  Returns false if the box
+//  misses the grid.
+//
+static bool
+voxelRange(
+    const MBoundingBox& box,
+    const double        origin[3],
+    const double        voxel[3],
+    const unsigned int  res[3],
+    int                 lo[3],
+    int                 hi[3]
+)
+{
+    MPoint low = box.min();
+    MPoint high = box.max();
+    for( int a = 0; a < 3; a++ )
+    {
+        double l = floor( (low[a] - origin[a]) / voxel[a] );
+        double h = floor( (high[a] - origin[a]) / voxel[a] );
+        if( h < 0.0 || l > (double)res[a] - 1.0 )
+        {
+            return false;
+        }
+        lo[a] = (l < 0.0) ? 0 : (int)l;
+        hi[a] = (h > (double)res[a] - 1.0) ? (int)res[a] - 1 : (int)h;
+    }
+    return true;
+}
+
+//  Emits into the voxels [lo, hi], numSamples samples per voxel.
+//  row( j, k, samples ) returns in samples[si*nx + n] the amount sample si
+//  emits into voxel (lo[0]+n, j, k), nx being the length of the row.
+//  With parallel, slabs of constant k are evaluated in parallel and each
+//  voxel is written by the task that owns its slab.  When the emission
+//  goes through the fluid, it is made by the calling thread, one call per
+//  sample as color blending depends on it.
+//
+template <class Row>
+static void
+emitIntoBox(
+    MFnFluid&           fluid,
+    const EmissionGrid& grid,
+    const int           lo[3],
+    const int           hi[3],
+    int                 numSamples,
+    const Row&          row,
+    bool                parallel,
+    bool                doEmitColor,
+    const MColor&       emitColor
+)
+{
+    const int nx = hi[0] - lo[0] + 1;
+    const int ny = hi[1] - lo[1] + 1;
+    const size_t rowSize = (size_t)nx * numSamples;
+
+    if( !grid.throughFluid )
+    {
+        auto slabs = [&]( const tbb::blocked_range<int>& r ) {
+            std::vector<double> samples( rowSize );
+            for( int k = r.begin(); k != r.end(); ++k )
+            {
+                for( int j = lo[1]; j <= hi[1]; j++ )
+                {
+                    row( j, k, &samples[0] );
+                    int idx = grid.index( lo[0], j, k );
+                    for( int n = 0; n < nx; n++, idx += grid.stride[0] )
+                    {
+                        double value = 0.0;
+                        for( int si = 0; si < numSamples; si++ )
+                        {
+                            value += samples[(size_t)si * nx + n];
+                        }
+                        if( value != 0.0 )
+                        {
+                            grid.emit( idx, (float)value );
+                        }
+                    }
+                }
+            }
+        };
+
+        tbb::blocked_range<int> slabRange( lo[2], hi[2] + 1, kSlabGrainSize );
+        if( parallel )
+        {
+            tbb::parallel_for( slabRange, slabs );
+        }
+        else
+        {
+            slabs( slabRange );
+        }
+        return;
+    }
+
+    std::vector<double> samples( rowSize * ny * kColorSlabBatch );
+    for( int k0 = lo[2]; k0 <= hi[2]; k0 += kColorSlabBatch )
+    {
+        const int k1 = MIN( k0 + kColorSlabBatch - 1, hi[2] );
+        auto slabs = [&]( const tbb::blocked_range<int>& r ) {
+            for( int k = r.begin(); k != r.end(); ++k )
+            {
+                for( int j = lo[1]; j <= hi[1]; j++ )
+                {
+                    row( j, k, &samples[((size_t)(k - k0) * ny + (j - lo[1])) * rowSize] );
+                }
+            }
+        };
+
+        tbb::blocked_range<int> slabRange( k0, k1 + 1, kSlabGrainSize );
+        if( parallel )
+        {
+            tbb::parallel_for( slabRange, slabs );
+        }
+        else
+        {
+            slabs( slabRange );
+        }
+
+        for( int k = k0; k <= k1; k++ )
+        {
+            for( int j = lo[1]; j <= hi[1]; j++ )
+            {
+                const double* s = &samples[((size_t)(k - k0) * ny + (j - lo[1])) * rowSize];
+                for( int n = 0; n < nx; n++ )
+                {
+                    for( int si = 0; si < numSamples; si++ )
+                    {
+                        const double value = s[(size_t)si * nx + n];
+                        if( value != 0.0 )
+                        {
+                            fluid.emitIntoArrays( (float)value, lo[0] + n, j, k, grid.densityEmit,
+                                                  grid.heatEmit, grid.fuelEmit, doEmitColor, emitColor );
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
 void 
 simpleFluidEmitter::omniFluidEmitter(
     MFnFluid&       fluid,
@@ -493,7 +732,7 @@ simpleFluidEmitter::omniFluidEmitter(
     //  Now, it's time to actually emit into the fluid:
     //  
     //  foreach emitter point
-    //      foreach voxel
+    //      foreach voxel within maxDist of the point, z-slabs in parallel
     //          - select some points in the voxel
     //          - compute a dropoff function from the emitter point
     //          - emit an appropriate amount of fluid into the voxel
@@ -504,9 +743,9 @@ simpleFluidEmitter::omniFluidEmitter(
     //  number of samples in these cases.
     //
     //  If the "jitter" flag is enabled, we jitter each sample position,
-    //  using the rangen() function, which keeps track of independent 
-    //  random states for each fluid, to make sure that results are
-    //  repeatable for multiple simulation runs.
+    //  using emitterJitter::value() seeded from the rangen() function,
+    //  which keeps track of independent random states for each fluid, to
+    //  make sure that results are repeatable for multiple simulation runs.
     //  
 
     // basic sample count
@@ -532,36 +771,86 @@ simpleFluidEmitter::omniFluidEmitter(
         numSamples = 1;
     }
 
+    EmissionGrid grid;
+    getEmissionGrid( fluid, res, densityEmit, heatEmit, fuelEmit, doEmitColor, grid );
+
+    const double origin[3] = { Ox, Oy, Oz };
+    const double voxel[3] = { dx, dy, dz };
+    MMatrix fluidInverseWorldMatrix = fluidWorldMatrix.inverse();
+
+    //  object->world matrix of the fluid, for the kernel
+    //
+    double m[4][3];
+    for( int r = 0; r < 4; r++ )
+    {
+        for( int c = 0; c < 3; c++ )
+        {
+            m[r][c] = fluidWorldMatrix( r, c );
+        }
+    }
+
     for( unsigned int p = 0; p < emitterPositions.length(); p++ )
     {
         MPoint emitterWorldPos = emitterPositions[p];
 
-        //  loop through all voxels, looking for ones that lie at least
-        //  partially within the dropoff field around this emitter point
+        unsigned long long seed = 0;
+        if( jitter )
+        {
+            double r0 = randgen();
+            double r1 = randgen();
+            seed = emitterJitter::seed( r0, r1 );
+        }
+
+        //  only the voxels overlapping the bounding box of the maxDist
+        //  sphere around this emitter point can receive anything
         //
-        for( unsigned int i = 0; i < res[0]; i++ )
+        MVector radius( maxDist, maxDist, maxDist );
+        MBoundingBox bbox( emitterWorldPos - radius, emitterWorldPos + radius );
+        bbox.transformUsing( fluidInverseWorldMatrix );
+
+        int lo[3], hi[3];
+        if( !voxelRange( bbox, origin, voxel, res, lo, hi ) )
         {
-            double x = Ox + i*dx;
-            
-            for( unsigned int j = 0; j < res[1]; j++ )
+            continue;
+        }
+
+        const int nx = hi[0] - lo[0] + 1;
+        const double ex = emitterWorldPos.x;
+        const double ey = emitterWorldPos.y;
+        const double ez = emitterWorldPos.z;
+
+        auto row = [&]( int j, int k, double* samples )
+        {
+            double y = Oy + j*dy;
+            double z = Oz + k*dz;
+
+            for( int n0 = 0; n0 < nx; n0 += kRowChunk )
             {
-                double y = Oy + j*dy;
-                
-                for( unsigned int k = 0; k < res[2]; k++ )
+                const int count = MIN( kRowChunk, nx - n0 );
+                double inRange[kRowChunk];
+                int n;
+                for( n = 0; n < count; n++ )
                 {
-                    double z = Oz + k*dz;
-    
-                    int si;
-                    for( si = 0; si < numSamples; si++ )
+                    inRange[n] = 0.0;
+                }
+
+                for( int si = 0; si < numSamples; si++ )
+                {
+                    double* values = samples + (size_t)si * nx;
+                    for( n = 0; n < count; n++ )
                     {
+                        const int i = lo[0] + n0 + n;
+                        double x = Ox + i*dx;
+
                         //  compute sample point (fluid object space)
                         //
                         double rx, ry, rz;
                         if( jitter )
                         {
-                            rx = x + randgen()*dx;
-                            ry = y + randgen()*dy;
-                            rz = z + randgen()*dz;
+                            unsigned int v = (unsigned int)grid.index( i, j, k );
+                            rx = x + emitterJitter::value( seed, v, 3*si )*dx;
+                            ry = y + emitterJitter::value( seed, v, 3*si+1 )*dy;
+                            rz = z + emitterJitter::value( seed, v, 3*si+2 )*dz;
                         }
                         else
                         {
@@ -570,51 +859,52 @@ simpleFluidEmitter::omniFluidEmitter(
                             rz = z + 0.5*dz;
                         }
 
-                        //  compute distance from sample to emitter point
-                        //  
-                        MPoint point( rx, ry, rz );
-                        point *= fluidWorldMatrix;
-                        MVector diff = point - emitterWorldPos;
-                        double distSquared = diff * diff;
-                        double dist = diff.length();
-                    
-                        //  discard if outside min/max range
+                        //  compute distance from sample (world space) to
+                        //  emitter point
                         //
-                        if( (dist < minDist) || (dist > maxDist) )
-                        {
-                            continue;
-                        }
-                        
-                        //  drop off the emission rate according to the falloff
-                        //  parameter, and divide to accound for multiple samples
-                        //  in the voxel
+                        double px = rx*m[0][0] + ry*m[1][0] + rz*m[2][0] + m[3][0] - ex;
+                        double py = rx*m[0][1] + ry*m[1][1] + rz*m[2][1] + m[3][1] - ey;
+                        double pz = rx*m[0][2] + ry*m[1][2] + rz*m[2][2] + m[3][2] - ez;
+                        double distSquared = px*px + py*py + pz*pz;
+                        double dist = sqrt( distSquared );
+
+                        //  discard if outside min/max range, otherwise drop
+                        //  off the emission rate according to the falloff
+                        //  parameter, and divide to account for multiple
+                        //  samples in the voxel
                         //
-                        double distDrop = dropoff * distSquared;
-                        double newVal = theRate * exp( -distDrop ) / (double)numSamples;
+                        bool inside = (dist >= minDist) && (dist <= maxDist);
+                        double newVal = theRate * exp( -dropoff * distSquared ) / (double)numSamples;
+                        values[n0+n] = inside ? newVal : 0.0;
+                        inRange[n] += inside ? 1.0 : 0.0;
+                    }
+                }
 
-                        //  emit density/heat/fuel/color into the current voxel
-                        //
-                        if( newVal != 0 )
+                if( grid.falloff != NULL )
+                {
+                    for( n = 0; n < count; n++ )
+                    {
+                        if( inRange[n] == 0.0 )
                         {
-                            fluid.emitIntoArrays( (float) newVal, i, j, k, (float)densityEmit, (float)heatEmit, (float)fuelEmit, doEmitColor, emitColor );
+                            continue;
                         }
 
-                        float *fArray = fluid.falloff();
-                        if( fArray != NULL )
-                        {
-                            MPoint midPoint( x+0.5*dx, y+0.5*dy, z+0.5*dz );
-                            midPoint.x *= 0.2;
-                            midPoint.y *= 0.2;
-                            midPoint.z *= 0.2;
-
-                            float fdist = (float) sqrt( midPoint.x*midPoint.x + midPoint.y*midPoint.y + midPoint.z*midPoint.z );
-                            fdist /= sqrtf(3.0f);
-                            fArray[fluid.index(i,j,k)] = 1.0f-fdist;
-                        }
+                        const int i = lo[0] + n0 + n;
+                        double x = Ox + i*dx;
+                        MPoint midPoint( x+0.5*dx, y+0.5*dy, z+0.5*dz );
+                        midPoint.x *= 0.2;
+                        midPoint.y *= 0.2;
+                        midPoint.z *= 0.2;
+
+                        float fdist = (float) sqrt( midPoint.x*midPoint.x + midPoint.y*midPoint.y + midPoint.z*midPoint.z );
+                        fdist /= sqrtf(3.0f);
+                        grid.falloff[grid.index( i, j, k )] = 1.0f-fdist;
                     }
                 }
             }
-        }
+        };
+
+        emitIntoBox( fluid, grid, lo, hi, numSamples, row, true, doEmitColor, emitColor );
     }
 }
 
@@ -744,30 +1034,6 @@ simpleFluidEmitter::volumeFluidEmitter(
     double Oy = -size[1]/2;
     double Oz = -size[2]/2; 
 
-    //  get fluid voxel coord range of bounding box
-    //
-    int3 lowCoords;
-    int3 highCoords;
-    fluid.toGridIndex( lowCorner, lowCoords );
-    fluid.toGridIndex( highCorner, highCoords );
-    
-    int i;
-    for ( i = 0; i < 3; i++ )
-    {
-        if ( lowCoords[i] < 0 ) {
-            lowCoords[i] = 0;
-        } else if ( lowCoords[i] > ((int)res[i])-1 ) {
-            lowCoords[i] = ((int)res[i])-1;
-        }
-
-        if ( highCoords[i] < 0 ) {
-            highCoords[i] = 0;
-        } else if ( highCoords[i] > ((int)res[i])-1 ) {
-            highCoords[i] = ((int)res[i])-1;
-        }
-        
-    }
-
     //  figure out the emitter size relative to the voxel size, and compute
     //  a per-voxel sampling rate that uses 1 sample/voxel for emitters that
     //  are >= 2 voxels big in all dimensions.  For smaller emitters, use up
@@ -797,63 +1063,83 @@ simpleFluidEmitter::volumeFluidEmitter(
         numSamples = 1;
     }
     
+    //  get fluid voxel coord range of bounding box
+    //
+    const double origin[3] = { Ox, Oy, Oz };
+    const double voxel[3] = { dx, dy, dz };
+    int lo[3], hi[3];
+    if( !voxelRange( bbox, origin, voxel, res, lo, hi ) )
+    {
+        return;
+    }
+
+    EmissionGrid grid;
+    getEmissionGrid( fluid, res, densityEmit, heatEmit, fuelEmit, doEmitColor, grid );
+
+    unsigned long long seed = 0;
+    if( jitter )
+    {
+        double r0 = randgen();
+        double r1 = randgen();
+        seed = emitterJitter::seed( r0, r1 );
+    }
+
     //  for each voxel that could potentially intersect the volume emitter
     //  primitive, take some samples in the voxel.  For those inside the
     //  volume, compute their dropoff relative to the primitive's local y-axis,
     //  and emit an appropriate amount into the voxel.
     //
-    for( i = lowCoords[0]; i <= highCoords[0]; i++ )
+    //  MPxEmitterNode::volumePrimitivePointInside() is not documented as
+    //  thread safe, so the volume is sampled on the calling thread.
+    //
+    const int nx = hi[0] - lo[0] + 1;
+    auto row = [&]( int j, int k, double* samples )
     {
-        double x = Ox + (i+0.5)*dx;
-            
-        for( int j = lowCoords[1]; j < highCoords[1]; j++ )
+        double y = Oy + (j+0.5)*dy;
+        double z = Oz + (k+0.5)*dz;
+
+        for( int n = 0; n < nx; n++ )
         {
-            double y = Oy + (j+0.5)*dy;
+            const int i = lo[0] + n;
+            double x = Ox + (i+0.5)*dx;
+            unsigned int v = (unsigned int)grid.index( i, j, k );
 
-            for( int k = lowCoords[2]; k < highCoords[2]; k++ )
-            {
-                double z = Oz + (k+0.5)*dz;
+            for ( int si = 0; si < numSamples; si++) {
                 
-                for ( int si = 0; si < numSamples; si++) {
-                    
-                    //  compute voxel sample point (object space)
-                    //
-                    double rx, ry, rz;
-                    if(jitter) {
-                        rx = x + dx*(randgen() - 0.5);
-                        ry = y + dy*(randgen() - 0.5);
-                        rz = z + dz*(randgen() - 0.5);
-                    } else {
-                        rx = x;
-                        ry = y;
-                        rz = z;
-                    }
-                    
-                    //  to world space
-                    MPoint pt( rx, ry, rz );
-                    pt *= fluidWorldMatrix;
+                //  compute voxel sample point (object space)
+                //
+                double rx, ry, rz;
+                if(jitter) {
+                    rx = x + dx*(emitterJitter::value( seed, v, 3*si ) - 0.5);
+                    ry = y + dy*(emitterJitter::value( seed, v, 3*si+1 ) - 0.5);
+                    rz = z + dz*(emitterJitter::value( seed, v, 3*si+2 ) - 0.5);
+                } else {
+                    rx = x;
+                    ry = y;
+                    rz = z;
+                }
+                
+                //  to world space
+                MPoint pt( rx, ry, rz );
+                pt *= fluidWorldMatrix;
 
-                    //  test to see if point is inside volume primitive
+                //  test to see if point is inside volume primitive
+                //
+                double value = 0.0;
+                if( volumePrimitivePointInside( pt, emitterWorldMatrix ) )
+                {
+                    //  compute dropoff
                     //
-                    if( volumePrimitivePointInside( pt, emitterWorldMatrix ) )
-                    {
-                        //  compute dropoff
-                        //
-                        double dist = pt.distanceTo( emitterPos );
-                        double distDrop = dropoff * (dist*dist);
-                        double newVal = (theRate * exp( -distDrop )) / (double)numSamples;
-                        
-                        //  emit into arrays
-                        //
-                        if( newVal != 0.0 )
-                        {
-                            fluid.emitIntoArrays( (float) newVal, i, j, k, (float)densityEmit, (float)heatEmit, (float)fuelEmit, doEmitColor, emitColor );
-                        }
-                    }
+                    double dist = pt.distanceTo( emitterPos );
+                    double distDrop = dropoff * (dist*dist);
+                    value = (theRate * exp( -distDrop )) / (double)numSamples;
                 }
+                samples[(size_t)si * nx + n] = value;
             }
         }
-    }
+    };
+
+    emitIntoBox( fluid, grid, lo, hi, numSamples, row, false, doEmitColor, emitColor );
 }
 
 void 
@@ -1011,12 +1297,23 @@ simpleFluidEmitter::surfaceFluidEmitter(
             evalEmission2dTexture( colorTextureAttr, uCoords, vCoords, &texturedColorValues, NULL );
         }
         
-        for( int t = 0; t < fnSweptData.triangleCount(); t++ )
+        //  the random points are drawn here, in the order of the randgen()
+        //  stream, as barycentric coordinates.  Placing them in the grid
+        //  and computing their emission is done in parallel afterwards.
+        //
+        const int triangleCount = fnSweptData.triangleCount();
+        std::vector<double> triVertices( 9 * (size_t)triangleCount );
+        std::vector<double> triRates( triangleCount );
+        std::vector<MColor> triColors( triangleCount );
+        std::vector<int> sampleTriangle;
+        std::vector<double> sampleCoords;
+
+        for( int t = 0; t < triangleCount; t++ )
         {
             //  calculate emission rate and color values for this triangle
             //
             double curTexturedRate = texturedRate ? texturedRateValues[t] : 1.0;
-            MColor curTexturedColor;
+            MColor& curTexturedColor = triColors[t];
             if( texturedColor )
             {
                 MVector& curVec = texturedColorValues[t];
@@ -1031,9 +1328,13 @@ simpleFluidEmitter::surfaceFluidEmitter(
             }
 
             MDynSweptTriangle tri = fnSweptData.sweptTriangle( t );
-            MVector v0 = tri.vertex(0);
-            MVector v1 = tri.vertex(1);
-            MVector v2 = tri.vertex(2);
+            for( int c = 0; c < 3; c++ )
+            {
+                MVector vertex = tri.vertex( c );
+                triVertices[9*t+3*c] = vertex.x;
+                triVertices[9*t+3*c+1] = vertex.y;
+                triVertices[9*t+3*c+2] = vertex.z;
+            }
 
             //  compute number of samples for this triangle based on area,
             //  with large triangles receiving approximately 1 sample for 
@@ -1049,12 +1350,11 @@ simpleFluidEmitter::surfaceFluidEmitter(
             //
             double triRate = (theRate*(triArea/vfArea))/numSamples;
             
-            triRate *= curTexturedRate;
+            triRates[t] = triRate * curTexturedRate;
             
             for( int j = 0; j < numSamples; j++ )
             {
-                //  generate a random point on the triangle,
-                //  map it into fluid local space
+                //  generate a random point on the triangle
                 //
                 double r1 = randgen();
                 double r2 = randgen();
@@ -1064,43 +1364,135 @@ simpleFluidEmitter::surfaceFluidEmitter(
                     r1 = 1-r1;
                     r2 = 1-r2;
                 }
-                double r3 = 1 - (r1+r2);
-                MPoint randPoint = r1*v0 + r2*v1 + r3*v2;
-                randPoint *= fluidInverseWorldMatrix;
-                
-                //  figure out where the current point lies
-                //
-                int3 coord;
-                fluid.toGridIndex( randPoint, coord );
-                
-                if( (coord[0]<0) || (coord[1]<0) || (coord[2]<0) ||
-                    (coord[0]>=(int)res[0]) || (coord[1]>=(int)res[1]) || (coord[2]>=(int)res[2]) )
+                sampleTriangle.push_back( t );
+                sampleCoords.push_back( r1 );
+                sampleCoords.push_back( r2 );
+            }
+        }
+
+        //  fluid local space voxel and emission of each sample, -1 for the
+        //  samples outside the grid or emitting nothing
+        //
+        EmissionGrid grid;
+        getEmissionGrid( fluid, res, densityEmit, heatEmit, fuelEmit, doEmitColor, grid );
+
+        const size_t sampleCount = sampleTriangle.size();
+        std::vector<int> sampleVoxel( 3 * sampleCount );
+        std::vector<double> sampleValue( sampleCount );
+
+        double mi[4][3];
+        for( int r = 0; r < 4; r++ )
+        {
+            for( int c = 0; c < 3; c++ )
+            {
+                mi[r][c] = fluidInverseWorldMatrix( r, c );
+            }
+        }
+
+        tbb::parallel_for( tbb::blocked_range<size_t>( 0, sampleCount, kSampleGrainSize ),
+            [&]( const tbb::blocked_range<size_t>& r ) {
+                for( size_t s = r.begin(); s != r.end(); ++s )
                 {
-                    continue;
+                    //  map the point into fluid local space
+                    //
+                    const double* v = &triVertices[9 * (size_t)sampleTriangle[s]];
+                    double r1 = sampleCoords[2*s];
+                    double r2 = sampleCoords[2*s+1];
+                    double r3 = 1 - (r1+r2);
+                    double wx = r1*v[0] + r2*v[3] + r3*v[6];
+                    double wy = r1*v[1] + r2*v[4] + r3*v[7];
+                    double wz = r1*v[2] + r2*v[5] + r3*v[8];
+                    MPoint randPoint( wx*mi[0][0] + wy*mi[1][0] + wz*mi[2][0] + mi[3][0],
+                                      wx*mi[0][1] + wy*mi[1][1] + wz*mi[2][1] + mi[3][1],
+                                      wx*mi[0][2] + wy*mi[1][2] + wz*mi[2][2] + mi[3][2] );
+
+                    //  figure out where the current point lies
+                    //
+                    int* coord = &sampleVoxel[3*s];
+                    coord[0] = (int)floor( (randPoint.x - Ox) / dx );
+                    coord[1] = (int)floor( (randPoint.y - Oy) / dy );
+                    coord[2] = (int)floor( (randPoint.z - Oz) / dz );
+                    sampleValue[s] = 0.0;
+
+                    if( (coord[0]<0) || (coord[1]<0) || (coord[2]<0) ||
+                        (coord[0]>=(int)res[0]) || (coord[1]>=(int)res[1]) || (coord[2]>=(int)res[2]) )
+                    {
+                        continue;
+                    }
+                    
+                    //  do some falloff based on how far from the voxel center 
+                    //  the current point lies
+                    //
+                    MPoint gridPoint;
+                    gridPoint.x = Ox + (coord[0]+0.5)*dx;
+                    gridPoint.y = Oy + (coord[1]+0.5)*dy;
+                    gridPoint.z = Oz + (coord[2]+0.5)*dz;
+                    
+                    MVector diff = gridPoint - randPoint;
+                    double distSquared = diff * diff;
+                    double distDrop = dropoff * distSquared;
+                    
+                    sampleValue[s] = triRates[sampleTriangle[s]] * exp( -distDrop );
                 }
-                
-                //  do some falloff based on how far from the voxel center 
-                //  the current point lies
-                //
-                MPoint gridPoint;
-                gridPoint.x = Ox + (coord[0]+0.5)*dx;
-                gridPoint.y = Oy + (coord[1]+0.5)*dy;
-                gridPoint.z = Oz + (coord[2]+0.5)*dz;
-                
-                MVector diff = gridPoint - randPoint;
-                double distSquared = diff * diff;
-                double distDrop = dropoff * distSquared;
-                
-                double newVal = triRate * exp( -distDrop );
-        
-                //  emit into the voxel
-                //
-                if( newVal != 0 )
+            });
+
+        //  emit into the voxels
+        //
+        if( grid.throughFluid )
+        {
+            //  color is blended by the fluid, one sample at a time in the
+            //  order they were drawn
+            //
+            for( size_t s = 0; s < sampleCount; s++ )
+            {
+                if( sampleValue[s] != 0 )
                 {
-                    fluid.emitIntoArrays( (float) newVal, coord[0], coord[1], coord[2], (float)densityEmit, (float)heatEmit, (float)fuelEmit, doEmitColor, curTexturedColor );      
+                    const int* coord = &sampleVoxel[3*s];
+                    fluid.emitIntoArrays( (float) sampleValue[s], coord[0], coord[1], coord[2], (float)densityEmit, (float)heatEmit, (float)fuelEmit, doEmitColor, triColors[sampleTriangle[s]] );
                 }
             }
         }
+        else
+        {
+            //  sort the samples by voxel, then add up the samples of each
+            //  voxel, so that every voxel is written by a single task
+            //
+            std::vector<unsigned long long> keys( sampleCount );
+            tbb::parallel_for( tbb::blocked_range<size_t>( 0, sampleCount, kSampleGrainSize ),
+                [&]( const tbb::blocked_range<size_t>& r ) {
+                    for( size_t s = r.begin(); s != r.end(); ++s )
+                    {
+                        const int* coord = &sampleVoxel[3*s];
+                        unsigned long long idx = (sampleValue[s] != 0)
+                            ? (unsigned int)grid.index( coord[0], coord[1], coord[2] )
+                            : 0xFFFFFFFFULL;
+                        keys[s] = (idx << 32) | (unsigned long long)s;
+                    }
+                });
+            tbb::parallel_sort( keys.begin(), keys.end() );
+            const size_t keyCount = std::lower_bound( keys.begin(), keys.end(), 0xFFFFFFFFULL << 32 ) - keys.begin();
+
+            tbb::parallel_for( tbb::blocked_range<size_t>( 0, keyCount, kSampleGrainSize ),
+                [&]( const tbb::blocked_range<size_t>& r ) {
+                    //  the voxels starting in this range
+                    //
+                    size_t s = r.begin();
+                    while( s > 0 && s < r.end() && (keys[s] >> 32) == (keys[s-1] >> 32) )
+                    {
+                        s++;
+                    }
+                    while( s < r.end() )
+                    {
+                        const unsigned long long idx = keys[s] >> 32;
+                        double value = 0.0;
+                        for( ; s < keyCount && (keys[s] >> 32) == idx; s++ )
+                        {
+                            value += (float) sampleValue[keys[s] & 0xFFFFFFFFULL];
+                        }
+                        grid.emit( (int)idx, (float)value );
+                    }
+                });
+        }
     }
 }
 
@@ -59,18 +59,41 @@ connectAttr offset.output1D solver.collisionPlane3;
 ```
 */
 
+// The physicsBatchEngine node runs the same simulation for many bodies at once, stored as arrays,
+// with substeps and in-memory checkpoints to resume from when going back in time.
+
+/*
+```MEL
+createNode physicsBatchEngine -name "batchSolver";
+setAttr "batchSolver.initialPositions"  -type vectorArray 3  0 10 0  2 12 0  4 14 0;
+setAttr "batchSolver.initialVelocities" -type vectorArray 3  1 0 0  1 0 0  1 0 0;
+setAttr "batchSolver.substeps" 4;
+setAttr "batchSolver.checkpointInterval" 10;
+currentTime 60;
+getAttr batchSolver.positions;
+```
+*/
+
 #include <type_traits>
 #include <utility>
 #include <cassert>
 #include <limits>
 #include <cmath>
 #include <thread>
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <vector>
 
 #include <maya/MPxNode.h>
 
 #include <maya/MFnNumericAttribute.h>
 #include <maya/MFnUnitAttribute.h>
 #include <maya/MFnCompoundAttribute.h>
+#include <maya/MFnTypedAttribute.h>
+#include <maya/MFnVectorArrayData.h>
+#include <maya/MVectorArray.h>
+#include <maya/MPlugArray.h>
 
 #include <maya/MString.h>
 #include <maya/MTypeId.h>
@@ -86,6 +109,9 @@ connectAttr offset.output1D solver.collisionPlane3;
 #include <maya/MFn.h>
 #include <maya/MDGModifier.h>
 
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
 // Helpers for vector math
 namespace {
 struct MDouble3 { double x, y, z; };
@@ -131,6 +157,7 @@ namespace detail {
     decltype(auto) as(const MDataHandle& handle) { return error_type{}; }
 
     template <> decltype(auto) as<bool>(const MDataHandle& handle) { return handle.asBool(); }
+    template <> decltype(auto) as<int>(const MDataHandle& handle) { return handle.asInt(); }
     template <> decltype(auto) as<double>(const MDataHandle& handle) { return handle.asDouble(); }
     template <> decltype(auto) as<MTime>(const MDataHandle& handle) { return handle.asTime(); }
     template <>
@@ -211,6 +238,114 @@ namespace physics {
     }
 }
 
+// Batched bodies for physicsBatchEngine
+namespace physics {
+    // N bodies stored as structure of arrays, so that the step kernel reads
+    // and writes contiguous doubles
+    struct BodyBatch {
+        MTime               Time;
+        std::vector<double> Px, Py, Pz;
+        std::vector<double> Vx, Vy, Vz;
+
+        size_t size() const noexcept { return Px.size(); }
+
+        void resize(size_t count) {
+            for (auto* a : { &Px, &Py, &Pz, &Vx, &Vy, &Vz })
+                a->assign(count, .0);
+        }
+    };
+
+    // Bodies per task of the step kernel
+    constexpr size_t kBodyGrainSize = 4096;
+
+    // apply_velocity() followed by resolve_collision() for the bodies [begin, end), written without
+    // branches on the data so that the compiler vectorizes the loop. The arrays are parameters, as
+    // the compiler only relies on __restrict for those. A ground plane with a null normal has no
+    // contact.
+    void step_range(double* __restrict px, double* __restrict py, double* __restrict pz,
+                    double* __restrict vx, double* __restrict vy, double* __restrict vz,
+                    size_t begin, size_t end, double dts, MDouble3 acceleration, MDouble4 ground, double elasticity) noexcept {
+        const bool     contact = dot(xyz(ground), xyz(ground)) > .0;
+        const MDouble3 gp = point_on_plane(ground);
+        const MDouble3 n  = contact ? normalized(xyz(ground)) : MDouble3{ .0, .0, .0 };
+        const double   k  = contact ? 1 + elasticity : .0;
+
+        for (size_t i = begin; i < end; ++i) {
+            double nvx = vx[i] + acceleration.x * dts;
+            double nvy = vy[i] + acceleration.y * dts;
+            double nvz = vz[i] + acceleration.z * dts;
+            double npx = px[i] + (nvx + vx[i]) * (0.5 * dts);
+            double npy = py[i] + (nvy + vy[i]) * (0.5 * dts);
+            double npz = pz[i] + (nvz + vz[i]) * (0.5 * dts);
+
+            // Reflect the position and velocity of the bodies below the ground plane
+            double v = npx * ground.x + npy * ground.y + npz * ground.z + ground.w;
+            double c = (v > .0) ? .0 : k;
+            double dp = ((npx - gp.x) * n.x + (npy - gp.y) * n.y + (npz - gp.z) * n.z) * c;
+            double dv = (nvx * n.x + nvy * n.y + nvz * n.z) * c;
+
+            px[i] = npx - n.x * dp;
+            py[i] = npy - n.y * dp;
+            pz[i] = npz - n.z * dp;
+            vx[i] = nvx - n.x * dv;
+            vy[i] = nvy - n.y * dv;
+            vz[i] = nvz - n.z * dv;
+        }
+    }
+
+    // Advances all the bodies by dt, in substeps, bodies in parallel
+    void step(BodyBatch& batch, MTime dt, int substeps, MDouble3 acceleration, MDouble4 ground, double elasticity) {
+        assert(elasticity >= 0 && substeps >= 1);
+        const double dts = dt.as(MTime::kSeconds) / substeps;
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, batch.size(), kBodyGrainSize),
+            [&](const tbb::blocked_range<size_t>& r) {
+                for (int s = 0; s < substeps; ++s)
+                    step_range(batch.Px.data(), batch.Py.data(), batch.Pz.data(),
+                               batch.Vx.data(), batch.Vy.data(), batch.Vz.data(),
+                               r.begin(), r.end(), dts, acceleration, ground, elasticity);
+            });
+        batch.Time = batch.Time + dt;
+    }
+
+    // Bodies saved at some of the simulated frames, so that going back in
+    // time resumes from the nearest earlier frame rather than from the start
+    class CheckpointStore {
+    public:
+        void store(const BodyBatch& batch) {
+            std::lock_guard<std::mutex> lock(fMutex);
+            fCheckpoints[batch.Time] = batch;
+        }
+
+        // The latest checkpoint in [start, time], if any
+        bool find(MTime start, MTime time, BodyBatch& batch) const {
+            std::lock_guard<std::mutex> lock(fMutex);
+            auto it = fCheckpoints.upper_bound(time);
+            if (it == fCheckpoints.begin())
+                return false;
+            --it;
+            if (it->first < start)
+                return false;
+            batch = it->second;
+            return true;
+        }
+
+        // Drops the checkpoints at or after time
+        void invalidate(MTime time) {
+            std::lock_guard<std::mutex> lock(fMutex);
+            fCheckpoints.erase(fCheckpoints.lower_bound(time), fCheckpoints.end());
+        }
+
+        void clear() {
+            std::lock_guard<std::mutex> lock(fMutex);
+            fCheckpoints.clear();
+        }
+
+    private:
+        mutable std::mutex              fMutex;
+        std::map<MTime, BodyBatch>      fCheckpoints;
+    };
+}
+
 class physicsEngine final : public MPxNode
 {
 public:
@@ -460,7 +595,343 @@ MStatus physicsEngine::initialize()
     return MS::kSuccess;
 }
 
-MCallbackId gNodeAddedCallbackId;
+
+// physicsBatchEngine: the physicsEngine simulation applied to N bodies at once.
+//
+// The bodies are stepped as a physics::BodyBatch, in parallel and in 'substeps' substeps per frame.
+// Every 'checkpointInterval' frames the node also keeps a copy of the bodies in memory. When the
+// status in the datablock is later than the requested time (e.g. scrubbing back without Cached
+// Playback), the simulation resumes from the latest checkpoint before that time instead of the
+// initial status. Checkpoints are dropped over the range returned by transformInvalidationRange(),
+// and all of them whenever a parameter other than the time is dirtied.
+//
+// The simulation steps whole frames from the initial time. A subframe time is reached with one
+// partial step from the last whole frame. A status left at a subframe time is never resumed from,
+// so the following frames stay on the frame grid: the next evaluation resumes from the latest
+// checkpoint, or the initial status, instead.
+class physicsBatchEngine final : public MPxNode
+{
+public:
+    MStatus    compute(const MPlug& plug, MDataBlock& data) override;
+    MStatus    setDependentsDirty(const MPlug& plug, MPlugArray& plugArray) override;
+
+    void       getCacheSetup(const MEvaluationNode&, MNodeCacheDisablingInfo&, MNodeCacheSetupInfo&, MObjectArray&) const override;
+    void       configCache(const MEvaluationNode&, MCacheSchema&) const override;
+
+    MTimeRange transformInvalidationRange(const MPlug& source, const MTimeRange& input) const override;
+
+    static void* creator();
+    static MStatus initialize();
+
+public:
+    // Attributes, as on physicsEngine unless noted
+
+    static MAttributeOf<bool>  aSimulationEnabled;
+
+    static MAttributeOf<MTime> aInputTime;
+
+    static  MObject     aCurrentStatus;
+        static  MAttributeOf<MTime>    aCurrentTime;
+        static  MObject                aCurrentPositions;   // [out] vector array, one per body
+        static  MObject                aCurrentVelocities;  // [out] vector array, one per body
+
+    static  MObject     aInitialStatus;
+        static  MAttributeOf<MTime>    aInitialTime;
+        static  MObject                aInitialPositions;   // [in] vector array, sets the number of bodies
+        static  MObject                aInitialVelocities;  // [in] vector array, missing velocities are 0
+
+    static  MAttributeOf<double>   aMass;
+    static  MAttributeOf<MDouble3> aForce;
+
+    static  MAttributeOf<MDouble4> aCollisionPlane;
+    static  MAttributeOf<double>   aCollisionElasticity;
+
+    static  MAttributeOf<int>      aSubsteps;              // [in] Solver steps per frame
+    static  MAttributeOf<int>      aCheckpointInterval;    // [in] Frames between checkpoints, 0 for none
+
+public:
+    static  MTypeId     id;
+    static  MString     nodeName;
+
+private:
+    mutable physics::CheckpointStore fCheckpoints;
+};
+
+MTypeId physicsBatchEngine::id = { 0x00081167 };
+MString physicsBatchEngine::nodeName = { "physicsBatchEngine" };
+
+MAttributeOf<MTime>    physicsBatchEngine::aInputTime;
+MObject                physicsBatchEngine::aCurrentStatus;
+MAttributeOf<MTime>    physicsBatchEngine::aCurrentTime;
+MObject                physicsBatchEngine::aCurrentPositions;
+MObject                physicsBatchEngine::aCurrentVelocities;
+MObject                physicsBatchEngine::aInitialStatus;
+MAttributeOf<MTime>    physicsBatchEngine::aInitialTime;
+MObject                physicsBatchEngine::aInitialPositions;
+MObject                physicsBatchEngine::aInitialVelocities;
+MAttributeOf<MDouble3> physicsBatchEngine::aForce;
+MAttributeOf<double>   physicsBatchEngine::aMass;
+MAttributeOf<MDouble4> physicsBatchEngine::aCollisionPlane;
+MAttributeOf<double>   physicsBatchEngine::aCollisionElasticity;
+MAttributeOf<bool>     physicsBatchEngine::aSimulationEnabled;
+MAttributeOf<int>      physicsBatchEngine::aSubsteps;
+MAttributeOf<int>      physicsBatchEngine::aCheckpointInterval;
+
+// helpers for the vector array attributes of physicsBatchEngine
+namespace {
+MVectorArray get_vector_array(MDataHandle handle) {
+    MFnVectorArrayData fnData(handle.data());
+    return fnData.array();
+}
+
+void set_vector_array(MDataHandle handle, const std::vector<double>& x, const std::vector<double>& y, const std::vector<double>& z) {
+    MVectorArray array(static_cast<unsigned int>(x.size()));
+    for (size_t i = 0; i < x.size(); ++i)
+        array[static_cast<unsigned int>(i)] = MVector(x[i], y[i], z[i]);
+    MFnVectorArrayData fnData;
+    handle.setMObject(fnData.create(array));
+    handle.setClean();
+}
+
+void from_vector_array(const MVectorArray& array, size_t count, std::vector<double>& x, std::vector<double>& y, std::vector<double>& z) {
+    size_t n = std::min<size_t>(count, array.length());
+    for (size_t i = 0; i < n; ++i) {
+        const MVector& v = array[static_cast<unsigned int>(i)];
+        x[i] = v.x; y[i] = v.y; z[i] = v.z;
+    }
+}
+}
+
+MStatus physicsBatchEngine::compute(const MPlug& plug, MDataBlock& data)
+{
+    using namespace physics;
+
+    if (plug == aCurrentStatus || plug.parent() == aCurrentStatus)
+    {
+        MTime time  = get_input(data, aInputTime);
+        MTime start = get_input(data, aInitialTime);
+        bool  simulation = get_input(data, aSimulationEnabled);
+
+        // The previous status, from the datablock
+        BodyBatch batch;
+        batch.Time = get_as_is(data, aCurrentTime);
+        MVectorArray positions  = get_vector_array(data.outputValue(aCurrentPositions));
+        MVectorArray velocities = get_vector_array(data.outputValue(aCurrentVelocities));
+        batch.resize(positions.length());
+        from_vector_array(positions,  batch.size(), batch.Px, batch.Py, batch.Pz);
+        from_vector_array(velocities, batch.size(), batch.Vx, batch.Vy, batch.Vz);
+
+        // Whether t is a whole number of frames after the start
+        const MTime frame { 1.0, MTime::uiUnit() };
+        auto on_frame = [&](MTime t) {
+            double frames = (t - start).as(MTime::kSeconds) / frame.as(MTime::kSeconds);
+            return std::fabs(frames - std::round(frames)) < 1e-6;
+        };
+
+        // Resume from the latest checkpoint before time if the datablock status is later than time,
+        // at a subframe time, or earlier than that checkpoint. Going back in time without one
+        // restarts from the initial status.
+        bool initial = batch.Time <= start || time <= start;
+        if (simulation && time > start) {
+            BodyBatch checkpoint;
+            bool found  = fCheckpoints.find(start, time, checkpoint);
+            bool behind = !initial && (batch.Time > time || !on_frame(batch.Time));
+            if (found && (initial || behind || checkpoint.Time > batch.Time)) {
+                batch   = std::move(checkpoint);
+                initial = false;
+            } else if (behind) {
+                initial = true;
+            }
+        }
+
+        if (initial) {
+            MVectorArray initialPositions  = get_vector_array(data.inputValue(aInitialPositions));
+            MVectorArray initialVelocities = get_vector_array(data.inputValue(aInitialVelocities));
+            batch.Time = start;
+            batch.resize(initialPositions.length());
+            from_vector_array(initialPositions,  batch.size(), batch.Px, batch.Py, batch.Pz);
+            from_vector_array(initialVelocities, batch.size(), batch.Vx, batch.Vy, batch.Vz);
+        }
+        assert(batch.Time >= start);
+
+        if (simulation && time > batch.Time) {
+            MDouble3 force    = get_input(data, aForce);
+            double   mass     = get_input(data, aMass);
+            MDouble4 ground   = get_input(data, aCollisionPlane);
+            double   damp     = get_input(data, aCollisionElasticity);
+            int      substeps = std::max(1, static_cast<int>(get_input(data, aSubsteps)));
+            int      interval = get_input(data, aCheckpointInterval);
+
+            // One step per frame, so that the result does not depend on the frames evaluated
+            // on the way, and a checkpoint on every interval-th frame after the start
+            while (time - batch.Time >= frame) {
+                step(batch, frame, substeps, force / mass, ground, damp);
+
+                if (interval > 0) {
+                    long index = std::lround((batch.Time - start).as(MTime::kSeconds) / frame.as(MTime::kSeconds));
+                    if (index % interval == 0)
+                        fCheckpoints.store(batch);
+                }
+            }
+
+            // A subframe time: the rest of the way from the last whole frame
+            if (batch.Time < time)
+                step(batch, time - batch.Time, substeps, force / mass, ground, damp);
+        }
+
+        set(data, aCurrentTime, batch.Time);
+        set_vector_array(data.outputValue(aCurrentPositions),  batch.Px, batch.Py, batch.Pz);
+        set_vector_array(data.outputValue(aCurrentVelocities), batch.Vx, batch.Vy, batch.Vz);
+
+        return MS::kSuccess;
+    }
+
+    return MS::kUnknownParameter;
+}
+
+MStatus physicsBatchEngine::setDependentsDirty(const MPlug& plug, MPlugArray& plugArray)
+{
+    // Any change other than the time invalidates the simulated frames.
+    // Animated parameters are dirtied on every frame in DG evaluation, and then keep no checkpoint.
+    if (plug.attribute() != aInputTime && !(plug == aCurrentStatus || plug.parent() == aCurrentStatus))
+        fCheckpoints.clear();
+
+    return MPxNode::setDependentsDirty(plug, plugArray);
+}
+
+void physicsBatchEngine::getCacheSetup(const MEvaluationNode& evalNode, MNodeCacheDisablingInfo&, MNodeCacheSetupInfo& setupInfo, MObjectArray&) const
+{
+    bool simulation;
+    if (evalNode.dirtyPlugExists(aSimulationEnabled)) {
+        assert(!"'physicsBatchEngine.simulation' cannot not be animated");
+        simulation = true;
+    } else {
+        auto data = const_cast<physicsBatchEngine*>(this)->forceCache();
+        simulation = get_input(data, aSimulationEnabled);
+    }
+
+    if (simulation && evalNode.dirtyPlugExists(aCurrentStatus)) {
+        setupInfo.setRequirement(MNodeCacheSetupInfo::kSimulationSupport,   true);
+        setupInfo.setPreference(MNodeCacheSetupInfo::kWantToCacheByDefault, true);
+    }
+}
+
+void physicsBatchEngine::configCache(const MEvaluationNode& evalNode, MCacheSchema& schema) const
+{
+    // As physicsEngine, aCurrentStatus(t) is needed to compute aCurrentStatus(t+1)
+    if (evalNode.dirtyPlugExists(aCurrentStatus))
+    {
+        schema.add(aCurrentStatus);
+    }
+}
+
+MTimeRange physicsBatchEngine::transformInvalidationRange(const MPlug& source, const MTimeRange& input) const
+{
+    // Frames simulated from the changed inputs can no longer be resumed from
+    MTimeRange range = input | MTimeRange{ input.bounds().min, kMaximumTime };
+    fCheckpoints.invalidate(range.bounds().min);
+    return range;
+}
+
+void* physicsBatchEngine::creator()
+{
+    return new physicsBatchEngine();
+}
+
+MStatus physicsBatchEngine::initialize()
+{
+    MFnNumericAttribute nAttr;
+    MFnUnitAttribute    uAttr;
+    MFnTypedAttribute   tAttr;
+    MFnCompoundAttribute cAttr;
+    MFnVectorArrayData  fnData;
+    MStatus             status;
+
+    aSimulationEnabled = nAttr.create("simulation", "se", MFnNumericData::kBoolean); nAttr.setDefault(true); nAttr.setKeyable(false); nAttr.setWritable(true); nAttr.setReadable(true); nAttr.setStorable(true); nAttr.setChannelBox(true);
+
+    aInputTime = uAttr.create("inputTime", "ipt", MFnUnitAttribute::kTime, 0.0); uAttr.setReadable(false); uAttr.setWritable(true); uAttr.setStorable(false); uAttr.setHidden(true);
+
+    aCurrentStatus = cAttr.create("status", "s");
+        aCurrentTime       = uAttr.create("time", "t", MFnUnitAttribute::kTime); uAttr.setDefault(kMinimumTime); uAttr.setWritable(false); uAttr.setConnectable(false); uAttr.setHidden(true);
+        aCurrentPositions  = tAttr.create("positions", "p", MFnData::kVectorArray, fnData.create());
+        aCurrentVelocities = tAttr.create("velocities", "v", MFnData::kVectorArray, fnData.create());
+        cAttr.addChild(aCurrentTime);
+        cAttr.addChild(aCurrentPositions);
+        cAttr.addChild(aCurrentVelocities);
+    cAttr.setReadable(true);
+    cAttr.setWritable(false);
+    cAttr.setKeyable(false);
+    cAttr.setStorable(true);
+
+    aInitialStatus = cAttr.create("initialStatus", "is");
+        aInitialTime       = uAttr.create("initialTime", "it", MFnUnitAttribute::kTime, 1.0); uAttr.setKeyable(false); uAttr.setChannelBox(true);
+        aInitialPositions  = tAttr.create("initialPositions", "ip", MFnData::kVectorArray, fnData.create());
+        aInitialVelocities = tAttr.create("initialVelocities", "iv", MFnData::kVectorArray, fnData.create());
+        cAttr.addChild(aInitialTime);
+        cAttr.addChild(aInitialPositions);
+        cAttr.addChild(aInitialVelocities);
+    cAttr.setWritable(true);
+    cAttr.setReadable(true);
+    cAttr.setStorable(true);
+
+    aForce               = nAttr.create("force", "f", MFnNumericData::k3Double); nAttr.setDefault(0.0, -9.8, 0.0); nAttr.setWritable(true); nAttr.setReadable(true); nAttr.setStorable(true); nAttr.setChannelBox(true);
+    aMass                = nAttr.create("mass", "m", MFnNumericData::kDouble, 1.0); nAttr.setWritable(true); nAttr.setReadable(true); nAttr.setStorable(true); nAttr.setChannelBox(true);
+
+    aCollisionPlane      = nAttr.create("collisionPlane", "cp", MFnNumericData::k4Double); nAttr.setDefault(0.0, 1.0, 0.0, 0.0); nAttr.setWritable(true); nAttr.setReadable(true); nAttr.setStorable(true); nAttr.setChannelBox(true);
+    aCollisionElasticity = nAttr.create("collisionElasticity", "ce", MFnNumericData::kDouble, 0.8); nAttr.setWritable(true); nAttr.setReadable(true); nAttr.setStorable(true); nAttr.setChannelBox(true);
+
+    aSubsteps            = nAttr.create("substeps", "ss", MFnNumericData::kInt, 1); nAttr.setMin(1); nAttr.setWritable(true); nAttr.setReadable(true); nAttr.setStorable(true); nAttr.setChannelBox(true);
+    aCheckpointInterval  = nAttr.create("checkpointInterval", "ci", MFnNumericData::kInt, 10); nAttr.setMin(0); nAttr.setWritable(true); nAttr.setReadable(true); nAttr.setStorable(true); nAttr.setChannelBox(true);
+
+    status = addAttribute(aSimulationEnabled);
+    status = addAttribute(aInputTime);
+    status = addAttribute(aCurrentStatus);
+    status = addAttribute(aInitialStatus);
+    status = addAttribute(aForce);
+    status = addAttribute(aMass);
+    status = addAttribute(aCollisionPlane);
+    status = addAttribute(aCollisionElasticity);
+    status = addAttribute(aSubsteps);
+    status = addAttribute(aCheckpointInterval);
+
+    status = attributeAffects(aSimulationEnabled,   aCurrentStatus);
+    status = attributeAffects(aInputTime,           aCurrentStatus);
+    status = attributeAffects(aInitialStatus,       aCurrentStatus);
+    status = attributeAffects(aForce,               aCurrentStatus);
+    status = attributeAffects(aMass,                aCurrentStatus);
+    status = attributeAffects(aCollisionPlane,      aCurrentStatus);
+    status = attributeAffects(aCollisionElasticity, aCurrentStatus);
+    status = attributeAffects(aSubsteps,            aCurrentStatus);
+    status = attributeAffects(aCheckpointInterval,  aCurrentStatus);
+
+    return MS::kSuccess;
+}
+
+MCallbackId gNodeAddedCallbackIds[2];
+
+// Ensure <node>.inputTime is always connected to time node
+template <class Node>
+void connectInputTime(MObject& node, void*)
+{
+    static MPlug timeOutPlug;
+    if (timeOutPlug.isNull())
+    {
+        MItDependencyNodes itr { MFn::kTime };
+        MObject timeNode = itr.thisNode();
+        MFnDependencyNode fDN(timeNode);
+        timeOutPlug = { timeNode, fDN.attribute("outTime") };
+    }
+
+    MFnDependencyNode fDN(node);
+    MPlug timeInPlug { node, Node::aInputTime };
+
+    if (!timeOutPlug.isNull() && !timeInPlug.isNull()) {
+        MDGModifier modifier;
+        modifier.connect(timeOutPlug, timeInPlug);
+        modifier.doIt();
+    }
+}
+
 // Plug-in entry points
 //
 MStatus initializePlugin(MObject obj)
@@ -479,26 +950,19 @@ MStatus initializePlugin(MObject obj)
         return status;
     }
 
-    // Ensure physicsEngine.inputTime is always connected to time node
-    gNodeAddedCallbackId = MDGMessage::addNodeAddedCallback([](MObject& node, void*) {
-        static MPlug timeOutPlug;
-        if (timeOutPlug.isNull())
-        {
-            MItDependencyNodes itr { MFn::kTime };
-            MObject timeNode = itr.thisNode();
-            MFnDependencyNode fDN(timeNode);
-            timeOutPlug = { timeNode, fDN.attribute("outTime") };
-        }
-
-        MFnDependencyNode fDN(node);
-        MPlug timeInPlug { node, physicsEngine::aInputTime };
+    status = plugin.registerNode(
+        physicsBatchEngine::nodeName,
+        physicsBatchEngine::id,
+        physicsBatchEngine::creator,
+        physicsBatchEngine::initialize
+    );
+    if (!status) {
+        status.perror("registerNode");
+        return status;
+    }
 
-        if (!timeOutPlug.isNull() && !timeInPlug.isNull()) {
-            MDGModifier modifier;
-            modifier.connect(timeOutPlug, timeInPlug);
-            modifier.doIt();
-        }
-    }, physicsEngine::nodeName);
+    gNodeAddedCallbackIds[0] = MDGMessage::addNodeAddedCallback(connectInputTime<physicsEngine>, physicsEngine::nodeName);
+    gNodeAddedCallbackIds[1] = MDGMessage::addNodeAddedCallback(connectInputTime<physicsBatchEngine>, physicsBatchEngine::nodeName);
 
     return status;
 }
@@ -508,7 +972,14 @@ MStatus uninitializePlugin(MObject obj)
     MStatus   status;
     MFnPlugin plugin(obj);
 
-    MDGMessage::removeCallback(gNodeAddedCallbackId);
+    MDGMessage::removeCallback(gNodeAddedCallbackIds[0]);
+    MDGMessage::removeCallback(gNodeAddedCallbackIds[1]);
+
+    status = plugin.deregisterNode(physicsBatchEngine::id);
+    if (!status) {
+        status.perror("deregisterNode");
+        return status;
+    }
 
     status = plugin.deregisterNode(physicsEngine::id);
     if (!status) {
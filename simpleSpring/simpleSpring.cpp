@@ -19,6 +19,16 @@
 // The example MEL script "simpleSpring.mel" shows how to create the node
 // and appropriate connections to correctly establish a user defined spring law. 
 //
+// Maya calls applySpringLaw() once per spring. The node also evaluates the
+// same law for all the springs of a network at once from arrays, see
+// springBatch.h, for solvers which hold the positions of all the particles.
+//
+// The simpleSpringBenchmark command runs both versions of a node on a
+// random network and compares them:
+//
+//  simpleSpringBenchmark -particles 100000 -springs 500000 simpleSpring1;
+//  // Result: pairSeconds networkSeconds maxDifference //
+//
 
 #include <maya/MIOStream.h>
 #include <math.h>
@@ -26,6 +36,18 @@
 #include "simpleSpring.h"
 #include <maya/MFnDependencyNode.h>
 #include <maya/MFnNumericAttribute.h>
+#include <maya/MPxCommand.h>
+#include <maya/MSyntax.h>
+#include <maya/MArgDatabase.h>
+#include <maya/MArgList.h>
+#include <maya/MSelectionList.h>
+#include <maya/MStringArray.h>
+#include <maya/MDoubleArray.h>
+#include <maya/MTimer.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
 
 
 //=================================================================
@@ -130,6 +152,188 @@ MStatus simpleSpring::applySpringLaw
 }
 
 
+MStatus simpleSpring::applySpringLaw
+(
+    springBatch::Network &network,
+    const MVectorArray &positions,
+    MVectorArray &forces
+)
+//
+//  Descriptions:
+//      Computes the forces of all the springs of network, with the
+//      spring law of the method above, and sums them per particle.
+//
+{
+    int numParticles = network.numParticles();
+    if( (int)positions.length() != numParticles )
+        return( MS::kInvalidParameter );
+
+    std::vector<double> xyz( 3 * (size_t)numParticles );
+    std::vector<double> sum( 3 * (size_t)numParticles );
+    int i;
+    for( i = 0; i < numParticles; i++ )
+    {
+        xyz[3*i]   = positions[i].x;
+        xyz[3*i+1] = positions[i].y;
+        xyz[3*i+2] = positions[i].z;
+    }
+
+    if( numParticles > 0 )
+        network.forces( factor, &xyz[0], &sum[0] );
+
+    forces.setLength( numParticles );
+    for( i = 0; i < numParticles; i++ )
+        forces[i] = MVector( sum[3*i], sum[3*i+1], sum[3*i+2] );
+
+    return( MS::kSuccess );
+}
+
+
+//
+//  simpleSpringBenchmark [-particles N] [-springs S] simpleSpringNode
+//
+//  Builds a network of S springs between random pairs of N random
+//  particles in a 100 unit cube, with random rest lengths, and computes the
+//  force on every particle with the node's spring factor, once through the
+//  per-pair applySpringLaw() summed serially and once through the array
+//  version. Returns the per-pair time, the array time (network build
+//  excluded) and the largest difference between the forces.
+//
+#define kParticlesFlag              "-p"
+#define kParticlesFlagLong          "-particles"
+#define kSpringsFlag                "-s"
+#define kSpringsFlagLong            "-springs"
+
+class simpleSpringBenchmarkCmd : public MPxCommand
+{
+public:
+    MStatus         doIt( const MArgList& args ) override;
+
+    static void     *creator();
+    static MSyntax  newSyntax();
+};
+
+void *simpleSpringBenchmarkCmd::creator()
+{
+    return new simpleSpringBenchmarkCmd;
+}
+
+MSyntax simpleSpringBenchmarkCmd::newSyntax()
+{
+    MSyntax syntax;
+    syntax.addFlag( kParticlesFlag, kParticlesFlagLong, MSyntax::kLong );
+    syntax.addFlag( kSpringsFlag, kSpringsFlagLong, MSyntax::kLong );
+    syntax.setObjectType( MSyntax::kStringObjects, 1, 1 );
+    return syntax;
+}
+
+MStatus simpleSpringBenchmarkCmd::doIt( const MArgList& args )
+{
+    MStatus status;
+    MArgDatabase argData( syntax(), args, &status );
+    if (!status) return status;
+
+    int numParticles = 100000, numSprings = 500000;
+    if (argData.isFlagSet( kParticlesFlag ))
+        argData.getFlagArgument( kParticlesFlag, 0, numParticles );
+    if (argData.isFlagSet( kSpringsFlag ))
+        argData.getFlagArgument( kSpringsFlag, 0, numSprings );
+    if (numParticles <= 0 || numSprings <= 0)
+    {
+        displayError( "The particle and spring counts must be positive." );
+        return MS::kInvalidParameter;
+    }
+
+    MStringArray names;
+    argData.getObjects( names );
+    MSelectionList list;
+    MObject node;
+    if (!list.add( names[0] ) || !list.getDependNode( 0, node ))
+    {
+        displayError( "No node " + names[0] );
+        return MS::kInvalidParameter;
+    }
+    MFnDependencyNode fnNode( node );
+    if (fnNode.typeId() != simpleSpring::id)
+    {
+        displayError( names[0] + " is not a simpleSpring node." );
+        return MS::kInvalidParameter;
+    }
+
+    // The factor compute() would read
+    simpleSpring *spring = (simpleSpring *) fnNode.userNode();
+    spring->factor = fnNode.findPlug( simpleSpring::aSpringFactor, true ).asDouble();
+
+    std::mt19937 rng( 1 );
+    std::uniform_real_distribution<double> coord( -50.0, 50.0 );
+    std::uniform_real_distribution<double> rest( 0.0, 10.0 );
+    std::uniform_int_distribution<int> particle( 0, numParticles - 1 );
+
+    MVectorArray positions( numParticles );
+    int i;
+    for (i = 0; i < numParticles; i++)
+    {
+        double x = coord( rng ), y = coord( rng ), z = coord( rng );
+        positions[i] = MVector( x, y, z );
+    }
+    std::vector<int> end1( numSprings ), end2( numSprings );
+    std::vector<double> restLength( numSprings );
+    for (i = 0; i < numSprings; i++)
+    {
+        end1[i] = particle( rng );
+        end2[i] = particle( rng );
+        restLength[i] = rest( rng );
+    }
+
+    // Per pair, each particle adding the forces of its springs in the
+    // order the springs are listed, as the network does
+    MTimer timer;
+    timer.beginTimer();
+    MVectorArray pairForces( numParticles, MVector::zero );
+    const MVector zero = MVector::zero;
+    for (i = 0; i < numSprings; i++)
+    {
+        MVector forceV1, forceV2;
+        spring->applySpringLaw( 0.0, 0.0, restLength[i], 1.0, 1.0,
+                                positions[end1[i]], positions[end2[i]],
+                                zero, zero, forceV1, forceV2 );
+        pairForces[end1[i]] += forceV1;
+        pairForces[end2[i]] += forceV2;
+    }
+    timer.endTimer();
+    double pairTime = timer.elapsedTime();
+
+    springBatch::Network network;
+    network.build( numParticles, numSprings, &end1[0], &end2[0], &restLength[0] );
+
+    MVectorArray networkForces;
+    timer.beginTimer();
+    status = spring->applySpringLaw( network, positions, networkForces );
+    timer.endTimer();
+    if (!status)
+    {
+        displayError( "The network evaluation failed." );
+        return status;
+    }
+
+    double maxDifference = 0.0;
+    for (i = 0; i < numParticles; i++)
+    {
+        MVector d = pairForces[i] - networkForces[i];
+        maxDifference = std::max( maxDifference,
+                                  std::max( fabs( d.x ), std::max( fabs( d.y ), fabs( d.z ) ) ) );
+    }
+
+    MDoubleArray result;
+    result.append( pairTime );
+    result.append( timer.elapsedTime() );
+    result.append( maxDifference );
+    setResult( result );
+
+    return MS::kSuccess;
+}
+
+
 MStatus initializePlugin(MObject obj)
 {
     MStatus status;
@@ -143,6 +347,14 @@ MStatus initializePlugin(MObject obj)
         return status;
     }
 
+    status = plugin.registerCommand( "simpleSpringBenchmark",
+                                     simpleSpringBenchmarkCmd::creator,
+                                     simpleSpringBenchmarkCmd::newSyntax );
+    if (!status) {
+        status.perror("registerCommand");
+        return status;
+    }
+
     return status;
 }
 
@@ -151,6 +363,12 @@ MStatus uninitializePlugin(MObject obj)
     MStatus status;
     MFnPlugin plugin(obj);
 
+    status = plugin.deregisterCommand( "simpleSpringBenchmark" );
+    if (!status) {
+        status.perror("deregisterCommand");
+        return status;
+    }
+
     status = plugin.deregisterNode( simpleSpring::id );
     if (!status) {
         status.perror("deregisterNode");
@@ -17,6 +17,9 @@
 #include <maya/MDataBlock.h>
 #include <maya/MFnPlugin.h>
 #include <maya/MPxSpringNode.h>
+#include <maya/MVectorArray.h>
+
+#include "springBatch.h"
 
 
 
@@ -49,6 +52,13 @@ public:
                         const MVector &endV1, const MVector &endV2,
                         MVector &forceV1, MVector &forceV2 ) override;
 
+    // Array version of applySpringLaw(), for callers holding the positions
+    // of all the particles of a spring network: returns in forces the sum
+    // of the spring forces on each particle.
+    //
+    MStatus applySpringLaw( springBatch::Network &network,
+                        const MVectorArray &positions, MVectorArray &forces );
+
 
     //=================================================================
     // If you need new attributes, add them here. Below is an example.
@@ -68,6 +78,7 @@ public:
     double  end2WeightValue( MDataBlock& block );
 
 private:
+    friend class simpleSpringBenchmarkCmd;
 
     // methods to get attribute value.
     //
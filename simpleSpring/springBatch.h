@@ -0,0 +1,173 @@
+//-
+// ==========================================================================
+// Copyright 2015 Autodesk, Inc.  All rights reserved.
+//
+// Use of this software is subject to the terms of the Autodesk
+// license agreement provided at the time of installation or download,
+// or which otherwise accompanies this software in either electronic
+// or hard copy form.
+// ==========================================================================
+//+
+
+#ifndef _springBatch_h_
+#define _springBatch_h_
+
+//  Description
+//  Array evaluation of the spring law of the simpleSpring node,
+//
+//      F = - factor * (L - restLength) * Vector of (endP1 - endP2),
+//
+//  for all the springs of a network at once. It does not depend on Maya.
+//
+//  The forces are computed in three passes, each of them in parallel:
+//
+//  - the end points of a block of springs are gathered into contiguous
+//    arrays,
+//  - the force of each spring of the block is computed from them, in a
+//    loop without branches which the compiler vectorizes,
+//  - the forces are summed per particle, each particle adding the forces
+//    of the springs attached to it in the order they are listed in the
+//    network. This needs no atomics or per-thread accumulators, and the
+//    sums do not depend on the number of threads.
+//
+//  The springs attached to each particle are found once, when the network
+//  is built.
+//
+
+#include <math.h>
+#include <vector>
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
+namespace springBatch
+{
+
+// Springs per task
+const int kGrainSize = 4096;
+
+// Springs whose end points are gathered at a time
+const int kBatchSize = 1024;
+
+// Force of end 1 of count springs, (endP1 - endP2) being (dx, dy, dz).
+// The force of end 2 is the opposite. A spring of length zero has no
+// force, as MVector::normalize() leaves a null vector unchanged: its
+// (dx, dy, dz) is null whatever it is divided by. gcc only vectorizes the
+// loop without math errno (-fno-math-errno), because of sqrt().
+inline void springLaw( int count, double factor,
+                       const double* __restrict dx, const double* __restrict dy,
+                       const double* __restrict dz,
+                       const double* __restrict restLength,
+                       double* __restrict fx, double* __restrict fy,
+                       double* __restrict fz )
+{
+    for ( int i = 0; i < count; i++ ) {
+        const double L = sqrt( dx[i]*dx[i] + dy[i]*dy[i] + dz[i]*dz[i] );
+        const double isNull = ( L > 0.0 ) ? 0.0 : 1.0;
+        const double s = - factor * ( L - restLength[i] ) / ( L + isNull );
+        fx[i] = s * dx[i];
+        fy[i] = s * dy[i];
+        fz[i] = s * dz[i];
+    }
+}
+
+class Network
+{
+public:
+    // Builds the network of the springs between particles end1[i] and
+    // end2[i], with the given rest lengths. Springs referring to particles
+    // outside [0, numParticles) are ignored.
+    void build( int numParticles, int numSprings, const int* end1,
+                const int* end2, const double* restLength )
+    {
+        fNumParticles = numParticles;
+        fEnd1.clear();
+        fEnd2.clear();
+        fRestLength.clear();
+        int s;
+        for ( s = 0; s < numSprings; s++ ) {
+            if ( end1[s] < 0 || end1[s] >= numParticles ||
+                 end2[s] < 0 || end2[s] >= numParticles )
+                continue;
+            fEnd1.push_back( end1[s] );
+            fEnd2.push_back( end2[s] );
+            fRestLength.push_back( restLength[s] );
+        }
+
+        // Springs of each particle, as 2 * spring + end (0 or 1)
+        const int count = (int) fEnd1.size();
+        fFirst.assign( numParticles + 1, 0 );
+        for ( s = 0; s < count; s++ ) {
+            fFirst[fEnd1[s] + 1]++;
+            fFirst[fEnd2[s] + 1]++;
+        }
+        for ( int p = 0; p < numParticles; p++ )
+            fFirst[p + 1] += fFirst[p];
+        fAttached.resize( 2 * (size_t) count );
+        std::vector<int> fill( fFirst.begin(), fFirst.end() - 1 );
+        for ( s = 0; s < count; s++ ) {
+            fAttached[fill[fEnd1[s]]++] = 2 * s;
+            fAttached[fill[fEnd2[s]]++] = 2 * s + 1;
+        }
+
+        fFx.resize( count );
+        fFy.resize( count );
+        fFz.resize( count );
+    }
+
+    int numParticles() const { return fNumParticles; }
+    int numSprings() const { return (int) fEnd1.size(); }
+
+    // Computes the spring force on each particle. position and force
+    // hold numParticles() x y z triples.
+    void forces( double factor, const double* position, double* force )
+    {
+        const int count = numSprings();
+        tbb::parallel_for( tbb::blocked_range<int>( 0, count, kGrainSize ),
+            [&]( const tbb::blocked_range<int>& r ) {
+                const int first = r.begin(), n = r.end() - r.begin();
+                double dx[kBatchSize], dy[kBatchSize], dz[kBatchSize];
+                for ( int b = 0; b < n; b += kBatchSize ) {
+                    const int m = ( n - b < kBatchSize ) ? n - b : kBatchSize;
+                    for ( int i = 0; i < m; i++ ) {
+                        const double* p1 = &position[3 * fEnd1[first + b + i]];
+                        const double* p2 = &position[3 * fEnd2[first + b + i]];
+                        dx[i] = p1[0] - p2[0];
+                        dy[i] = p1[1] - p2[1];
+                        dz[i] = p1[2] - p2[2];
+                    }
+                    springLaw( m, factor, dx, dy, dz, &fRestLength[first + b],
+                               &fFx[first + b], &fFy[first + b], &fFz[first + b] );
+                }
+            });
+
+        tbb::parallel_for( tbb::blocked_range<int>( 0, fNumParticles, kGrainSize ),
+            [&]( const tbb::blocked_range<int>& r ) {
+                for ( int p = r.begin(); p != r.end(); p++ ) {
+                    double f[3] = { 0.0, 0.0, 0.0 };
+                    for ( int k = fFirst[p]; k < fFirst[p + 1]; k++ ) {
+                        const int s = fAttached[k] >> 1;
+                        const double sign = ( fAttached[k] & 1 ) ? -1.0 : 1.0;
+                        f[0] += sign * fFx[s];
+                        f[1] += sign * fFy[s];
+                        f[2] += sign * fFz[s];
+                    }
+                    force[3*p]   = f[0];
+                    force[3*p+1] = f[1];
+                    force[3*p+2] = f[2];
+                }
+            });
+    }
+
+private:
+    int                 fNumParticles = 0;
+    std::vector<int>    fEnd1, fEnd2;
+    std::vector<double> fRestLength;
+    std::vector<int>    fFirst;         // first attached spring of each particle
+    std::vector<int>    fAttached;      // springs of each particle, by particle
+    std::vector<double> fFx, fFy, fFz;  // force of end 1 of each spring
+};
+
+}
+
+#endif
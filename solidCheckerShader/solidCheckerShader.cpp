@@ -13,6 +13,7 @@
 #include <maya/MFloatMatrix.h>
 #include <maya/MFnPlugin.h>
 
+#include "../common/batchTexture.h"
 
 //
 // DESCRIPTION:    
@@ -24,6 +25,11 @@
 // To use this shader, create a SolidChecker node and connect its output to an input 
 // of a surface/shader node such as Color. 
 //
+// The plug-in also provides the command "solidCheckerSample", which
+// evaluates a solidChecker node on many world space points at once rather
+// than one compute() per sample, and can bake the texture to an image. See
+// common/batchTexture.h.
+//
 
 
 class mySChecker : public MPxNode
@@ -41,6 +47,21 @@ class mySChecker : public MPxNode
     //  Id tag for use with binary file format
     static const MTypeId id;
 
+    // Batch interface, see batchTexture.h
+    struct Params
+    {
+        MFloatVector    color1;
+        MFloatVector    color2;
+        MFloatMatrix    placement;
+        float           bias[3];
+    };
+
+    static const unsigned int kCoordinates = 3;
+
+    static MStatus getParams( const MObject& node, Params& params );
+    static void sampleBatch( const Params& params, const float* worldPoints,
+                             size_t count, float* rgba );
+
     private:
 
     // Input attributes
@@ -202,6 +223,45 @@ MStatus mySChecker::compute(const MPlug& plug, MDataBlock& block)
     return MS::kSuccess;
 }
 
+//
+// Batch interface, see batchTexture.h
+//
+MStatus mySChecker::getParams( const MObject& node, Params& params )
+{
+    MStatus status;
+    MFnDependencyNode fnNode( node, &status );
+    if (!status) return status;
+
+    batchTexture::getColor( fnNode, aColor1, params.color1 );
+    batchTexture::getColor( fnNode, aColor2, params.color2 );
+    batchTexture::getFloats( fnNode, aBias, params.bias, 3 );
+
+    return batchTexture::getMatrix( fnNode, aPlaceMat, params.placement );
+}
+
+void mySChecker::sampleBatch( const Params& params, const float* worldPoints,
+                              size_t count, float* rgba )
+{
+    const float c1[3] = { params.color1.x, params.color1.y, params.color1.z };
+    const float c2[3] = { params.color2.x, params.color2.y, params.color2.z };
+    const float* bias = params.bias;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        MFloatPoint pos( worldPoints[3*i], worldPoints[3*i+1], worldPoints[3*i+2] );
+        pos *= params.placement;            // Convert into solid space
+
+        int odd = ((pos.x - floor(pos.x) < bias[0]) +
+                   (pos.y - floor(pos.y) < bias[1]) +
+                   (pos.z - floor(pos.z) < bias[2])) & 1;
+
+        rgba[4*i]   = odd ? c2[0] : c1[0];
+        rgba[4*i+1] = odd ? c2[1] : c1[1];
+        rgba[4*i+2] = odd ? c2[2] : c1[2];
+        rgba[4*i+3] = odd ? 1.0f : 0.0f;
+    }
+}
+
 
 MStatus initializePlugin( MObject obj )
 {
@@ -211,6 +271,9 @@ MStatus initializePlugin( MObject obj )
     plugin.registerNode("solidChecker", mySChecker::id, 
                         &mySChecker::creator, &mySChecker::initialize,
                         MPxNode::kDependNode, &UserClassify );
+    plugin.registerCommand( "solidCheckerSample",
+                            batchTexture::SampleCmd<mySChecker>::creator,
+                            batchTexture::SampleCmd<mySChecker>::newSyntax );
 
     return MS::kSuccess;
 }
@@ -218,6 +281,7 @@ MStatus initializePlugin( MObject obj )
 MStatus uninitializePlugin( MObject obj )
 {
     MFnPlugin plugin( obj );
+    plugin.deregisterCommand( "solidCheckerSample" );
     plugin.deregisterNode( mySChecker::id );
 
     return MS::kSuccess;
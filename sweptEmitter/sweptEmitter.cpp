@@ -45,6 +45,9 @@
 #include <maya/MFnArrayAttrsData.h>
 #include <maya/MFnMatrixData.h>
 
+#include "../common/emitterJitter.h"
+#include "../common/pathEmission.h"
+
 
 
 MTypeId sweptEmitter::id( 0x80016 );
@@ -191,74 +194,56 @@ MStatus sweptEmitter::compute(const MPlug& plug, MDataBlock& block)
         MObject sweptData = sweptHandle.data();
         MFnDynSweptGeometryData fnSweptData( sweptData );
 
-
-        // Curve emission
+        // Gather the points of all the lines and triangles, so that
+        // they are emitted from at once.
         //
-        if (fnSweptData.lineCount() > 0) {
-            int numLines = fnSweptData.lineCount();
-        
-            for ( int i=0; i<numLines; i++ )
-            {
-                inPosAry.clear();
-                inVelAry.clear();
-                emitCountPP.clear();
-
-                MDynSweptLine line = fnSweptData.sweptLine( i );
+        int numLines = fnSweptData.lineCount();
+        int numTriangles = fnSweptData.triangleCount();
+        int numPoints = 2 * numLines + numTriangles;
 
-                // ... process current line ...
-                MVector p1 = line.vertex( 0 );
-                MVector p2 = line.vertex( 1 );
+        inPosAry.setLength( numPoints );
+        inVelAry.setLength( numPoints );
 
-                inPosAry.append( p1 );
-                inPosAry.append( p2 );
-
-                inVelAry.append( MVector( 0,0,0 ) );
-                inVelAry.append( MVector( 0,0,0 ) );
-
-                // emit Rate for two points on line
-                emitCountPP.clear();
-                status = emitCountPerPoint( plug, block, 2, emitCountPP );
+        // Curve emission
+        //
+        for ( int i=0; i<numLines; i++ )
+        {
+            MDynSweptLine line = fnSweptData.sweptLine( i );
 
-                emit( inPosAry, inVelAry, emitCountPP,
-                    dt, speed, inheritFactor, rotatedV, fnOutPos, fnOutVel );
+            // ... process current line ...
+            inPosAry[2*i] = line.vertex( 0 );
+            inPosAry[2*i+1] = line.vertex( 1 );
 
-            }
+            inVelAry[2*i] = MVector( 0,0,0 );
+            inVelAry[2*i+1] = MVector( 0,0,0 );
         }
 
         // Surface emission (nurb or polygon)
         //
-        if (fnSweptData.triangleCount() > 0) {
-            int numTriangles = fnSweptData.triangleCount();
-        
-            for ( int i=0; i<numTriangles; i++ )
-            {
-                inPosAry.clear();
-                inVelAry.clear();
-                emitCountPP.clear();
-
-                MDynSweptTriangle tri = fnSweptData.sweptTriangle( i );
-
-                // ... process current triangle ...
-                MVector p1 = tri.vertex( 0 );
-                MVector p2 = tri.vertex( 1 );
-                MVector p3 = tri.vertex( 2 );
+        for ( int i=0; i<numTriangles; i++ )
+        {
+            MDynSweptTriangle tri = fnSweptData.sweptTriangle( i );
 
-                MVector center = p1 + p2 + p3;
-                center /= 3.0;
+            // ... process current triangle ...
+            MVector p1 = tri.vertex( 0 );
+            MVector p2 = tri.vertex( 1 );
+            MVector p3 = tri.vertex( 2 );
 
-                inPosAry.append( center );
+            MVector center = p1 + p2 + p3;
+            center /= 3.0;
 
-                inVelAry.append( MVector( 0,0,0 ) );
+            inPosAry[2*numLines+i] = center;
 
-                // emit Rate for two points on line
-                emitCountPP.clear();
-                status = emitCountPerPoint( plug, block, 1, emitCountPP );
+            inVelAry[2*numLines+i] = MVector( 0,0,0 );
+        }
 
-                emit( inPosAry, inVelAry, emitCountPP,
-                    dt, speed, inheritFactor, rotatedV, fnOutPos, fnOutVel );
+        // emit Rate for all the points
+        status = emitCountPerPoint( plug, block, numPoints, emitCountPP );
 
-            }
-        }
+        emit( inPosAry, inVelAry, emitCountPP,
+            dt, speed, inheritFactor, rotatedV,
+            emitterJitter::seed( emitterJitter::seedAttribute( block, multiIndex ), cT ),
+            fnOutPos, fnOutVel );
     }
 
     // Update the data block with new dOutput and set plug clean.
@@ -279,66 +264,18 @@ void sweptEmitter::emit
         double speed,                   // speed factor
         double inheritFactor,           // for inherit velocity
         MVector dirV,                   // emit direction
+        unsigned long long seed,        // seed of the jitter
         MVectorArray &outPosAry,        // holding new particles position
         MVectorArray &outVelAry         // holding new particles velocity
     )
 //
 //  Descriptions:
+//      Emits emitCountPP[index] particles from each point, see
+//      common/pathEmission.h.
 //
 {
-    // check the length of input arrays.
-    //
-    int posLength = inPosAry.length();
-    int velLength = inVelAry.length();
-    int countLength = emitCountPP.length();
-    if( (posLength != velLength) || (posLength != countLength) )
-        return;
-
-    // Compute total emit count.
-    //
-    int index;
-    int totalCount = 0;
-    for( index = 0; index < countLength; index ++ )
-        totalCount += emitCountPP[index];
-
-    if( totalCount <= 0 )
-        return;
-
-    // Map direction vector into world space and normalize it.
-    //
-    dirV.normalize();
-
-    // Start emission.
-    //
-    int emitCount;
-    MVector newPos, newVel;
-    MVector prePos, sPos, sVel;
-    for( index = 0; index < posLength; index++ )
-    {
-        emitCount = emitCountPP[index];
-        if( emitCount <= 0 )
-            continue;
-
-        sPos = inPosAry[index];
-        sVel = inVelAry[index];
-        prePos = sPos - sVel * dt;
-
-        for( int i = 0; i < emitCount; i++ )
-        {
-            double alpha = ( (double)i + drand48() ) / (double)emitCount;
-            newPos = (1 - alpha) * prePos + alpha * sPos;
-            newVel = dirV * speed;
-
-            newPos += newVel * ( dt * (1 - alpha) );
-            newVel += sVel * inheritFactor;
-
-            // Add new data into output arrays.
-            //
-            outPosAry.append( newPos );
-            outVelAry.append( newVel );
-        }
-    }
-
+    pathEmission::emit( inPosAry, inVelAry, emitCountPP, dt, speed,
+                        inheritFactor, dirV, seed, outPosAry, outVelAry );
 }
 
 MVector sweptEmitter::useRotation ( MVector &direction )
@@ -417,9 +354,11 @@ MStatus sweptEmitter::emitCountPerPoint
     double dblCount = rate * dt.as( MTime::kSeconds );
 
     int intCount = (int)dblCount;
+    unsigned int first = emitCountPP.length();
+    emitCountPP.setLength( first + length );
     for( int i = 0; i < length; i++ )
     {
-        emitCountPP.append( intCount );
+        emitCountPP[first + i] = intCount;
     }
 
     return( MS::kSuccess );
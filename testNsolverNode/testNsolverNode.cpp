@@ -29,6 +29,7 @@
 #include <maya/MFloatPointArray.h>
 #include <maya/MItMeshVertex.h>
 #include <maya/MFnPlugin.h>
+#include <maya/MTimer.h>
 #include <math.h>
 
 /*
@@ -69,7 +70,9 @@ to reflect the effects of any external animation.
 Once all the nThings have been updated, the solve() call on the solver
 will update all the objects that have been assigned to that solver.
 
-After that, we mark the plug clean to indicate that the solve is completed.
+After that, we mark all the nextState elements clean to indicate that the
+solve is completed, so that the pulls of the other nThings on their own
+element do not solve the same frame again.
 You may notive that we're not actually passing back any data or an updated
 MnObject, This is because when we added an object to the MnSolver at the start frame,
 it actually got a pointer to the internal data of the source object, and
@@ -80,6 +83,18 @@ updated.
 A motivated individual could add some current and start state connections for passive
 objects, and just skip the next state connections on those.
 
+The time in seconds spent in the last compute updating the objects (pulling
+their current or start state), solving, and marking the next states clean is
+stored in the updateDuration, solveDuration and extractDuration attributes:
+
+    getAttr testNsolverNode1.updateDuration;
+
+extractDuration only covers marking the next states clean: the solver writes
+into the objects' data directly, so there is nothing else to extract.
+The solve writes the three attributes as a side effect. Nothing affects them,
+so they are never dirty and reading them does not trigger a solve; they hold
+the timings of the last solve that ran.
+
 Below is some example code to test this plugin:
 
 //---------------------------------------------------------------------------------
@@ -127,6 +142,9 @@ MObject testNsolverNode::startState;
 MObject testNsolverNode::currentState;
 MObject testNsolverNode::nextState;
 MObject testNsolverNode::currentTime;
+MObject testNsolverNode::updateDuration;
+MObject testNsolverNode::solveDuration;
+MObject testNsolverNode::extractDuration;
 
 
 inline void statCheck( MStatus stat, MString msg )
@@ -155,12 +173,14 @@ MStatus testNsolverNode::compute(const MPlug &plug, MDataBlock &data)
         MTime currTime = data.inputValue(currentTime).asTime();
         float solveTime = (float)currTime.as(MTime::kSeconds);
 
+        MTimer timer;
+        timer.beginTimer();
+
         MObject inputData;
         // start frame setup
         if(currTime.value() <= 1.0) {
-            // actually, there will be multiple pulls on next state at the start frame
-            // if there are multiple nCloth objects - you'll need to check and make sure that 
-            // you only initialize once, or take a performance hit
+            // all the nextState elements are cleaned below, so this is
+            // only done once even if there are multiple nCloth objects.
             // you could also re-initialize if a connection is made or broke at the start frame
             MArrayDataHandle multiDataHandle = data.inputArrayValue(startState);
             int count =  multiDataHandle.elementCount();
@@ -188,20 +208,22 @@ MStatus testNsolverNode::compute(const MPlug &plug, MDataBlock &data)
             solver.makeAllCollide();
         } else {
 
+            // The solver already points to the internal data of the
+            // objects, so pulling on the current states is enough to
+            // update them; there is no need to get an MnCloth for each
+            // of them every frame.
             MArrayDataHandle multiDataHandle = data.inputArrayValue(currentState);
             int count =  multiDataHandle.elementCount();
             for (int i = 0; i < count; i++) {
                 multiDataHandle.jumpToElement(i);
-                inputData =multiDataHandle.inputValue().data();
-        
-                MFnNObjectData inputNData(inputData);       
-                MnCloth * nObj = NULL;
-                inputNData.getObjectPtr(nObj);
-                delete nObj;    
+                multiDataHandle.inputValue();
             }
 
         }
 
+        timer.endTimer();
+        double updateSeconds = timer.elapsedTime();
+
         solver.setGravity(9.8f);
         solver.setGravityDir(0.0f, -1.0f, 0.0f);
         solver.setAirDensity(1.0f);
@@ -212,9 +234,30 @@ MStatus testNsolverNode::compute(const MPlug &plug, MDataBlock &data)
         solver.setSubsteps(3);
         solver.setMaxIterations(4);
 
-    
+        timer.beginTimer();
         solver.solve(solveTime);
+        timer.endTimer();
+        double solveSeconds = timer.elapsedTime();
+
+        // The solve updated every object, so all the next states are
+        // clean, not only the one being pulled.
+        timer.beginTimer();
+        MArrayDataHandle nextHandle = data.outputArrayValue(nextState);
+        nextHandle.setAllClean();
         data.setClean(plug);
+        timer.endTimer();
+
+        double extractSeconds = timer.elapsedTime();
+
+        MDataHandle updateHandle = data.outputValue(updateDuration);
+        updateHandle.set(updateSeconds);
+        updateHandle.setClean();
+        MDataHandle solveHandle = data.outputValue(solveDuration);
+        solveHandle.set(solveSeconds);
+        solveHandle.setClean();
+        MDataHandle extractHandle = data.outputValue(extractDuration);
+        extractHandle.set(extractSeconds);
+        extractHandle.setClean();
     }
     else if ( plug == currentState )
     {   
@@ -266,10 +309,31 @@ MStatus testNsolverNode::initialize()
     MFnUnitAttribute uniAttr;
     currentTime = uniAttr.create( "currentTime", "ctm" , MFnUnitAttribute::kTime,  0.0, &stat  );       
 
+    // timings of the last solve, in seconds. compute(nextState) writes
+    // them, nothing affects them.
+    MFnNumericAttribute nAttr;
+    updateDuration = nAttr.create("updateDuration", "upd", MFnNumericData::kDouble, 0.0, &stat );
+    statCheck(stat, "failed to create updateDuration");
+    nAttr.setWritable(false);
+    nAttr.setStorable(false);
+
+    solveDuration = nAttr.create("solveDuration", "svd", MFnNumericData::kDouble, 0.0, &stat );
+    statCheck(stat, "failed to create solveDuration");
+    nAttr.setWritable(false);
+    nAttr.setStorable(false);
+
+    extractDuration = nAttr.create("extractDuration", "exd", MFnNumericData::kDouble, 0.0, &stat );
+    statCheck(stat, "failed to create extractDuration");
+    nAttr.setWritable(false);
+    nAttr.setStorable(false);
+
     addAttribute(startState);
     addAttribute(currentState);
     addAttribute(nextState);
     addAttribute(currentTime);
+    addAttribute(updateDuration);
+    addAttribute(solveDuration);
+    addAttribute(extractDuration);
     
     attributeAffects(startState, nextState);
     attributeAffects(currentState, nextState);  
@@ -34,6 +34,9 @@ public:
     static MObject currentState;
     static MObject nextState;
     static MObject currentTime;
+    static MObject updateDuration;
+    static MObject solveDuration;
+    static MObject extractDuration;
     MnSolver solver;
 
 };
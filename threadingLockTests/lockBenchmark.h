@@ -0,0 +1,279 @@
+//-
+// ==========================================================================
+// Copyright 1995,2006,2008 Autodesk, Inc. All rights reserved.
+//
+// Use of this software is subject to the terms of the Autodesk
+// license agreement provided at the time of installation or download,
+// or which otherwise accompanies this software in either electronic
+// or hard copy form.
+// ==========================================================================
+//+
+
+#ifndef _lockBenchmark_h_
+#define _lockBenchmark_h_
+
+//
+// DESCRIPTION:
+// Benchmark of the ways threads can update a shared sum, used by the
+// threadingLockTests command and by the standalone lockBenchmarkMain.cpp.
+// It does not depend on Maya.
+//
+// Each primitive counts the elements of a tbb::parallel_for over
+// `iterations' elements. Before each update of the count, the thread does
+// `work' steps of private computation: with no work, every thread updates
+// the count all the time (high contention); with more work, the updates
+// are further apart (low contention).
+//
+// The primitives are:
+//
+//  lock <name>     a lock taken around each update of one shared count,
+//                  for any class with lock() and unlock() (std::mutex,
+//                  tbb::spin_mutex, MSpinLock, MMutexLock, ...)
+//  atomic          std::atomic fetch_add on one shared count
+//  combinable      tbb::combinable count per thread, combined at the end
+//  ets             tbb::enumerable_thread_specific count per thread
+//  padded          a count per thread in an array, one per cache line
+//  unpadded        the same without padding, so the counts share cache
+//                  lines (false sharing)
+//  reduce          tbb::parallel_reduce
+//  serial          a plain loop on the calling thread
+//
+// sweep() runs each primitive for each thread count, in a tbb::task_arena
+// of that many threads, and each amount of work, keeps the best time of
+// `repeat' runs and writes one CSV line per run:
+//
+//  primitive,threads,work,iterations,seconds,mupdates_per_second,correct
+//
+// correct is 0 when the count is wrong, which only the racy primitives
+// would produce.
+//
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <tbb/blocked_range.h>
+#include <tbb/combinable.h>
+#include <tbb/enumerable_thread_specific.h>
+#include <tbb/parallel_for.h>
+#include <tbb/parallel_reduce.h>
+#include <tbb/task_arena.h>
+
+namespace lockBenchmark
+{
+
+const int kCacheLine = 64;
+
+// Private computation done before each update, returned so that it is not
+// optimized away
+inline unsigned int privateWork( unsigned int x, int work )
+{
+    for ( int w = 0; w < work; w++ )
+        x = x * 1664525u + 1013904223u;
+    return x;
+}
+
+// Every kernel returns the count, and xors the results of privateWork()
+// into sink
+typedef std::function<long long( int iterations, int work,
+                                 std::atomic<unsigned int>& sink )> Kernel;
+
+struct Primitive
+{
+    std::string name;
+    Kernel      kernel;
+};
+
+template <class Lock>
+long long lockedCount( int iterations, int work, std::atomic<unsigned int>& sink )
+{
+    long long count = 0;
+    Lock lock;
+    tbb::parallel_for( tbb::blocked_range<int>( 0, iterations ),
+        [&]( const tbb::blocked_range<int>& r ) {
+            unsigned int x = 0;
+            for ( int i = r.begin(); i != r.end(); i++ ) {
+                x ^= privateWork( i, work );
+                lock.lock();
+                count += 1;
+                lock.unlock();
+            }
+            sink ^= x;
+        });
+    return count;
+}
+
+inline long long atomicCount( int iterations, int work, std::atomic<unsigned int>& sink )
+{
+    std::atomic<long long> count( 0 );
+    tbb::parallel_for( tbb::blocked_range<int>( 0, iterations ),
+        [&]( const tbb::blocked_range<int>& r ) {
+            unsigned int x = 0;
+            for ( int i = r.begin(); i != r.end(); i++ ) {
+                x ^= privateWork( i, work );
+                count.fetch_add( 1, std::memory_order_relaxed );
+            }
+            sink ^= x;
+        });
+    return count;
+}
+
+inline long long combinableCount( int iterations, int work, std::atomic<unsigned int>& sink )
+{
+    tbb::combinable<long long> count( [] { return 0LL; } );
+    tbb::parallel_for( tbb::blocked_range<int>( 0, iterations ),
+        [&]( const tbb::blocked_range<int>& r ) {
+            unsigned int x = 0;
+            for ( int i = r.begin(); i != r.end(); i++ ) {
+                x ^= privateWork( i, work );
+                count.local() += 1;
+            }
+            sink ^= x;
+        });
+    return count.combine( []( long long a, long long b ) { return a + b; } );
+}
+
+inline long long etsCount( int iterations, int work, std::atomic<unsigned int>& sink )
+{
+    tbb::enumerable_thread_specific<long long> count( 0LL );
+    tbb::parallel_for( tbb::blocked_range<int>( 0, iterations ),
+        [&]( const tbb::blocked_range<int>& r ) {
+            unsigned int x = 0;
+            for ( int i = r.begin(); i != r.end(); i++ ) {
+                x ^= privateWork( i, work );
+                count.local() += 1;
+            }
+            sink ^= x;
+        });
+    return count.combine( []( long long a, long long b ) { return a + b; } );
+}
+
+struct alignas( kCacheLine ) PaddedCount
+{
+    long long value;
+};
+
+// A count per thread of the current arena, padded to a cache line or not
+template <class Count>
+long long perThreadCount( int iterations, int work, std::atomic<unsigned int>& sink )
+{
+    std::vector<Count> counts( tbb::this_task_arena::max_concurrency() );
+    for ( size_t t = 0; t < counts.size(); t++ )
+        counts[t].value = 0;
+    tbb::parallel_for( tbb::blocked_range<int>( 0, iterations ),
+        [&]( const tbb::blocked_range<int>& r ) {
+            Count& count = counts[tbb::this_task_arena::current_thread_index()];
+            unsigned int x = 0;
+            for ( int i = r.begin(); i != r.end(); i++ ) {
+                x ^= privateWork( i, work );
+                // volatile, so that each update goes to memory as with
+                // the other primitives instead of being kept in a register
+                *(volatile long long*) &count.value += 1;
+            }
+            sink ^= x;
+        });
+    long long total = 0;
+    for ( size_t t = 0; t < counts.size(); t++ )
+        total += counts[t].value;
+    return total;
+}
+
+struct UnpaddedCount
+{
+    long long value;
+};
+
+inline long long reduceCount( int iterations, int work, std::atomic<unsigned int>& sink )
+{
+    return tbb::parallel_reduce( tbb::blocked_range<int>( 0, iterations ), 0LL,
+        [&]( const tbb::blocked_range<int>& r, long long count ) {
+            unsigned int x = 0;
+            for ( int i = r.begin(); i != r.end(); i++ ) {
+                x ^= privateWork( i, work );
+                count += 1;
+            }
+            sink ^= x;
+            return count;
+        },
+        []( long long a, long long b ) { return a + b; } );
+}
+
+inline long long serialCount( int iterations, int work, std::atomic<unsigned int>& sink )
+{
+    long long count = 0;
+    unsigned int x = 0;
+    for ( int i = 0; i < iterations; i++ ) {
+        x ^= privateWork( i, work );
+        count += 1;
+    }
+    sink ^= x;
+    return count;
+}
+
+// The primitives which need neither Maya nor a lock class
+inline void addStandardPrimitives( std::vector<Primitive>& primitives )
+{
+    primitives.push_back( Primitive{ "atomic", atomicCount } );
+    primitives.push_back( Primitive{ "combinable", combinableCount } );
+    primitives.push_back( Primitive{ "ets", etsCount } );
+    primitives.push_back( Primitive{ "padded", perThreadCount<PaddedCount> } );
+    primitives.push_back( Primitive{ "unpadded", perThreadCount<UnpaddedCount> } );
+    primitives.push_back( Primitive{ "reduce", reduceCount } );
+    primitives.push_back( Primitive{ "serial", serialCount } );
+}
+
+// 1, 2, 4, ... up to maxThreads, and maxThreads itself
+inline std::vector<int> threadCounts( int maxThreads )
+{
+    std::vector<int> counts;
+    for ( int n = 1; n < maxThreads; n *= 2 )
+        counts.push_back( n );
+    counts.push_back( maxThreads > 0 ? maxThreads : 1 );
+    return counts;
+}
+
+inline void writeHeader( std::ostream& csv )
+{
+    csv << "primitive,threads,work,iterations,seconds,mupdates_per_second,correct\n";
+}
+
+inline void sweep( const std::vector<Primitive>& primitives,
+                   const std::vector<int>& threads, const std::vector<int>& works,
+                   int iterations, int repeat, std::ostream& csv )
+{
+    std::atomic<unsigned int> sink( 0 );
+    for ( size_t p = 0; p < primitives.size(); p++ ) {
+        for ( size_t t = 0; t < threads.size(); t++ ) {
+            tbb::task_arena arena( threads[t] );
+            for ( size_t w = 0; w < works.size(); w++ ) {
+                double best = -1.0;
+                bool correct = true;
+                for ( int r = 0; r < repeat; r++ ) {
+                    long long count = 0;
+                    auto start = std::chrono::steady_clock::now();
+                    arena.execute( [&] {
+                        count = primitives[p].kernel( iterations, works[w], sink );
+                    });
+                    double seconds = std::chrono::duration<double>(
+                        std::chrono::steady_clock::now() - start ).count();
+                    if ( best < 0.0 || seconds < best )
+                        best = seconds;
+                    if ( count != iterations )
+                        correct = false;
+                }
+                csv << primitives[p].name << ',' << threads[t] << ',' << works[w]
+                    << ',' << iterations << ',' << best << ','
+                    << ( best > 0.0 ? iterations / best * 1e-6 : 0.0 ) << ','
+                    << ( correct ? 1 : 0 ) << '\n';
+                csv.flush();
+            }
+        }
+    }
+}
+
+}
+
+#endif
@@ -0,0 +1,54 @@
+//-
+// ==========================================================================
+// Copyright 1995,2006,2008 Autodesk, Inc. All rights reserved.
+//
+// Use of this software is subject to the terms of the Autodesk
+// license agreement provided at the time of installation or download,
+// or which otherwise accompanies this software in either electronic
+// or hard copy form.
+// ==========================================================================
+//+
+
+//
+// DESCRIPTION:
+// Standalone driver of lockBenchmark.h, which runs the sweep without Maya
+// and writes the CSV to the standard output. It is not part of the
+// threadingLockTests plug-in; build it on its own, e.g.
+//
+//  g++ -O2 -std=c++17 lockBenchmarkMain.cpp -ltbb -o lockBenchmark
+//  ./lockBenchmark [iterations [maxThreads [repeat]]] > locks.csv
+//
+// tbb::spin_mutex stands for MSpinLock, which needs Maya.
+//
+
+#include <stdlib.h>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+#include <tbb/spin_mutex.h>
+
+#include "lockBenchmark.h"
+
+int main( int argc, char** argv )
+{
+    int iterations = ( argc > 1 ) ? atoi( argv[1] ) : 1000000;
+    int maxThreads = ( argc > 2 ) ? atoi( argv[2] )
+                                  : (int) std::thread::hardware_concurrency();
+    int repeat = ( argc > 3 ) ? atoi( argv[3] ) : 3;
+    if ( iterations <= 0 || repeat <= 0 ) {
+        std::cerr << "usage: lockBenchmark [iterations [maxThreads [repeat]]]\n";
+        return 1;
+    }
+
+    std::vector<lockBenchmark::Primitive> primitives;
+    primitives.push_back( { "std::mutex", lockBenchmark::lockedCount<std::mutex> } );
+    primitives.push_back( { "tbb::spin_mutex", lockBenchmark::lockedCount<tbb::spin_mutex> } );
+    lockBenchmark::addStandardPrimitives( primitives );
+
+    std::vector<int> works = { 0, 16, 256 };
+    lockBenchmark::writeHeader( std::cout );
+    lockBenchmark::sweep( primitives, lockBenchmark::threadCounts( maxThreads ),
+                          works, iterations, repeat, std::cout );
+    return 0;
+}
@@ -15,6 +15,7 @@
 #include <maya/MTimer.h>
 
 #include <maya/MSpinLock.h>
+#include <maya/MMutexLock.h>
 #include <maya/MThreadUtils.h>
 
 #include <tbb/blocked_range.h>
@@ -23,6 +24,9 @@
 
 #include <mutex>
 #include <atomic>
+#include <fstream>
+
+#include "lockBenchmark.h"
 
 DeclareSimpleCommand( threadingLockTests, PLUGIN_COMPANY, "3.0");
 
@@ -121,14 +125,40 @@ MStatus threadingLockTests::doIt( const MArgList& args )
     if ( MS::kSuccess != stat )
         cout<<"Error creating curve."<<endl;
 
-    if(args.length() != 1) {
-        MString str = MString("Invalid number of arguments, usage: threadingLockTests 1000000");
+    if(args.length() != 1 && args.length() != 2) {
+        MString str = MString("Invalid number of arguments, usage: threadingLockTests 1000000 [\"locks.csv\"]");
         MGlobal::displayError(str);
         return MStatus::kFailure;
     }
 
     printf("In threadedLockTests, numthreads %d\n", MThreadUtils::getNumThreads());
     int iterations = args.asInt( 0, &stat );
+
+    // With a file name, sweep all the primitives over the thread counts
+    // and contention levels, and write the results to it as CSV
+    if(args.length() == 2) {
+        MString fileName = args.asString( 1, &stat );
+        std::ofstream csv(fileName.asChar());
+        if(!csv) {
+            MGlobal::displayError(MString("Cannot write ") + fileName);
+            return MStatus::kFailure;
+        }
+
+        std::vector<lockBenchmark::Primitive> primitives;
+        primitives.push_back( { "std::mutex", lockBenchmark::lockedCount<std::mutex> } );
+        primitives.push_back( { "MSpinLock", lockBenchmark::lockedCount<MSpinLock> } );
+        primitives.push_back( { "MMutexLock", lockBenchmark::lockedCount<MMutexLock> } );
+        lockBenchmark::addStandardPrimitives(primitives);
+
+        std::vector<int> works = { 0, 16, 256 };
+        lockBenchmark::writeHeader(csv);
+        lockBenchmark::sweep(primitives,
+                             lockBenchmark::threadCounts(MThreadUtils::getNumThreads()),
+                             works, iterations, 3, csv);
+        MGlobal::displayInfo(MString("Wrote ") + fileName);
+        return stat;
+    }
+
     int increment = 2;
     int sum = 0;
     int repeat = 1;
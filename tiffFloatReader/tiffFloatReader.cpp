@@ -17,6 +17,22 @@
 // In image reading menu dialogs of Maya, you can select *.* to see all images
 // and then retrieve a tiff extension file item to load the .tif file into Maya.
 //
+// Each directory of the file is exposed as one image, so the reduced
+// resolution levels of a pyramid tif are loaded with load( image, n).
+// loadRegion() reads a sub-rectangle of a directory: only the strips or
+// tiles that overlap it are decoded. Rows of strips or tiles are decoded
+// in parallel. libtiff handles cannot be shared between threads, so each
+// thread opens the file once and keeps its handle for the whole read.
+//
+// The plug-in also adds a command that reads a region into a new image:
+//
+//      tiffFloatReadRegion [-level n] [-region x0 y0 x1 y1] [-output file] "map.tif";
+//
+// The region is given in pixels of the directory, top-left origin, with
+// inclusive bounds. The command returns the width and height that were
+// read and writes the image to -output when given. See
+// common/readRegionCmd.h.
+//
 
 #include <maya/MPxImageFile.h>
 #include <maya/MImageFileInfo.h>
@@ -26,6 +42,16 @@
 #include <maya/MIOStream.h>
 #include <maya/MGlobal.h>
 
+#include <tbb/blocked_range.h>
+#include <tbb/enumerable_thread_specific.h>
+#include <tbb/parallel_for.h>
+
+#include <atomic>
+#include <string.h>
+#include <vector>
+
+#include "../common/readRegionCmd.h"
+
 // #pragma warning( disable : 4290 )        // Disable STL warnings.
 
 #include "tiff.h"
@@ -35,6 +61,19 @@ MString kImagePluginName( "TIFF Float Reader");
 
 #define _TIFF_SUCCESS   1
 
+//
+// How the pixels of a directory are laid out
+//
+struct tiffLayout
+{
+    unsigned int    width;
+    unsigned int    height;
+    unsigned int    channels;
+    bool            tiled;
+    unsigned int    blockWidth;         // Tile width, or image width for strips
+    unsigned int    blockHeight;        // Tile height, or rows per strip
+};
+
 class tiffFloatReader : public MPxImageFile
 {
 public:
@@ -45,11 +84,21 @@ public:
     MStatus load( MImage& image, unsigned int idx) override;
     MStatus close() override;
 
+    // Read the given rectangle of directory idx. The bounds are inclusive
+    // and clamped to the size of the directory.
+    MStatus loadRegion( MImage& image, unsigned int idx,
+                        unsigned int xMin, unsigned int yMin,
+                        unsigned int xMax, unsigned int yMax);
+
 protected:
+    static bool getLayout( TIFF* tif, tiffLayout& layout);
+
     unsigned int    fWidth;             // Width
     unsigned int    fHeight;            // Height
     unsigned int    fChannels;          // Number of channels
+    unsigned int    fNumImages;         // Number of directories
 
+    MString         fPathname;
     TIFF            *fInputFile;        // Tif interface
 };
 
@@ -59,7 +108,8 @@ tiffFloatReader::tiffFloatReader()
 : fInputFile( NULL), 
   fChannels( 0), 
   fWidth(0),
-  fHeight(0)
+  fHeight(0),
+  fNumImages(0)
 {
 
 }
@@ -82,79 +132,110 @@ void * tiffFloatReader::creator()
 
 //
 // DESCRIPTION:
-//      Open up the file for read. Return "info" if requested.
-MStatus tiffFloatReader::open( MString pathname, MImageFileInfo* info)
+//      Check that the current directory holds a supported image and
+//      describe how its pixels are stored.
+bool tiffFloatReader::getLayout( TIFF* tif, tiffLayout& layout)
 {
-    try
-    {
-        // Open the tif file for read
-        // (TIFF *) cast from integer required on Mac.
-        fInputFile = (TIFF *) TIFFOpen( pathname.asChar(), "r" );
-    }
-    catch( ... )
-    {
-    }
-
-    if( !fInputFile)
-    {
-        return MS::kFailure;
-    }
-
     unsigned short num_samps;
     unsigned short bitsPerChannel;
     unsigned short sampleType = 0;
     short config;
 
-    if (_TIFF_SUCCESS != TIFFGetField(fInputFile, TIFFTAG_IMAGEWIDTH, &fWidth ) || 
-        fWidth < 1)
-        goto no_support;
-    if (_TIFF_SUCCESS != TIFFGetField(fInputFile, TIFFTAG_IMAGELENGTH, &fHeight ) || 
-        fHeight < 1)
-        goto no_support;
+    if (_TIFF_SUCCESS != TIFFGetField(tif, TIFFTAG_IMAGEWIDTH, &layout.width ) || 
+        layout.width < 1)
+        return false;
+    if (_TIFF_SUCCESS != TIFFGetField(tif, TIFFTAG_IMAGELENGTH, &layout.height ) || 
+        layout.height < 1)
+        return false;
 
 
     // Suport 3 and 4 channel images only
-    if (_TIFF_SUCCESS != TIFFGetField(fInputFile, TIFFTAG_SAMPLESPERPIXEL, &num_samps))
-        goto no_support;
+    if (_TIFF_SUCCESS != TIFFGetField(tif, TIFFTAG_SAMPLESPERPIXEL, &num_samps))
+        return false;
     if ((num_samps != 3) && (num_samps!= 4))
-        goto no_support;
-    fChannels = num_samps;
+        return false;
+    layout.channels = num_samps;
 
     // This is more robust than TIFFTAG_SAMPLEFORMAT since it may not be supported
     // properly as it's an extension. 
 
-    if (_TIFF_SUCCESS != TIFFGetField(fInputFile, TIFFTAG_BITSPERSAMPLE, &bitsPerChannel))
-        goto no_support;
+    if (_TIFF_SUCCESS != TIFFGetField(tif, TIFFTAG_BITSPERSAMPLE, &bitsPerChannel))
+        return false;
     if (bitsPerChannel != 32)
-        goto no_support;
+        return false;
 
     // Check the sample type. We only care about 32 bit 
     // floating point samples for this reader.
     // SAMPLEFORMAT_IEEEFP is specified as IEEE floating point.
-    if (_TIFF_SUCCESS != TIFFGetField(fInputFile, TIFFTAG_SAMPLEFORMAT, &sampleType) ||
+    if (_TIFF_SUCCESS != TIFFGetField(tif, TIFFTAG_SAMPLEFORMAT, &sampleType) ||
         sampleType != SAMPLEFORMAT_IEEEFP)
     {
-        goto no_support;
+        return false;
     }
 
     // See how the data is stored in the scan line. Only support
     // contiguous scan line for now.
     // - PLANARCONFIG_SEPARATE is not supported.
-    if (_TIFF_SUCCESS != TIFFGetField(fInputFile, TIFFTAG_PLANARCONFIG, &config) ||
+    if (_TIFF_SUCCESS != TIFFGetField(tif, TIFFTAG_PLANARCONFIG, &config) ||
         (config != PLANARCONFIG_CONTIG))
     {
-        goto no_support;
+        return false;
+    }
+
+    // Strips are treated as tiles as wide as the image
+    layout.tiled = TIFFIsTiled(tif) != 0;
+    if (layout.tiled)
+    {
+        if (_TIFF_SUCCESS != TIFFGetField(tif, TIFFTAG_TILEWIDTH, &layout.blockWidth) ||
+            _TIFF_SUCCESS != TIFFGetField(tif, TIFFTAG_TILELENGTH, &layout.blockHeight) ||
+            layout.blockWidth < 1 || layout.blockHeight < 1)
+        {
+            return false;
+        }
+    }
+    else
+    {
+        unsigned int rowsPerStrip = layout.height;
+        TIFFGetFieldDefaulted(tif, TIFFTAG_ROWSPERSTRIP, &rowsPerStrip);
+        layout.blockWidth = layout.width;
+        layout.blockHeight = (rowsPerStrip < 1 || rowsPerStrip > layout.height) ?
+                             layout.height : rowsPerStrip;
+    }
+
+    return true;
+}
+
+//
+// DESCRIPTION:
+//      Open up the file for read. Return "info" if requested.
+MStatus tiffFloatReader::open( MString pathname, MImageFileInfo* info)
+{
+    try
+    {
+        // Open the tif file for read
+        // (TIFF *) cast from integer required on Mac.
+        fInputFile = (TIFF *) TIFFOpen( pathname.asChar(), "r" );
+    }
+    catch( ... )
+    {
     }
 
-    // Compression not supported yet.. 
-#if 0
-    unsigned short compression;
-    if (_TIFF_SUCCESS != TIFFGetField(fInputFile, TIFFTAG_COMPRESSION, &compression) ||
-        (compression != COMPRESSION_NONE))
+    if( !fInputFile)
     {
-        goto no_support;
+        return MS::kFailure;
     }
-#endif
+
+    tiffLayout layout;
+    if (!getLayout(fInputFile, layout))
+    {
+        close();
+        return MS::kFailure;
+    }
+    fWidth = layout.width;
+    fHeight = layout.height;
+    fChannels = layout.channels;
+    fNumImages = TIFFNumberOfDirectories(fInputFile);
+    fPathname = pathname;
 
     //printf("Opened tif file successfully: w=%d,h=%d, ch=%d\n",
     //  fWidth, fHeight, fChannels );
@@ -166,14 +247,10 @@ MStatus tiffFloatReader::open( MString pathname, MImageFileInfo* info)
         info->width( fWidth );
         info->height( fHeight );
         info->channels( fChannels );
-        info->numberOfImages( 1 );
+        info->numberOfImages( fNumImages );
         info->pixelType( MImage::kFloat);
     }
     return MS::kSuccess;
-
-no_support:
-    close();
-    return MS::kFailure;
 }
 
 //
@@ -192,39 +269,120 @@ MStatus tiffFloatReader::close()
 // DESCRIPTION:
 //      Load the image into system memory (MImage)
 MStatus tiffFloatReader::load( MImage& image, unsigned int imageNumber)
+{
+    return loadRegion( image, imageNumber, 0, 0, 0xffffffff, 0xffffffff);
+}
+
+//
+// DESCRIPTION:
+//      Load a rectangle of the image into system memory (MImage)
+MStatus tiffFloatReader::loadRegion( MImage& image, unsigned int imageNumber,
+                                     unsigned int xMin, unsigned int yMin,
+                                     unsigned int xMax, unsigned int yMax)
 {
     MStatus rval = MS::kFailure;
 
-    if (!fInputFile)
+    // TIFFSetDirectory() takes a tdir_t, which is 16 bits before libtiff 4.5
+    tdir_t directory = (tdir_t) imageNumber;
+    if (!fInputFile || imageNumber >= fNumImages || directory != imageNumber)
+        return rval;
+
+    tiffLayout layout;
+    if (_TIFF_SUCCESS != TIFFSetDirectory(fInputFile, directory) ||
+        !getLayout(fInputFile, layout))
         return rval;
 
+    if (xMax >= layout.width)
+        xMax = layout.width - 1;
+    if (yMax >= layout.height)
+        yMax = layout.height - 1;
+    if (xMin > xMax || yMin > yMax)
+        return rval;
+
+    unsigned int regionWidth = xMax - xMin + 1;
+    unsigned int regionHeight = yMax - yMin + 1;
+    unsigned int channels = layout.channels;
+
     // Configure our Maya image to hold the result
-    image.create( fWidth, fHeight, fChannels, MImage::kFloat);
+    image.create( regionWidth, regionHeight, channels, MImage::kFloat);
     float* outputBuffer = image.floatPixels();
     if (outputBuffer == NULL)
         return rval;
-    
-    // Maya expects images upside down
-    unsigned int row = 0;
-    bool flipVertically = true;
-    if (flipVertically)
+
+    // Rows of strips or tiles overlapping the region
+    unsigned int firstRow = yMin / layout.blockHeight;
+    unsigned int lastRow = yMax / layout.blockHeight;
+
+    tmsize_t blockBytes = layout.tiled ? TIFFTileSize(fInputFile) : TIFFStripSize(fInputFile);
+    std::atomic<bool> failed(false);
+    const char* pathname = fPathname.asChar();
+
+    // One handle per thread, opened on its first row
+    tbb::enumerable_thread_specific<TIFF*> handles((TIFF*) NULL);
+
+    tbb::parallel_for(tbb::blocked_range<unsigned int>(firstRow, lastRow + 1),
+        [&](const tbb::blocked_range<unsigned int>& rows)
     {
-        outputBuffer += (fHeight-1) * (fWidth * fChannels);
-        for (row = 0; row < fHeight; row++)
+        TIFF*& tif = handles.local();
+        if (!tif)
         {
-            TIFFReadScanline (fInputFile, outputBuffer, row);
-            outputBuffer -= (fWidth * fChannels);
+            tif = (TIFF *) TIFFOpen( pathname, "r" );
+            if (!tif || _TIFF_SUCCESS != TIFFSetDirectory(tif, directory))
+            {
+                failed = true;
+                return;
+            }
         }
-    }
-    else
-    {
-        for (row = 0; row < fHeight; row++)
+
+        std::vector<float> block(blockBytes / sizeof(float));
+
+        unsigned int row;
+        for (row = rows.begin(); row != rows.end() && !failed; row++)
         {
-            TIFFReadScanline (fInputFile, outputBuffer, row);
-            outputBuffer += (fWidth * fChannels);
+            unsigned int by = row * layout.blockHeight;
+            unsigned int y0 = (by > yMin) ? by : yMin;
+            unsigned int y1 = by + layout.blockHeight - 1;
+            if (y1 > yMax)
+                y1 = yMax;
+
+            unsigned int bx;
+            for (bx = (xMin / layout.blockWidth) * layout.blockWidth; bx <= xMax; bx += layout.blockWidth)
+            {
+                tmsize_t bytes = layout.tiled ?
+                    TIFFReadEncodedTile(tif, TIFFComputeTile(tif, bx, by, 0, 0), &block[0], blockBytes) :
+                    TIFFReadEncodedStrip(tif, TIFFComputeStrip(tif, by, 0), &block[0], blockBytes);
+                if (bytes < 0)
+                {
+                    failed = true;
+                    break;
+                }
+
+                unsigned int x0 = (bx > xMin) ? bx : xMin;
+                unsigned int x1 = bx + layout.blockWidth - 1;
+                if (x1 > xMax)
+                    x1 = xMax;
+
+                // Maya expects images upside down
+                unsigned int y;
+                for (y = y0; y <= y1; y++)
+                {
+                    const float* src = &block[((size_t)(y - by) * layout.blockWidth + (x0 - bx)) * channels];
+                    float* dst = outputBuffer +
+                        ((size_t)(regionHeight - 1 - (y - yMin)) * regionWidth + (x0 - xMin)) * channels;
+                    memcpy(dst, src, (size_t)(x1 - x0 + 1) * channels * sizeof(float));
+                }
+            }
         }
+    });
+
+    for (TIFF* tif : handles)
+    {
+        if (tif)
+            TIFFClose(tif);
     }
-    rval = MS::kSuccess;
+
+    if (!failed)
+        rval = MS::kSuccess;
 
     return rval;
 }
@@ -244,6 +402,10 @@ MStatus initializePlugin( MObject obj )
                     tiffFloatReader::creator, 
                     extensions,
                     MFnPlugin::kImageFilePriorityLow));
+    CHECK_MSTATUS( plugin.registerCommand(
+                    "tiffFloatReadRegion",
+                    readRegion::ReadRegionCmd<tiffFloatReader>::creator,
+                    readRegion::ReadRegionCmd<tiffFloatReader>::newSyntax));
 
     return MS::kSuccess;
 }
@@ -252,6 +414,7 @@ MStatus initializePlugin( MObject obj )
 MStatus uninitializePlugin( MObject obj )
 {
     MFnPlugin plugin( obj );
+    CHECK_MSTATUS( plugin.deregisterCommand( "tiffFloatReadRegion" ) );
     CHECK_MSTATUS( plugin.deregisterImageFile( kImagePluginName ) );
 
     return MS::kSuccess;
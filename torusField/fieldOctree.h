@@ -0,0 +1,296 @@
+//-
+// ==========================================================================
+// Copyright 2015 Autodesk, Inc.  All rights reserved.
+//
+// Use of this software is subject to the terms of the Autodesk
+// license agreement provided at the time of installation or download,
+// or which otherwise accompanies this software in either electronic
+// or hard copy form.
+// ==========================================================================
+//+
+
+#ifndef _fieldOctree_h_
+#define _fieldOctree_h_
+
+//  Description
+//  Octree of the field positions of the torusField node, used when its
+//  useSpatialTree attribute is on. It does not depend on Maya.
+//
+//  Each node keeps the bounding box, the number and the sum of its
+//  positions. Without max distance, the attract-repel force of a position
+//  is linear in the offset from it, so a node lying entirely in the repel
+//  or attract zone of a receptor contributes
+//
+//      +/- magnitude * (count * receptor - sum)
+//
+//  and a node lying entirely inside minDistance or between repelDistance
+//  and attractDistance contributes nothing. Only the nodes crossing one of
+//  those spheres are opened, which keeps the result exact up to the order
+//  of the additions.
+//
+//  With max distance, visitWithin() only opens the nodes within
+//  maxDistance of the receptor.
+//
+
+#include <math.h>
+#include <vector>
+
+namespace fieldOctree
+{
+
+// Positions per leaf
+const int kLeafSize = 16;
+
+// Leaves are not split below this depth, for coincident positions
+const int kMaxDepth = 24;
+
+struct Node
+{
+    double  lo[3], hi[3];   // bounding box of the positions
+    double  sum[3];         // sum of the positions
+    int     first;          // first position, in tree order
+    int     count;          // number of positions
+    int     firstChild;     // first child node, -1 for a leaf
+    int     childCount;
+};
+
+class Octree
+{
+public:
+    // Builds the tree of count positions, stored as x y z triples.
+    void build( const double* xyz, int count )
+    {
+        fNodes.clear();
+        fIndex.resize( count );
+        fPos.resize( 3 * (size_t) count );
+        for ( int i = 0; i < count; i++ )
+            fIndex[i] = i;
+        if ( count == 0 )
+            return;
+
+        fNodes.push_back( Node() );
+        buildNode( 0, xyz, 0, count, 0 );
+
+        // Positions in tree order, so that leaves read contiguous memory
+        std::vector<double> sorted( 3 * (size_t) count );
+        for ( int i = 0; i < count; i++ ) {
+            sorted[3*i]   = xyz[3*fIndex[i]];
+            sorted[3*i+1] = xyz[3*fIndex[i]+1];
+            sorted[3*i+2] = xyz[3*fIndex[i]+2];
+        }
+        fPos.swap( sorted );
+    }
+
+    int size() const { return (int) fIndex.size(); }
+
+    // Sum over the positions q of the torusField force without max
+    // distance, without drag and swarm, at receptor p:
+    //
+    //  d = |p - q|
+    //  d <  minDist            nothing
+    //  d <= repelDist          magnitude * (p - q)
+    //  d >= attractDist        -magnitude * (p - q)
+    //
+    void linearForce( const double p[3], double magnitude, double minDist,
+                      double repelDist, double attractDist, double force[3] ) const
+    {
+        force[0] = force[1] = force[2] = 0.0;
+        if ( fNodes.empty() )
+            return;
+
+        int stack[8 * kMaxDepth + 8];
+        int top = 0;
+        stack[top++] = 0;
+        while ( top > 0 ) {
+            const Node& node = fNodes[stack[--top]];
+            double dmin, dmax;
+            boxDistances( node, p, dmin, dmax );
+
+            if ( dmax < minDist )
+                continue;
+            if ( dmin >= minDist ) {
+                if ( dmax <= repelDist ) {
+                    addLinear( node, p, magnitude, force );
+                    continue;
+                }
+                if ( dmin > repelDist ) {
+                    if ( dmin >= attractDist ) {
+                        addLinear( node, p, -magnitude, force );
+                        continue;
+                    }
+                    if ( dmax < attractDist )
+                        continue;
+                }
+            }
+
+            if ( node.firstChild < 0 ) {
+                const double* q = &fPos[3 * (size_t) node.first];
+                for ( int i = 0; i < node.count; i++, q += 3 ) {
+                    const double dx = p[0] - q[0];
+                    const double dy = p[1] - q[1];
+                    const double dz = p[2] - q[2];
+                    const double d = sqrt( dx*dx + dy*dy + dz*dz );
+                    double scale;
+                    if ( d < minDist )
+                        scale = 0.0;
+                    else if ( d <= repelDist )
+                        scale = magnitude;
+                    else if ( d >= attractDist )
+                        scale = -magnitude;
+                    else
+                        scale = 0.0;
+                    force[0] += dx * scale;
+                    force[1] += dy * scale;
+                    force[2] += dz * scale;
+                }
+            }
+            else {
+                for ( int c = node.childCount; --c >= 0; )
+                    stack[top++] = node.firstChild + c;
+            }
+        }
+    }
+
+    // Calls visit( index, dx, dy, dz, d ) for every position within
+    // [minDist, maxDist] of receptor p, index being the position in the
+    // array given to build() and (dx, dy, dz) = p - position. The order
+    // only depends on the tree.
+    template <class Visit>
+    void visitWithin( const double p[3], double minDist, double maxDist,
+                      Visit& visit ) const
+    {
+        if ( fNodes.empty() )
+            return;
+
+        int stack[8 * kMaxDepth + 8];
+        int top = 0;
+        stack[top++] = 0;
+        while ( top > 0 ) {
+            const Node& node = fNodes[stack[--top]];
+            double dmin, dmax;
+            boxDistances( node, p, dmin, dmax );
+            if ( dmin > maxDist || dmax < minDist )
+                continue;
+
+            if ( node.firstChild < 0 ) {
+                const double* q = &fPos[3 * (size_t) node.first];
+                for ( int i = 0; i < node.count; i++, q += 3 ) {
+                    const double dx = p[0] - q[0];
+                    const double dy = p[1] - q[1];
+                    const double dz = p[2] - q[2];
+                    const double d = sqrt( dx*dx + dy*dy + dz*dz );
+                    if ( d >= minDist && d <= maxDist )
+                        visit( fIndex[node.first + i], dx, dy, dz, d );
+                }
+            }
+            else {
+                for ( int c = node.childCount; --c >= 0; )
+                    stack[top++] = node.firstChild + c;
+            }
+        }
+    }
+
+private:
+    void buildNode( int nodeIndex, const double* xyz, int first, int count, int depth )
+    {
+        Node node;
+        node.first = first;
+        node.count = count;
+        node.firstChild = -1;
+        node.childCount = 0;
+
+        int i, k;
+        for ( k = 0; k < 3; k++ ) {
+            node.lo[k] = node.hi[k] = xyz[3*fIndex[first]+k];
+            node.sum[k] = 0.0;
+        }
+        for ( i = first; i < first + count; i++ ) {
+            const double* q = &xyz[3*fIndex[i]];
+            for ( k = 0; k < 3; k++ ) {
+                if ( q[k] < node.lo[k] ) node.lo[k] = q[k];
+                if ( q[k] > node.hi[k] ) node.hi[k] = q[k];
+                node.sum[k] += q[k];
+            }
+        }
+
+        if ( count > kLeafSize && depth < kMaxDepth ) {
+            // Split at the center of the box into up to 8 children
+            double center[3];
+            for ( k = 0; k < 3; k++ )
+                center[k] = 0.5 * ( node.lo[k] + node.hi[k] );
+
+            int octantCount[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+            std::vector<unsigned char> octant( count );
+            for ( i = 0; i < count; i++ ) {
+                const double* q = &xyz[3*fIndex[first+i]];
+                octant[i] = (unsigned char)( ( q[0] > center[0] ? 1 : 0 ) |
+                                             ( q[1] > center[1] ? 2 : 0 ) |
+                                             ( q[2] > center[2] ? 4 : 0 ) );
+                octantCount[octant[i]]++;
+            }
+
+            int start[8], s = 0, children = 0;
+            for ( k = 0; k < 8; k++ ) {
+                start[k] = s;
+                s += octantCount[k];
+                if ( octantCount[k] > 0 )
+                    children++;
+            }
+
+            if ( children > 1 ) {
+                std::vector<int> reordered( count );
+                for ( i = 0; i < count; i++ )
+                    reordered[start[octant[i]]++] = fIndex[first+i];
+                for ( i = 0; i < count; i++ )
+                    fIndex[first+i] = reordered[i];
+
+                node.firstChild = (int) fNodes.size();
+                node.childCount = children;
+                fNodes[nodeIndex] = node;
+                fNodes.resize( fNodes.size() + children );
+
+                int child = node.firstChild, childFirst = first;
+                for ( k = 0; k < 8; k++ ) {
+                    if ( octantCount[k] == 0 )
+                        continue;
+                    buildNode( child++, xyz, childFirst, octantCount[k], depth + 1 );
+                    childFirst += octantCount[k];
+                }
+                return;
+            }
+        }
+        fNodes[nodeIndex] = node;
+    }
+
+    static void boxDistances( const Node& node, const double p[3],
+                              double& dmin, double& dmax )
+    {
+        double near2 = 0.0, far2 = 0.0;
+        for ( int k = 0; k < 3; k++ ) {
+            const double a = node.lo[k] - p[k];
+            const double b = p[k] - node.hi[k];
+            const double n = ( a > 0.0 ) ? a : ( ( b > 0.0 ) ? b : 0.0 );
+            const double f = ( -a > -b ) ? -a : -b;
+            near2 += n * n;
+            far2 += f * f;
+        }
+        dmin = sqrt( near2 );
+        dmax = sqrt( far2 );
+    }
+
+    static void addLinear( const Node& node, const double p[3], double scale,
+                           double force[3] )
+    {
+        force[0] += scale * ( node.count * p[0] - node.sum[0] );
+        force[1] += scale * ( node.count * p[1] - node.sum[1] );
+        force[2] += scale * ( node.count * p[2] - node.sum[2] );
+    }
+
+    std::vector<Node>   fNodes;
+    std::vector<int>    fIndex;     // original index of each position, in tree order
+    std::vector<double> fPos;       // positions in tree order
+};
+
+}
+
+#endif
@@ -19,6 +19,22 @@
 // The example MEL script "torusField.mel" shows how to create the node
 // and appropriate connections to correctly establish a user defined field. 
 //
+// With the useSpatialTree attribute on, the field positions (the owner's
+// points with applyPerVertex) are put in an octree (fieldOctree.h) and
+// receptors are computed in parallel. Without max distance, the octree
+// sums whole nodes at once and gives the same force up to rounding. With
+// max distance, only the positions within maxDistance are visited; see
+// applyMaxDistTree() for the differences with the serial loops, which are
+// kept as they were so that existing scenes do not change.
+//
+// The torusFieldBenchmark command times the octree against the loops
+// over every field position, for random receptors and field positions
+// and the attributes of a torusField node:
+//
+//  torusFieldBenchmark -receptors 100000 -fieldPositions 1000
+//                      -fieldPositions 10000 torusField1;
+//  // Result: N M loopSeconds treeSeconds maxDifference ... //
+//
 
 #include <maya/MIOStream.h>
 #include <math.h>
@@ -39,6 +55,29 @@
 #include <maya/MFnVectorArrayData.h>
 #include <maya/MFnDoubleArrayData.h>
 #include <maya/MFnMatrixData.h>
+#include <maya/MPxCommand.h>
+#include <maya/MSyntax.h>
+#include <maya/MArgDatabase.h>
+#include <maya/MArgList.h>
+#include <maya/MSelectionList.h>
+#include <maya/MStringArray.h>
+#include <maya/MTimer.h>
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <tbb/task_arena.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "fieldOctree.h"
+
+// Receptors per task
+#define kReceptorGrainSize  1024
+
+// Samples of the falloff curve in the octree path
+#define kFalloffSamples     1024
 
 
 MObject torusField::aMinDistance;
@@ -48,6 +87,7 @@ MObject torusField::aDrag;
 MObject torusField::aSwarmAmplitude;
 MObject torusField::aSwarmFrequency;
 MObject torusField::aSwarmPhase;
+MObject torusField::aUseSpatialTree;
 
 MTypeId torusField::id( 0x80018 );
 
@@ -115,6 +155,15 @@ MStatus torusField::initialize()
     status = addAttribute( aSwarmPhase );
     McheckErr(status, "ERROR adding aSwarmPhase attribute.\n");
 
+    aUseSpatialTree = numAttr.create("useSpatialTree", "ust",
+                                        MFnNumericData::kBoolean);
+    numAttr.setDefault( false );
+    status = addAttribute( aUseSpatialTree );
+    McheckErr(status, "ERROR adding aUseSpatialTree attribute.\n");
+
+    status = attributeAffects( aUseSpatialTree, mOutputForce );
+    McheckErr(status, "ERROR in attributeAffects(aUseSpatialTree,outputForce).\n");
+
     // the new attribute will affect output force.
     //
     //status = attributeAffects( aMinDistance, outputForce );
@@ -183,15 +232,25 @@ MStatus torusField::compute(const MPlug& plug, MDataBlock& block)
     // Compute the output force.
     //
 
+    // get owner's data. posArray may have only one point which is the centroid
+    // (if this has owner) or field position(if without owner). Or it may have
+    // a list of points if with owner and applyPerVertex.
+    //
+    MVectorArray posArray;
+    ownerPosition( block, posArray );
+    bool useTree = useSpatialTreeValue( block );
+
     MVectorArray forceArray;
     bool useMaxDistSet = useMaxDistanceValue( block );
     if( useMaxDistSet )
     {
-        applyMaxDist( block, points, velocities, masses, forceArray );
+        applyMaxDist( block, posArray, useTree, points, velocities, masses,
+                      forceArray );
     }
     else
     {
-        applyNoMaxDist( block, points, velocities, masses, forceArray );
+        applyNoMaxDist( block, posArray, useTree, points, velocities, masses,
+                        forceArray );
     }
 
     // get output data handle
@@ -222,6 +281,8 @@ MStatus torusField::compute(const MPlug& plug, MDataBlock& block)
 void torusField::applyNoMaxDist
     (
         MDataBlock &block,              // get field param from this block
+        const MVectorArray &posArray,   // field positions
+        bool useTree,                   // sum through an octree
         const MVectorArray &points,     // current position of Object
         const MVectorArray &velocities, // current velocity of Object
         const MDoubleArray &/*masses*/,     // mass of Object
@@ -230,6 +291,9 @@ void torusField::applyNoMaxDist
 //
 //  Descriptions:
 //      Compute output force in the case that the useMaxDistance is not set.
+//      Receptors are computed in parallel. With useSpatialTree, the
+//      attract-repel sum comes from an octree of the field positions,
+//      which gives the same force up to the order of the additions.
 //
 {
     // points and velocities should have the same length. If not return.
@@ -250,63 +314,50 @@ void torusField::applyNoMaxDist
     double repelDist = repelDistanceValue( block );
     double dragMag = dragValue( block );
     double swarmAmp = swarmAmplitudeValue( block );
-
-    // get owner's data. posArray may have only one point which is the centroid
-    // (if this has owner) or field position(if without owner). Or it may have
-    // a list of points if with owner and applyPerVertex.
-    //
-    MVectorArray posArray;
-    posArray.clear();
-    ownerPosition( block, posArray );
+    double frequency = swarmFrequencyValue( block );
+    MVector phase( 0.0, 0.0, swarmPhaseValue(block) );
 
     int fieldPosCount = posArray.length();
     int receptorSize = points.length();
 
+    fieldOctree::Octree tree;
+    if (useTree)
+    {
+        std::vector<double> xyz( 3 * (size_t) fieldPosCount );
+        for (int i = 0; i < fieldPosCount; i++)
+            posArray[i].get( &xyz[3*i] );
+        tree.build( xyz.data(), fieldPosCount );
+    }
+
     // With this model,if max distance isn't set then we
     // also don't attenuate, because 1 - dist/maxDist isn't
     // meaningful. No max distance and no attenuation.
     //
-    if (dragMag <= 0)
+    outputForce.setLength( receptorSize );
+    tbb::parallel_for( tbb::blocked_range<int>( 0, receptorSize, kReceptorGrainSize ),
+        [&]( const tbb::blocked_range<int>& r )
     {
-        if (swarmAmp <= 0)
+        for (int ptIndex = r.begin(); ptIndex != r.end(); ptIndex ++ )
         {
-            // No max dist, no attenuation, no drag, no swarm
+            MVector forceV(0.0,0.0,0.0);
+            const MVector &receptorPoint = points[ptIndex];
+
+            // Apply from every field position to every receptor position.
+            // distance ends up being the one from the first field position.
             //
-            for (int ptIndex = 0; ptIndex < receptorSize; ptIndex ++ )
+            double distance = 0.0;
+            int i;
+            if (useTree)
             {
-                MVector forceV(0.0,0.0,0.0);
-                const MVector &receptorPoint = points[ptIndex];
-
-                // Apply from every field position to every receptor position.
-                //
-                for(int i = fieldPosCount; --i>=0; )
-                {
-                    MVector difference = (receptorPoint-posArray[i]);
-
-                    double distance = difference.length();
-                    if (distance < minDist) continue;
-
-                    if (distance <= repelDist)
-                        forceV += difference * magValue;
-                    else if (distance >= attractDist)
-                        forceV += -difference * magValue;
-                }
-                outputForce.append( forceV );
+                double p[3];
+                receptorPoint.get( p );
+                tree.linearForce( p, magValue, minDist, repelDist,
+                                  attractDist, &forceV.x );
+                if (fieldPosCount > 0)
+                    distance = (receptorPoint-posArray[0]).length();
             }
-        }
-        else
-        {
-            // No max dist, no attenuation, no drag, yes swarm
-            //
-            for (int ptIndex = 0; ptIndex < receptorSize; ptIndex ++ )
+            else
             {
-                MVector forceV(0.0,0.0,0.0);
-                const MVector &receptorPoint = points[ptIndex];
-
-                // Apply from every field position to every receptor position.
-                //
-                double distance = 0.0;
-                int i;
                 for(i = fieldPosCount; --i>=0; )
                 {
                     MVector difference = (receptorPoint-posArray[i]);
@@ -318,161 +369,46 @@ void torusField::applyNoMaxDist
                     else if (distance >= attractDist)
                         forceV += -difference * magValue;
                 }
-
-                // Apply swarm only if the object is inside the zone
-                // the repulsion-attraction is pushing the object to.
-                //
-                if ( distance >= repelDist && distance <= attractDist)
-                {
-                    double frequency = swarmFrequencyValue( block );
-                    MVector phase( 0.0, 0.0, swarmPhaseValue(block) );
-
-                    // Add swarm in here
-                    //
-                    for(i = fieldPosCount; --i >= 0;)
-                    {
-                        MVector difference = receptorPoint - posArray[i];
-                        difference = (difference + phase) * frequency;
-
-                        double *noiseEffect = &difference.x;
-                        if( (noiseEffect[0] < -2147483647.0) ||
-                            (noiseEffect[0] >  2147483647.0) ||
-                            (noiseEffect[1] < -2147483647.0) ||
-                            (noiseEffect[1] >  2147483647.0) ||
-                            (noiseEffect[2] < -2147483647.0) ||
-                            (noiseEffect[2] >  2147483647.0) )
-                            continue;
-
-                        double noiseOut[4];
-                        noiseFunction( noiseEffect, noiseOut );
-                        MVector swarmForce( noiseOut[0] * swarmAmp,
-                                            noiseOut[1] * swarmAmp,
-                                            noiseOut[2] * swarmAmp );
-                        forceV += swarmForce;
-                    }
-                }
-                outputForce.append( forceV );
             }
-        }
-    }
-    else
-    {
-        if (swarmAmp <= 0)
-        {
-            // Yes drag, no swarm
-            //
-            for (int ptIndex = 0; ptIndex < receptorSize; ptIndex ++ )
-            {
-                const MVector& receptorPoint = points[ptIndex];
-
-                // Apply from every field position to every receptor position.
-                //
-                MVector forceV(0,0,0);
-                double distance = 0.0;
-                for(int i = fieldPosCount; --i>=0; )
-                {
-                    MVector difference = (receptorPoint-posArray[i]);
-                    distance = difference.length();
-                    if (distance < minDist) continue;
-
-                    if (distance <= repelDist)
-                        forceV += difference * magValue;
-                    else if (distance >= attractDist)
-                        forceV += -difference * magValue;
-                }
-
-                // Apply drag only if the object is inside the zone
-                // the repulsion-attraction is pushing the object to.
-                //
-                if ( distance >= repelDist && distance <= attractDist)
-                {
-                    if (fieldPosCount > 0)
-                    {
-                        MVector dragForceV;
-                        dragForceV = velocities[ptIndex] *
-                                                (-dragMag) * fieldPosCount;
-                        forceV += dragForceV;
-                    }
-                }
 
-                outputForce.append( forceV );
-            }
-        }
-        else
-        {
-            // Yes drag, yes swarm
+            // Apply drag and swarm only if the object is inside
+            // the zone the repulsion-attraction is pushing the object to.
             //
-            for (int ptIndex = 0; ptIndex < receptorSize; ptIndex ++ )
+            if ( (dragMag > 0 || swarmAmp > 0) &&
+                 distance >= repelDist && distance <= attractDist)
             {
-                const MVector &receptorPoint = points[ptIndex];
-
-                // Apply from every field position to every receptor position.
-                //
-                MVector forceV(0,0,0);
-                double distance = 0.0;
-                int i;
-                for(i = fieldPosCount; --i>=0; )
+                if (dragMag > 0 && fieldPosCount > 0)
                 {
-                    MVector difference = (receptorPoint-posArray[i]);
-                    distance = difference.length();
-                    if (distance < minDist) continue;
-
-                    if (distance <= repelDist)
-                        forceV += difference * magValue;
-                    else if (distance >= attractDist)
-                        forceV += -difference * magValue;
+                    MVector dragForceV;
+                    dragForceV = velocities[ptIndex] *
+                                            (-dragMag) * fieldPosCount;
+                    forceV += dragForceV;
                 }
 
-                // Apply drag and swarm only if the object is inside
-                // the zone the repulsion-attraction is pushing the object to.
+                // Add swarm in here
                 //
-                if ( distance >= repelDist && distance <= attractDist)
+                if (swarmAmp > 0)
                 {
-                    if (fieldPosCount > 0)
-                    {
-                        MVector dragForceV;
-                        dragForceV = velocities[ptIndex] *
-                                                (-dragMag) * fieldPosCount;
-                        forceV += dragForceV;
-                    }
-
-                    // Add swarm in here
-                    //
-                    double frequency = swarmFrequencyValue( block );
-                    MVector phase( 0.0, 0.0, swarmPhaseValue(block) );
-
                     for(i = fieldPosCount; --i>=0; )
                     {
-                        MVector difference = receptorPoint - posArray[i];
-                        difference = (difference + phase) * frequency;
-
-                        double *noiseEffect = &difference.x;
-                        if( (noiseEffect[0] < -2147483647.0) ||
-                            (noiseEffect[0] >  2147483647.0) ||
-                            (noiseEffect[1] < -2147483647.0) ||
-                            (noiseEffect[1] >  2147483647.0) ||
-                            (noiseEffect[2] < -2147483647.0) ||
-                            (noiseEffect[2] >  2147483647.0) )
-                            continue;
-
-                        double noiseOut[4];
-                        noiseFunction( noiseEffect, noiseOut );
-                        MVector swarmForce( noiseOut[0] * swarmAmp,
-                                            noiseOut[1] * swarmAmp,
-                                            noiseOut[2] * swarmAmp );
-                        forceV += swarmForce;
+                        MVector swarmForce;
+                        if (swarmForceAt( receptorPoint - posArray[i], phase,
+                                          frequency, swarmAmp, swarmForce ))
+                            forceV += swarmForce;
                     }
                 }
-                outputForce.append( forceV );
             }
+            outputForce[ptIndex] = forceV;
         }
-    }
+    });
 }
 
 
 void torusField::applyMaxDist
     (
         MDataBlock& block,              // get field param from this block
+        const MVectorArray &posArray,   // field positions
+        bool useTree,                   // visit through an octree
         const MVectorArray &points,     // current position of Object
         const MVectorArray &velocities, // current velocity of Object
         const MDoubleArray &/*masses*/,     // mass of Object
@@ -492,6 +428,12 @@ void torusField::applyMaxDist
     //
     outputForce.clear();
 
+    if( useTree )
+    {
+        applyMaxDistTree( block, posArray, points, velocities, outputForce );
+        return;
+    }
+
     // get field parameters.
     //
     double magValue = magnitudeValue( block );
@@ -503,14 +445,6 @@ void torusField::applyMaxDist
     double dragMag = dragValue( block );
     double swarmAmp = swarmAmplitudeValue( block );
 
-    // get owner's data. posArray may have only one point which is the centroid
-    // (if this has owner) or field position(if without owner). Or it may have
-    // a list of points if with owner and applyPerVertex.
-    //
-    MVectorArray posArray;
-    posArray.clear();
-    ownerPosition( block, posArray );
-
     int fieldPosCount = posArray.length();
     int receptorSize = points.length();
 
@@ -660,6 +594,150 @@ void torusField::applyMaxDist
 }
 
 
+void torusField::applyMaxDistTree
+    (
+        MDataBlock& block,              // get field param from this block
+        const MVectorArray &posArray,   // field positions
+        const MVectorArray &points,     // current position of Object
+        const MVectorArray &velocities, // current velocity of Object
+        MVectorArray &outputForce       // output force
+    )
+//
+//  Descriptions:
+//      Compute output force in the case that the useMaxDistance and
+//      useSpatialTree are set. Only the field positions within maxDistance
+//      of a receptor are visited, through an octree, and receptors are
+//      computed in parallel.
+//
+//      Each field position between minDistance and maxDistance applies
+//      its own force: the attenuated or attract-repel force, plus drag
+//      and swarm in the swarm zone, times the falloff curve. The serial
+//      loops of applyMaxDist() differ where the force of one position
+//      leaks into the next: forceV is carried from position to position,
+//      positions out of range add it again with attenuation, a swarm
+//      noise out of range drops the position, and without attenuation the
+//      swarm loop ends the loop over the positions.
+//
+//      The falloff curve cannot be read from several threads, so it is
+//      sampled kFalloffSamples times before the receptors are computed and
+//      interpolated linearly between the samples. Each receptor sums its
+//      positions in the order the octree visits them, which does not
+//      depend on the number of threads.
+//
+{
+    double magValue = magnitudeValue( block );
+    double attenValue = attenuationValue( block );
+    double maxDist = maxDistanceValue( block );
+    double minDist = minDistanceValue( block );
+    double attractDist = attractDistanceValue( block );
+    double repelDist = repelDistanceValue( block );
+    double dragMag = dragValue( block );
+    double swarmAmp = swarmAmplitudeValue( block );
+    double frequency = swarmFrequencyValue( block );
+    MVector phase( 0.0, 0.0, swarmPhaseValue(block) );
+
+    int fieldPosCount = posArray.length();
+    int receptorSize = points.length();
+
+    std::vector<double> xyz( 3 * (size_t) fieldPosCount );
+    int i;
+    for (i = 0; i < fieldPosCount; i++)
+        posArray[i].get( &xyz[3*i] );
+    fieldOctree::Octree tree;
+    tree.build( xyz.data(), fieldPosCount );
+
+    double falloff[kFalloffSamples + 1];
+    for (i = 0; i <= kFalloffSamples; i++)
+        falloff[i] = (maxDist > 0.0) ? falloffCurve( (double) i / kFalloffSamples ) : 1.0;
+
+    outputForce.setLength( receptorSize );
+    tbb::parallel_for( tbb::blocked_range<int>( 0, receptorSize, kReceptorGrainSize ),
+        [&]( const tbb::blocked_range<int>& r )
+    {
+        for (int ptIndex = r.begin(); ptIndex != r.end(); ptIndex ++ )
+        {
+            const MVector dragForceV = velocities[ptIndex] *
+                                            (-dragMag) * fieldPosCount;
+            MVector sumForceV(0,0,0);
+
+            auto apply = [&]( int, double dx, double dy, double dz, double distance )
+            {
+                MVector difference( dx, dy, dz );
+                MVector forceV(0,0,0);
+                if (attenValue > 0.0)
+                    forceV = difference * ( magValue *
+                                (pow((1.0-(distance/maxDist)),attenValue)) );
+                else if (distance <= repelDist)
+                    forceV = difference * magValue;
+                else if (distance >= attractDist)
+                    forceV = -difference * magValue;
+
+                if ( distance >= repelDist && distance <= attractDist)
+                {
+                    if (dragMag > 0)
+                        forceV += dragForceV;
+
+                    if (swarmAmp > 0)
+                    {
+                        MVector swarmForce;
+                        if (swarmForceAt( difference, phase, frequency, swarmAmp, swarmForce ))
+                            forceV += swarmForce;
+                    }
+                }
+
+                if (maxDist > 0.0)
+                {
+                    double t = distance / maxDist * kFalloffSamples;
+                    int k = (int) t;
+                    if (k >= kFalloffSamples) k = kFalloffSamples - 1;
+                    t -= k;
+                    forceV *= falloff[k] + t * (falloff[k+1] - falloff[k]);
+                }
+                sumForceV += forceV;
+            };
+
+            double p[3];
+            points[ptIndex].get( p );
+            tree.visitWithin( p, minDist, maxDist, apply );
+            outputForce[ptIndex] = sumForceV;
+        }
+    });
+}
+
+
+bool torusField::swarmForceAt
+    (
+        const MVector &difference,      // receptor - field position
+        const MVector &phase,
+        double frequency,
+        double swarmAmp,
+        MVector &swarmForce
+    )
+//
+//  Descriptions:
+//      Swarm force of one field position. Returns false, and no force,
+//      when the noise argument is out of the range of the noise lattice.
+//
+{
+    MVector noiseArg = (difference + phase) * frequency;
+    double *noiseEffect = &noiseArg.x;
+    if( (noiseEffect[0] < -2147483647.0) ||
+        (noiseEffect[0] >  2147483647.0) ||
+        (noiseEffect[1] < -2147483647.0) ||
+        (noiseEffect[1] >  2147483647.0) ||
+        (noiseEffect[2] < -2147483647.0) ||
+        (noiseEffect[2] >  2147483647.0) )
+        return false;
+
+    double noiseOut[4];
+    noiseFunction( noiseEffect, noiseOut );
+    swarmForce = MVector( noiseOut[0] * swarmAmp,
+                          noiseOut[1] * swarmAmp,
+                          noiseOut[2] * swarmAmp );
+    return true;
+}
+
+
 void torusField::ownerPosition
     (
         MDataBlock& block,
@@ -836,14 +914,20 @@ MStatus torusField::getForceAtPoint(const MVectorArray& points,
 {
     MDataBlock block = forceCache();
 
+    MVectorArray posArray;
+    ownerPosition( block, posArray );
+    bool useTree = useSpatialTreeValue( block );
+
     bool useMaxDistSet = useMaxDistanceValue( block );
     if( useMaxDistSet )
     {
-        applyMaxDist( block, points, velocities, masses, forceArray );
+        applyMaxDist( block, posArray, useTree, points, velocities, masses,
+                      forceArray );
     }
     else
     {
-        applyNoMaxDist( block, points, velocities, masses, forceArray );
+        applyNoMaxDist( block, posArray, useTree, points, velocities, masses,
+                        forceArray );
     }
 
     return MS::kSuccess;
@@ -896,8 +980,14 @@ MStatus torusField::iconBitmap(GLubyte* bitmap)
 #define rand3c(x,y,z)   frand(89*(x)+97*(y)+101*(z))
 #define rand3d(x,y,z)   frand(103*(x)+107*(y)+109*(z))
 
-int     xlim[3][2];     // integer bound for point
-double  xarg[3];        // fractional part
+// Lattice cell of a noise evaluation, on the stack of the caller so
+// that receptors can be computed in parallel.
+//
+struct NoiseCell
+{
+    int     xlim[3][2];     // integer bound for point
+    double  xarg[3];        // fractional part
+};
 
 double frand( int s )   // get random number from seed
 {
@@ -916,13 +1006,15 @@ double hermite( double p0, double p1, double r0, double r1, double t )
     return(p0*(_2t3-_3t2+1) + p1*(-_2t3+_3t2) + r0*(t3-2.*t2+t) + r1*(t3-t2));
 }
 
-void interpolate( double f[4], int i, int n )
+void interpolate( const NoiseCell& c, double f[4], int i, int n )
 //
 //  f[] returned tangent and value *
 //  i   location ?
 //  n   order
 //
 {
+    const int (&xlim)[3][2] = c.xlim;
+    const double (&xarg)[3] = c.xarg;
     double f0[4], f1[4] ;  //results for first and second halves
 
     if( n == 0 )    // at 0, return lattice value
@@ -935,8 +1027,8 @@ void interpolate( double f[4], int i, int n )
     }
 
     n--;
-    interpolate( f0, i, n );        // compute first half
-    interpolate( f1, i| 1<<n, n );  // compute second half
+    interpolate( c, f0, i, n );         // compute first half
+    interpolate( c, f1, i| 1<<n, n );   // compute second half
 
     // use linear interpolation for slopes
     //
@@ -955,6 +1047,10 @@ void torusField::noiseFunction( double *inNoise, double *out )
 //      A noise function.
 //
 {
+    NoiseCell c;
+    int (&xlim)[3][2] = c.xlim;
+    double (&xarg)[3] = c.xarg;
+
     xlim[0][0] = (int)floor( inNoise[0] );
     xlim[0][1] = xlim[0][0] + 1;
     xlim[1][0] = (int)floor( inNoise[1] );
@@ -966,7 +1062,7 @@ void torusField::noiseFunction( double *inNoise, double *out )
     xarg[1] = inNoise[1] - xlim[1][0];
     xarg[2] = inNoise[2] - xlim[2][0];
 
-    interpolate( out, 0, 3 ) ;
+    interpolate( c, out, 0, 3 ) ;
 }
 
 #define TORUS_PI 3.14159265
@@ -1006,6 +1102,169 @@ void torusField::draw( M3dView& view, const MDagPath& path, M3dView::DisplayStyl
 }
 
 
+//
+//  torusFieldBenchmark [-receptors N]... [-fieldPositions M]... torusFieldNode
+//
+//  For every N and M, computes the force of M random field positions in a
+//  100 unit cube on N random receptors with random velocities, with the
+//  attributes of the given torusField node, once through the loops over
+//  every field position and once through the octree. The paths are the
+//  ones compute() runs, chosen by the node's useMaxDistance. Both run on
+//  one thread, so that their ratio only measures the octree. Returns N,
+//  M, the loop time, the octree time (build included) and the largest
+//  difference between the forces, for each pair. With max distance, the
+//  difference includes the forces the serial loops carry from one field
+//  position to the next (see applyMaxDistTree()).
+//
+#define kReceptorsFlag              "-r"
+#define kReceptorsFlagLong          "-receptors"
+#define kFieldPositionsFlag         "-fp"
+#define kFieldPositionsFlagLong     "-fieldPositions"
+
+class torusFieldBenchmarkCmd : public MPxCommand
+{
+public:
+    MStatus         doIt( const MArgList& args ) override;
+
+    static void     *creator();
+    static MSyntax  newSyntax();
+};
+
+void *torusFieldBenchmarkCmd::creator()
+{
+    return new torusFieldBenchmarkCmd;
+}
+
+MSyntax torusFieldBenchmarkCmd::newSyntax()
+{
+    MSyntax syntax;
+    syntax.addFlag( kReceptorsFlag, kReceptorsFlagLong, MSyntax::kLong );
+    syntax.makeFlagMultiUse( kReceptorsFlag );
+    syntax.addFlag( kFieldPositionsFlag, kFieldPositionsFlagLong, MSyntax::kLong );
+    syntax.makeFlagMultiUse( kFieldPositionsFlag );
+    syntax.setObjectType( MSyntax::kStringObjects, 1, 1 );
+    return syntax;
+}
+
+static void randomVectors( std::mt19937& rng, int count, double range,
+                           MVectorArray& vectors )
+{
+    std::uniform_real_distribution<double> coord( -range, range );
+    vectors.setLength( count );
+    for (int i = 0; i < count; i++)
+    {
+        double x = coord( rng ), y = coord( rng ), z = coord( rng );
+        vectors[i] = MVector( x, y, z );
+    }
+}
+
+MStatus torusFieldBenchmarkCmd::doIt( const MArgList& args )
+{
+    MStatus status;
+    MArgDatabase argData( syntax(), args, &status );
+    if (!status) return status;
+
+    std::vector<int> receptorCounts, positionCounts;
+    unsigned int i, j;
+    for (i = 0; i < argData.numberOfFlagUses( kReceptorsFlag ); i++)
+    {
+        MArgList flagArgs;
+        argData.getFlagArgumentList( kReceptorsFlag, i, flagArgs );
+        receptorCounts.push_back( flagArgs.asInt( 0 ) );
+    }
+    for (i = 0; i < argData.numberOfFlagUses( kFieldPositionsFlag ); i++)
+    {
+        MArgList flagArgs;
+        argData.getFlagArgumentList( kFieldPositionsFlag, i, flagArgs );
+        positionCounts.push_back( flagArgs.asInt( 0 ) );
+    }
+    if (receptorCounts.empty())
+        receptorCounts.push_back( 10000 );
+    if (positionCounts.empty())
+        positionCounts.push_back( 1000 );
+
+    MStringArray names;
+    argData.getObjects( names );
+    MSelectionList list;
+    MObject node;
+    if (!list.add( names[0] ) || !list.getDependNode( 0, node ))
+    {
+        displayError( "No node " + names[0] );
+        return MS::kInvalidParameter;
+    }
+    MFnDependencyNode fnNode( node );
+    if (fnNode.typeId() != torusField::id)
+    {
+        displayError( names[0] + " is not a torusField node." );
+        return MS::kInvalidParameter;
+    }
+    torusField *field = (torusField *) fnNode.userNode();
+    MDataBlock block = field->forceCache();
+    bool useMaxDistSet = field->useMaxDistanceValue( block );
+
+    MDoubleArray result;
+    tbb::task_arena arena( 1 );
+
+    for (i = 0; i < receptorCounts.size(); i++)
+    for (j = 0; j < positionCounts.size(); j++)
+    {
+        const int receptorSize = receptorCounts[i];
+        const int fieldPosCount = positionCounts[j];
+        if (receptorSize <= 0 || fieldPosCount <= 0)
+        {
+            displayError( "The receptor and field position counts must be positive." );
+            return MS::kInvalidParameter;
+        }
+
+        std::mt19937 rng( 1 );
+        MVectorArray receptors, velocities, positions;
+        randomVectors( rng, receptorSize, 50.0, receptors );
+        randomVectors( rng, receptorSize, 1.0, velocities );
+        randomVectors( rng, fieldPosCount, 50.0, positions );
+        MDoubleArray masses( receptorSize, 1.0 );
+        MVectorArray loopForce, treeForce;
+
+        // Both paths on one thread: the max distance loops are serial, and
+        // the receptors of the others would be split across all the threads
+        MTimer timer;
+        double loopTime = 0.0, treeTime = 0.0;
+        arena.execute( [&]
+        {
+            for (int useTree = 0; useTree < 2; useTree++)
+            {
+                MVectorArray& force = useTree ? treeForce : loopForce;
+                timer.beginTimer();
+                if (useMaxDistSet)
+                    field->applyMaxDist( block, positions, useTree != 0,
+                                         receptors, velocities, masses, force );
+                else
+                    field->applyNoMaxDist( block, positions, useTree != 0,
+                                           receptors, velocities, masses, force );
+                timer.endTimer();
+                (useTree ? treeTime : loopTime) = timer.elapsedTime();
+            }
+        });
+
+        double maxDifference = 0.0;
+        for (int k = 0; k < receptorSize; k++)
+        {
+            MVector d = loopForce[k] - treeForce[k];
+            maxDifference = std::max( maxDifference,
+                                      std::max( fabs( d.x ), std::max( fabs( d.y ), fabs( d.z ) ) ) );
+        }
+
+        result.append( receptorSize );
+        result.append( fieldPosCount );
+        result.append( loopTime );
+        result.append( treeTime );
+        result.append( maxDifference );
+    }
+
+    setResult( result );
+    return MS::kSuccess;
+}
+
+
 MStatus initializePlugin(MObject obj)
 {
     MStatus status;
@@ -1019,6 +1278,14 @@ MStatus initializePlugin(MObject obj)
         return status;
     }
 
+    status = plugin.registerCommand( "torusFieldBenchmark",
+                                     torusFieldBenchmarkCmd::creator,
+                                     torusFieldBenchmarkCmd::newSyntax );
+    if (!status) {
+        status.perror("registerCommand");
+        return status;
+    }
+
     return status;
 }
 
@@ -1027,6 +1294,12 @@ MStatus uninitializePlugin(MObject obj)
     MStatus status;
     MFnPlugin plugin(obj);
 
+    status = plugin.deregisterCommand( "torusFieldBenchmark" );
+    if (!status) {
+        status.perror("deregisterCommand");
+        return status;
+    }
+
     status = plugin.deregisterNode( torusField::id );
     if (!status) {
         status.perror("deregisterNode");
@@ -94,30 +94,48 @@ public:
     //
     static MObject  aSwarmPhase;
 
+    // evaluate through an octree of the field positions, in parallel.
+    //
+    static MObject  aUseSpatialTree;
+
     // Other data members
     //
     static MTypeId  id;
 
 private:
+    friend class torusFieldBenchmarkCmd;
 
     // methods to compute output force.
     //
     void    applyNoMaxDist( MDataBlock& block,
+                            const MVectorArray &posArray,
+                            bool useTree,
                             const MVectorArray &points,
                             const MVectorArray &velocities,
                             const MDoubleArray &masses,
                             MVectorArray &outputForce );
 
     void    applyMaxDist( MDataBlock& block,
+                            const MVectorArray &posArray,
+                            bool useTree,
                             const MVectorArray &points,
                             const MVectorArray &velocities,
                             const MDoubleArray &masses,
                             MVectorArray &outputForce );
 
+    void    applyMaxDistTree( MDataBlock& block,
+                            const MVectorArray &posArray,
+                            const MVectorArray &points,
+                            const MVectorArray &velocities,
+                            MVectorArray &outputForce );
+
     void    ownerPosition( MDataBlock& block, MVectorArray &vArray );
     MStatus getWorldPosition( MVector &vector );
     MStatus getWorldPosition( MDataBlock& block, MVector &vector );
-    void    noiseFunction( double *inputNoise, double *out );
+    static void noiseFunction( double *inputNoise, double *out );
+    static bool swarmForceAt( const MVector &difference, const MVector &phase,
+                              double frequency, double swarmAmp,
+                              MVector &swarmForce );
 
     // methods to get attribute value.
     //
@@ -136,6 +154,7 @@ private:
     double  swarmAmplitudeValue( MDataBlock& block );
     double  swarmFrequencyValue( MDataBlock& block );
     double  swarmPhaseValue( MDataBlock& block );
+    bool    useSpatialTreeValue( MDataBlock& block );
 
     MStatus ownerCentroidValue( MDataBlock& block, MVector &vector );
 };
@@ -298,6 +317,19 @@ inline double torusField::swarmPhaseValue( MDataBlock& block )
     return( value );
 }
 
+inline bool torusField::useSpatialTreeValue( MDataBlock& block )
+{
+    MStatus status;
+
+    MDataHandle hValue = block.inputValue( aUseSpatialTree, &status );
+
+    bool value = false;
+    if( status == MS::kSuccess )
+        value = hValue.asBool();
+
+    return( value );
+}
+
 inline MStatus torusField::ownerCentroidValue(MDataBlock& block,MVector &vector)
 {
     MStatus status;